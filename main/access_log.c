@@ -0,0 +1,1089 @@
+#include "access_log.h"
+#include "card_record.h"
+#include "card_index.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+static const char *TAG = "ACCESS_LOG";
+
+#define ACCESS_LOG_SECTOR_SIZE      4096
+#define ACCESS_LOG_BLOCK_MAGIC      0x4243  // "CB"
+#define ACCESS_LOG_BLOCK_VERSION    2
+#define ACCESS_LOG_SUMMARY_MAGIC    0x5342  // "BS"
+#define ACCESS_LOG_BLOOM_BYTES      256     // 2048 bits, 3 funções: ~3% de falso positivo com 255 UIDs
+#define ACCESS_LOG_BLOOM_HASHES     3
+#define ACCESS_LOG_LEGACY_MAGIC     0x4C41  // registros fixos de 48 bytes (formato antigo)
+
+// Bloco = setor: cabeçalho + eventos até o primeiro byte apagado (0xFF) +
+// resumo no fim do setor, gravado quando o bloco é fechado.
+// Evento:
+//   tag      u8   ação << 4 | UID_NOVO | índice (0..6; 7 = índice em varint)
+//   [ação]   u8 tamanho + texto, só para ações fora da tabela (código 0)
+//   [uid]    u8 tamanho + bytes, se UID_NOVO (vira a próxima entrada do
+//            dicionário do bloco)
+//   [índice] varint(índice - 7), se o índice não coube na tag
+//   delta    varint zigzag do timestamp em relação ao evento anterior
+//   crc      u8   CRC8 dos bytes anteriores do evento
+// Um cartão que volta no mesmo bloco custa 3-4 bytes (48 no formato antigo).
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t reserved;
+    uint32_t first_seq;
+    uint32_t base_ts;
+    uint32_t crc;           // CRC32 dos campos anteriores
+} access_log_block_header_t;
+
+// Resumo do bloco: intervalo de timestamps e filtro de Bloom dos UIDs,
+// para as consultas pularem blocos sem descomprimi-los
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint16_t count;
+    uint32_t min_ts;
+    uint32_t max_ts;
+    uint8_t bloom[ACCESS_LOG_BLOOM_BYTES];
+    uint32_t crc;           // CRC32 dos campos anteriores
+} access_log_block_summary_t;
+
+#define BLOCK_HEADER_CRC_LEN    offsetof(access_log_block_header_t, crc)
+#define BLOCK_DATA_START        sizeof(access_log_block_header_t)
+#define BLOCK_DATA_END          (ACCESS_LOG_SECTOR_SIZE - sizeof(access_log_block_summary_t))
+#define SUMMARY_CRC_LEN         offsetof(access_log_block_summary_t, crc)
+
+#define TAG_ACTION_SHIFT        4
+#define TAG_NEW_UID             0x08
+#define TAG_INDEX_MASK          0x07
+#define TAG_INDEX_ESCAPE        0x07
+#define TAG_ERASED              0xFF
+
+#define ACTION_INLINE           0       // texto gravado no evento
+#define DICT_MAX                255     // UIDs distintos por bloco
+#define EVENT_MIN_SIZE          3       // tag + delta + crc
+#define EVENT_MAX_SIZE          (1 + 1 + MAX_ACTION_LENGTH + 1 + CARD_UID_MAX_BYTES + 5 + 5 + 1)
+#define CHECKPOINT_EVENTS       16      // eventos entre pontos de retomada do cache
+#define CHECKPOINT_MAX          ((BLOCK_DATA_END - BLOCK_DATA_START) / EVENT_MIN_SIZE / CHECKPOINT_EVENTS + 1)
+
+// Códigos 1..14 (15 faria a tag parecer flash apagado)
+static const char *const s_action_names[] = {
+    [1] = "ACCESS_GRANTED",
+    [2] = "ACCESS_DENIED",
+    [3] = "CARD_ADDED",
+    [4] = "ADD_FAILED",
+};
+#define ACTION_COUNT  (sizeof(s_action_names) / sizeof(s_action_names[0]))
+
+_Static_assert(ACTION_COUNT <= 15, "códigos de ação cabem em 4 bits (15 reservado)");
+
+// Evento decodificado; os ponteiros apontam para os bytes do bloco
+typedef struct {
+    uint32_t seq;
+    uint32_t timestamp;
+    const uint8_t *uid;
+    uint8_t uid_len;
+    uint8_t action_code;
+    const char *action_text;    // só para ACTION_INLINE
+    uint8_t action_len;
+} log_event_t;
+
+// Posição de leitura dentro de um bloco
+typedef struct {
+    const uint8_t *data;        // setor inteiro
+    uint32_t pos;
+    uint32_t seq;               // sequência do próximo evento
+    uint32_t timestamp;         // do evento anterior (base_ts no início)
+    uint32_t dict_count;
+    uint16_t *dict;             // offset de [tamanho][uid] de cada entrada
+} block_cursor_t;
+
+// Cache do último bloco lido pelo leitor reverso: o setor inteiro e o
+// estado do decodificador a cada CHECKPOINT_EVENTS eventos, para chegar a
+// qualquer sequência decodificando no máximo CHECKPOINT_EVENTS eventos
+typedef struct {
+    uint32_t sector;
+    uint32_t first_seq;         // 0 = vazio
+    uint32_t count;             // eventos válidos no bloco
+    bool sealed;                // lido depois de o bloco sair da escrita
+    uint16_t dict[DICT_MAX];
+    struct {
+        uint16_t pos;
+        uint8_t dict_count;
+        uint32_t timestamp;
+    } checkpoints[CHECKPOINT_MAX];
+    uint8_t data[ACCESS_LOG_SECTOR_SIZE];
+} block_cache_t;
+
+static const esp_partition_t *s_partition = NULL;
+static SemaphoreHandle_t s_log_mutex = NULL;
+static uint32_t s_sector_count = 0;
+// Por setor, em RAM: o bloco e o intervalo de timestamps do resumo
+typedef struct {
+    uint32_t first_seq;     // 0 = sem bloco válido
+    uint32_t min_ts;
+    uint32_t max_ts;
+    bool has_bloom;         // resumo íntegro no flash (ou bloco em escrita)
+} block_info_t;
+
+static block_info_t *s_blocks = NULL;
+static uint32_t s_head_sector = 0;          // setor em escrita
+static uint32_t s_head_fill = 0;            // bytes usados no setor em escrita
+static uint32_t s_head_flushed = 0;         // bytes já gravados no flash
+static uint32_t s_head_count = 0;           // eventos no bloco em escrita
+static uint32_t s_head_last_ts = 0;
+static uint32_t s_head_dict_count = 0;
+static uint16_t s_head_dict[DICT_MAX];
+static uint8_t s_head_bloom[ACCESS_LOG_BLOOM_BYTES];
+static uint32_t s_next_seq = 1;
+static uint8_t *s_sector_buf = NULL;        // cópia em RAM do setor em escrita
+static block_cache_t *s_cache = NULL;
+
+static esp_err_t erase_sector(uint32_t sector) {
+    memset(&s_blocks[sector], 0, sizeof(block_info_t));
+    return esp_partition_erase_range(s_partition, sector * ACCESS_LOG_SECTOR_SIZE,
+                                     ACCESS_LOG_SECTOR_SIZE);
+}
+
+static uint32_t header_crc(const access_log_block_header_t *header) {
+    return esp_rom_crc32_le(0, (const uint8_t *)header, BLOCK_HEADER_CRC_LEN);
+}
+
+static bool header_valid(const access_log_block_header_t *header) {
+    return header->magic == ACCESS_LOG_BLOCK_MAGIC &&
+           header->version == ACCESS_LOG_BLOCK_VERSION &&
+           header->first_seq != 0 &&
+           header->crc == header_crc(header);
+}
+
+static inline uint32_t zigzag_encode(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t zigzag_decode(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// varint_decode (card_record.h) limitado ao fim dos dados do bloco
+static bool read_varint(const uint8_t *data, uint32_t *pos, uint32_t *value) {
+    if (*pos >= BLOCK_DATA_END) {
+        return false;
+    }
+    size_t n = varint_decode(&data[*pos], BLOCK_DATA_END - *pos, value);
+    *pos += n;
+    return n > 0;
+}
+
+static uint8_t action_code(const char *action) {
+    for (uint8_t code = 1; code < ACTION_COUNT; code++) {
+        if (s_action_names[code] && strcmp(action, s_action_names[code]) == 0) {
+            return code;
+        }
+    }
+    return ACTION_INLINE;
+}
+
+static void block_cursor_init(block_cursor_t *cursor, const uint8_t *data, uint16_t *dict) {
+    const access_log_block_header_t *header = (const access_log_block_header_t *)data;
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->data = data;
+    cursor->pos = BLOCK_DATA_START;
+    cursor->seq = header->first_seq;
+    cursor->timestamp = header->base_ts;
+    cursor->dict = dict;
+}
+
+// ESP_ERR_NOT_FOUND no fim do bloco; ESP_ERR_INVALID_CRC se o evento está
+// incompleto ou corrompido (queda de energia durante a gravação)
+static esp_err_t block_decode_next(block_cursor_t *cursor, log_event_t *event) {
+    const uint8_t *data = cursor->data;
+    uint32_t start = cursor->pos;
+    if (start >= BLOCK_DATA_END || data[start] == TAG_ERASED) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint32_t pos = start;
+    uint8_t tag = data[pos++];
+    event->action_code = tag >> TAG_ACTION_SHIFT;
+    event->action_text = NULL;
+    event->action_len = 0;
+    if (event->action_code == ACTION_INLINE) {
+        if (pos >= BLOCK_DATA_END || data[pos] >= MAX_ACTION_LENGTH ||
+            pos + 1 + data[pos] > BLOCK_DATA_END) {
+            return ESP_ERR_INVALID_CRC;
+        }
+        event->action_len = data[pos];
+        event->action_text = (const char *)&data[pos + 1];
+        pos += 1 + event->action_len;
+    } else if (event->action_code >= ACTION_COUNT) {
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    uint32_t index;
+    uint32_t dict_count = cursor->dict_count;
+    if (tag & TAG_NEW_UID) {
+        if ((tag & TAG_INDEX_MASK) || dict_count >= DICT_MAX || pos >= BLOCK_DATA_END ||
+            data[pos] > CARD_UID_MAX_BYTES || pos + 1 + data[pos] > BLOCK_DATA_END) {
+            return ESP_ERR_INVALID_CRC;
+        }
+        index = dict_count++;
+        cursor->dict[index] = (uint16_t)pos;
+        pos += 1 + data[pos];
+    } else {
+        index = tag & TAG_INDEX_MASK;
+        if (index == TAG_INDEX_ESCAPE) {
+            uint32_t extra;
+            if (!read_varint(data, &pos, &extra)) {
+                return ESP_ERR_INVALID_CRC;
+            }
+            index += extra;
+        }
+        if (index >= dict_count) {
+            return ESP_ERR_INVALID_CRC;
+        }
+    }
+
+    uint32_t delta;
+    if (!read_varint(data, &pos, &delta) || pos >= BLOCK_DATA_END ||
+        data[pos] != esp_rom_crc8_le(0, &data[start], pos - start)) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    pos++;
+
+    cursor->pos = pos;
+    cursor->dict_count = dict_count;
+    cursor->timestamp += (uint32_t)zigzag_decode(delta);
+    event->seq = cursor->seq++;
+    event->timestamp = cursor->timestamp;
+    event->uid_len = data[cursor->dict[index]];
+    event->uid = &data[cursor->dict[index] + 1];
+    return ESP_OK;
+}
+
+static void event_to_entry(const log_event_t *event, access_log_t *entry) {
+    memset(entry, 0, sizeof(*entry));
+    entry->id = event->seq;
+    entry->timestamp = event->timestamp;
+    card_uid_format(event->uid, event->uid_len, entry->uid, sizeof(entry->uid));
+    if (event->action_code == ACTION_INLINE) {
+        memcpy(entry->action, event->action_text, event->action_len);
+    } else if (s_action_names[event->action_code]) {
+        strncpy(entry->action, s_action_names[event->action_code], MAX_ACTION_LENGTH - 1);
+    }
+}
+
+// Codifica um evento do bloco em escrita; dict_index < 0 define um UID novo.
+// Retorna o tamanho e, para UID novo, o offset da entrada do dicionário.
+static uint32_t encode_event(uint8_t *out, uint8_t code, const char *action, int dict_index,
+                             const uint8_t *uid, uint8_t uid_len, uint32_t timestamp,
+                             uint32_t *dict_offset) {
+    uint32_t len = 1;
+    uint8_t tag = code << TAG_ACTION_SHIFT;
+    if (code == ACTION_INLINE) {
+        uint8_t action_len = (uint8_t)strnlen(action, MAX_ACTION_LENGTH - 1);
+        out[len++] = action_len;
+        memcpy(&out[len], action, action_len);
+        len += action_len;
+    }
+    if (dict_index < 0) {
+        tag |= TAG_NEW_UID;
+        *dict_offset = len;
+        out[len++] = uid_len;
+        memcpy(&out[len], uid, uid_len);
+        len += uid_len;
+    } else if (dict_index < TAG_INDEX_ESCAPE) {
+        tag |= (uint8_t)dict_index;
+    } else {
+        tag |= TAG_INDEX_ESCAPE;
+        len += varint_encode((uint32_t)dict_index - TAG_INDEX_ESCAPE, &out[len]);
+    }
+    out[0] = tag;
+    len += varint_encode(zigzag_encode((int32_t)(timestamp - s_head_last_ts)), &out[len]);
+    out[len] = esp_rom_crc8_le(0, out, len);
+    return len + 1;
+}
+
+static int head_dict_find(const uint8_t *uid, uint8_t uid_len) {
+    for (uint32_t i = 0; i < s_head_dict_count; i++) {
+        const uint8_t *entry = &s_sector_buf[s_head_dict[i]];
+        if (entry[0] == uid_len && memcmp(&entry[1], uid, uid_len) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// Filtro de Bloom do resumo: dupla hash sobre o hash do UID
+static void bloom_bits(const uint8_t *uid, uint8_t uid_len, uint32_t bits[ACCESS_LOG_BLOOM_HASHES]) {
+    uint32_t h1 = card_index_hash(uid, uid_len);
+    uint32_t h2 = ((h1 >> 16) | (h1 << 16)) * 0x9E3779B1u | 1;
+    for (uint32_t i = 0; i < ACCESS_LOG_BLOOM_HASHES; i++) {
+        bits[i] = (h1 + i * h2) % (ACCESS_LOG_BLOOM_BYTES * 8);
+    }
+}
+
+static void bloom_add(uint8_t *bloom, const uint8_t *uid, uint8_t uid_len) {
+    uint32_t bits[ACCESS_LOG_BLOOM_HASHES];
+    bloom_bits(uid, uid_len, bits);
+    for (uint32_t i = 0; i < ACCESS_LOG_BLOOM_HASHES; i++) {
+        bloom[bits[i] / 8] |= 1 << (bits[i] % 8);
+    }
+}
+
+static bool bloom_test(const uint8_t *bloom, const uint8_t *uid, uint8_t uid_len) {
+    uint32_t bits[ACCESS_LOG_BLOOM_HASHES];
+    bloom_bits(uid, uid_len, bits);
+    for (uint32_t i = 0; i < ACCESS_LOG_BLOOM_HASHES; i++) {
+        if (!(bloom[bits[i] / 8] & (1 << (bits[i] % 8)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint32_t summary_crc(const access_log_block_summary_t *summary) {
+    return esp_rom_crc32_le(0, (const uint8_t *)summary, SUMMARY_CRC_LEN);
+}
+
+// Decodifica o bloco inteiro e monta o resumo; retorna o resultado da
+// última decodificação (ESP_ERR_NOT_FOUND = fim normal)
+static esp_err_t block_summarize(const uint8_t *data, uint16_t *dict, access_log_block_summary_t *summary,
+                                 block_cursor_t *cursor) {
+    log_event_t event;
+    esp_err_t ret;
+    memset(summary, 0, sizeof(*summary));
+    summary->magic = ACCESS_LOG_SUMMARY_MAGIC;
+    block_cursor_init(cursor, data, dict);
+    while ((ret = block_decode_next(cursor, &event)) == ESP_OK) {
+        if (summary->count == 0 || event.timestamp < summary->min_ts) {
+            summary->min_ts = event.timestamp;
+        }
+        if (summary->count == 0 || event.timestamp > summary->max_ts) {
+            summary->max_ts = event.timestamp;
+        }
+        bloom_add(summary->bloom, event.uid, event.uid_len);
+        summary->count++;
+    }
+    summary->crc = summary_crc(summary);
+    return ret;
+}
+
+static void head_reset(void) {
+    s_head_fill = 0;
+    s_head_flushed = 0;
+    s_head_count = 0;
+    s_head_dict_count = 0;
+    memset(s_sector_buf, 0xFF, ACCESS_LOG_SECTOR_SIZE);
+    memset(s_head_bloom, 0, sizeof(s_head_bloom));
+}
+
+// Cabeçalho do bloco em escrita, criado no primeiro evento do setor
+static void head_begin_block(uint32_t timestamp) {
+    access_log_block_header_t header = {
+        .magic = ACCESS_LOG_BLOCK_MAGIC,
+        .version = ACCESS_LOG_BLOCK_VERSION,
+        .first_seq = s_next_seq,
+        .base_ts = timestamp,
+    };
+    header.crc = header_crc(&header);
+    memcpy(s_sector_buf, &header, sizeof(header));
+    s_head_fill = BLOCK_DATA_START;
+    s_head_last_ts = timestamp;
+    s_blocks[s_head_sector] = (block_info_t) {
+        .first_seq = s_next_seq,
+        .min_ts = timestamp,
+        .max_ts = timestamp,
+        .has_bloom = true,
+    };
+}
+
+// Resumo do bloco em escrita, mantido em RAM a cada evento
+static void head_note_event(const uint8_t *uid, uint8_t uid_len, uint32_t timestamp) {
+    block_info_t *info = &s_blocks[s_head_sector];
+    if (timestamp < info->min_ts) {
+        info->min_ts = timestamp;
+    }
+    if (timestamp > info->max_ts) {
+        info->max_ts = timestamp;
+    }
+    bloom_add(s_head_bloom, uid, uid_len);
+}
+
+// Grava no flash os bytes do buffer ainda não persistidos
+static esp_err_t flush_locked(void) {
+    if (s_head_flushed == s_head_fill) {
+        return ESP_OK;
+    }
+    esp_err_t ret = esp_partition_write(s_partition,
+                                        s_head_sector * ACCESS_LOG_SECTOR_SIZE + s_head_flushed,
+                                        &s_sector_buf[s_head_flushed], s_head_fill - s_head_flushed);
+    if (ret == ESP_OK) {
+        s_head_flushed = s_head_fill;
+    }
+    return ret;
+}
+
+// Fecha o bloco em escrita gravando o resumo no fim do setor
+static void seal_head_locked(void) {
+    block_info_t *info = &s_blocks[s_head_sector];
+    if (s_head_count == 0) {
+        return;
+    }
+    if (s_sector_buf[BLOCK_DATA_END] != 0xFF) {
+        info->has_bloom = true; // recuperado de um bloco já fechado
+        return;
+    }
+    access_log_block_summary_t summary = {
+        .magic = ACCESS_LOG_SUMMARY_MAGIC,
+        .count = (uint16_t)s_head_count,
+        .min_ts = info->min_ts,
+        .max_ts = info->max_ts,
+    };
+    memcpy(summary.bloom, s_head_bloom, sizeof(summary.bloom));
+    summary.crc = summary_crc(&summary);
+    info->has_bloom = esp_partition_write(s_partition, s_head_sector * ACCESS_LOG_SECTOR_SIZE + BLOCK_DATA_END,
+                                          &summary, sizeof(summary)) == ESP_OK;
+}
+
+// Avança para o próximo setor, apagando o bloco mais antigo (wraparound)
+static esp_err_t advance_sector_locked(void) {
+    esp_err_t ret = flush_locked();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    seal_head_locked();
+    uint32_t next = (s_head_sector + 1) % s_sector_count;
+    ret = erase_sector(next);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    s_head_sector = next;
+    head_reset();
+    return ESP_OK;
+}
+
+// Primeiro evento ainda presente: o bloco válido mais antigo na ordem do anel
+static uint32_t oldest_seq_locked(void) {
+    for (uint32_t i = 1; i <= s_sector_count; i++) {
+        uint32_t sector = (s_head_sector + i) % s_sector_count;
+        if (s_blocks[sector].first_seq != 0) {
+            return s_blocks[sector].first_seq;
+        }
+    }
+    return s_next_seq;
+}
+
+// Registros fixos de 48 bytes ou blocos de outra versão: descartados,
+// como os logs antigos do NVS
+static bool partition_needs_format(void) {
+    for (uint32_t s = 0; s < s_sector_count; s++) {
+        access_log_block_header_t header;
+        if (esp_partition_read(s_partition, s * ACCESS_LOG_SECTOR_SIZE, &header, sizeof(header)) != ESP_OK) {
+            continue;
+        }
+        if (header.magic == ACCESS_LOG_LEGACY_MAGIC ||
+            (header.magic == ACCESS_LOG_BLOCK_MAGIC && header.version != ACCESS_LOG_BLOCK_VERSION)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Resumo de um bloco fechado; se faltar (queda antes de fechar o bloco) é
+// refeito decodificando o setor e gravado se a área ainda estiver apagada
+static esp_err_t recover_summary(uint32_t sector) {
+    block_info_t *info = &s_blocks[sector];
+    access_log_block_summary_t summary;
+    size_t offset = sector * ACCESS_LOG_SECTOR_SIZE + BLOCK_DATA_END;
+    esp_err_t ret = esp_partition_read(s_partition, offset, &summary, sizeof(summary));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (summary.magic == ACCESS_LOG_SUMMARY_MAGIC && summary.crc == summary_crc(&summary)) {
+        info->min_ts = summary.min_ts;
+        info->max_ts = summary.max_ts;
+        info->has_bloom = true;
+        return ESP_OK;
+    }
+
+    bool erased = true;
+    for (size_t i = 0; i < sizeof(summary) && erased; i++) {
+        erased = ((const uint8_t *)&summary)[i] == 0xFF;
+    }
+    ret = esp_partition_read(s_partition, sector * ACCESS_LOG_SECTOR_SIZE, s_cache->data, ACCESS_LOG_SECTOR_SIZE);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    block_cursor_t cursor;
+    block_summarize(s_cache->data, s_cache->dict, &summary, &cursor);
+    s_cache->first_seq = 0;
+    info->min_ts = summary.min_ts;
+    info->max_ts = summary.max_ts;
+    info->has_bloom = erased && summary.count > 0 &&
+                      esp_partition_write(s_partition, offset, &summary, sizeof(summary)) == ESP_OK;
+    ESP_LOGW(TAG, "Resumo do bloco no setor %" PRIu32 " refeito (%u eventos)", sector, summary.count);
+    return ESP_OK;
+}
+
+// Localiza o bloco em escrita (maior first_seq) e refaz o estado do
+// codificador decodificando-o; os demais blocos só têm o resumo lido
+static esp_err_t recover_head(void) {
+    if (partition_needs_format()) {
+        ESP_LOGW(TAG, "Log em formato anterior descartado (%" PRIu32 " setores)", s_sector_count);
+        esp_err_t ret = esp_partition_erase_range(s_partition, 0, s_sector_count * ACCESS_LOG_SECTOR_SIZE);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    bool found = false;
+    uint32_t best_sector = 0;
+    uint32_t best_seq = 0;
+    for (uint32_t s = 0; s < s_sector_count; s++) {
+        access_log_block_header_t header;
+        esp_err_t ret = esp_partition_read(s_partition, s * ACCESS_LOG_SECTOR_SIZE, &header, sizeof(header));
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        memset(&s_blocks[s], 0, sizeof(block_info_t));
+        s_blocks[s].first_seq = header_valid(&header) ? header.first_seq : 0;
+        if (s_blocks[s].first_seq && (!found || header.first_seq > best_seq)) {
+            found = true;
+            best_sector = s;
+            best_seq = header.first_seq;
+        }
+    }
+
+    head_reset();
+    if (!found) {
+        // Partição nova (ou ilegível): começar do setor 0
+        s_head_sector = 0;
+        s_next_seq = 1;
+        return erase_sector(0);
+    }
+
+    for (uint32_t s = 0; s < s_sector_count; s++) {
+        if (s != best_sector && s_blocks[s].first_seq != 0) {
+            esp_err_t ret = recover_summary(s);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+        }
+    }
+
+    s_head_sector = best_sector;
+    s_next_seq = best_seq;
+    esp_err_t ret = esp_partition_read(s_partition, best_sector * ACCESS_LOG_SECTOR_SIZE,
+                                       s_sector_buf, ACCESS_LOG_SECTOR_SIZE);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    access_log_block_summary_t summary;
+    block_cursor_t cursor;
+    ret = block_summarize(s_sector_buf, s_head_dict, &summary, &cursor);
+    s_head_count = summary.count;
+    s_head_dict_count = cursor.dict_count;
+    s_head_last_ts = cursor.timestamp;
+    s_head_fill = cursor.pos;
+    s_head_flushed = cursor.pos;
+    s_next_seq = cursor.seq;
+    memcpy(s_head_bloom, summary.bloom, sizeof(s_head_bloom));
+    s_blocks[best_sector].min_ts = summary.min_ts;
+    s_blocks[best_sector].max_ts = summary.max_ts;
+    s_blocks[best_sector].has_bloom = true;
+
+    // Cabeçalho sem nenhum evento íntegro: o setor é reaproveitado
+    if (s_head_count == 0) {
+        head_reset();
+        return erase_sector(best_sector);
+    }
+    // Evento incompleto no fim (ou bloco já fechado): o restante do setor
+    // não pode ser regravado
+    if (ret == ESP_ERR_INVALID_CRC || BLOCK_DATA_END - s_head_fill < EVENT_MIN_SIZE ||
+        s_sector_buf[BLOCK_DATA_END] != 0xFF) {
+        if (ret == ESP_ERR_INVALID_CRC) {
+            ESP_LOGW(TAG, "Evento incompleto no setor %" PRIu32 " - iniciando novo bloco", best_sector);
+        }
+        s_head_flushed = s_head_fill;
+        return advance_sector_locked();
+    }
+    return ESP_OK;
+}
+
+esp_err_t access_log_init(void) {
+    s_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                           ACCESS_LOG_PARTITION_SUBTYPE,
+                                           ACCESS_LOG_PARTITION_LABEL);
+    if (!s_partition) {
+        ESP_LOGE(TAG, "Partição '%s' não encontrada - verifique partitions.csv",
+                 ACCESS_LOG_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    s_sector_count = s_partition->size / ACCESS_LOG_SECTOR_SIZE;
+    if (s_sector_count < 2) {
+        ESP_LOGE(TAG, "Partição de log muito pequena");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (!s_log_mutex) {
+        s_log_mutex = xSemaphoreCreateMutex();
+    }
+    s_sector_buf = malloc(ACCESS_LOG_SECTOR_SIZE);
+    s_blocks = calloc(s_sector_count, sizeof(block_info_t));
+    s_cache = calloc(1, sizeof(block_cache_t));
+    if (!s_log_mutex || !s_sector_buf || !s_blocks || !s_cache) {
+        access_log_deinit();
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = recover_head();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Falha ao recuperar log: %s", esp_err_to_name(ret));
+        access_log_deinit();
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Log de acesso: %" PRIu32 " registros, %" PRIu32 " retidos em %" PRIu32 " setores (setor %" PRIu32 ")",
+             access_log_total(), access_log_retained(), s_sector_count, s_head_sector);
+    return ESP_OK;
+}
+
+void access_log_deinit(void) {
+    if (s_sector_buf) {
+        access_log_flush();
+    }
+    if (s_log_mutex) {
+        xSemaphoreTake(s_log_mutex, portMAX_DELAY);
+    }
+    free(s_sector_buf);
+    free(s_blocks);
+    free(s_cache);
+    s_sector_buf = NULL;
+    s_blocks = NULL;
+    s_cache = NULL;
+    s_partition = NULL;
+    if (s_log_mutex) {
+        xSemaphoreGive(s_log_mutex);
+    }
+}
+
+esp_err_t access_log_append(const char *uid, const char *action, uint32_t timestamp) {
+    if (!uid || !action) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_sector_buf) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint8_t uid_bytes[CARD_UID_MAX_BYTES];
+    uint8_t uid_len;
+    if (card_uid_parse(uid, uid_bytes, &uid_len) != ESP_OK) {
+        uid_len = 0;
+    }
+    uint8_t code = action_code(action);
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(s_log_mutex, portMAX_DELAY);
+
+    uint8_t event[EVENT_MAX_SIZE];
+    uint32_t dict_offset = 0;
+    uint32_t len = 0;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (s_head_count == 0) {
+            head_begin_block(timestamp);
+        }
+        int index = head_dict_find(uid_bytes, uid_len);
+        len = encode_event(event, code, action, index, uid_bytes, uid_len, timestamp, &dict_offset);
+        if ((index >= 0 || s_head_dict_count < DICT_MAX) && s_head_fill + len <= BLOCK_DATA_END) {
+            if (index < 0) {
+                s_head_dict[s_head_dict_count++] = (uint16_t)(s_head_fill + dict_offset);
+            }
+            break;
+        }
+        // Bloco cheio (bytes ou dicionário): grava e começa outro setor
+        ret = advance_sector_locked();
+        if (ret != ESP_OK) {
+            xSemaphoreGive(s_log_mutex);
+            return ret;
+        }
+    }
+
+    memcpy(&s_sector_buf[s_head_fill], event, len);
+    s_head_fill += len;
+    s_head_count++;
+    head_note_event(uid_bytes, uid_len, timestamp);
+    s_head_last_ts = timestamp;
+    s_next_seq++;
+
+    // Sem espaço nem para o menor evento: grava o lote e prepara o próximo setor
+    if (BLOCK_DATA_END - s_head_fill < EVENT_MIN_SIZE) {
+        ret = advance_sector_locked();
+    }
+
+    xSemaphoreGive(s_log_mutex);
+    return ret;
+}
+
+esp_err_t access_log_flush(void) {
+    if (!s_sector_buf) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_log_mutex, portMAX_DELAY);
+    esp_err_t ret = flush_locked();
+    xSemaphoreGive(s_log_mutex);
+    return ret;
+}
+
+uint32_t access_log_total(void) {
+    return s_next_seq - 1;
+}
+
+uint32_t access_log_retained(void) {
+    if (!s_sector_buf) {
+        return 0;
+    }
+    xSemaphoreTake(s_log_mutex, portMAX_DELAY);
+    uint32_t retained = s_next_seq - oldest_seq_locked();
+    xSemaphoreGive(s_log_mutex);
+    return retained;
+}
+
+esp_err_t access_log_reader_begin(access_log_reader_t *reader) {
+    if (!reader) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_sector_buf) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_log_mutex, portMAX_DELAY);
+    reader->next_seq = s_next_seq - 1;
+    reader->oldest_seq = oldest_seq_locked();
+    xSemaphoreGive(s_log_mutex);
+    return ESP_OK;
+}
+
+// Posição no anel: 1 = setor seguinte ao de escrita (o mais antigo),
+// s_sector_count = setor em escrita
+static uint32_t ring_sector(uint32_t pos) {
+    return (s_head_sector + pos) % s_sector_count;
+}
+
+static uint32_t ring_pos(uint32_t sector) {
+    uint32_t pos = (sector + s_sector_count - s_head_sector) % s_sector_count;
+    return pos ? pos : s_sector_count;
+}
+
+// Busca binária da maior posição em [1, hi] com bloco válido e chave <=
+// limit. Na ordem do anel first_seq sempre cresce e min_ts também, enquanto
+// o relógio não volta. Setores sem bloco (o trecho ainda não usado antes da
+// primeira volta, ou um cabeçalho corrompido) são pulados para a direita.
+static bool ring_search_locked(uint32_t hi, bool by_time, uint32_t limit, uint32_t *pos) {
+    bool found = false;
+    uint32_t lo = 1;
+    while (lo <= hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint32_t p = mid;
+        while (p <= hi && s_blocks[ring_sector(p)].first_seq == 0) {
+            p++;
+        }
+        if (p > hi) {
+            hi = mid - 1;
+            continue;
+        }
+        const block_info_t *info = &s_blocks[ring_sector(p)];
+        if ((by_time ? info->min_ts : info->first_seq) <= limit) {
+            found = true;
+            *pos = p;
+            lo = p + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+// Setor do bloco que contém 'seq' (maior first_seq <= seq); *sector é
+// sempre escrito (setor em escrita quando não há bloco)
+static bool find_block_locked(uint32_t seq, uint32_t *sector) {
+    uint32_t pos = s_sector_count;
+    bool found = ring_search_locked(s_sector_count, false, seq, &pos);
+    *sector = ring_sector(pos);
+    return found && seq < s_next_seq;
+}
+
+// first_seq do primeiro bloco válido depois da posição 'pos'
+static uint32_t next_first_seq_locked(uint32_t pos) {
+    for (uint32_t p = pos + 1; p <= s_sector_count; p++) {
+        uint32_t first = s_blocks[ring_sector(p)].first_seq;
+        if (first != 0) {
+            return first;
+        }
+    }
+    return s_next_seq;
+}
+
+// Lê o setor para o cache e registra os pontos de retomada
+static esp_err_t cache_load_locked(uint32_t sector) {
+    block_cache_t *cache = s_cache;
+    cache->first_seq = 0;
+    if (sector == s_head_sector) {
+        memcpy(cache->data, s_sector_buf, ACCESS_LOG_SECTOR_SIZE);
+    } else {
+        esp_err_t ret = esp_partition_read(s_partition, sector * ACCESS_LOG_SECTOR_SIZE,
+                                           cache->data, ACCESS_LOG_SECTOR_SIZE);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    if (!header_valid((const access_log_block_header_t *)cache->data)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    block_cursor_t cursor;
+    log_event_t event;
+    block_cursor_init(&cursor, cache->data, cache->dict);
+    uint32_t count = 0;
+    while (true) {
+        if (count % CHECKPOINT_EVENTS == 0) {
+            cache->checkpoints[count / CHECKPOINT_EVENTS].pos = (uint16_t)cursor.pos;
+            cache->checkpoints[count / CHECKPOINT_EVENTS].dict_count = (uint8_t)cursor.dict_count;
+            cache->checkpoints[count / CHECKPOINT_EVENTS].timestamp = cursor.timestamp;
+        }
+        if (block_decode_next(&cursor, &event) != ESP_OK) {
+            break;
+        }
+        count++;
+    }
+    cache->sector = sector;
+    cache->first_seq = ((const access_log_block_header_t *)cache->data)->first_seq;
+    cache->count = count;
+    cache->sealed = sector != s_head_sector;
+    return ESP_OK;
+}
+
+static bool cache_valid_locked(uint32_t sector) {
+    const block_cache_t *cache = s_cache;
+    if (cache->first_seq == 0 || cache->sector != sector ||
+        cache->first_seq != s_blocks[sector].first_seq) {
+        return false;
+    }
+    return sector == s_head_sector ? cache->count == s_head_count : cache->sealed;
+}
+
+// Pelo resumo, o bloco pode conter eventos da consulta? (falso positivo
+// do Bloom só custa decodificar o bloco)
+static bool block_may_match_locked(uint32_t sector, const database_log_query_t *query) {
+    const block_info_t *info = &s_blocks[sector];
+    if ((query->from && info->max_ts < query->from) || (query->to && info->min_ts > query->to)) {
+        return false;
+    }
+    if (query->uid_len == 0 || !info->has_bloom) {
+        return true;
+    }
+    if (sector == s_head_sector) {
+        return bloom_test(s_head_bloom, query->uid, query->uid_len);
+    }
+    uint8_t bloom[ACCESS_LOG_BLOOM_BYTES];
+    size_t offset = sector * ACCESS_LOG_SECTOR_SIZE + BLOCK_DATA_END + offsetof(access_log_block_summary_t, bloom);
+    if (esp_partition_read(s_partition, offset, bloom, sizeof(bloom)) != ESP_OK) {
+        return true;
+    }
+    return bloom_test(bloom, query->uid, query->uid_len);
+}
+
+static bool event_matches(const log_event_t *event, const database_log_query_t *query) {
+    if ((query->from && event->timestamp < query->from) || (query->to && event->timestamp > query->to)) {
+        return false;
+    }
+    return query->uid_len == 0 ||
+           (event->uid_len == query->uid_len && memcmp(event->uid, query->uid, query->uid_len) == 0);
+}
+
+esp_err_t access_log_reader_next(access_log_reader_t *reader, access_log_t *entry) {
+    return access_log_reader_next_match(reader, NULL, entry);
+}
+
+esp_err_t access_log_reader_next_match(access_log_reader_t *reader, const database_log_query_t *query,
+                                       access_log_t *entry) {
+    if (!reader || !entry) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_sector_buf) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint32_t candidate = 0;     // first_seq do bloco já aprovado pelo resumo
+    while (reader->next_seq >= reader->oldest_seq && reader->next_seq > 0) {
+        uint32_t seq = reader->next_seq--;
+        uint32_t sector = 0;
+
+        xSemaphoreTake(s_log_mutex, portMAX_DELAY);
+        if (!find_block_locked(seq, &sector)) {
+            xSemaphoreGive(s_log_mutex);
+            continue; // bloco já sobrescrito
+        }
+        if (query && s_blocks[sector].first_seq != candidate) {
+            const block_info_t *info = &s_blocks[sector];
+            // Blocos mais antigos só têm eventos ainda mais velhos: acabou
+            if (query->from && info->max_ts < query->from) {
+                reader->next_seq = 0;
+                xSemaphoreGive(s_log_mutex);
+                break;
+            }
+            // Bloco todo depois de 'to': busca binária do último bloco que
+            // começa até 'to' e retoma do fim dele
+            uint32_t pos;
+            if (query->to && info->min_ts > query->to) {
+                if (ring_search_locked(ring_pos(sector) - 1, true, query->to, &pos)) {
+                    reader->next_seq = next_first_seq_locked(pos) - 1;
+                } else {
+                    reader->next_seq = 0;
+                }
+                xSemaphoreGive(s_log_mutex);
+                continue;
+            }
+            if (!block_may_match_locked(sector, query)) {
+                // Bloco inteiro fora da consulta: salta para o anterior
+                reader->next_seq = s_blocks[sector].first_seq - 1;
+                xSemaphoreGive(s_log_mutex);
+                continue;
+            }
+            candidate = s_blocks[sector].first_seq;
+        }
+        esp_err_t ret = ESP_OK;
+        if (!cache_valid_locked(sector)) {
+            ret = cache_load_locked(sector);
+        }
+        uint32_t index = seq - s_cache->first_seq;
+        if (ret != ESP_OK || index >= s_cache->count) {
+            xSemaphoreGive(s_log_mutex);
+            if (ret != ESP_OK && ret != ESP_ERR_NOT_FOUND) {
+                return ret;
+            }
+            continue; // evento corrompido ou perdido numa queda de energia
+        }
+
+        // Retoma do ponto anterior mais próximo e decodifica até 'seq'; com
+        // consulta, cada trecho entre pontos é decodificado uma vez e fica
+        // o último evento que casa
+        log_event_t event;
+        bool found = false;
+        for (int32_t checkpoint = index / CHECKPOINT_EVENTS; checkpoint >= 0 && !found; checkpoint--) {
+            block_cursor_t cursor;
+            log_event_t decoded;
+            block_cursor_init(&cursor, s_cache->data, s_cache->dict);
+            cursor.pos = s_cache->checkpoints[checkpoint].pos;
+            cursor.dict_count = s_cache->checkpoints[checkpoint].dict_count;
+            cursor.timestamp = s_cache->checkpoints[checkpoint].timestamp;
+            cursor.seq = s_cache->first_seq + checkpoint * CHECKPOINT_EVENTS;
+            while (cursor.seq <= seq && block_decode_next(&cursor, &decoded) == ESP_OK) {
+                if (!query || event_matches(&decoded, query)) {
+                    event = decoded;
+                    found = true;
+                }
+            }
+            if (!query) {
+                break;
+            }
+        }
+        if (!found) {
+            reader->next_seq = s_cache->first_seq - 1;
+            xSemaphoreGive(s_log_mutex);
+            continue;
+        }
+        reader->next_seq = event.seq - 1;
+        event_to_entry(&event, entry);
+        xSemaphoreGive(s_log_mutex);
+        return ESP_OK;
+    }
+
+    return ESP_ERR_NOT_FOUND;
+}
+
+uint32_t access_log_last_timestamp(void) {
+    if (!s_sector_buf) {
+        return 0;
+    }
+    uint32_t last = 0;
+    xSemaphoreTake(s_log_mutex, portMAX_DELAY);
+    for (uint32_t pos = s_sector_count; pos >= 1; pos--) {
+        const block_info_t *info = &s_blocks[ring_sector(pos)];
+        if (info->first_seq != 0) {
+            last = info->max_ts;
+            break;
+        }
+    }
+    xSemaphoreGive(s_log_mutex);
+    return last;
+}
+
+esp_err_t access_log_scan(uint32_t from, access_log_scan_cb_t cb, void *ctx) {
+    if (!cb) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_sector_buf) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint8_t *data = malloc(ACCESS_LOG_SECTOR_SIZE);
+    uint16_t *dict = malloc(DICT_MAX * sizeof(uint16_t));
+    if (!data || !dict) {
+        free(data);
+        free(dict);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Do bloco seguinte ao de escrita (o mais antigo) até o de escrita; com
+    // 'from', a partir do último bloco que começa antes dele (os anteriores
+    // terminam antes do seu início)
+    uint32_t start = 1;
+    if (from > 0) {
+        xSemaphoreTake(s_log_mutex, portMAX_DELAY);
+        ring_search_locked(s_sector_count, true, from - 1, &start);
+        xSemaphoreGive(s_log_mutex);
+    }
+    esp_err_t ret = ESP_OK;
+    bool done = false;
+    for (uint32_t i = start; i <= s_sector_count && !done && ret == ESP_OK; i++) {
+        xSemaphoreTake(s_log_mutex, portMAX_DELAY);
+        uint32_t sector = (s_head_sector + i) % s_sector_count;
+        if (s_blocks[sector].first_seq == 0) {
+            xSemaphoreGive(s_log_mutex);
+            continue;
+        }
+        if (sector == s_head_sector) {
+            memcpy(data, s_sector_buf, ACCESS_LOG_SECTOR_SIZE);
+        } else {
+            ret = esp_partition_read(s_partition, sector * ACCESS_LOG_SECTOR_SIZE, data, ACCESS_LOG_SECTOR_SIZE);
+        }
+        xSemaphoreGive(s_log_mutex);
+        if (ret != ESP_OK || !header_valid((const access_log_block_header_t *)data)) {
+            continue;
+        }
+
+        block_cursor_t cursor;
+        log_event_t event;
+        access_log_t entry;
+        block_cursor_init(&cursor, data, dict);
+        while (block_decode_next(&cursor, &event) == ESP_OK) {
+            if (event.timestamp < from) {
+                continue;
+            }
+            event_to_entry(&event, &entry);
+            if (!cb(&entry, ctx)) {
+                done = true;
+                break;
+            }
+        }
+    }
+
+    free(data);
+    free(dict);
+    return ret;
+}
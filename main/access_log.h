@@ -0,0 +1,55 @@
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "database.h"
+
+// Log de acesso append-only numa partição de dados dedicada (partitions.csv).
+// Cada setor guarda um bloco comprimido: cabeçalho com a sequência e o
+// timestamp do primeiro evento, seguido de eventos de tamanho variável
+// (ação em código, UID por índice num dicionário do próprio bloco e
+// timestamp em delta varint) e, ao fechar o bloco, um resumo com o
+// intervalo de timestamps e um filtro de Bloom dos UIDs. O bloco em escrita
+// fica num buffer de um setor em RAM e é gravado em lote; ao encher o
+// último setor o log volta ao início (wraparound), apagando o bloco mais
+// antigo.
+#define ACCESS_LOG_PARTITION_LABEL    "rfidlog"
+#define ACCESS_LOG_PARTITION_SUBTYPE  0x40
+
+typedef struct {
+    uint32_t next_seq;      // próximo registro a retornar (decrescente)
+    uint32_t oldest_seq;    // limite inferior ainda presente no flash
+} access_log_reader_t;
+
+// Retorna false para interromper a leitura
+typedef bool (*access_log_scan_cb_t)(const access_log_t *entry, void *ctx);
+
+esp_err_t access_log_init(void);
+void access_log_deinit(void);
+
+esp_err_t access_log_append(const char *uid, const char *action, uint32_t timestamp);
+esp_err_t access_log_flush(void);
+
+uint32_t access_log_total(void);      // registros gravados desde a formatação
+uint32_t access_log_retained(void);   // registros ainda presentes no flash
+
+// Leitura do mais recente para o mais antigo
+esp_err_t access_log_reader_begin(access_log_reader_t *reader);
+esp_err_t access_log_reader_next(access_log_reader_t *reader, access_log_t *entry);
+// Idem, só com os eventos da consulta; blocos cujo resumo (intervalo de
+// timestamps e filtro de Bloom dos UIDs) exclui a consulta são pulados
+// sem leitura do flash além do filtro
+esp_err_t access_log_reader_next_match(access_log_reader_t *reader, const database_log_query_t *query,
+                                       access_log_t *entry);
+
+// Leitura sequencial do mais antigo para o mais recente, descomprimindo um
+// bloco por vez (sem o cache usado pelo leitor reverso). Só eventos com
+// timestamp >= from (0 = todos); os blocos anteriores são pulados pela
+// busca binária nos resumos, sem leitura do flash
+esp_err_t access_log_scan(uint32_t from, access_log_scan_cb_t cb, void *ctx);
+// Maior timestamp do bloco mais recente (0 com o log vazio)
+uint32_t access_log_last_timestamp(void);
+
+#endif // ACCESS_LOG_H
@@ -0,0 +1,233 @@
+#include "access_stats.h"
+#include "card_index.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <string.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <math.h>
+#include <inttypes.h>
+
+static const char *TAG = "ACCESS_STATS";
+
+#define SECONDS_PER_HOUR  3600u
+#define SECONDS_PER_DAY   86400u
+
+// id = período + 1 (0 marca bucket vazio)
+typedef struct {
+    uint32_t id;
+    uint32_t granted;
+    uint32_t denied;
+} hour_bucket_t;
+
+typedef struct {
+    uint32_t id;
+    uint32_t granted;
+    uint32_t denied;
+    uint8_t regs[ACCESS_STATS_HLL_REGS];    // HyperLogLog dos UIDs do dia
+} day_bucket_t;
+
+static hour_bucket_t *s_hours = NULL;
+static day_bucket_t *s_days = NULL;
+static access_stats_totals_t s_totals;
+static SemaphoreHandle_t s_stats_mutex = NULL;
+
+// Finalizador do murmur3 sobre o FNV do UID: o HLL usa os bits altos
+static inline uint32_t stats_mix(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static void hll_add(uint8_t *regs, uint32_t hash) {
+    uint32_t index = hash >> (32 - ACCESS_STATS_HLL_BITS);
+    uint32_t rest = hash << ACCESS_STATS_HLL_BITS;
+    uint8_t rank = rest ? (uint8_t)(__builtin_clz(rest) + 1) : (uint8_t)(32 - ACCESS_STATS_HLL_BITS + 1);
+    if (rank > regs[index]) {
+        regs[index] = rank;
+    }
+}
+
+static uint32_t hll_estimate(const uint8_t *regs) {
+    const float m = (float)ACCESS_STATS_HLL_REGS;
+    float alpha;
+    switch (ACCESS_STATS_HLL_REGS) {
+    case 16: alpha = 0.673f; break;
+    case 32: alpha = 0.697f; break;
+    case 64: alpha = 0.709f; break;
+    default: alpha = 0.7213f / (1.0f + 1.079f / m); break;
+    }
+    float sum = 0.0f;
+    uint32_t zeros = 0;
+    for (uint32_t i = 0; i < ACCESS_STATS_HLL_REGS; i++) {
+        sum += ldexpf(1.0f, -(int)regs[i]);
+        if (regs[i] == 0) {
+            zeros++;
+        }
+    }
+    float estimate = alpha * m * m / sum;
+    // Correção para cardinalidades pequenas (contagem linear)
+    if (estimate <= 2.5f * m && zeros > 0) {
+        estimate = m * logf(m / (float)zeros);
+    }
+    return (uint32_t)(estimate + 0.5f);
+}
+
+esp_err_t access_stats_init(void) {
+    if (!s_stats_mutex) {
+        s_stats_mutex = xSemaphoreCreateMutex();
+        if (!s_stats_mutex) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    hour_bucket_t *hours = calloc(ACCESS_STATS_HOURS, sizeof(hour_bucket_t));
+    day_bucket_t *days = calloc(ACCESS_STATS_DAYS, sizeof(day_bucket_t));
+    if (!hours || !days) {
+        free(hours);
+        free(days);
+        return ESP_ERR_NO_MEM;
+    }
+    // Anéis trocados sob o lock: access_stats_record pode estar rodando
+    xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+    free(s_hours);
+    free(s_days);
+    s_hours = hours;
+    s_days = days;
+    memset(&s_totals, 0, sizeof(s_totals));
+    xSemaphoreGive(s_stats_mutex);
+    ESP_LOGI(TAG, "Estatísticas: %d horas, %d dias, %" PRIu32 " bytes",
+             ACCESS_STATS_HOURS, ACCESS_STATS_DAYS, access_stats_memory());
+    return ESP_OK;
+}
+
+// O mutex fica: quem já passou pela verificação dos ponteiros espera aqui
+// e reencontra NULL depois do lock
+void access_stats_deinit(void) {
+    if (s_stats_mutex) {
+        xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+    }
+    free(s_hours);
+    free(s_days);
+    s_hours = NULL;
+    s_days = NULL;
+    if (s_stats_mutex) {
+        xSemaphoreGive(s_stats_mutex);
+    }
+}
+
+access_event_t access_stats_classify(const char *action) {
+    if (!action) {
+        return ACCESS_EVENT_OTHER;
+    }
+    if (strcmp(action, "ACCESS_GRANTED") == 0) {
+        return ACCESS_EVENT_GRANTED;
+    }
+    if (strcmp(action, "ACCESS_DENIED") == 0 || strcmp(action, "ADD_FAILED") == 0) {
+        return ACCESS_EVENT_DENIED;
+    }
+    return ACCESS_EVENT_OTHER;
+}
+
+// Bucket do período 'period' no anel; NULL se o anel já avançou além dele.
+// Serve aos dois tipos de bucket, que começam pelo id.
+_Static_assert(offsetof(hour_bucket_t, id) == 0 && offsetof(day_bucket_t, id) == 0, "id fora do início");
+
+static inline void *ring_slot(void *ring, size_t bucket_size, uint32_t size, uint32_t period) {
+    uint32_t *id = (uint32_t *)((uint8_t *)ring + (period % size) * bucket_size);
+    if (*id != period + 1) {
+        if (*id > period + 1) {
+            return NULL;
+        }
+        memset(id, 0, bucket_size);
+        *id = period + 1;
+    }
+    return id;
+}
+
+void access_stats_record(const uint8_t *uid, uint8_t uid_len, access_event_t event, uint32_t timestamp) {
+    if (!s_stats_mutex) {
+        return;
+    }
+    uint32_t hash = uid_len ? stats_mix(card_index_hash(uid, uid_len)) : 0;
+
+    xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+    if (!s_hours || !s_days) {
+        xSemaphoreGive(s_stats_mutex); // deinit concorrente
+        return;
+    }
+    s_totals.events++;
+    s_totals.granted += event == ACCESS_EVENT_GRANTED;
+    s_totals.denied += event == ACCESS_EVENT_DENIED;
+
+    hour_bucket_t *hour = ring_slot(s_hours, sizeof(*s_hours), ACCESS_STATS_HOURS, timestamp / SECONDS_PER_HOUR);
+    if (hour) {
+        hour->granted += event == ACCESS_EVENT_GRANTED;
+        hour->denied += event == ACCESS_EVENT_DENIED;
+    }
+    day_bucket_t *day = ring_slot(s_days, sizeof(*s_days), ACCESS_STATS_DAYS, timestamp / SECONDS_PER_DAY);
+    if (day) {
+        day->granted += event == ACCESS_EVENT_GRANTED;
+        day->denied += event == ACCESS_EVENT_DENIED;
+        if (uid_len) {
+            hll_add(day->regs, hash);
+        }
+    }
+    xSemaphoreGive(s_stats_mutex);
+}
+
+void access_stats_totals(access_stats_totals_t *totals) {
+    if (!s_stats_mutex) {
+        memset(totals, 0, sizeof(*totals));
+        return;
+    }
+    xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+    *totals = s_totals;
+    xSemaphoreGive(s_stats_mutex);
+}
+
+void access_stats_hours(uint32_t now, access_stats_bucket_t *buckets, uint32_t count) {
+    memset(buckets, 0, count * sizeof(*buckets));
+    if (!s_stats_mutex) {
+        return;
+    }
+    uint32_t current = now / SECONDS_PER_HOUR;
+    xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+    for (uint32_t i = 0; s_hours && i < count && i < ACCESS_STATS_HOURS && i <= current; i++) {
+        uint32_t period = current - i;
+        const hour_bucket_t *b = &s_hours[period % ACCESS_STATS_HOURS];
+        buckets[i].start = period * SECONDS_PER_HOUR;
+        if (b->id == period + 1) {
+            buckets[i].granted = b->granted;
+            buckets[i].denied = b->denied;
+        }
+    }
+    xSemaphoreGive(s_stats_mutex);
+}
+
+void access_stats_days(uint32_t now, access_stats_bucket_t *buckets, uint32_t count) {
+    memset(buckets, 0, count * sizeof(*buckets));
+    if (!s_stats_mutex) {
+        return;
+    }
+    uint32_t current = now / SECONDS_PER_DAY;
+    xSemaphoreTake(s_stats_mutex, portMAX_DELAY);
+    for (uint32_t i = 0; s_days && i < count && i < ACCESS_STATS_DAYS && i <= current; i++) {
+        uint32_t period = current - i;
+        const day_bucket_t *b = &s_days[period % ACCESS_STATS_DAYS];
+        buckets[i].start = period * SECONDS_PER_DAY;
+        if (b->id == period + 1) {
+            buckets[i].granted = b->granted;
+            buckets[i].denied = b->denied;
+            buckets[i].unique_cards = hll_estimate(b->regs);
+        }
+    }
+    xSemaphoreGive(s_stats_mutex);
+}
+
+uint32_t access_stats_memory(void) {
+    return ACCESS_STATS_HOURS * sizeof(hour_bucket_t) + ACCESS_STATS_DAYS * sizeof(day_bucket_t);
+}
@@ -0,0 +1,61 @@
+#ifndef ACCESS_STATS_H
+#define ACCESS_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Estatísticas de acesso atualizadas a cada evento do log, sem varrer
+// registros: acessos concedidos/negados por hora e por dia em anéis de
+// tamanho fixo e cartões distintos por dia estimados com HyperLogLog.
+// No boot os anéis são refeitos a partir do log de acesso (access_log.h).
+#ifndef ACCESS_STATS_HOURS
+#define ACCESS_STATS_HOURS       48      // buckets de uma hora
+#endif
+#ifndef ACCESS_STATS_DAYS
+#define ACCESS_STATS_DAYS        14      // buckets de um dia (UTC)
+#endif
+#ifndef ACCESS_STATS_HLL_BITS
+#define ACCESS_STATS_HLL_BITS    8       // 2^bits registradores por dia; erro ~1,04/sqrt(2^bits)
+#endif
+#define ACCESS_STATS_HLL_REGS    (1u << ACCESS_STATS_HLL_BITS)
+
+#if ACCESS_STATS_HLL_BITS < 4 || ACCESS_STATS_HLL_BITS > 12
+#error "ACCESS_STATS_HLL_BITS deve estar entre 4 e 12"
+#endif
+
+typedef enum {
+    ACCESS_EVENT_OTHER,         // cadastro etc.: só conta como cartão visto
+    ACCESS_EVENT_GRANTED,
+    ACCESS_EVENT_DENIED,
+} access_event_t;
+
+typedef struct {
+    uint32_t start;             // início do período (epoch); 0 = sem dados
+    uint32_t granted;
+    uint32_t denied;
+    uint32_t unique_cards;      // só nos buckets diários (estimativa)
+} access_stats_bucket_t;
+
+typedef struct {
+    uint32_t granted;           // desde o boot, mais os dias refeitos do log
+    uint32_t denied;
+    uint32_t events;
+} access_stats_totals_t;
+
+esp_err_t access_stats_init(void);
+void access_stats_deinit(void);
+
+// Classifica a ação gravada no log (ACCESS_GRANTED, ACCESS_DENIED, ...)
+access_event_t access_stats_classify(const char *action);
+void access_stats_record(const uint8_t *uid, uint8_t uid_len, access_event_t event, uint32_t timestamp);
+
+void access_stats_totals(access_stats_totals_t *totals);
+// Últimos 'count' períodos terminando no que contém 'now', mais recente
+// primeiro. Períodos sem eventos retornam zerados com 'start' preenchido.
+void access_stats_hours(uint32_t now, access_stats_bucket_t *buckets, uint32_t count);
+void access_stats_days(uint32_t now, access_stats_bucket_t *buckets, uint32_t count);
+
+uint32_t access_stats_memory(void);
+
+#endif // ACCESS_STATS_H
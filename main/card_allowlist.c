@@ -0,0 +1,192 @@
+#include "card_allowlist.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ALLOWLIST_DISP_MAX   0xFFFF
+#define ALLOWLIST_GROUP_MAX  64      // grupo maior que isso: outra semente
+
+typedef struct {
+    uint32_t h2;
+    uint32_t item;
+} allowlist_member_t;
+
+// FNV-1a de 64 bits com semente + finalizador do splitmix64: a metade alta
+// escolhe o grupo, a baixa a posição
+static inline uint64_t allowlist_hash(const uint8_t *uid, uint8_t uid_len, uint32_t seed) {
+    uint64_t h = 0xcbf29ce484222325ULL ^ seed ^ ((uint64_t)uid_len << 56);
+    for (uint8_t i = 0; i < uid_len; i++) {
+        h = (h ^ uid[i]) * 0x100000001b3ULL;
+    }
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+// x uniforme em 32 bits -> [0, n) sem divisão
+static inline uint32_t allowlist_range(uint32_t x, uint32_t n) {
+    return (uint32_t)(((uint64_t)x * n) >> 32);
+}
+
+static inline uint32_t allowlist_group(const card_allowlist_t *list, uint64_t h) {
+    return allowlist_range((uint32_t)(h >> 32), list->groups);
+}
+
+static inline uint32_t allowlist_pos(const card_allowlist_t *list, uint32_t h2, uint16_t disp) {
+    uint32_t x = h2 + disp * 0x9E3779B9u;
+    x ^= x >> 16;
+    x *= 0x85ebca6bu;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35u;
+    x ^= x >> 16;
+    return allowlist_range(x, list->slots);
+}
+
+static inline bool allowlist_bit(const uint32_t *bits, uint32_t pos) {
+    return (bits[pos / 32] >> (pos % 32)) & 1;
+}
+
+// Grupos maiores primeiro, com a tabela ainda vazia; false se algum grupo
+// esgotou os deslocamentos (outra semente)
+static bool allowlist_place(card_allowlist_t *list, const uint32_t *group_start,
+                            const allowlist_member_t *members, uint32_t max_group, uint32_t *used) {
+    uint32_t pos[ALLOWLIST_GROUP_MAX];
+    if (max_group > ALLOWLIST_GROUP_MAX) {
+        return false;
+    }
+    memset(used, 0, ((list->slots + 31) / 32) * sizeof(uint32_t));
+    for (uint32_t size = max_group; size > 0; size--) {
+        for (uint32_t g = 0; g < list->groups; g++) {
+            if (group_start[g + 1] - group_start[g] != size) {
+                continue;
+            }
+            const allowlist_member_t *m = &members[group_start[g]];
+            uint32_t disp = 0;
+            for (; disp <= ALLOWLIST_DISP_MAX; disp++) {
+                uint32_t placed = 0;
+                for (; placed < size; placed++) {
+                    uint32_t p = allowlist_pos(list, m[placed].h2, (uint16_t)disp);
+                    if (allowlist_bit(used, p)) {
+                        break;
+                    }
+                    uint32_t k = 0;
+                    while (k < placed && pos[k] != p) {
+                        k++;
+                    }
+                    if (k < placed) {
+                        break;
+                    }
+                    pos[placed] = p;
+                }
+                if (placed == size) {
+                    break;
+                }
+            }
+            if (disp > ALLOWLIST_DISP_MAX) {
+                return false;
+            }
+            list->disp[g] = (uint16_t)disp;
+            for (uint32_t k = 0; k < size; k++) {
+                used[pos[k] / 32] |= 1u << (pos[k] % 32);
+            }
+        }
+    }
+    return true;
+}
+
+esp_err_t card_allowlist_build(const card_allowlist_entry_t *items, uint32_t count, card_allowlist_t **out) {
+    uint32_t slots = count + count / 8 + 1;
+    uint32_t groups = (count + CARD_ALLOWLIST_GROUP_SIZE - 1) / CARD_ALLOWLIST_GROUP_SIZE;
+    if (groups == 0) {
+        groups = 1;
+    }
+
+    // Entradas (múltiplo de 4 bytes) antes dos deslocamentos mantém o alinhamento
+    size_t size = sizeof(card_allowlist_t) + slots * sizeof(card_allowlist_entry_t) + groups * sizeof(uint16_t);
+    card_allowlist_t *list = malloc(size);
+    uint32_t *group_start = calloc(groups + 1, sizeof(uint32_t));
+    allowlist_member_t *members = malloc((count ? count : 1) * sizeof(allowlist_member_t));
+    uint32_t *used = malloc(((slots + 31) / 32) * sizeof(uint32_t));
+    if (!list || !group_start || !members || !used) {
+        free(list);
+        free(group_start);
+        free(members);
+        free(used);
+        return ESP_ERR_NO_MEM;
+    }
+    list->count = count;
+    list->slots = slots;
+    list->groups = groups;
+    list->entries = (card_allowlist_entry_t *)(list + 1);
+    list->disp = (uint16_t *)(list->entries + slots);
+
+    esp_err_t ret = ESP_FAIL;
+    for (uint32_t seed = 0; seed < CARD_ALLOWLIST_MAX_SEEDS && ret != ESP_OK; seed++) {
+        list->seed = seed;
+        // Membros agrupados por contagem: tamanhos, fins acumulados, depois
+        // cada membro recua o fim do seu grupo até ele virar o início
+        memset(group_start, 0, (groups + 1) * sizeof(uint32_t));
+        for (uint32_t i = 0; i < count; i++) {
+            group_start[allowlist_group(list, allowlist_hash(items[i].uid, items[i].uid_len, seed))]++;
+        }
+        uint32_t max_group = 0;
+        for (uint32_t g = 0; g < groups; g++) {
+            if (group_start[g] > max_group) {
+                max_group = group_start[g];
+            }
+            if (g > 0) {
+                group_start[g] += group_start[g - 1];
+            }
+        }
+        group_start[groups] = count;
+        for (uint32_t i = 0; i < count; i++) {
+            uint64_t h = allowlist_hash(items[i].uid, items[i].uid_len, seed);
+            allowlist_member_t *m = &members[--group_start[allowlist_group(list, h)]];
+            m->h2 = (uint32_t)h;
+            m->item = i;
+        }
+        if (allowlist_place(list, group_start, members, max_group, used)) {
+            ret = ESP_OK;
+        }
+    }
+    free(used);
+
+    if (ret == ESP_OK) {
+        memset(list->entries, 0, slots * sizeof(card_allowlist_entry_t));
+        for (uint32_t g = 0; g < groups; g++) {
+            for (uint32_t k = group_start[g]; k < group_start[g + 1]; k++) {
+                list->entries[allowlist_pos(list, members[k].h2, list->disp[g])] = items[members[k].item];
+            }
+        }
+        *out = list;
+    } else {
+        free(list);
+    }
+    free(group_start);
+    free(members);
+    return ret;
+}
+
+void card_allowlist_free(card_allowlist_t *list) {
+    free(list);
+}
+
+bool card_allowlist_find(const card_allowlist_t *list, const uint8_t *uid, uint8_t uid_len, uint8_t *access_level) {
+    uint64_t h = allowlist_hash(uid, uid_len, list->seed);
+    const card_allowlist_entry_t *entry =
+        &list->entries[allowlist_pos(list, (uint32_t)h, list->disp[allowlist_group(list, h)])];
+    if (entry->uid_len != uid_len || memcmp(entry->uid, uid, uid_len) != 0) {
+        return false;
+    }
+    if (access_level) {
+        *access_level = entry->access_level;
+    }
+    return true;
+}
+
+size_t card_allowlist_memory(const card_allowlist_t *list) {
+    return sizeof(card_allowlist_t) + list->slots * sizeof(card_allowlist_entry_t) +
+           list->groups * sizeof(uint16_t);
+}
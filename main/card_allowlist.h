@@ -0,0 +1,42 @@
+#ifndef CARD_ALLOWLIST_H
+#define CARD_ALLOWLIST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "card_record.h"
+
+// Lista de acesso compilada: hash perfeito (hash-and-displace) sobre um
+// conjunto de UIDs, montado de novo a cada mudança e nunca alterado (cada
+// balde da visão do toque, card_view.h, é uma lista destas). O UID cai num
+// grupo (~4 UIDs) cujo deslocamento de 16 bits leva cada um a uma posição
+// livre da tabela; a consulta lê o deslocamento e uma entrada, sempre duas
+// leituras, e confirma o UID inteiro. Posições sobram ~1/8 (quase mínimo)
+// para a montagem não demorar.
+#define CARD_ALLOWLIST_GROUP_SIZE   4
+#define CARD_ALLOWLIST_MAX_SEEDS    8       // sementes tentadas antes de desistir
+
+typedef struct {
+    uint8_t uid[CARD_UID_MAX_BYTES];
+    uint8_t uid_len;            // 0 = posição vazia
+    uint8_t access_level;
+} card_allowlist_entry_t;
+
+typedef struct {
+    uint32_t seed;
+    uint32_t count;             // UIDs
+    uint32_t slots;             // posições em entries
+    uint32_t groups;            // deslocamentos em disp
+    uint16_t *disp;
+    card_allowlist_entry_t *entries;
+} card_allowlist_t;
+
+// Monta a partir de items[0..count) (UIDs distintos) numa alocação só
+// (card_allowlist_free). As posições vazias de entries têm uid_len 0.
+esp_err_t card_allowlist_build(const card_allowlist_entry_t *items, uint32_t count, card_allowlist_t **out);
+void card_allowlist_free(card_allowlist_t *list);
+bool card_allowlist_find(const card_allowlist_t *list, const uint8_t *uid, uint8_t uid_len, uint8_t *access_level);
+size_t card_allowlist_memory(const card_allowlist_t *list);
+
+#endif // CARD_ALLOWLIST_H
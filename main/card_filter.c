@@ -0,0 +1,185 @@
+#include "card_filter.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FP_MASK  ((1u << CARD_FILTER_FINGERPRINT_BITS) - 1)
+
+// Finalizador do murmur3: espalha os bits do hash FNV, que também é usado
+// pelo índice, para que bucket e fingerprint sejam independentes dele
+static inline uint32_t card_filter_mix(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline card_filter_fp_t card_filter_fingerprint(uint32_t mixed) {
+    card_filter_fp_t fp = (card_filter_fp_t)((mixed >> 16) & FP_MASK);
+    return fp ? fp : 1; // 0 marca entrada vazia
+}
+
+// Bucket alternativo: i2 = i1 ^ hash(fp), reversível sem o hash original
+static inline uint32_t card_filter_alt(const card_filter_t *filter, uint32_t bucket, card_filter_fp_t fp) {
+    return (bucket ^ (card_filter_mix(fp) & 0xFFFF)) & (filter->bucket_count - 1);
+}
+
+static inline card_filter_fp_t *card_filter_bucket(const card_filter_t *filter, uint32_t bucket) {
+    return &filter->buckets[bucket * CARD_FILTER_BUCKET_SIZE];
+}
+
+static bool card_filter_bucket_add(card_filter_t *filter, uint32_t bucket, card_filter_fp_t fp) {
+    card_filter_fp_t *entries = card_filter_bucket(filter, bucket);
+    for (int i = 0; i < CARD_FILTER_BUCKET_SIZE; i++) {
+        if (entries[i] == 0) {
+            entries[i] = fp;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool card_filter_bucket_has(const card_filter_t *filter, uint32_t bucket, card_filter_fp_t fp) {
+    const card_filter_fp_t *entries = card_filter_bucket(filter, bucket);
+    for (int i = 0; i < CARD_FILTER_BUCKET_SIZE; i++) {
+        if (entries[i] == fp) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool card_filter_bucket_del(card_filter_t *filter, uint32_t bucket, card_filter_fp_t fp) {
+    card_filter_fp_t *entries = card_filter_bucket(filter, bucket);
+    for (int i = 0; i < CARD_FILTER_BUCKET_SIZE; i++) {
+        if (entries[i] == fp) {
+            entries[i] = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+esp_err_t card_filter_init(card_filter_t *filter, uint32_t expected_count) {
+    if (!filter) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t buckets = CARD_FILTER_MIN_BUCKETS;
+    while (buckets < 0x10000 &&
+           buckets * CARD_FILTER_BUCKET_SIZE * CARD_FILTER_LOAD_PERCENT < expected_count * 100) {
+        buckets <<= 1;
+    }
+
+    memset(filter, 0, sizeof(*filter));
+    filter->buckets = calloc(buckets * CARD_FILTER_BUCKET_SIZE, sizeof(card_filter_fp_t));
+    if (!filter->buckets) {
+        return ESP_ERR_NO_MEM;
+    }
+    filter->bucket_count = buckets;
+    return ESP_OK;
+}
+
+void card_filter_free(card_filter_t *filter) {
+    if (!filter) {
+        return;
+    }
+    free(filter->buckets);
+    memset(filter, 0, sizeof(*filter));
+}
+
+esp_err_t card_filter_insert(card_filter_t *filter, uint32_t hash) {
+    if (!filter || !filter->buckets) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (filter->has_victim) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint32_t mixed = card_filter_mix(hash);
+    card_filter_fp_t fp = card_filter_fingerprint(mixed);
+    uint32_t i1 = mixed & (filter->bucket_count - 1);
+    uint32_t i2 = card_filter_alt(filter, i1, fp);
+    if (card_filter_bucket_add(filter, i1, fp) || card_filter_bucket_add(filter, i2, fp)) {
+        filter->count++;
+        return ESP_OK;
+    }
+
+    // Desloca fingerprints entre os buckets alternativos (cuckoo)
+    uint32_t bucket = (mixed & 0x10000) ? i2 : i1;
+    for (int kick = 0; kick < CARD_FILTER_MAX_KICKS; kick++) {
+        card_filter_fp_t *entries = card_filter_bucket(filter, bucket);
+        int victim = (int)((mixed >> (kick % 8)) % CARD_FILTER_BUCKET_SIZE);
+        card_filter_fp_t evicted = entries[victim];
+        entries[victim] = fp;
+        fp = evicted;
+        bucket = card_filter_alt(filter, bucket, fp);
+        if (card_filter_bucket_add(filter, bucket, fp)) {
+            filter->count++;
+            return ESP_OK;
+        }
+    }
+
+    // Sem espaço: o último despejado fica guardado para não perder itens
+    filter->has_victim = true;
+    filter->victim_bucket = bucket;
+    filter->victim_fp = fp;
+    filter->count++;
+    return ESP_ERR_NO_MEM;
+}
+
+bool card_filter_contains(const card_filter_t *filter, uint32_t hash) {
+    if (!filter || !filter->buckets) {
+        return true; // sem filtro: não rejeitar nada
+    }
+    uint32_t mixed = card_filter_mix(hash);
+    card_filter_fp_t fp = card_filter_fingerprint(mixed);
+    uint32_t i1 = mixed & (filter->bucket_count - 1);
+    uint32_t i2 = card_filter_alt(filter, i1, fp);
+    if (card_filter_bucket_has(filter, i1, fp) || card_filter_bucket_has(filter, i2, fp)) {
+        return true;
+    }
+    return filter->has_victim && filter->victim_fp == fp &&
+           (filter->victim_bucket == i1 || filter->victim_bucket == i2);
+}
+
+bool card_filter_remove(card_filter_t *filter, uint32_t hash) {
+    if (!filter || !filter->buckets) {
+        return false;
+    }
+    uint32_t mixed = card_filter_mix(hash);
+    card_filter_fp_t fp = card_filter_fingerprint(mixed);
+    uint32_t i1 = mixed & (filter->bucket_count - 1);
+    uint32_t i2 = card_filter_alt(filter, i1, fp);
+
+    if (filter->has_victim && filter->victim_fp == fp &&
+        (filter->victim_bucket == i1 || filter->victim_bucket == i2)) {
+        filter->has_victim = false;
+        filter->count--;
+        return true;
+    }
+    if (card_filter_bucket_del(filter, i1, fp) || card_filter_bucket_del(filter, i2, fp)) {
+        filter->count--;
+        // Com espaço livre o despejado pode voltar para a tabela
+        if (filter->has_victim &&
+            card_filter_bucket_add(filter, filter->victim_bucket, filter->victim_fp)) {
+            filter->has_victim = false;
+        }
+        return true;
+    }
+    return false;
+}
+
+uint32_t card_filter_memory(const card_filter_t *filter) {
+    return filter ? filter->bucket_count * CARD_FILTER_BUCKET_SIZE * sizeof(card_filter_fp_t) : 0;
+}
+
+uint32_t card_filter_expected_fp_ppm(const card_filter_t *filter) {
+    if (!filter || filter->bucket_count == 0) {
+        return 0;
+    }
+    // Duas posições candidatas com b entradas cada, ponderado pela ocupação
+    uint64_t slots = (uint64_t)filter->bucket_count * CARD_FILTER_BUCKET_SIZE;
+    uint64_t ppm = (uint64_t)2 * CARD_FILTER_BUCKET_SIZE * 1000000u * filter->count;
+    return (uint32_t)(ppm / (slots << CARD_FILTER_FINGERPRINT_BITS));
+}
@@ -0,0 +1,64 @@
+#ifndef CARD_FILTER_H
+#define CARD_FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Filtro cuckoo em RAM para rejeitar UIDs desconhecidos antes do índice.
+// "Não contém" é definitivo; "talvez contenha" erra com probabilidade de
+// aproximadamente 2 * CARD_FILTER_BUCKET_SIZE / 2^bits. Ao contrário de um
+// filtro de Bloom, suporta remoção.
+#ifndef CARD_FILTER_FINGERPRINT_BITS
+#define CARD_FILTER_FINGERPRINT_BITS  12      // 4..16; ~0,2% de falsos positivos
+#endif
+#ifndef CARD_FILTER_LOAD_PERCENT
+#define CARD_FILTER_LOAD_PERCENT      85      // ocupação alvo ao dimensionar
+#endif
+#define CARD_FILTER_BUCKET_SIZE       4
+#define CARD_FILTER_MIN_BUCKETS       16
+#define CARD_FILTER_MAX_KICKS         128
+
+#if CARD_FILTER_FINGERPRINT_BITS < 4 || CARD_FILTER_FINGERPRINT_BITS > 16
+#error "CARD_FILTER_FINGERPRINT_BITS deve estar entre 4 e 16"
+#endif
+
+#if CARD_FILTER_FINGERPRINT_BITS <= 8
+typedef uint8_t card_filter_fp_t;
+#else
+typedef uint16_t card_filter_fp_t;
+#endif
+
+typedef struct {
+    card_filter_fp_t *buckets;  // bucket_count * CARD_FILTER_BUCKET_SIZE, 0 = vazio
+    uint32_t bucket_count;      // sempre potência de dois
+    uint32_t count;
+    bool has_victim;            // item despejado quando o filtro encheu
+    uint32_t victim_bucket;
+    card_filter_fp_t victim_fp;
+} card_filter_t;
+
+typedef struct {
+    uint32_t items;
+    uint32_t capacity;          // entradas (buckets * CARD_FILTER_BUCKET_SIZE)
+    uint32_t memory_bytes;
+    uint32_t fingerprint_bits;
+    uint32_t expected_fp_ppm;   // taxa teórica de falsos positivos (por milhão)
+    uint32_t lookups;
+    uint32_t rejected;          // UIDs descartados sem consultar o índice
+    uint32_t false_positives;   // filtro aceitou, índice não encontrou
+} card_filter_stats_t;
+
+esp_err_t card_filter_init(card_filter_t *filter, uint32_t expected_count);
+void card_filter_free(card_filter_t *filter);
+
+// ESP_ERR_NO_MEM: filtro cheio, recriar com capacidade maior
+esp_err_t card_filter_insert(card_filter_t *filter, uint32_t hash);
+bool card_filter_contains(const card_filter_t *filter, uint32_t hash);
+// Só remover itens inseridos anteriormente
+bool card_filter_remove(card_filter_t *filter, uint32_t hash);
+
+uint32_t card_filter_memory(const card_filter_t *filter);
+uint32_t card_filter_expected_fp_ppm(const card_filter_t *filter);
+
+#endif // CARD_FILTER_H
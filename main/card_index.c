@@ -0,0 +1,178 @@
+#include "card_index.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Fator de carga máximo (incluindo lápides): 3/4
+#define CARD_INDEX_NEEDS_GROW(idx) \
+    (((idx)->count + (idx)->deleted + 1) * 4 > (idx)->capacity * 3)
+
+// FNV-1a 32 bits
+uint32_t card_index_hash(const void *data, size_t len) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// O tag de 16 bits também define a posição inicial da sondagem, o que
+// permite refazer a tabela sem guardar o hash completo.
+static inline uint16_t card_index_tag(uint32_t hash) {
+    return (uint16_t)((hash >> 16) ^ (hash & 0xFFFF));
+}
+
+static uint32_t card_index_capacity_for(uint32_t expected_count) {
+    uint32_t capacity = CARD_INDEX_MIN_CAPACITY;
+    while (capacity < CARD_INDEX_MAX_CAPACITY && capacity * 3 < expected_count * 4 + 4) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+static esp_err_t card_index_alloc(card_index_t *index, uint32_t capacity) {
+    index->tags = malloc(capacity * sizeof(uint16_t));
+    index->slots = malloc(capacity * sizeof(uint16_t));
+    if (!index->tags || !index->slots) {
+        free(index->tags);
+        free(index->slots);
+        index->tags = NULL;
+        index->slots = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    memset(index->slots, 0xFF, capacity * sizeof(uint16_t)); // CARD_INDEX_SLOT_EMPTY
+    index->capacity = capacity;
+    index->count = 0;
+    index->deleted = 0;
+    return ESP_OK;
+}
+
+esp_err_t card_index_init(card_index_t *index, uint32_t expected_count) {
+    if (!index) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return card_index_alloc(index, card_index_capacity_for(expected_count));
+}
+
+void card_index_free(card_index_t *index) {
+    if (!index) {
+        return;
+    }
+    free(index->tags);
+    free(index->slots);
+    memset(index, 0, sizeof(*index));
+}
+
+// Insere sem verificar capacidade (usado também no rehash)
+static void card_index_place(card_index_t *index, uint16_t tag, uint16_t slot) {
+    uint32_t mask = index->capacity - 1;
+    uint32_t pos = tag & mask;
+    while (index->slots[pos] != CARD_INDEX_SLOT_EMPTY &&
+           index->slots[pos] != CARD_INDEX_SLOT_DELETED) {
+        pos = (pos + 1) & mask;
+    }
+    if (index->slots[pos] == CARD_INDEX_SLOT_DELETED) {
+        index->deleted--;
+    }
+    index->tags[pos] = tag;
+    index->slots[pos] = slot;
+    index->count++;
+}
+
+static esp_err_t card_index_rehash(card_index_t *index, uint32_t new_capacity) {
+    card_index_t old = *index;
+    esp_err_t ret = card_index_alloc(index, new_capacity);
+    if (ret != ESP_OK) {
+        *index = old;
+        return ret;
+    }
+
+    for (uint32_t i = 0; i < old.capacity; i++) {
+        uint16_t slot = old.slots[i];
+        if (slot != CARD_INDEX_SLOT_EMPTY && slot != CARD_INDEX_SLOT_DELETED) {
+            card_index_place(index, old.tags[i], slot);
+        }
+    }
+
+    free(old.tags);
+    free(old.slots);
+    return ESP_OK;
+}
+
+esp_err_t card_index_insert(card_index_t *index, uint32_t hash, uint16_t slot) {
+    if (!index || !index->slots || slot > CARD_INDEX_MAX_SLOT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (CARD_INDEX_NEEDS_GROW(index)) {
+        // Só dobra se houver poucas lápides; caso contrário, limpa no lugar
+        uint32_t new_capacity = index->capacity;
+        if (index->count * 2 >= index->capacity) {
+            new_capacity <<= 1;
+        }
+        if (new_capacity > CARD_INDEX_MAX_CAPACITY) {
+            if (index->deleted == 0) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            new_capacity = index->capacity;
+        }
+        esp_err_t ret = card_index_rehash(index, new_capacity);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    card_index_place(index, card_index_tag(hash), slot);
+    return ESP_OK;
+}
+
+// Retorna a posição na tabela da entrada encontrada, ou -1
+static int32_t card_index_lookup(const card_index_t *index, uint32_t hash,
+                                 card_index_match_fn match, void *ctx) {
+    if (!index || !index->slots) {
+        return -1;
+    }
+
+    uint16_t tag = card_index_tag(hash);
+    uint32_t mask = index->capacity - 1;
+    uint32_t pos = tag & mask;
+
+    for (uint32_t probes = 0; probes < index->capacity; probes++) {
+        uint16_t slot = index->slots[pos];
+        if (slot == CARD_INDEX_SLOT_EMPTY) {
+            break;
+        }
+        if (slot != CARD_INDEX_SLOT_DELETED && index->tags[pos] == tag &&
+            (!match || match(slot, ctx))) {
+            return (int32_t)pos;
+        }
+        pos = (pos + 1) & mask;
+    }
+
+    return -1;
+}
+
+bool card_index_find(const card_index_t *index, uint32_t hash,
+                     card_index_match_fn match, void *ctx, uint16_t *slot) {
+    int32_t pos = card_index_lookup(index, hash, match, ctx);
+    if (pos < 0) {
+        return false;
+    }
+    if (slot) {
+        *slot = index->slots[pos];
+    }
+    return true;
+}
+
+bool card_index_remove(card_index_t *index, uint32_t hash,
+                       card_index_match_fn match, void *ctx) {
+    int32_t pos = card_index_lookup(index, hash, match, ctx);
+    if (pos < 0) {
+        return false;
+    }
+    index->slots[pos] = CARD_INDEX_SLOT_DELETED;
+    index->count--;
+    index->deleted++;
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef CARD_INDEX_H
+#define CARD_INDEX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Índice em RAM UID -> slot NVS (endereçamento aberto, sondagem linear).
+// Cada entrada guarda apenas 16 bits do hash e o slot; a confirmação do UID
+// é feita pelo chamador através do callback de comparação.
+#define CARD_INDEX_SLOT_EMPTY     0xFFFF
+#define CARD_INDEX_SLOT_DELETED   0xFFFE
+#define CARD_INDEX_MAX_SLOT       0xFFFD
+#define CARD_INDEX_MIN_CAPACITY   64
+#define CARD_INDEX_MAX_CAPACITY   65536   // ~49k cartões com carga de 3/4
+
+typedef struct {
+    uint16_t *tags;         // hash dobrado em 16 bits (também define a posição)
+    uint16_t *slots;        // slot NVS (card_<slot>) ou marcador
+    uint32_t capacity;      // sempre potência de dois
+    uint32_t count;         // entradas válidas
+    uint32_t deleted;       // lápides pendentes
+} card_index_t;
+
+// Retorna true se o slot candidato contém o UID procurado
+typedef bool (*card_index_match_fn)(uint16_t slot, void *ctx);
+
+uint32_t card_index_hash(const void *data, size_t len);
+
+esp_err_t card_index_init(card_index_t *index, uint32_t expected_count);
+void card_index_free(card_index_t *index);
+esp_err_t card_index_insert(card_index_t *index, uint32_t hash, uint16_t slot);
+bool card_index_find(const card_index_t *index, uint32_t hash,
+                     card_index_match_fn match, void *ctx, uint16_t *slot);
+bool card_index_remove(card_index_t *index, uint32_t hash,
+                       card_index_match_fn match, void *ctx);
+
+#endif // CARD_INDEX_H
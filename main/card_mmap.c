@@ -0,0 +1,387 @@
+#include "card_mmap.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_log.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <inttypes.h>
+
+static const char *TAG = "CARD_MMAP";
+
+#define CARD_MMAP_SECTOR_SIZE   4096
+#define CARD_MMAP_DELTA_SIZE    (16 * CARD_MMAP_SECTOR_SIZE)
+#define CARD_MMAP_BANK_MAGIC    0x4B4E4142  // "BANK"
+#define CARD_MMAP_DELTA_MAGIC   0x41544C44  // "DLTA"
+#define CARD_MMAP_RECORD_MAGIC  0xC5
+#define CARD_MMAP_ERASED        0xFF
+
+#define CARD_MMAP_FLAG_LIVE     0x01
+#define CARD_MMAP_FLAG_DELETED  0x02
+
+// Localização do registro atual de cada slot
+#define LOC_BASE    0xFFFF      // registro no banco ativo
+#define LOC_NONE    0xFFFE      // slot livre
+
+typedef struct {
+    uint32_t magic;
+    uint32_t generation;
+    uint32_t slot_count;
+    uint32_t crc;
+} card_mmap_header_t;
+
+_Static_assert(sizeof(card_mmap_record_t) == 96, "registro mapeado deve ter 96 bytes");
+
+#define RECORD_CRC_LEN      offsetof(card_mmap_record_t, crc)
+#define HEADER_CRC_LEN      offsetof(card_mmap_header_t, crc)
+#define RECORDS_OFFSET      sizeof(card_mmap_header_t)
+
+static const esp_partition_t *s_partition = NULL;
+static esp_partition_mmap_handle_t s_mmap_handle;
+static const uint8_t *s_mapped = NULL;
+static uint32_t s_bank_size = 0;
+static uint32_t s_slot_capacity = 0;
+static uint32_t s_delta_capacity = 0;
+static uint32_t s_active_bank = 0;
+static uint32_t s_generation = 0;
+static uint32_t s_delta_next = 0;
+static uint16_t *s_loc = NULL;
+
+static inline uint32_t bank_offset(uint32_t bank) {
+    return bank * s_bank_size;
+}
+
+static inline uint32_t delta_offset(void) {
+    return 2 * s_bank_size;
+}
+
+static inline const card_mmap_record_t *base_record(uint32_t bank, uint32_t slot) {
+    return (const card_mmap_record_t *)&s_mapped[bank_offset(bank) + RECORDS_OFFSET +
+                                                 slot * sizeof(card_mmap_record_t)];
+}
+
+static inline const card_mmap_record_t *delta_record(uint32_t index) {
+    return (const card_mmap_record_t *)&s_mapped[delta_offset() + RECORDS_OFFSET +
+                                                 index * sizeof(card_mmap_record_t)];
+}
+
+static uint32_t record_crc(const card_mmap_record_t *rec) {
+    return esp_rom_crc32_le(0, (const uint8_t *)rec, RECORD_CRC_LEN);
+}
+
+static bool record_valid(const card_mmap_record_t *rec) {
+    return rec->magic == CARD_MMAP_RECORD_MAGIC && rec->crc == record_crc(rec);
+}
+
+static bool header_valid(const card_mmap_header_t *hdr, uint32_t magic) {
+    return hdr->magic == magic &&
+           hdr->crc == esp_rom_crc32_le(0, (const uint8_t *)hdr, HEADER_CRC_LEN);
+}
+
+static esp_err_t write_header(uint32_t offset, uint32_t magic, uint32_t generation, uint32_t slot_count) {
+    card_mmap_header_t hdr = {
+        .magic = magic,
+        .generation = generation,
+        .slot_count = slot_count,
+    };
+    hdr.crc = esp_rom_crc32_le(0, (const uint8_t *)&hdr, HEADER_CRC_LEN);
+    return esp_partition_write(s_partition, offset, &hdr, sizeof(hdr));
+}
+
+static esp_err_t reset_delta(uint32_t generation) {
+    esp_err_t ret = esp_partition_erase_range(s_partition, delta_offset(), CARD_MMAP_DELTA_SIZE);
+    if (ret == ESP_OK) {
+        ret = write_header(delta_offset(), CARD_MMAP_DELTA_MAGIC, generation, 0);
+    }
+    s_delta_next = 0;
+    return ret;
+}
+
+static void fill_record(card_mmap_record_t *rec, uint16_t slot, const card_hot_t *hot,
+                        uint32_t first_seen, const char *name) {
+    memset(rec, 0, sizeof(*rec));
+    rec->hot = *hot;
+    rec->first_seen = first_seen;
+    if (name) {
+        memcpy(rec->name, name, strnlen(name, CARD_MMAP_NAME_LENGTH - 1));   // rec zerado: termina em '\0'
+    }
+    rec->slot = slot;
+    rec->flags = CARD_MMAP_FLAG_LIVE;
+    rec->magic = CARD_MMAP_RECORD_MAGIC;
+    rec->crc = record_crc(rec);
+}
+
+// Partição nova ou sem banco válido: formatar
+static esp_err_t format_partition(void) {
+    ESP_LOGW(TAG, "Formatando tabela mapeada");
+    esp_err_t ret = esp_partition_erase_range(s_partition, 0, 2 * s_bank_size);
+    if (ret == ESP_OK) {
+        ret = write_header(bank_offset(0), CARD_MMAP_BANK_MAGIC, 1, 0);
+    }
+    if (ret == ESP_OK) {
+        ret = reset_delta(1);
+    }
+    s_active_bank = 0;
+    s_generation = 1;
+    return ret;
+}
+
+static esp_err_t select_active_bank(void) {
+    const card_mmap_header_t *h0 = (const card_mmap_header_t *)&s_mapped[bank_offset(0)];
+    const card_mmap_header_t *h1 = (const card_mmap_header_t *)&s_mapped[bank_offset(1)];
+    bool v0 = header_valid(h0, CARD_MMAP_BANK_MAGIC);
+    bool v1 = header_valid(h1, CARD_MMAP_BANK_MAGIC);
+
+    if (!v0 && !v1) {
+        return format_partition();
+    }
+    if (v0 && (!v1 || h0->generation >= h1->generation)) {
+        s_active_bank = 0;
+        s_generation = h0->generation;
+    } else {
+        s_active_bank = 1;
+        s_generation = h1->generation;
+    }
+    return ESP_OK;
+}
+
+// Reaplica a área delta; ela só vale para a geração do banco ativo
+static esp_err_t replay_delta(void) {
+    const card_mmap_header_t *hdr = (const card_mmap_header_t *)&s_mapped[delta_offset()];
+    if (!header_valid(hdr, CARD_MMAP_DELTA_MAGIC) || hdr->generation != s_generation) {
+        // Compactação interrompida após a troca de banco
+        return reset_delta(s_generation);
+    }
+
+    uint32_t index = 0;
+    for (; index < s_delta_capacity; index++) {
+        const card_mmap_record_t *rec = delta_record(index);
+        if (rec->magic == CARD_MMAP_ERASED) {
+            break;
+        }
+        if (!record_valid(rec) || rec->slot >= s_slot_capacity) {
+            continue; // registro incompleto ocupa o espaço normalmente
+        }
+        s_loc[rec->slot] = (rec->flags & CARD_MMAP_FLAG_LIVE) ? (uint16_t)index : LOC_NONE;
+    }
+    s_delta_next = index;
+    return ESP_OK;
+}
+
+esp_err_t card_mmap_init(card_mmap_load_cb cb, void *ctx) {
+    s_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                           CARD_MMAP_PARTITION_SUBTYPE,
+                                           CARD_MMAP_PARTITION_LABEL);
+    if (!s_partition) {
+        ESP_LOGE(TAG, "Partição '%s' não encontrada", CARD_MMAP_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (s_partition->size < CARD_MMAP_DELTA_SIZE + 4 * CARD_MMAP_SECTOR_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    s_bank_size = ((s_partition->size - CARD_MMAP_DELTA_SIZE) / 2) & ~(CARD_MMAP_SECTOR_SIZE - 1);
+    s_slot_capacity = (s_bank_size - RECORDS_OFFSET) / sizeof(card_mmap_record_t);
+    s_delta_capacity = (CARD_MMAP_DELTA_SIZE - RECORDS_OFFSET) / sizeof(card_mmap_record_t);
+    if (s_slot_capacity > LOC_NONE) {
+        s_slot_capacity = LOC_NONE;
+    }
+
+    const void *ptr = NULL;
+    esp_err_t ret = esp_partition_mmap(s_partition, 0, s_partition->size,
+                                       ESP_PARTITION_MMAP_DATA, &ptr, &s_mmap_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Falha no mmap: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    s_mapped = (const uint8_t *)ptr;
+
+    s_loc = malloc(s_slot_capacity * sizeof(uint16_t));
+    if (!s_loc) {
+        card_mmap_deinit();
+        return ESP_ERR_NO_MEM;
+    }
+
+    ret = select_active_bank();
+    if (ret != ESP_OK) {
+        card_mmap_deinit();
+        return ret;
+    }
+
+    for (uint32_t slot = 0; slot < s_slot_capacity; slot++) {
+        const card_mmap_record_t *rec = base_record(s_active_bank, slot);
+        s_loc[slot] = (record_valid(rec) && (rec->flags & CARD_MMAP_FLAG_LIVE)) ? LOC_BASE : LOC_NONE;
+    }
+
+    ret = replay_delta();
+    if (ret != ESP_OK) {
+        card_mmap_deinit();
+        return ret;
+    }
+
+    if (cb) {
+        for (uint32_t slot = 0; slot < s_slot_capacity; slot++) {
+            const card_mmap_record_t *rec = card_mmap_get((uint16_t)slot);
+            if (rec) {
+                cb((uint16_t)slot, rec, ctx);
+            }
+        }
+    }
+
+    ESP_LOGI(TAG, "Tabela mapeada: banco %" PRIu32 " geração %" PRIu32 ", %" PRIu32 " slots, delta %" PRIu32 "/%" PRIu32,
+             s_active_bank, s_generation, s_slot_capacity, s_delta_next, s_delta_capacity);
+    return ESP_OK;
+}
+
+void card_mmap_deinit(void) {
+    if (s_mapped) {
+        esp_partition_munmap(s_mmap_handle);
+        s_mapped = NULL;
+    }
+    free(s_loc);
+    s_loc = NULL;
+    s_partition = NULL;
+}
+
+uint32_t card_mmap_slot_capacity(void) {
+    return s_slot_capacity;
+}
+
+uint32_t card_mmap_delta_free(void) {
+    return s_delta_capacity - s_delta_next;
+}
+
+const card_mmap_record_t *card_mmap_get(uint16_t slot) {
+    if (!s_loc || slot >= s_slot_capacity || s_loc[slot] == LOC_NONE) {
+        return NULL;
+    }
+    if (s_loc[slot] == LOC_BASE) {
+        return base_record(s_active_bank, slot);
+    }
+    return delta_record(s_loc[slot]);
+}
+
+static esp_err_t append_delta(const card_mmap_record_t *rec) {
+    if (s_delta_next >= s_delta_capacity) {
+        return ESP_ERR_NO_MEM;
+    }
+    uint32_t offset = delta_offset() + RECORDS_OFFSET + s_delta_next * sizeof(*rec);
+    esp_err_t ret = esp_partition_write(s_partition, offset, rec, sizeof(*rec));
+    // Mesmo com erro o espaço é considerado usado (pode estar parcialmente gravado)
+    s_delta_next++;
+    return ret;
+}
+
+esp_err_t card_mmap_put(uint16_t slot, const card_hot_t *hot, uint32_t first_seen, const char *name) {
+    if (!s_mapped || !hot || slot >= s_slot_capacity) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    card_mmap_record_t rec;
+    if (!name) {
+        const card_mmap_record_t *current = card_mmap_get(slot);
+        first_seen = current ? current->first_seen : 0;
+        name = current ? current->name : "";
+    }
+    fill_record(&rec, slot, hot, first_seen, name);
+
+    uint16_t index = (uint16_t)s_delta_next;
+    esp_err_t ret = append_delta(&rec);
+    if (ret == ESP_OK) {
+        s_loc[slot] = index;
+    }
+    return ret;
+}
+
+esp_err_t card_mmap_delete(uint16_t slot) {
+    if (!s_mapped || slot >= s_slot_capacity) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    card_mmap_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.slot = slot;
+    rec.flags = CARD_MMAP_FLAG_DELETED;
+    rec.magic = CARD_MMAP_RECORD_MAGIC;
+    rec.crc = record_crc(&rec);
+
+    esp_err_t ret = append_delta(&rec);
+    if (ret == ESP_OK) {
+        s_loc[slot] = LOC_NONE;
+    }
+    return ret;
+}
+
+static bool mapped_cold(uint16_t slot, uint32_t *first_seen, const char **name, void *ctx) {
+    (void)ctx;
+    const card_mmap_record_t *current = card_mmap_get(slot);
+    if (!current) {
+        return false;
+    }
+    *first_seen = current->first_seen;
+    *name = current->name;
+    return true;
+}
+
+esp_err_t card_mmap_compact(const card_hot_t *table, uint32_t slot_count,
+                            card_mmap_cold_fn cold, void *ctx) {
+    if (!s_mapped || !table) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (slot_count > s_slot_capacity) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint32_t records_per_chunk = CARD_MMAP_SECTOR_SIZE / sizeof(card_mmap_record_t);
+    card_mmap_record_t *chunk = malloc(records_per_chunk * sizeof(card_mmap_record_t));
+    if (!chunk) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (!cold) {
+        cold = mapped_cold;
+    }
+
+    uint32_t target = 1 - s_active_bank;
+    esp_err_t ret = esp_partition_erase_range(s_partition, bank_offset(target), s_bank_size);
+
+    // Grava os registros em lotes; slots livres ficam apagados (0xFF)
+    uint32_t slot = 0;
+    while (ret == ESP_OK && slot < slot_count) {
+        uint32_t first = slot;
+        uint32_t n = 0;
+        for (; slot < slot_count && n < records_per_chunk; slot++, n++) {
+            uint32_t first_seen = 0;
+            const char *name = "";
+            if (table[slot].uid_len != 0) {
+                cold((uint16_t)slot, &first_seen, &name, ctx);
+                fill_record(&chunk[n], (uint16_t)slot, &table[slot], first_seen, name);
+            } else {
+                memset(&chunk[n], CARD_MMAP_ERASED, sizeof(card_mmap_record_t));
+            }
+        }
+        ret = esp_partition_write(s_partition,
+                                  bank_offset(target) + RECORDS_OFFSET + first * sizeof(card_mmap_record_t),
+                                  chunk, n * sizeof(card_mmap_record_t));
+    }
+    free(chunk);
+
+    // O cabeçalho é gravado por último: só então o novo banco passa a valer
+    if (ret == ESP_OK) {
+        ret = write_header(bank_offset(target), CARD_MMAP_BANK_MAGIC, s_generation + 1, slot_count);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Falha na compactação: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    s_active_bank = target;
+    s_generation++;
+    for (uint32_t i = 0; i < s_slot_capacity; i++) {
+        s_loc[i] = (i < slot_count && table[i].uid_len != 0) ? LOC_BASE : LOC_NONE;
+    }
+
+    ret = reset_delta(s_generation);
+    ESP_LOGI(TAG, "Compactação concluída: geração %" PRIu32, s_generation);
+    return ret;
+}
@@ -0,0 +1,52 @@
+#ifndef CARD_MMAP_H
+#define CARD_MMAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "card_record.h"
+
+// Tabela de cartões numa partição mapeada em memória (esp_partition_mmap).
+// Layout: [banco 0][banco 1][área delta]. O banco ativo guarda um registro
+// por slot; alterações são anexadas à área delta e incorporadas a um novo
+// banco na compactação (troca de geração).
+#define CARD_MMAP_PARTITION_LABEL    "cardtab"
+#define CARD_MMAP_PARTITION_SUBTYPE  0x41
+#define CARD_MMAP_NAME_LENGTH        64     // = MAX_NAME_LENGTH
+
+typedef struct __attribute__((packed)) {
+    card_hot_t hot;
+    uint32_t first_seen;
+    char name[CARD_MMAP_NAME_LENGTH];   // sempre terminado em '\0'
+    uint16_t slot;
+    uint8_t flags;
+    uint8_t magic;
+    uint32_t crc;
+} card_mmap_record_t;
+
+// Fornece first_seen e nome de um slot durante a compactação
+typedef bool (*card_mmap_cold_fn)(uint16_t slot, uint32_t *first_seen, const char **name, void *ctx);
+
+// Chamado para cada slot vivo após aplicar a área delta
+typedef void (*card_mmap_load_cb)(uint16_t slot, const card_mmap_record_t *record, void *ctx);
+
+esp_err_t card_mmap_init(card_mmap_load_cb cb, void *ctx);
+void card_mmap_deinit(void);
+
+uint32_t card_mmap_slot_capacity(void);
+uint32_t card_mmap_delta_free(void);
+
+// Ponteiro para o registro atual do slot na memória mapeada (ou NULL)
+const card_mmap_record_t *card_mmap_get(uint16_t slot);
+
+// Anexa à área delta. name == NULL mantém nome e first_seen atuais.
+// Retorna ESP_ERR_NO_MEM quando a área delta está cheia.
+esp_err_t card_mmap_put(uint16_t slot, const card_hot_t *hot, uint32_t first_seen, const char *name);
+esp_err_t card_mmap_delete(uint16_t slot);
+
+// Grava um novo banco com os slots vivos (contadores de 'table') e zera a
+// área delta. cold == NULL usa o nome/first_seen atuais do mapeamento.
+esp_err_t card_mmap_compact(const card_hot_t *table, uint32_t slot_count,
+                            card_mmap_cold_fn cold, void *ctx);
+
+#endif // CARD_MMAP_H
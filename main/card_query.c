@@ -0,0 +1,367 @@
+#include "card_query.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define LEVEL_BUCKET(level)  ((level) < CARD_QUERY_LEVELS ? (level) : 0)
+#define BIT_WORDS(slots)     (((slots) + 31) / 32)
+
+static inline bool bit_get(const uint32_t *bits, uint32_t slot) {
+    return (bits[slot / 32] >> (slot % 32)) & 1;
+}
+
+static inline void bit_set(uint32_t *bits, uint32_t slot, bool value) {
+    if (value) {
+        bits[slot / 32] |= 1u << (slot % 32);
+    } else {
+        bits[slot / 32] &= ~(1u << (slot % 32));
+    }
+}
+
+static void name_key(const char *name, char key[CARD_QUERY_NAME_KEY_LEN]) {
+    memset(key, 0, CARD_QUERY_NAME_KEY_LEN);
+    for (int i = 0; i < CARD_QUERY_NAME_KEY_LEN && name && name[i]; i++) {
+        char c = name[i];
+        key[i] = (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+    }
+}
+
+void card_query_init(card_query_t *query) {
+    memset(query, 0, sizeof(*query));
+    query->head = CARD_QUERY_NIL;
+    query->tail = CARD_QUERY_NIL;
+}
+
+void card_query_free(card_query_t *query) {
+    for (int i = 0; i < CARD_QUERY_LEVELS; i++) {
+        free(query->level_bits[i]);
+    }
+    free(query->prev);
+    free(query->next);
+    free(query->name_keys);
+    free(query->by_name);
+    card_query_init(query);
+}
+
+esp_err_t card_query_reserve(card_query_t *query, uint32_t slots) {
+    if (slots <= query->capacity) {
+        return ESP_OK;
+    }
+    uint32_t new_capacity = slots;
+
+    for (int i = 0; i < CARD_QUERY_LEVELS; i++) {
+        uint32_t *bits = realloc(query->level_bits[i], BIT_WORDS(new_capacity) * sizeof(uint32_t));
+        if (!bits) {
+            return ESP_ERR_NO_MEM;
+        }
+        memset(&bits[BIT_WORDS(query->capacity)], 0,
+               (BIT_WORDS(new_capacity) - BIT_WORDS(query->capacity)) * sizeof(uint32_t));
+        query->level_bits[i] = bits;
+    }
+    uint16_t *prev = realloc(query->prev, new_capacity * sizeof(uint16_t));
+    if (!prev) {
+        return ESP_ERR_NO_MEM;
+    }
+    query->prev = prev;
+    uint16_t *next = realloc(query->next, new_capacity * sizeof(uint16_t));
+    if (!next) {
+        return ESP_ERR_NO_MEM;
+    }
+    query->next = next;
+    char (*keys)[CARD_QUERY_NAME_KEY_LEN] = realloc(query->name_keys, new_capacity * CARD_QUERY_NAME_KEY_LEN);
+    if (!keys) {
+        return ESP_ERR_NO_MEM;
+    }
+    query->name_keys = keys;
+    uint16_t *by_name = realloc(query->by_name, new_capacity * sizeof(uint16_t));
+    if (!by_name) {
+        return ESP_ERR_NO_MEM;
+    }
+    query->by_name = by_name;
+    query->capacity = new_capacity;
+    return ESP_OK;
+}
+
+// --- Lista por last_seen ---
+
+static void list_unlink(card_query_t *query, uint16_t slot) {
+    uint16_t prev = query->prev[slot];
+    uint16_t next = query->next[slot];
+    if (prev != CARD_QUERY_NIL) {
+        query->next[prev] = next;
+    } else {
+        query->head = next;
+    }
+    if (next != CARD_QUERY_NIL) {
+        query->prev[next] = prev;
+    } else {
+        query->tail = prev;
+    }
+}
+
+static void list_insert_after(card_query_t *query, uint16_t after, uint16_t slot) {
+    uint16_t next = after == CARD_QUERY_NIL ? query->head : query->next[after];
+    query->prev[slot] = after;
+    query->next[slot] = next;
+    if (after != CARD_QUERY_NIL) {
+        query->next[after] = slot;
+    } else {
+        query->head = slot;
+    }
+    if (next != CARD_QUERY_NIL) {
+        query->prev[next] = slot;
+    } else {
+        query->tail = slot;
+    }
+}
+
+// Ordem total da lista: last_seen e, no mesmo segundo, o slot. Assim a
+// posição de um cartão depende só dele e um cursor (last_seen, slot)
+// continua no lugar certo mesmo depois de acessos.
+static inline bool list_before(const card_hot_t *cards, uint16_t a, uint16_t b) {
+    return cards[a].last_seen < cards[b].last_seen ||
+           (cards[a].last_seen == cards[b].last_seen && a < b);
+}
+
+// Procura a posição a partir do fim: acessos novos param no primeiro passo
+static void list_insert_sorted(card_query_t *query, const card_hot_t *cards, uint16_t slot) {
+    uint16_t after = query->tail;
+    if (!query->bulk) {
+        while (after != CARD_QUERY_NIL && list_before(cards, slot, after)) {
+            after = query->prev[after];
+        }
+    }
+    list_insert_after(query, after, slot);
+}
+
+// --- Vetor ordenado por nome ---
+
+static uint32_t name_lower_bound(const card_query_t *query, const char *key, size_t len) {
+    uint32_t lo = 0;
+    uint32_t hi = query->count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (memcmp(query->name_keys[query->by_name[mid]], key, len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static uint32_t name_upper_bound(const card_query_t *query, const char *key, size_t len) {
+    uint32_t lo = 0;
+    uint32_t hi = query->count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (memcmp(query->name_keys[query->by_name[mid]], key, len) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Posição de 'slot' em by_name (count se não estiver)
+static uint32_t name_position(const card_query_t *query, uint16_t slot) {
+    uint32_t i = query->bulk ? 0 : name_lower_bound(query, query->name_keys[slot], CARD_QUERY_NAME_KEY_LEN);
+    for (; i < query->count; i++) {
+        if (query->by_name[i] == slot) {
+            return i;
+        }
+        if (!query->bulk && memcmp(query->name_keys[query->by_name[i]], query->name_keys[slot],
+                                   CARD_QUERY_NAME_KEY_LEN) != 0) {
+            break;
+        }
+    }
+    return query->count;
+}
+
+void card_query_add(card_query_t *query, const card_hot_t *cards, uint16_t slot, const char *name) {
+    if (slot >= query->capacity) {
+        return;
+    }
+    uint8_t bucket = LEVEL_BUCKET(cards[slot].access_level);
+    bit_set(query->level_bits[bucket], slot, true);
+    query->level_count[bucket]++;
+    list_insert_sorted(query, cards, slot);
+
+    name_key(name, query->name_keys[slot]);
+    uint32_t pos = query->bulk ? query->count :
+                   name_upper_bound(query, query->name_keys[slot], CARD_QUERY_NAME_KEY_LEN);
+    memmove(&query->by_name[pos + 1], &query->by_name[pos], (query->count - pos) * sizeof(uint16_t));
+    query->by_name[pos] = slot;
+    query->count++;
+    query->name_generation++;
+}
+
+void card_query_remove(card_query_t *query, const card_hot_t *cards, uint16_t slot) {
+    if (slot >= query->capacity) {
+        return;
+    }
+    uint8_t bucket = LEVEL_BUCKET(cards[slot].access_level);
+    if (!bit_get(query->level_bits[bucket], slot)) {
+        return; // não indexado
+    }
+    bit_set(query->level_bits[bucket], slot, false);
+    query->level_count[bucket]--;
+    list_unlink(query, slot);
+
+    uint32_t pos = name_position(query, slot);
+    if (pos < query->count) {
+        memmove(&query->by_name[pos], &query->by_name[pos + 1], (query->count - pos - 1) * sizeof(uint16_t));
+        query->count--;
+        query->name_generation++;
+    }
+}
+
+void card_query_touch(card_query_t *query, const card_hot_t *cards, uint16_t slot) {
+    if (slot >= query->capacity || !bit_get(query->level_bits[LEVEL_BUCKET(cards[slot].access_level)], slot)) {
+        return;
+    }
+    if (query->tail == slot && (query->prev[slot] == CARD_QUERY_NIL ||
+                                list_before(cards, query->prev[slot], slot))) {
+        return; // já é o mais recente
+    }
+    list_unlink(query, slot);
+    list_insert_sorted(query, cards, slot);
+}
+
+void card_query_move(card_query_t *query, const card_hot_t *cards, uint16_t from, uint16_t to) {
+    if (from >= query->capacity || to >= query->capacity) {
+        return;
+    }
+    uint8_t bucket = LEVEL_BUCKET(cards[from].access_level);
+    if (!bit_get(query->level_bits[bucket], from)) {
+        return;
+    }
+    bit_set(query->level_bits[bucket], from, false);
+    bit_set(query->level_bits[bucket], to, true);
+
+    // Mesma posição na lista e no vetor, só troca o slot; na lista o slot
+    // novo ainda pode mudar a ordem entre cartões do mesmo segundo
+    uint16_t prev = query->prev[from];
+    list_unlink(query, from);
+    while (prev != CARD_QUERY_NIL && list_before(cards, to, prev)) {
+        prev = query->prev[prev];
+    }
+    uint16_t next = prev == CARD_QUERY_NIL ? query->head : query->next[prev];
+    while (next != CARD_QUERY_NIL && list_before(cards, next, to)) {
+        prev = next;
+        next = query->next[next];
+    }
+    list_insert_after(query, prev, to);
+
+    uint32_t pos = name_position(query, from);
+    memcpy(query->name_keys[to], query->name_keys[from], CARD_QUERY_NAME_KEY_LEN);
+    if (pos < query->count) {
+        query->by_name[pos] = to;
+    }
+}
+
+// qsort sem contexto: os índices são alterados só sob o lock do banco
+static const card_query_t *s_sort_query;
+static const card_hot_t *s_sort_cards;
+
+static int cmp_by_name(const void *a, const void *b) {
+    return memcmp(s_sort_query->name_keys[*(const uint16_t *)a],
+                  s_sort_query->name_keys[*(const uint16_t *)b], CARD_QUERY_NAME_KEY_LEN);
+}
+
+static int cmp_by_last_seen(const void *a, const void *b) {
+    uint16_t sa = *(const uint16_t *)a;
+    uint16_t sb = *(const uint16_t *)b;
+    uint32_t la = s_sort_cards[sa].last_seen;
+    uint32_t lb = s_sort_cards[sb].last_seen;
+    if (la != lb) {
+        return la < lb ? -1 : 1;
+    }
+    return sa < sb ? -1 : sa > sb;
+}
+
+void card_query_bulk_begin(card_query_t *query) {
+    query->bulk = true;
+}
+
+void card_query_bulk_end(card_query_t *query, const card_hot_t *cards) {
+    if (!query->bulk) {
+        return;
+    }
+    query->bulk = false;
+    if (query->count == 0) {
+        return;
+    }
+    query->name_generation++;
+    s_sort_query = query;
+    s_sort_cards = cards;
+    qsort(query->by_name, query->count, sizeof(uint16_t), cmp_by_name);
+
+    // Lista refeita a partir de uma cópia ordenada por last_seen
+    uint16_t *order = malloc(query->count * sizeof(uint16_t));
+    if (order) {
+        memcpy(order, query->by_name, query->count * sizeof(uint16_t));
+        qsort(order, query->count, sizeof(uint16_t), cmp_by_last_seen);
+        query->head = CARD_QUERY_NIL;
+        query->tail = CARD_QUERY_NIL;
+        for (uint32_t i = 0; i < query->count; i++) {
+            list_insert_after(query, query->tail, order[i]);
+        }
+        free(order);
+    } else {
+        // Sem memória: reordenar por inserção a partir do fim
+        uint16_t slot = query->head;
+        query->head = CARD_QUERY_NIL;
+        query->tail = CARD_QUERY_NIL;
+        while (slot != CARD_QUERY_NIL) {
+            uint16_t next = query->next[slot];
+            list_insert_sorted(query, cards, slot);
+            slot = next;
+        }
+    }
+    s_sort_query = NULL;
+    s_sort_cards = NULL;
+}
+
+uint32_t card_query_name_range(const card_query_t *query, const char *prefix, uint32_t *first) {
+    char key[CARD_QUERY_NAME_KEY_LEN];
+    size_t len = prefix ? strlen(prefix) : 0;
+    if (len > CARD_QUERY_NAME_KEY_LEN) {
+        len = CARD_QUERY_NAME_KEY_LEN;
+    }
+    name_key(prefix, key);
+    uint32_t lo = name_lower_bound(query, key, len);
+    uint32_t hi = name_upper_bound(query, key, len);
+    *first = lo;
+    return hi - lo;
+}
+
+uint32_t card_query_level_next(const card_query_t *query, uint8_t level, uint32_t from) {
+    const uint32_t *bits = query->level_bits[LEVEL_BUCKET(level)];
+    for (uint32_t w = from / 32; w < BIT_WORDS(query->capacity); w++) {
+        uint32_t word = bits[w];
+        if (w == from / 32) {
+            word &= ~0u << (from % 32);
+        }
+        if (word) {
+            return w * 32 + __builtin_ctz(word);
+        }
+    }
+    return CARD_QUERY_NIL;
+}
+
+bool card_query_name_has_prefix(const char *name, const char *prefix) {
+    for (; *prefix; name++, prefix++) {
+        char a = (*name >= 'A' && *name <= 'Z') ? (char)(*name - 'A' + 'a') : *name;
+        char b = (*prefix >= 'A' && *prefix <= 'Z') ? (char)(*prefix - 'A' + 'a') : *prefix;
+        if (a != b) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t card_query_memory(const card_query_t *query) {
+    return query->capacity * (2 * sizeof(uint16_t) + CARD_QUERY_NAME_KEY_LEN + sizeof(uint16_t)) +
+           CARD_QUERY_LEVELS * BIT_WORDS(query->capacity) * sizeof(uint32_t);
+}
@@ -0,0 +1,67 @@
+#ifndef CARD_QUERY_H
+#define CARD_QUERY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "card_record.h"
+
+// Índices secundários em RAM sobre a tabela quente, mantidos pelo banco a
+// cada mutação:
+//  - bitmap de slots por nível de acesso;
+//  - lista duplamente encadeada por last_seen crescente, desempatada pelo
+//    slot (um acesso move o cartão para o fim em O(1) no caso comum);
+//  - vetor de slots ordenado pelo prefixo do nome em minúsculas, para busca
+//    por prefixo com pesquisa binária.
+// Os nomes completos ficam no registro frio; prefixos maiores que
+// CARD_QUERY_NAME_KEY_LEN são confirmados pelo chamador.
+#ifndef CARD_QUERY_NAME_KEY_LEN
+#define CARD_QUERY_NAME_KEY_LEN   8       // bytes do nome guardados por slot
+#endif
+#define CARD_QUERY_LEVELS         4       // bitmaps dos níveis 0..3; acima disso, o 0
+#define CARD_QUERY_NIL            0xFFFF
+
+typedef struct {
+    uint32_t capacity;                          // slots alocados
+    uint32_t *level_bits[CARD_QUERY_LEVELS];
+    uint32_t level_count[CARD_QUERY_LEVELS];
+    uint16_t *prev;                             // lista por last_seen
+    uint16_t *next;
+    uint16_t head;                              // mais antigo
+    uint16_t tail;                              // mais recente
+    char (*name_keys)[CARD_QUERY_NAME_KEY_LEN]; // por slot, sem terminador
+    uint16_t *by_name;                          // slots ordenados por name_keys
+    uint32_t count;
+    uint32_t name_generation;                   // muda quando posições de by_name mudam
+    bool bulk;                                  // ordenação adiada (carga/importação)
+} card_query_t;
+
+void card_query_init(card_query_t *query);
+void card_query_free(card_query_t *query);
+// Exatamente 'slots' posições; a política de crescimento é do chamador
+esp_err_t card_query_reserve(card_query_t *query, uint32_t slots);
+
+// 'cards' é a tabela quente; o slot já deve estar preenchido nela
+void card_query_add(card_query_t *query, const card_hot_t *cards, uint16_t slot, const char *name);
+// Chamar antes de limpar o slot na tabela quente
+void card_query_remove(card_query_t *query, const card_hot_t *cards, uint16_t slot);
+// last_seen do slot mudou
+void card_query_touch(card_query_t *query, const card_hot_t *cards, uint16_t slot);
+// cards[to] já é a cópia de cards[from]; 'from' ainda não foi limpo
+void card_query_move(card_query_t *query, const card_hot_t *cards, uint16_t from, uint16_t to);
+
+// Inserções em lote sem manter a ordem; bulk_end ordena tudo de uma vez
+void card_query_bulk_begin(card_query_t *query);
+void card_query_bulk_end(card_query_t *query, const card_hot_t *cards);
+
+// Faixa [*first, *first + retorno) de by_name cujo nome começa com 'prefix'
+// (comparando até CARD_QUERY_NAME_KEY_LEN bytes, sem diferenciar maiúsculas)
+uint32_t card_query_name_range(const card_query_t *query, const char *prefix, uint32_t *first);
+// Próximo slot >= from com o nível (CARD_QUERY_NIL no fim)
+uint32_t card_query_level_next(const card_query_t *query, uint8_t level, uint32_t from);
+// Compara 'name' com 'prefix' do mesmo jeito que o índice, sem limite de tamanho
+bool card_query_name_has_prefix(const char *name, const char *prefix);
+
+uint32_t card_query_memory(const card_query_t *query);
+
+#endif // CARD_QUERY_H
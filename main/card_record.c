@@ -0,0 +1,123 @@
+#include "card_record.h"
+#include <stdio.h>
+#include <string.h>
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+esp_err_t card_uid_parse(const char *str, uint8_t *uid, uint8_t *uid_len) {
+    if (!str || !uid || !uid_len) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t len = 0;
+    const char *p = str;
+    while (*p) {
+        if (*p == ':' || *p == '-' || *p == ' ') {
+            p++;
+            continue;
+        }
+        int hi = hex_value(p[0]);
+        int lo = (hi >= 0) ? hex_value(p[1]) : -1;
+        if (lo < 0 || len >= CARD_UID_MAX_BYTES) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        uid[len++] = (uint8_t)((hi << 4) | lo);
+        p += 2;
+    }
+
+    if (len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *uid_len = len;
+    return ESP_OK;
+}
+
+// Mesmo formato usado por rc522_read_card_uid
+void card_uid_format(const uint8_t *uid, uint8_t uid_len, char *out, size_t out_size) {
+    size_t written = 0;
+    if (out_size == 0) {
+        return;
+    }
+    for (uint8_t i = 0; i < uid_len && written + 3 < out_size; i++) {
+        if (i > 0) {
+            out[written++] = ':';
+        }
+        written += snprintf(&out[written], out_size - written, "%02X", uid[i]);
+    }
+    out[written] = '\0';
+}
+
+size_t varint_encode(uint32_t value, uint8_t *out) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+size_t varint_decode(const uint8_t *in, size_t in_len, uint32_t *value) {
+    uint32_t result = 0;
+    for (size_t i = 0; i < in_len && i < VARINT_MAX_BYTES; i++) {
+        result |= (uint32_t)(in[i] & 0x7F) << (7 * i);
+        if (!(in[i] & 0x80)) {
+            *value = result;
+            return i + 1;
+        }
+    }
+    return 0; // truncado ou inválido
+}
+
+static void put_u32(uint8_t *out, uint32_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)(value >> 16);
+    out[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t get_u32(const uint8_t *in) {
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) |
+           ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+size_t card_hot_encode(const card_hot_t *card, uint8_t *out) {
+    size_t n = 0;
+    out[n++] = card->uid_len;
+    memcpy(&out[n], card->uid, card->uid_len);
+    n += card->uid_len;
+    out[n++] = card->access_level;
+    put_u32(&out[n], card->last_seen);
+    n += 4;
+    n += varint_encode(card->access_count, &out[n]);
+    return n;
+}
+
+esp_err_t card_hot_decode(const uint8_t *in, size_t in_len, card_hot_t *card) {
+    if (in_len < 1) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memset(card, 0, sizeof(*card));
+    uint8_t uid_len = in[0];
+    if (uid_len == 0 || uid_len > CARD_UID_MAX_BYTES || in_len < (size_t)uid_len + 6) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    size_t n = 1;
+    memcpy(card->uid, &in[n], uid_len);
+    n += uid_len;
+    card->uid_len = uid_len;
+    card->access_level = in[n++];
+    card->last_seen = get_u32(&in[n]);
+    n += 4;
+    if (varint_decode(&in[n], in_len - n, &card->access_count) == 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,40 @@
+#ifndef CARD_RECORD_H
+#define CARD_RECORD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// UID binário (mesmo formato de rc522_card_t)
+#define CARD_UID_MAX_BYTES      10
+
+// Tamanho máximo do registro "quente" codificado no flash:
+// uid_len(1) + uid(10) + access_level(1) + last_seen(4) + varint(5)
+#define CARD_HOT_MAX_ENCODED    21
+
+#define VARINT_MAX_BYTES        5
+
+// Registro "quente" mantido em RAM: apenas o necessário para a decisão de
+// acesso. Nome e first_seen ficam no registro "frio" (lido sob demanda).
+// 20 bytes por cartão -> ~200 KB para 10k cartões.
+typedef struct {
+    uint8_t uid[CARD_UID_MAX_BYTES];
+    uint8_t uid_len;            // 0 = slot livre
+    uint8_t access_level;
+    uint32_t last_seen;
+    uint32_t access_count;
+} card_hot_t;
+
+// Conversão UID texto ("04:A3:B2:C1" ou "04A3B2C1") <-> binário
+esp_err_t card_uid_parse(const char *str, uint8_t *uid, uint8_t *uid_len);
+void card_uid_format(const uint8_t *uid, uint8_t uid_len, char *out, size_t out_size);
+
+// Inteiros sem sinal em base 128 (LEB128)
+size_t varint_encode(uint32_t value, uint8_t *out);
+size_t varint_decode(const uint8_t *in, size_t in_len, uint32_t *value);
+
+// Registro quente <-> blob compacto
+size_t card_hot_encode(const card_hot_t *card, uint8_t *out);
+esp_err_t card_hot_decode(const uint8_t *in, size_t in_len, card_hot_t *card);
+
+#endif // CARD_RECORD_H
@@ -0,0 +1,472 @@
+#include "card_snapshot.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+// Registro de cada slot no pedaço: card_hot_encode + chave de nome, ou um
+// byte 0 para slot livre. A gravação de uma fotografia nova é feita pedaço
+// a pedaço (card_snapshot_step) com o banco liberado entre eles: slots
+// gravados depois que o seu pedaço já foi escrito, ou fora do intervalo
+// fotografado, entram na lista da geração nova. O cabeçalho é gravado por
+// último e a lista em seguida; até lá a geração anterior não bate com os
+// pedaços e o boot faz a leitura completa.
+#define SNAP_MAGIC            0x50414E53  // "SNAP"
+#define SNAP_VERSION          1
+#define SNAP_CHUNK_MAGIC      0x4B43      // "CK"
+#define SNAP_HEADER_KEY       "snap_h"
+#define SNAP_DIRTY_KEY        "snap_d"
+#define SNAP_CHUNK_PREFIX     "snap_"
+#define SNAP_DIRTY_OVERFLOW   0x0001      // lista estourou: fotografia inválida
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t name_key_len;
+    uint16_t chunk_count;
+    uint32_t generation;
+    uint32_t slot_count;
+    uint32_t crc;
+} snap_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint16_t index;
+    uint32_t generation;
+    uint16_t first_slot;
+    uint16_t slot_count;
+    uint32_t crc;           // cabeçalho (até slot_count) + registros
+} snap_chunk_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t generation;
+    uint16_t flags;
+    uint16_t count;
+    uint32_t crc;           // cabeçalho (até count) + slots
+} snap_dirty_header_t;
+
+#define SNAP_RECORD_MAX   (CARD_HOT_MAX_ENCODED + CARD_QUERY_NAME_KEY_LEN)
+
+typedef struct {
+    uint16_t *slots;        // ordenados
+    uint32_t count;
+} snap_slot_list_t;
+
+static const storage_backend_t *s_store = NULL;
+static snap_header_t s_header;          // fotografia válida no flash
+static bool s_valid = false;            // s_dirty acompanha s_header no flash
+static snap_slot_list_t s_dirty;
+static bool s_dirty_changed = false;
+
+// Gravação em andamento
+static bool s_writing = false;
+static snap_header_t s_next;
+static uint32_t s_next_slot;            // slots abaixo já estão em pedaços gravados
+static snap_slot_list_t s_pending;      // lista da geração nova
+static uint8_t *s_chunk = NULL;
+static int64_t s_write_start_us = 0;
+static card_snapshot_stats_t s_stats;
+
+static void snap_chunk_key(uint32_t index, char *key, size_t key_size) {
+    snprintf(key, key_size, SNAP_CHUNK_PREFIX "%" PRIu32, index);
+}
+
+static uint32_t snap_header_crc(const snap_header_t *hdr) {
+    return esp_rom_crc32_le(0, (const uint8_t *)hdr, offsetof(snap_header_t, crc));
+}
+
+static uint32_t snap_chunk_crc(const snap_chunk_header_t *hdr, const uint8_t *payload, size_t len) {
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)hdr, offsetof(snap_chunk_header_t, crc));
+    return esp_rom_crc32_le(crc, payload, len);
+}
+
+// Insere mantendo a ordem; false se a lista está cheia
+static bool snap_list_add(snap_slot_list_t *list, uint16_t slot, bool *added) {
+    uint32_t lo = 0;
+    uint32_t hi = list->count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (list->slots[mid] < slot) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *added = false;
+    if (lo < list->count && list->slots[lo] == slot) {
+        return true;
+    }
+    if (list->count >= CARD_SNAPSHOT_MAX_DIRTY) {
+        return false;
+    }
+    memmove(&list->slots[lo + 1], &list->slots[lo], (list->count - lo) * sizeof(uint16_t));
+    list->slots[lo] = slot;
+    list->count++;
+    *added = true;
+    return true;
+}
+
+static esp_err_t snap_write_dirty(uint32_t generation, uint16_t flags, const snap_slot_list_t *list) {
+    size_t len = sizeof(snap_dirty_header_t) + list->count * sizeof(uint16_t);
+    uint8_t *buf = malloc(len);
+    if (!buf) {
+        return ESP_ERR_NO_MEM;
+    }
+    snap_dirty_header_t hdr = {
+        .generation = generation,
+        .flags = flags,
+        .count = (uint16_t)list->count,
+    };
+    if (list->count > 0) {
+        memcpy(&buf[sizeof(hdr)], list->slots, list->count * sizeof(uint16_t));
+    }
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)&hdr, offsetof(snap_dirty_header_t, crc));
+    hdr.crc = esp_rom_crc32_le(crc, &buf[sizeof(hdr)], list->count * sizeof(uint16_t));
+    memcpy(buf, &hdr, sizeof(hdr));
+    esp_err_t ret = storage_set(s_store, SNAP_DIRTY_KEY, buf, len);
+    free(buf);
+    return ret;
+}
+
+static esp_err_t snap_read_dirty(void) {
+    size_t len = 0;
+    esp_err_t ret = storage_get(s_store, SNAP_DIRTY_KEY, NULL, &len);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (len < sizeof(snap_dirty_header_t) ||
+        len > sizeof(snap_dirty_header_t) + CARD_SNAPSHOT_MAX_DIRTY * sizeof(uint16_t)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    uint8_t *buf = malloc(len);
+    if (!buf) {
+        return ESP_ERR_NO_MEM;
+    }
+    ret = storage_get(s_store, SNAP_DIRTY_KEY, buf, &len);
+    snap_dirty_header_t hdr;
+    memcpy(&hdr, buf, sizeof(hdr));
+    size_t list_len = len - sizeof(hdr);
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)&hdr, offsetof(snap_dirty_header_t, crc));
+    crc = esp_rom_crc32_le(crc, &buf[sizeof(hdr)], list_len);
+    if (ret == ESP_OK && (hdr.crc != crc || hdr.count * sizeof(uint16_t) != list_len)) {
+        ret = ESP_ERR_INVALID_CRC;
+    } else if (ret == ESP_OK && (hdr.generation != s_header.generation || (hdr.flags & SNAP_DIRTY_OVERFLOW))) {
+        ret = ESP_ERR_INVALID_STATE;
+    }
+    if (ret == ESP_OK) {
+        memcpy(s_dirty.slots, &buf[sizeof(hdr)], list_len);
+        s_dirty.count = hdr.count;
+    }
+    free(buf);
+    return ret;
+}
+
+esp_err_t card_snapshot_open(const storage_backend_t *store) {
+    card_snapshot_close();
+    s_store = store;
+    s_dirty.slots = malloc(CARD_SNAPSHOT_MAX_DIRTY * sizeof(uint16_t));
+    s_pending.slots = malloc(CARD_SNAPSHOT_MAX_DIRTY * sizeof(uint16_t));
+    if (!s_dirty.slots || !s_pending.slots) {
+        card_snapshot_close();
+        return ESP_ERR_NO_MEM;
+    }
+
+    size_t len = sizeof(s_header);
+    esp_err_t ret = storage_get(s_store, SNAP_HEADER_KEY, &s_header, &len);
+    if (ret == ESP_OK && (len != sizeof(s_header) || s_header.magic != SNAP_MAGIC ||
+                          s_header.crc != snap_header_crc(&s_header))) {
+        ret = ESP_ERR_INVALID_CRC;
+    }
+    if (ret == ESP_OK && (s_header.version != SNAP_VERSION ||
+                          s_header.name_key_len != CARD_QUERY_NAME_KEY_LEN)) {
+        ret = ESP_ERR_INVALID_VERSION;
+    }
+    if (ret == ESP_OK) {
+        ret = snap_read_dirty();
+    }
+    if (ret != ESP_OK) {
+        // A próxima gravação continua a numeração e sobrescreve os pedaços
+        uint32_t generation = s_header.magic == SNAP_MAGIC ? s_header.generation : 0;
+        uint16_t chunk_count = s_header.magic == SNAP_MAGIC ? s_header.chunk_count : 0;
+        memset(&s_header, 0, sizeof(s_header));
+        s_header.generation = generation;
+        s_header.chunk_count = chunk_count;
+        s_valid = false;
+        return ret == ESP_ERR_NOT_FOUND ? ret : ESP_ERR_INVALID_CRC;
+    }
+    s_valid = true;
+    return ESP_OK;
+}
+
+void card_snapshot_close(void) {
+    free(s_dirty.slots);
+    free(s_pending.slots);
+    free(s_chunk);
+    s_dirty.slots = NULL;
+    s_pending.slots = NULL;
+    s_chunk = NULL;
+    s_dirty.count = 0;
+    s_pending.count = 0;
+    s_dirty_changed = false;
+    s_valid = false;
+    s_writing = false;
+    memset(&s_header, 0, sizeof(s_header));
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+uint32_t card_snapshot_slot_count(void) {
+    return s_valid ? s_header.slot_count : 0;
+}
+
+static size_t snap_hot_size(const card_hot_t *card) {
+    uint8_t varint[VARINT_MAX_BYTES];
+    return 1 + card->uid_len + 1 + 4 + varint_encode(card->access_count, varint);
+}
+
+esp_err_t card_snapshot_load(card_hot_t *cards, char (*name_keys)[CARD_QUERY_NAME_KEY_LEN], uint32_t slot_count) {
+    if (!s_valid) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint8_t *buf = malloc(sizeof(snap_chunk_header_t) + CARD_SNAPSHOT_CHUNK_SIZE);
+    if (!buf) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t ret = ESP_OK;
+    uint32_t next_slot = 0;
+    for (uint32_t index = 0; index < s_header.chunk_count && ret == ESP_OK; index++) {
+        char key[16];
+        snap_chunk_key(index, key, sizeof(key));
+        size_t len = sizeof(snap_chunk_header_t) + CARD_SNAPSHOT_CHUNK_SIZE;
+        ret = storage_get(s_store, key, buf, &len);
+        if (ret != ESP_OK) {
+            break;
+        }
+        snap_chunk_header_t hdr;
+        if (len < sizeof(hdr)) {
+            ret = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+        const uint8_t *payload = &buf[sizeof(hdr)];
+        size_t payload_len = len - sizeof(hdr);
+        memcpy(&hdr, buf, sizeof(hdr));
+        if (hdr.magic != SNAP_CHUNK_MAGIC || hdr.index != index ||
+            hdr.generation != s_header.generation || hdr.first_slot != next_slot ||
+            hdr.crc != snap_chunk_crc(&hdr, payload, payload_len)) {
+            ret = ESP_ERR_INVALID_CRC;
+            break;
+        }
+
+        size_t pos = 0;
+        for (uint32_t i = 0; i < hdr.slot_count; i++, next_slot++) {
+            if (pos >= payload_len) {
+                ret = ESP_ERR_INVALID_SIZE;
+                break;
+            }
+            card_hot_t card;
+            char name_key[CARD_QUERY_NAME_KEY_LEN];
+            memset(name_key, 0, sizeof(name_key));
+            if (payload[pos] == 0) {
+                memset(&card, 0, sizeof(card));
+                pos++;
+            } else {
+                ret = card_hot_decode(&payload[pos], payload_len - pos, &card);
+                if (ret != ESP_OK) {
+                    break;
+                }
+                pos += snap_hot_size(&card);
+                if (pos + CARD_QUERY_NAME_KEY_LEN > payload_len) {
+                    ret = ESP_ERR_INVALID_SIZE;
+                    break;
+                }
+                memcpy(name_key, &payload[pos], CARD_QUERY_NAME_KEY_LEN);
+                pos += CARD_QUERY_NAME_KEY_LEN;
+            }
+            if (next_slot < slot_count) {
+                cards[next_slot] = card;
+                memcpy(name_keys[next_slot], name_key, CARD_QUERY_NAME_KEY_LEN);
+            }
+        }
+    }
+    free(buf);
+    if (ret == ESP_OK && next_slot != s_header.slot_count) {
+        ret = ESP_ERR_INVALID_SIZE;
+    }
+    return ret;
+}
+
+uint32_t card_snapshot_dirty(const uint16_t **slots) {
+    *slots = s_dirty.slots;
+    return s_valid ? s_dirty.count : 0;
+}
+
+void card_snapshot_invalidate(void) {
+    s_valid = false;
+    s_dirty.count = 0;
+    s_dirty_changed = true;
+    card_snapshot_save(); // o boot seguinte não tenta a mesma fotografia
+}
+
+void card_snapshot_mark(uint16_t slot) {
+    bool added;
+    if (s_writing && (slot < s_next_slot || slot >= s_next.slot_count)) {
+        if (!snap_list_add(&s_pending, slot, &added)) {
+            s_writing = false; // lista da geração nova estourou: recomeçar depois
+        }
+    }
+    if (!s_valid) {
+        return;
+    }
+    if (!snap_list_add(&s_dirty, slot, &added)) {
+        s_valid = false;
+        s_dirty_changed = true;
+    } else if (added) {
+        s_dirty_changed = true;
+    }
+}
+
+esp_err_t card_snapshot_save(void) {
+    if (!s_dirty_changed || !s_store) {
+        return ESP_OK;
+    }
+    snap_slot_list_t none = { .slots = NULL, .count = 0 };
+    esp_err_t ret = s_valid ? snap_write_dirty(s_header.generation, 0, &s_dirty)
+                            : snap_write_dirty(s_header.generation, SNAP_DIRTY_OVERFLOW, &none);
+    if (ret == ESP_OK) {
+        s_dirty_changed = false;
+    }
+    return ret;
+}
+
+bool card_snapshot_due(uint32_t slot_count, uint32_t max_dirty) {
+    if (!s_store || slot_count == 0) {
+        return false;
+    }
+    return s_writing || !s_valid || s_dirty.count > max_dirty;
+}
+
+// Pedaço com os slots a partir de s_next_slot
+static esp_err_t snap_write_chunk(const card_hot_t *cards, const char (*name_keys)[CARD_QUERY_NAME_KEY_LEN]) {
+    uint8_t *payload = &s_chunk[sizeof(snap_chunk_header_t)];
+    size_t pos = 0;
+    uint32_t slot = s_next_slot;
+    while (slot < s_next.slot_count && pos + SNAP_RECORD_MAX <= CARD_SNAPSHOT_CHUNK_SIZE) {
+        const card_hot_t *card = &cards[slot];
+        if (card->uid_len == 0) {
+            payload[pos++] = 0;
+        } else {
+            pos += card_hot_encode(card, &payload[pos]);
+            memcpy(&payload[pos], name_keys[slot], CARD_QUERY_NAME_KEY_LEN);
+            pos += CARD_QUERY_NAME_KEY_LEN;
+        }
+        slot++;
+    }
+    snap_chunk_header_t hdr = {
+        .magic = SNAP_CHUNK_MAGIC,
+        .index = (uint16_t)s_next.chunk_count,
+        .generation = s_next.generation,
+        .first_slot = (uint16_t)s_next_slot,
+        .slot_count = (uint16_t)(slot - s_next_slot),
+    };
+    hdr.crc = snap_chunk_crc(&hdr, payload, pos);
+    memcpy(s_chunk, &hdr, sizeof(hdr));
+
+    char key[16];
+    snap_chunk_key(hdr.index, key, sizeof(key));
+    esp_err_t ret = storage_set(s_store, key, s_chunk, sizeof(hdr) + pos);
+    if (ret == ESP_OK) {
+        s_next.chunk_count++;
+        s_next_slot = slot;
+    }
+    return ret;
+}
+
+// Cabeçalho e lista vazia da geração nova; pedaços antigos a mais são apagados
+static esp_err_t snap_finish(void) {
+    s_next.magic = SNAP_MAGIC;
+    s_next.version = SNAP_VERSION;
+    s_next.name_key_len = CARD_QUERY_NAME_KEY_LEN;
+    s_next.crc = snap_header_crc(&s_next);
+    esp_err_t ret = storage_set(s_store, SNAP_HEADER_KEY, &s_next, sizeof(s_next));
+    if (ret == ESP_OK) {
+        ret = snap_write_dirty(s_next.generation, 0, &s_pending);
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    for (uint32_t index = s_next.chunk_count; index < s_header.chunk_count; index++) {
+        char key[16];
+        snap_chunk_key(index, key, sizeof(key));
+        storage_erase(s_store, key);
+    }
+    ret = storage_commit(s_store);
+
+    s_header = s_next;
+    snap_slot_list_t swap = s_dirty;
+    s_dirty = s_pending;
+    s_pending = swap;
+    s_pending.count = 0;
+    s_dirty_changed = false;
+    s_valid = true;
+    s_writing = false;
+    free(s_chunk);
+    s_chunk = NULL;
+
+    s_stats.writes++;
+    s_stats.last_write_ms = (uint32_t)((esp_timer_get_time() - s_write_start_us) / 1000);
+    printf("Fotografia dos índices gravada: geração %" PRIu32 ", %" PRIu32 " slots em %" PRIu32 " pedaços (%" PRIu32 " ms)\n",
+           s_header.generation, s_header.slot_count, s_header.chunk_count, s_stats.last_write_ms);
+    return ret;
+}
+
+esp_err_t card_snapshot_step(const card_hot_t *cards, const char (*name_keys)[CARD_QUERY_NAME_KEY_LEN],
+                             uint32_t slot_count, bool *done) {
+    *done = false;
+    if (!s_store) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!s_writing) {
+        s_chunk = s_chunk ? s_chunk : malloc(sizeof(snap_chunk_header_t) + CARD_SNAPSHOT_CHUNK_SIZE);
+        if (!s_chunk) {
+            return ESP_ERR_NO_MEM;
+        }
+        // Os pedaços antigos vão ser sobrescritos: a geração atual deixa de
+        // valer no flash antes disso e a lista dela não é mais mantida
+        s_valid = false;
+        s_dirty_changed = true;
+        esp_err_t save_ret = card_snapshot_save();
+        if (save_ret != ESP_OK) {
+            return save_ret;
+        }
+        memset(&s_next, 0, sizeof(s_next));
+        s_next.generation = s_header.generation + 1;
+        s_next.slot_count = slot_count;
+        s_next_slot = 0;
+        s_pending.count = 0;
+        s_writing = true;
+        s_write_start_us = esp_timer_get_time();
+    }
+    esp_err_t ret = ESP_OK;
+    if (s_next_slot < s_next.slot_count) {
+        ret = snap_write_chunk(cards, name_keys);
+    }
+    if (ret == ESP_OK && s_next_slot >= s_next.slot_count) {
+        ret = snap_finish();
+        *done = ret == ESP_OK;
+    }
+    if (ret != ESP_OK) {
+        printf("Erro ao gravar fotografia dos índices: %s\n", esp_err_to_name(ret));
+        s_writing = false;
+    }
+    return ret;
+}
+
+void card_snapshot_get_stats(card_snapshot_stats_t *stats) {
+    *stats = s_stats;
+    stats->generation = s_valid ? s_header.generation : 0;
+    stats->slot_count = s_header.slot_count;
+    stats->chunk_count = s_header.chunk_count;
+    stats->dirty_count = s_valid ? s_dirty.count : 0;
+    stats->writing = s_writing;
+}
@@ -0,0 +1,55 @@
+#ifndef CARD_SNAPSHOT_H
+#define CARD_SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "card_record.h"
+#include "card_query.h"
+#include "storage_backend.h"
+
+// Fotografia da tabela quente e das chaves de nome (card_query) gravada no
+// backend em pedaços ("snap_<n>"), com versão, geração e CRC por pedaço.
+// Junto dela fica a lista dos slots gravados depois ("snap_d"), atualizada
+// antes de cada gravação de cartão: no boot a tabela vem da fotografia e só
+// os slots da lista são relidos. Geração ou CRC divergentes fazem o banco
+// voltar à leitura completa.
+#define CARD_SNAPSHOT_CHUNK_SIZE   4000    // bytes por pedaço (um blob NVS)
+#define CARD_SNAPSHOT_MAX_DIRTY    1024    // acima disso a fotografia é invalidada
+
+typedef struct {
+    uint32_t generation;        // 0 = nenhuma fotografia válida
+    uint32_t slot_count;        // slots cobertos pela fotografia
+    uint32_t chunk_count;
+    uint32_t dirty_count;       // slots alterados desde a fotografia
+    uint32_t writes;            // fotografias gravadas desde o open
+    uint32_t last_write_ms;
+    bool writing;
+} card_snapshot_stats_t;
+
+// Lê cabeçalho e lista de alterados; ESP_ERR_NOT_FOUND/ESP_ERR_INVALID_CRC
+// se não houver fotografia utilizável (o estado fica pronto para gravar uma)
+esp_err_t card_snapshot_open(const storage_backend_t *store);
+void card_snapshot_close(void);
+uint32_t card_snapshot_slot_count(void);
+// Preenche cards[0..slot_count) e name_keys a partir dos pedaços
+esp_err_t card_snapshot_load(card_hot_t *cards, char (*name_keys)[CARD_QUERY_NAME_KEY_LEN], uint32_t slot_count);
+// Slots gravados depois da fotografia (ordenados)
+uint32_t card_snapshot_dirty(const uint16_t **slots);
+// Descarta a fotografia carregada (falha na carga)
+void card_snapshot_invalidate(void);
+
+// Antes de gravar o registro de um slot: mark registra em RAM, save grava a
+// lista se ela mudou (dentro do grupo do journal, no mesmo registro)
+void card_snapshot_mark(uint16_t slot);
+esp_err_t card_snapshot_save(void);
+
+// true se há fotografia a gravar/continuar para 'slot_count' slots
+bool card_snapshot_due(uint32_t slot_count, uint32_t max_dirty);
+// Grava o próximo pedaço; *done quando a fotografia nova passa a valer
+esp_err_t card_snapshot_step(const card_hot_t *cards, const char (*name_keys)[CARD_QUERY_NAME_KEY_LEN],
+                             uint32_t slot_count, bool *done);
+
+void card_snapshot_get_stats(card_snapshot_stats_t *stats);
+
+#endif // CARD_SNAPSHOT_H
@@ -0,0 +1,280 @@
+#include "card_view.h"
+#include "card_index.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Verificações do contador antes de ceder a CPU por um tick: a seção do
+// leitor dura duas leituras do balde, então quase sempre basta girar
+#define CARD_VIEW_SPIN_CHECKS   1000
+
+static inline uint32_t card_view_bucket_of(const uint8_t *uid, uint8_t uid_len) {
+    return card_index_hash(uid, uid_len) >> 24;
+}
+
+// Vira a época e espera os leitores da anterior saírem; depois disso
+// nenhum leitor enxerga ponteiros trocados antes da chamada
+static void card_view_synchronize(card_view_t *view) {
+    unsigned epoch = atomic_load(&view->epoch);
+    atomic_store(&view->epoch, epoch + 1);
+    atomic_uint *readers = &view->readers[epoch & 1];
+    if (atomic_load(readers) == 0) {
+        return;
+    }
+
+    int64_t start = esp_timer_get_time();
+    uint32_t checks = 0;
+    while (atomic_load(readers) != 0) {
+        if (++checks >= CARD_VIEW_SPIN_CHECKS) {
+            vTaskDelay(1); // leitor preemptado: deixar ele terminar
+            checks = 0;
+        }
+    }
+    uint32_t waited = (uint32_t)(esp_timer_get_time() - start);
+    view->grace_waits++;
+    if (waited > view->grace_max_us) {
+        view->grace_max_us = waited;
+    }
+}
+
+// Troca o balde publicado e libera o antigo após o período de graça
+static void card_view_publish(card_view_t *view, uint32_t index, card_allowlist_t *bucket) {
+    card_allowlist_t *old = atomic_exchange(&view->buckets[index], bucket);
+    view->publishes++;
+    if (old) {
+        card_view_synchronize(view);
+        view->memory_bytes -= card_allowlist_memory(old);
+        view->entries -= old->count;
+        card_allowlist_free(old);
+    }
+    if (bucket) {
+        view->memory_bytes += card_allowlist_memory(bucket);
+        view->entries += bucket->count;
+    }
+}
+
+// Copia para 'items' as entradas do balde, menos a do UID; retorna quantas
+static uint32_t card_view_collect(const card_allowlist_t *bucket, const uint8_t *uid, uint8_t uid_len,
+                                  card_allowlist_entry_t *items) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; bucket && i < bucket->slots; i++) {
+        const card_allowlist_entry_t *entry = &bucket->entries[i];
+        if (entry->uid_len == 0 || (entry->uid_len == uid_len && memcmp(entry->uid, uid, uid_len) == 0)) {
+            continue;
+        }
+        items[count++] = *entry;
+    }
+    return count;
+}
+
+void card_view_init(card_view_t *view) {
+    memset(view, 0, sizeof(*view));
+}
+
+// Leitores atrasados ainda podem estar num balde: esvaziar, esperar, liberar
+void card_view_free(card_view_t *view) {
+    card_allowlist_t *old[CARD_VIEW_BUCKETS];
+    for (uint32_t i = 0; i < CARD_VIEW_BUCKETS; i++) {
+        old[i] = atomic_exchange(&view->buckets[i], NULL);
+    }
+    card_view_synchronize(view);
+    for (uint32_t i = 0; i < CARD_VIEW_BUCKETS; i++) {
+        card_allowlist_free(old[i]);
+    }
+    view->entries = 0;
+    view->memory_bytes = 0;
+}
+
+esp_err_t card_view_put(card_view_t *view, const uint8_t *uid, uint8_t uid_len, uint8_t access_level) {
+    if (uid_len == 0 || uid_len > CARD_UID_MAX_BYTES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t index = card_view_bucket_of(uid, uid_len);
+    const card_allowlist_t *old = atomic_load(&view->buckets[index]);
+    uint8_t level;
+    if (old && card_allowlist_find(old, uid, uid_len, &level) && level == access_level) {
+        return ESP_OK;
+    }
+
+    card_allowlist_t *bucket = NULL;
+    card_allowlist_entry_t *items = malloc(((old ? old->count : 0) + 1) * sizeof(card_allowlist_entry_t));
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    if (items) {
+        uint32_t count = card_view_collect(old, uid, uid_len, items);
+        card_allowlist_entry_t *entry = &items[count++];
+        memset(entry, 0, sizeof(*entry));
+        memcpy(entry->uid, uid, uid_len);
+        entry->uid_len = uid_len;
+        entry->access_level = access_level;
+        ret = card_allowlist_build(items, count, &bucket);
+        free(items);
+    }
+    if (ret != ESP_OK) {
+        atomic_store(&view->stale, true);
+        return ret;
+    }
+    card_view_publish(view, index, bucket);
+    return ESP_OK;
+}
+
+void card_view_remove(card_view_t *view, const uint8_t *uid, uint8_t uid_len) {
+    uint32_t index = card_view_bucket_of(uid, uid_len);
+    const card_allowlist_t *old = atomic_load(&view->buckets[index]);
+    if (!old || !card_allowlist_find(old, uid, uid_len, NULL)) {
+        return;
+    }
+
+    card_allowlist_t *bucket = NULL;
+    if (old->count > 1) {
+        card_allowlist_entry_t *items = malloc((old->count - 1) * sizeof(card_allowlist_entry_t));
+        esp_err_t ret = ESP_ERR_NO_MEM;
+        if (items) {
+            ret = card_allowlist_build(items, card_view_collect(old, uid, uid_len, items), &bucket);
+            free(items);
+        }
+        if (ret != ESP_OK) {
+            atomic_store(&view->stale, true); // o cartão continuaria visível
+            return;
+        }
+    }
+    card_view_publish(view, index, bucket);
+}
+
+esp_err_t card_view_rebuild(card_view_t *view, const card_hot_t *cards, uint32_t slot_count) {
+    int64_t start = esp_timer_get_time();
+    // Slots ordenados por balde (contagem), depois um balde montado por vez
+    // a partir de um vetor do tamanho do maior
+    uint32_t *first = calloc(CARD_VIEW_BUCKETS + 1, sizeof(uint32_t));
+    uint32_t *order = malloc((slot_count ? slot_count : 1) * sizeof(uint32_t));
+    card_allowlist_t **fresh = calloc(CARD_VIEW_BUCKETS, sizeof(card_allowlist_t *));
+    card_allowlist_entry_t *items = NULL;
+    esp_err_t ret = (first && order && fresh) ? ESP_OK : ESP_ERR_NO_MEM;
+
+    if (ret == ESP_OK) {
+        for (uint32_t i = 0; i < slot_count; i++) {
+            if (cards[i].uid_len != 0) {
+                first[card_view_bucket_of(cards[i].uid, cards[i].uid_len) + 1]++;
+            }
+        }
+        uint32_t largest = 0;
+        for (uint32_t b = 0; b < CARD_VIEW_BUCKETS; b++) {
+            if (first[b + 1] > largest) {
+                largest = first[b + 1];
+            }
+            first[b + 1] += first[b];
+        }
+        for (uint32_t i = 0; i < slot_count; i++) {
+            if (cards[i].uid_len != 0) {
+                order[first[card_view_bucket_of(cards[i].uid, cards[i].uid_len)]++] = i;
+            }
+        }
+        // Os inícios andaram até o fim de cada balde: voltar um balde
+        memmove(&first[1], first, CARD_VIEW_BUCKETS * sizeof(uint32_t));
+        first[0] = 0;
+        items = malloc((largest ? largest : 1) * sizeof(card_allowlist_entry_t));
+        ret = items ? ESP_OK : ESP_ERR_NO_MEM;
+    }
+    for (uint32_t b = 0; b < CARD_VIEW_BUCKETS && ret == ESP_OK; b++) {
+        uint32_t count = first[b + 1] - first[b];
+        if (count == 0) {
+            continue;
+        }
+        for (uint32_t k = 0; k < count; k++) {
+            const card_hot_t *card = &cards[order[first[b] + k]];
+            card_allowlist_entry_t *entry = &items[k];
+            memset(entry, 0, sizeof(*entry));
+            memcpy(entry->uid, card->uid, card->uid_len);
+            entry->uid_len = card->uid_len;
+            entry->access_level = card->access_level;
+        }
+        ret = card_allowlist_build(items, count, &fresh[b]);
+    }
+    free(items);
+    free(order);
+    free(first);
+    if (ret != ESP_OK) {
+        for (uint32_t b = 0; fresh && b < CARD_VIEW_BUCKETS; b++) {
+            card_allowlist_free(fresh[b]);
+        }
+        free(fresh);
+        atomic_store(&view->stale, true);
+        return ret;
+    }
+
+    // Todos os baldes trocados com um período de graça só; 'fresh' passa a
+    // guardar os antigos
+    view->entries = 0;
+    view->memory_bytes = 0;
+    for (uint32_t b = 0; b < CARD_VIEW_BUCKETS; b++) {
+        if (fresh[b]) {
+            view->entries += fresh[b]->count;
+            view->memory_bytes += card_allowlist_memory(fresh[b]);
+        }
+        fresh[b] = atomic_exchange(&view->buckets[b], fresh[b]);
+    }
+    view->publishes++;
+    atomic_store(&view->stale, false);
+    card_view_synchronize(view);
+    for (uint32_t b = 0; b < CARD_VIEW_BUCKETS; b++) {
+        card_allowlist_free(fresh[b]);
+    }
+    free(fresh);
+    view->rebuilds++;
+    view->rebuild_us = (uint32_t)(esp_timer_get_time() - start);
+    return ESP_OK;
+}
+
+esp_err_t card_view_lookup(card_view_t *view, const uint8_t *uid, uint8_t uid_len, uint8_t *access_level) {
+    if (atomic_load(&view->stale)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int64_t start = esp_timer_get_time();
+
+    // Entrada: contar-se na época atual e confirmar que ela não virou
+    unsigned epoch;
+    while (1) {
+        epoch = atomic_load(&view->epoch);
+        atomic_fetch_add(&view->readers[epoch & 1], 1);
+        if (atomic_load(&view->epoch) == epoch) {
+            break;
+        }
+        atomic_fetch_sub(&view->readers[epoch & 1], 1);
+        atomic_fetch_add_explicit(&view->read_retries, 1, memory_order_relaxed);
+    }
+
+    const card_allowlist_t *bucket = atomic_load(&view->buckets[card_view_bucket_of(uid, uid_len)]);
+    bool found = bucket && card_allowlist_find(bucket, uid, uid_len, access_level);
+
+    atomic_fetch_sub(&view->readers[epoch & 1], 1);
+
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+    atomic_fetch_add_explicit(&view->reads, 1, memory_order_relaxed);
+    if (found) {
+        atomic_fetch_add_explicit(&view->hits, 1, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&view->read_total_us, elapsed, memory_order_relaxed);
+    unsigned max = atomic_load_explicit(&view->read_max_us, memory_order_relaxed);
+    while (elapsed > max &&
+           !atomic_compare_exchange_weak_explicit(&view->read_max_us, &max, elapsed,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+    return found ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+void card_view_get_stats(card_view_t *view, card_view_stats_t *stats) {
+    stats->reads = atomic_load(&view->reads);
+    stats->hits = atomic_load(&view->hits);
+    stats->read_retries = atomic_load(&view->read_retries);
+    stats->read_max_us = atomic_load(&view->read_max_us);
+    stats->read_total_us = atomic_load(&view->read_total_us);
+    stats->publishes = view->publishes;
+    stats->grace_waits = view->grace_waits;
+    stats->grace_max_us = view->grace_max_us;
+    stats->entries = view->entries;
+    stats->memory_bytes = view->memory_bytes;
+    stats->stale = atomic_load(&view->stale);
+    stats->rebuilds = view->rebuilds;
+    stats->rebuild_us = view->rebuild_us;
+}
@@ -0,0 +1,78 @@
+#ifndef CARD_VIEW_H
+#define CARD_VIEW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "esp_err.h"
+#include "card_record.h"
+#include "card_allowlist.h"
+
+// Visão somente leitura UID -> nível de acesso para o caminho do toque,
+// publicada no estilo RCU: 256 baldes (byte alto de card_index_hash), cada
+// um uma lista compilada imutável (hash perfeito, card_allowlist.h). O
+// escritor (serializado pelo lock do banco) monta de novo o balde alterado,
+// troca o ponteiro e só libera a versão antiga quando os leitores que podiam
+// vê-la saíram (período de graça com dois contadores de época). Leitores não
+// pegam lock nem esperam escritores: no máximo repetem a entrada se a época
+// virou no meio. É a única cópia dos UIDs fora da tabela quente: ~15 bytes
+// por cartão, e uma mudança copia só o seu balde.
+#define CARD_VIEW_BUCKETS   256
+
+typedef struct {
+    uint32_t reads;
+    uint32_t hits;
+    uint32_t read_retries;      // época virou entre a entrada e a confirmação
+    uint32_t read_max_us;
+    uint64_t read_total_us;
+    uint32_t publishes;         // trocas de ponteiro (baldes ou reconstrução)
+    uint32_t grace_waits;       // publicações que esperaram leitores
+    uint32_t grace_max_us;
+    uint32_t entries;
+    uint32_t memory_bytes;
+    bool stale;
+    uint32_t rebuilds;
+    uint32_t rebuild_us;        // última reconstrução
+} card_view_stats_t;
+
+typedef struct {
+    card_allowlist_t *_Atomic buckets[CARD_VIEW_BUCKETS];
+    atomic_uint epoch;
+    atomic_uint readers[2];     // leitores dentro da seção, por paridade da época
+    atomic_bool stale;          // cópia falhou (sem memória): até reconstruir, usar o lock
+    // Contadores dos leitores (atualizados sem lock)
+    atomic_uint reads;
+    atomic_uint hits;
+    atomic_uint read_retries;
+    atomic_uint read_max_us;
+    _Atomic uint64_t read_total_us;
+    // Do escritor (protegidos pelo lock do banco)
+    uint32_t publishes;
+    uint32_t grace_waits;
+    uint32_t grace_max_us;
+    uint32_t entries;
+    uint32_t memory_bytes;
+    uint32_t rebuilds;
+    uint32_t rebuild_us;
+} card_view_t;
+
+void card_view_init(card_view_t *view);
+void card_view_free(card_view_t *view);
+
+// Escritor: insere ou troca o nível; remove; reconstrói a partir da tabela
+// quente (carga e fim de importação) com um único período de graça. Se a
+// montagem de um balde falha a visão fica 'stale' até a próxima reconstrução.
+esp_err_t card_view_put(card_view_t *view, const uint8_t *uid, uint8_t uid_len, uint8_t access_level);
+void card_view_remove(card_view_t *view, const uint8_t *uid, uint8_t uid_len);
+esp_err_t card_view_rebuild(card_view_t *view, const card_hot_t *cards, uint32_t slot_count);
+
+// Leitor: sem lock, pode rodar junto com o escritor. ESP_ERR_NOT_FOUND se o
+// UID não está cadastrado, ESP_ERR_INVALID_STATE se a visão está 'stale'.
+esp_err_t card_view_lookup(card_view_t *view, const uint8_t *uid, uint8_t uid_len, uint8_t *access_level);
+static inline bool card_view_stale(card_view_t *view) {
+    return atomic_load(&view->stale);
+}
+
+void card_view_get_stats(card_view_t *view, card_view_stats_t *stats);
+
+#endif // CARD_VIEW_H
@@ -5,12 +5,80 @@
 #include <time.h>
 #include <stdbool.h>
 #include "esp_err.h"
+#include "card_record.h"
+#include "card_filter.h"
+#include "card_query.h"
+#include "access_stats.h"
+#include "storage_backend.h"
+#include "card_snapshot.h"
+#include "card_view.h"
 
 // Definições de tamanhos
 #define MAX_UID_LENGTH 32
 #define MAX_NAME_LENGTH 64
 #define MAX_ACTION_LENGTH 16
 
+// Cache write-back dos contadores de acesso
+#ifndef DATABASE_FLUSH_INTERVAL_MS
+#define DATABASE_FLUSH_INTERVAL_MS      30000   // flush periódico
+#endif
+#ifndef DATABASE_FLUSH_DIRTY_THRESHOLD
+#define DATABASE_FLUSH_DIRTY_THRESHOLD  32      // flush antecipado com N cartões sujos
+#endif
+#ifndef DATABASE_TXN_MAX_OPS
+#define DATABASE_TXN_MAX_OPS            8       // mutações de cartão por transação
+#endif
+#ifndef DATABASE_TXN_MAX_LOGS
+#define DATABASE_TXN_MAX_LOGS           8       // logs pendentes por transação
+#endif
+#ifndef DATABASE_COMPACT_BATCH
+#define DATABASE_COMPACT_BATCH          8       // cartões movidos por ciclo de flush
+#endif
+
+// Armazenamento dos cartões: 0 = chaves NVS (c_/n_), 1 = tabela mapeada
+// na partição "cardtab" (card_mmap.h), leitura sem cópia
+#ifndef DATABASE_STORAGE_MMAP
+#define DATABASE_STORAGE_MMAP           0
+#endif
+
+// Backend chave/valor do banco (storage_backend.h): 0 = NVS, 1 = partição
+// crua "rfidkv", 2 = RAM/arquivo em DATABASE_STORAGE_FILE_PATH (NULL = só RAM)
+#ifndef DATABASE_STORAGE_BACKEND
+#define DATABASE_STORAGE_BACKEND        0
+#endif
+#ifndef DATABASE_STORAGE_FILE_PATH
+#define DATABASE_STORAGE_FILE_PATH      NULL
+#endif
+
+// Com o backend NVS: cartões distribuídos por slot entre partições NVS
+// próprias "rfid0".."rfid<N-1>" (storage_shard.c, ver partitions.csv).
+// Cada cartão ocupa ~6 entradas NVS (c_ + n_) e cada página de 4KB tem
+// 126, então a partição "nvs" padrão comporta só ~100 cartões. O padrão é
+// um shard só, a partição "rfid0" de 704KB do layout de 2MB (~2.700
+// cartões com nomes de 63 caracteres, ~3.600 com nomes curtos); 0 = chaves
+// na partição "nvs". O banco na partição "nvs" é migrado na primeira abertura.
+#ifndef DATABASE_STORAGE_SHARDS
+#define DATABASE_STORAGE_SHARDS         1
+#endif
+#define DATABASE_STORAGE_SHARD_LABEL    "rfid%u"
+
+// Journal de escrita antecipada sobre o backend (storage_journal.c):
+// cadastro, remoção, compactação e transações gravam um registro com CRC
+// antes de tocar nas chaves, e o boot só refaz o fim do journal
+#ifndef DATABASE_JOURNAL
+#define DATABASE_JOURNAL                1
+#endif
+
+// Fotografia da tabela quente e das chaves de nome (card_snapshot.c): o boot
+// lê a fotografia e só os slots alterados depois dela. A task de flush grava
+// uma nova quando os alterados passam de slots/DIV (mínimo MIN_DIRTY).
+// Sem efeito com DATABASE_STORAGE_MMAP, que já não lê a tabela no boot.
+#ifndef DATABASE_SNAPSHOT
+#define DATABASE_SNAPSHOT               1
+#endif
+#define DATABASE_SNAPSHOT_MIN_DIRTY     64
+#define DATABASE_SNAPSHOT_DIRTY_DIV     16
+
 // Níveis de acesso
 #define ACCESS_LEVEL_USER     1
 #define ACCESS_LEVEL_ADMIN    2
@@ -33,22 +101,193 @@ typedef struct {
     char action[MAX_ACTION_LENGTH];
 } access_log_t;
 
+typedef struct {
+    uint32_t flush_count;
+    uint32_t flush_errors;
+    uint32_t records_written;
+    uint32_t bytes_written;
+    uint32_t last_flush_us;
+    uint32_t max_flush_us;
+    uint64_t total_flush_us;
+    uint32_t dirty_records;     // pendentes no momento da consulta
+    uint32_t free_slots;        // buracos aguardando compactação/reuso
+    uint32_t compacted_slots;   // cartões movidos pela compactação
+} database_cache_stats_t;
+
+// Lock do banco (escritores e consultas completas) e visão sem lock do
+// caminho do toque (card_view)
+typedef struct {
+    uint32_t lock_acquires;
+    uint32_t lock_contended;    // tiveram que esperar outra task
+    uint32_t lock_wait_max_us;
+    uint64_t lock_wait_total_us;
+    uint32_t view_fallbacks;    // consultas de acesso que usaram o lock
+    card_view_stats_t view;
+} database_concurrency_stats_t;
+
+// Estatísticas de /api/stats, mantidas a cada evento (ver access_stats.h)
+#ifndef DATABASE_STATS_HOURS
+#define DATABASE_STATS_HOURS            24      // últimas horas retornadas
+#endif
+#ifndef DATABASE_STATS_DAYS
+#define DATABASE_STATS_DAYS             7       // últimos dias retornados
+#endif
+
+typedef struct {
+    uint32_t total_cards;
+    uint32_t cards_by_level[CARD_QUERY_LEVELS]; // níveis acima de 3 contam no 0
+    uint32_t card_accesses;     // soma de access_count dos cartões cadastrados
+    uint32_t log_records;       // gravados no log desde a formatação
+    access_stats_totals_t events;
+    access_stats_bucket_t hours[DATABASE_STATS_HOURS];  // mais recente primeiro
+    access_stats_bucket_t days[DATABASE_STATS_DAYS];
+} database_access_stats_t;
+
+// Visão de um cartão durante database_foreach_card; os ponteiros só valem
+// dentro do callback
+typedef struct {
+    const card_hot_t *hot;
+    const char *name;
+    uint32_t first_seen;
+} database_card_view_t;
+
+// Retorna false para interromper a iteração
+typedef bool (*database_card_cb_t)(const database_card_view_t *card, void *ctx);
+
+// Predicados opcionais dos iteradores: true mantém o item
+typedef bool (*database_card_filter_t)(const rfid_record_t *record, void *ctx);
+typedef bool (*database_log_filter_t)(const access_log_t *entry, void *ctx);
+
+// Iteradores com memória constante. O cursor (database_*_iter_cursor) é
+// opaco e permite retomar a leitura em outra requisição; cursor 0 começa
+// do início.
+typedef struct {
+    uint32_t slot;              // próximo slot a examinar
+    uint32_t generation;        // layout da tabela quando o cursor foi criado
+    database_card_filter_t filter;
+    void *filter_ctx;
+} database_cards_iter_t;
+
+// Consulta de logs resolvida pelos resumos dos blocos (access_log.h)
+typedef struct {
+    uint32_t from;              // timestamps inclusivos; 0 = sem limite
+    uint32_t to;
+    uint8_t uid[CARD_UID_MAX_BYTES];
+    uint8_t uid_len;            // 0 = todos os cartões
+} database_log_query_t;
+
+typedef struct {
+    uint32_t next_seq;          // do mais recente para o mais antigo
+    uint32_t oldest_seq;
+    database_log_filter_t filter;
+    void *filter_ctx;
+    bool has_query;
+    database_log_query_t query;
+} database_logs_iter_t;
+
 // Funções do banco de dados
 esp_err_t database_init(void);
-esp_err_t database_close(void);
+// Mesmo que database_init, com outro backend (testes e benchmarks no host)
+esp_err_t database_init_with_backend(const storage_backend_t *backend);
+esp_err_t database_close(void);   // faz flush do cache antes de fechar
+esp_err_t database_flush(void);
+void database_set_flush_interval(uint32_t interval_ms);
+esp_err_t database_get_cache_stats(database_cache_stats_t *stats);
+esp_err_t database_get_concurrency_stats(database_concurrency_stats_t *stats);
+esp_err_t database_get_filter_stats(card_filter_stats_t *stats);
+esp_err_t database_get_journal_stats(storage_journal_stats_t *stats, uint32_t *ready_ms);
+esp_err_t database_get_snapshot_stats(card_snapshot_stats_t *stats);
+// Preenche até 'max' shards; *count = 0 sem shards
+esp_err_t database_get_shard_stats(storage_shard_stats_t *stats, uint32_t max, uint32_t *count);
 
 // Operações com cartões RFID
 esp_err_t database_add_card(const char *uid, const char *name, uint8_t access_level);
 esp_err_t database_update_card_access(const char *uid);
 esp_err_t database_get_card(const char *uid, rfid_record_t *record);
+esp_err_t database_lookup_card(const char *uid, card_hot_t *card); // somente RAM
+// Caminho do toque: só o nível, sem lock (não espera cadastros nem flush)
+esp_err_t database_lookup_access(const char *uid, uint8_t *access_level);
 esp_err_t database_delete_card(const char *uid);
-esp_err_t database_get_all_cards(rfid_record_t **records, int *count);
+esp_err_t database_get_all_cards(rfid_record_t **records, int *count); // aloca todos; ver iteradores
+esp_err_t database_foreach_card(database_card_cb_t cb, void *ctx); // sem alocação
+
+// Consulta pelos índices secundários em RAM (sem varrer o armazenamento).
+// Critérios zerados/NULL são ignorados; a ordem segue o índice usado: nome,
+// last_seen (mais antigo primeiro em seen_before, mais recente primeiro em
+// seen_after) ou slot.
+typedef struct {
+    const char *name_prefix;    // sem diferenciar maiúsculas (ASCII)
+    uint8_t access_level;
+    uint32_t seen_before;       // last_seen < valor
+    uint32_t seen_after;        // last_seen >= valor
+} database_card_query_t;
+
+// Preenche até 'max' registros a partir de *cursor (0 = início) e grava em
+// *cursor a posição no índice para continuar (0 no fim), sem reprocessar o
+// que já foi entregue. ESP_ERR_INVALID_STATE: cadastro/remoção (busca por
+// nome) ou compactação (nível/todos) invalidou o cursor, recomeçar do 0;
+// nas listas por last_seen um cartão tocado não invalida o cursor.
+esp_err_t database_query_cards(const database_card_query_t *query, uint64_t *cursor,
+                               rfid_record_t *records, uint32_t max, uint32_t *count);
+
+// ESP_ERR_INVALID_STATE: cursor invalidado pela compactação, recomeçar do 0
+// Varreduras longas (exportação) seguram a compactação para o cursor não
+// ser invalidado no meio; um resume para cada pause
+void database_compact_pause(void);
+void database_compact_resume(void);
+esp_err_t database_cards_iter_begin(database_cards_iter_t *iter, uint32_t cursor,
+                                    database_card_filter_t filter, void *ctx);
+esp_err_t database_cards_iter_next(database_cards_iter_t *iter, rfid_record_t *record); // ESP_ERR_NOT_FOUND no fim
+uint32_t database_cards_iter_cursor(const database_cards_iter_t *iter);
+void database_cards_iter_end(database_cards_iter_t *iter);
+
+// Transação: agrupa chamadas database_add_card/update_card_access/
+// delete_card/add_access_log da mesma task num único commit. O banco fica
+// travado para as outras tasks até commit/abort; abort desfaz as mutações
+// e descarta os logs pendentes. Cartões novos só entram em card_count no
+// commit, então no modo NVS uma queda no meio da transação não os deixa
+// visíveis.
+esp_err_t database_txn_begin(void);
+esp_err_t database_txn_commit(void);   // em caso de erro a transação é desfeita
+void database_txn_abort(void);
+
+// Importação em lote (provisionamento/restauração de backup). Duplicados
+// são descartados pelo índice; tudo é confirmado num único commit em
+// database_import_end. Só uma importação por vez.
+typedef struct {
+    uint32_t imported;
+    uint32_t duplicates;
+    uint32_t invalid;
+    uint32_t elapsed_ms;
+    uint32_t records_per_sec;
+} database_import_stats_t;
+
+esp_err_t database_import_begin(void);
+// record->uid, name e access_level obrigatórios; datas/contador 0 = agora/zero
+esp_err_t database_import_add(const rfid_record_t *record);
+esp_err_t database_import_end(database_import_stats_t *stats);
+// Desfaz os cartões acrescentados desde o begin (corpo incompleto, erro de
+// escrita). Durante a importação database_add_card/delete_card retornam
+// ESP_ERR_INVALID_STATE.
+void database_import_abort(void);
+// Exportação: database_cards_iter_begin/next (mesmos campos de rfid_record_t)
 
 // Log de acesso
 esp_err_t database_add_access_log(const char *uid, const char *action);
+// Cópia dos logs mais recentes; para leitura sem alocação use
+// database_logs_iter_begin/next
 esp_err_t database_get_access_logs(access_log_t **logs, int *count, int limit);
+esp_err_t database_logs_iter_begin(database_logs_iter_t *iter, uint32_t cursor,
+                                   database_log_filter_t filter, void *ctx);
+// Como database_logs_iter_begin, restrito a um intervalo de tempo e/ou cartão
+esp_err_t database_logs_query_begin(database_logs_iter_t *iter, uint32_t cursor,
+                                    const database_log_query_t *query);
+esp_err_t database_logs_iter_next(database_logs_iter_t *iter, access_log_t *entry); // ESP_ERR_NOT_FOUND no fim
+uint32_t database_logs_iter_cursor(const database_logs_iter_t *iter);
+void database_logs_iter_end(database_logs_iter_t *iter);
 
 // Estatísticas
 esp_err_t database_get_stats(int *total_cards, int *total_accesses);
+esp_err_t database_get_access_stats(database_access_stats_t *stats);
 
 #endif // DATABASE_H
@@ -1,243 +1,2281 @@
 #include "database.h"
+#include "card_index.h"
+#include "card_filter.h"
+#include "card_query.h"
+#include "access_log.h"
+#include "access_stats.h"
+#include "card_snapshot.h"
+#include "card_view.h"
+#if DATABASE_STORAGE_MMAP
+#include "card_mmap.h"
+#endif
+#include "storage_backend.h"
 #include "nvs_flash.h"
-#include "nvs.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include <string.h>
 #include <stdio.h>
 #include <time.h>
 #include <stdlib.h>
+#include <stdatomic.h>
 #include <inttypes.h>
 
-static nvs_handle_t nvs_database_handle;
+// Backend chave/valor aberto em database_init (NVS por padrão)
+static const storage_backend_t *s_store = NULL;
 
 #define CARD_COUNT_KEY "card_count"
-#define CARD_PREFIX "card_"
-#define LOG_COUNT_KEY "log_count"
+#define CARD_PREFIX "card_"         // formato antigo (rfid_record_t inteiro)
+#define CARD_HOT_PREFIX "c_"        // registro quente compacto
+#define CARD_COLD_PREFIX "n_"       // registro frio: first_seen + nome
+#define FREE_SLOTS_KEY "free_slots"    // slots livres (u16[]) abaixo de card_count
+#define DB_VERSION_KEY "db_version"
+#define DB_VERSION 2
+#define LOG_COUNT_KEY "log_count"     // anel antigo de 50 logs no NVS
 #define LOG_PREFIX "log_"
+#define LEGACY_LOG_SLOTS 50
+
+// Registro frio: first_seen (u32) seguido do nome sem terminador
+#define CARD_COLD_MAX_SIZE (sizeof(uint32_t) + MAX_NAME_LENGTH - 1)
+
+// Tabela quente em RAM indexada pelo slot NVS (c_<slot>)
+static card_hot_t *s_cards = NULL;
+static uint32_t s_slot_count = 0;      // slots em uso (= card_count no NVS)
+static uint32_t s_slot_capacity = 0;
+
+// Índice UID -> slot NVS, construído em database_init
+static card_index_t s_card_index;
+
+// Cópia UID -> nível lida sem lock pelo caminho do toque; mudanças de
+// transação e importação só são publicadas no commit
+static card_view_t s_card_view;
+static uint32_t s_view_fallbacks = 0;
+
+// Alocador de slots: pilha de slots livres abaixo de s_slot_count; a
+// compactação move os últimos cartões para esses buracos
+static uint16_t *s_free_slots = NULL;
+static uint32_t s_free_count = 0;
+static uint32_t s_free_capacity = 0;
+static uint32_t s_layout_generation = 0;   // muda quando a compactação move cartões
+static uint32_t s_compact_pauses = 0;      // database_compact_pause sem resume
+
+// Importação em lote: registros acrescentados no fim sem commit individual;
+// card_count só é gravado em database_import_end
+static bool s_import_active = false;
+static uint32_t s_import_base = 0;         // s_slot_count em import_begin (abort)
+static database_import_stats_t s_import_stats;
+static int64_t s_import_start_us = 0;
+
+// Transação aberta por database_txn_begin: registro de desfazer das
+// mutações de cartão e logs retidos até o commit
+typedef enum {
+    TXN_OP_ADD,
+    TXN_OP_UPDATE,
+    TXN_OP_DELETE,
+} txn_op_type_t;
+
+typedef struct {
+    txn_op_type_t type;
+    uint16_t slot;
+    card_hot_t before;              // UPDATE/DELETE
+    uint32_t first_seen;            // DELETE
+    char name[MAX_NAME_LENGTH];     // DELETE
+} txn_op_t;
+
+typedef struct {
+    char uid[MAX_UID_LENGTH];
+    char action[MAX_ACTION_LENGTH];
+    uint32_t timestamp;
+} txn_log_t;
+
+static struct {
+    bool active;
+    uint32_t op_count;
+    uint32_t log_count;
+    txn_op_t ops[DATABASE_TXN_MAX_OPS];
+    txn_log_t logs[DATABASE_TXN_MAX_LOGS];
+} s_txn;
+
+// Gravações adiadas para um único commit (importação ou transação)
+static inline bool card_batch_active(void) {
+    return s_import_active || s_txn.active;
+}
+
+static txn_op_t *txn_reserve_op(void) {
+    if (!s_txn.active) {
+        return NULL;
+    }
+    if (s_txn.op_count >= DATABASE_TXN_MAX_OPS) {
+        return NULL;
+    }
+    return &s_txn.ops[s_txn.op_count];
+}
+
+// Filtro de UIDs desconhecidos, consultado antes do índice
+static card_filter_t s_card_filter;
+static card_filter_stats_t s_filter_stats;
+
+// Índices secundários (nome, nível, last_seen) para database_query_cards
+static card_query_t s_card_query;
+static uint32_t s_access_total = 0;   // soma de access_count dos cartões cadastrados
+
+// Cache write-back: contadores alterados ficam só em RAM até o próximo flush
+static uint32_t *s_dirty_bits = NULL;  // 1 bit por slot
+static uint32_t s_dirty_count = 0;
+static atomic_uint s_flush_interval_ms = DATABASE_FLUSH_INTERVAL_MS;  // lido pela task de flush
+static TaskHandle_t s_flush_task = NULL;
+// database_close pede a parada e espera a task sair fora do lock; apagá-la
+// de fora podia deixar o lock do banco ou o do log travados para sempre
+static atomic_bool s_flush_stop = false;
+static SemaphoreHandle_t s_flush_done = NULL;
+static database_cache_stats_t s_cache_stats;
+static uint32_t s_ready_ms = 0;        // database_init_with_backend até o banco pronto
+
+// Protege a tabela quente, o índice e o cache (rfid_task x httpd x flush)
+static SemaphoreHandle_t s_db_mutex = NULL;
+// Recursivo: database_txn_begin mantém o lock enquanto a mesma task chama
+// as funções públicas
+static database_concurrency_stats_t s_lock_stats;   // campos lock_*, com o lock
+
+static void db_lock(void) {
+    if (xSemaphoreTakeRecursive(s_db_mutex, 0) != pdTRUE) {
+        int64_t start = esp_timer_get_time();
+        xSemaphoreTakeRecursive(s_db_mutex, portMAX_DELAY);
+        uint32_t waited = (uint32_t)(esp_timer_get_time() - start);
+        s_lock_stats.lock_contended++;
+        s_lock_stats.lock_wait_total_us += waited;
+        if (waited > s_lock_stats.lock_wait_max_us) {
+            s_lock_stats.lock_wait_max_us = waited;
+        }
+    }
+    s_lock_stats.lock_acquires++;
+}
+
+#define DB_LOCK()   db_lock()
+#define DB_UNLOCK() xSemaphoreGiveRecursive(s_db_mutex)
+
+#define DIRTY_WORDS(slots) (((slots) + 31) / 32)
+
+// Fotografia dos índices (card_snapshot); a tabela mapeada não precisa
+#if DATABASE_SNAPSHOT && !DATABASE_STORAGE_MMAP
+#define CARD_USE_SNAPSHOT 1
+#else
+#define CARD_USE_SNAPSHOT 0
+#endif
+static bool s_names_loaded = false;    // chaves de nome vieram da fotografia
+
+typedef struct {
+    uint8_t uid[CARD_UID_MAX_BYTES];
+    uint8_t uid_len;
+} card_uid_key_t;
+
+static uint32_t card_uid_hash(const card_uid_key_t *key) {
+    return card_index_hash(key->uid, key->uid_len);
+}
+
+static void card_slot_key(const char *prefix, uint32_t slot, char *key, size_t key_size) {
+    snprintf(key, key_size, "%s%" PRIu32, prefix, slot);
+}
+
+// Confirma o candidato do índice contra a tabela em RAM (sem acesso ao flash)
+static bool card_slot_matches(uint16_t slot, void *ctx) {
+    const card_uid_key_t *key = (const card_uid_key_t *)ctx;
+    const card_hot_t *card = &s_cards[slot];
+    return card->uid_len == key->uid_len && memcmp(card->uid, key->uid, key->uid_len) == 0;
+}
+
+// UIDs desconhecidos (cartões não cadastrados, varredura de UIDs) são
+// rejeitados pelo filtro sem sondar o índice
+static bool card_find_slot(const card_uid_key_t *key, uint16_t *slot) {
+    uint32_t hash = card_uid_hash(key);
+    s_filter_stats.lookups++;
+    if (!card_filter_contains(&s_card_filter, hash)) {
+        s_filter_stats.rejected++;
+        return false;
+    }
+    if (!card_index_find(&s_card_index, hash, card_slot_matches, (void *)key, slot)) {
+        s_filter_stats.false_positives++;
+        return false;
+    }
+    return true;
+}
+
+// Recria o filtro a partir da tabela quente (carga inicial ou filtro cheio)
+static esp_err_t card_filter_rebuild(uint32_t expected) {
+    for (;;) {
+        card_filter_free(&s_card_filter);
+        esp_err_t ret = card_filter_init(&s_card_filter, expected);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        for (uint32_t i = 0; i < s_slot_count && ret == ESP_OK; i++) {
+            if (s_cards[i].uid_len == 0) {
+                continue;
+            }
+            card_uid_key_t key = { .uid_len = s_cards[i].uid_len };
+            memcpy(key.uid, s_cards[i].uid, key.uid_len);
+            ret = card_filter_insert(&s_card_filter, card_uid_hash(&key));
+        }
+        if (ret != ESP_ERR_NO_MEM || s_card_filter.bucket_count >= 0x10000) {
+            if (ret != ESP_OK) {
+                card_filter_free(&s_card_filter); // sem filtro nada é rejeitado
+            }
+            return ret;
+        }
+        expected = s_card_filter.bucket_count * CARD_FILTER_BUCKET_SIZE * 2;
+    }
+}
+
+// Acrescenta um UID ao filtro sem falhar: filtro cheio é recriado maior e,
+// sem memória para isso, fica desligado (as buscas vão direto ao índice)
+// até o próximo cadastro conseguir recriá-lo
+static void card_filter_add(uint32_t hash) {
+    esp_err_t ret = card_filter_insert(&s_card_filter, hash);
+    if (ret == ESP_ERR_NO_MEM || ret == ESP_ERR_INVALID_STATE) {
+        ret = card_filter_rebuild(s_card_index.count * 2);
+        if (ret != ESP_OK) {
+            printf("Filtro de cartões desligado: %s\n", esp_err_to_name(ret));
+        }
+    }
+}
+
+// A carga reserva exatamente os slots em uso; cadastros crescem a tabela
+// (e os índices de card_query) em passos fixos. Dobrar a capacidade deixava
+// até metade da tabela vazia, o que em RAM interna não cabe.
+#define CARD_TABLE_GROW_STEP    256
+
+static esp_err_t card_table_reserve(uint32_t slots) {
+    if (slots <= s_slot_capacity) {
+        return ESP_OK;
+    }
+    uint32_t new_capacity = s_slot_capacity + CARD_TABLE_GROW_STEP;
+    if (new_capacity < slots || s_slot_capacity == 0) {
+        new_capacity = slots;
+    }
+    uint32_t *dirty = realloc(s_dirty_bits, DIRTY_WORDS(new_capacity) * sizeof(uint32_t));
+    if (!dirty) {
+        return ESP_ERR_NO_MEM;
+    }
+    memset(&dirty[DIRTY_WORDS(s_slot_capacity)], 0,
+           (DIRTY_WORDS(new_capacity) - DIRTY_WORDS(s_slot_capacity)) * sizeof(uint32_t));
+    s_dirty_bits = dirty;
+
+    card_hot_t *table = realloc(s_cards, new_capacity * sizeof(card_hot_t));
+    if (!table) {
+        return ESP_ERR_NO_MEM;
+    }
+    memset(&table[s_slot_capacity], 0, (new_capacity - s_slot_capacity) * sizeof(card_hot_t));
+    s_cards = table;
+    s_slot_capacity = new_capacity;
+    return card_query_reserve(&s_card_query, new_capacity);
+}
+
+static esp_err_t card_write_hot_len(uint32_t slot, size_t *written) {
+    uint8_t blob[CARD_HOT_MAX_ENCODED];
+    size_t len = card_hot_encode(&s_cards[slot], blob);
+    char key[16];
+    card_slot_key(CARD_HOT_PREFIX, slot, key, sizeof(key));
+    if (written) {
+        *written = len;
+    }
+    return storage_set(s_store, key, blob, len);
+}
+
+static esp_err_t card_write_hot(uint32_t slot) {
+    return card_write_hot_len(slot, NULL);
+}
+
+static inline bool card_is_dirty(uint32_t slot) {
+    return (s_dirty_bits[slot / 32] >> (slot % 32)) & 1;
+}
+
+static void card_mark_dirty(uint32_t slot) {
+    if (!card_is_dirty(slot)) {
+        s_dirty_bits[slot / 32] |= 1u << (slot % 32);
+        s_dirty_count++;
+    }
+}
+
+static void card_clear_dirty(uint32_t slot) {
+    if (card_is_dirty(slot)) {
+        s_dirty_bits[slot / 32] &= ~(1u << (slot % 32));
+        s_dirty_count--;
+    }
+}
+
+static esp_err_t card_persist_hot(uint32_t slot, size_t *written);
+static esp_err_t card_persist_commit(void);
+static esp_err_t card_compact_locked(uint32_t max_moves);
+
+// Grava todos os slots sujos e faz um único commit
+static esp_err_t card_flush_locked(void) {
+    if (s_dirty_count == 0) {
+        return ESP_OK;
+    }
+
+    int64_t start = esp_timer_get_time();
+    uint32_t records = 0;
+    uint32_t bytes = 0;
+
+    // Lista da fotografia gravada uma vez para o flush inteiro
+    for (uint32_t w = 0; w < DIRTY_WORDS(s_slot_count); w++) {
+        for (uint32_t bits = s_dirty_bits[w]; bits; bits &= bits - 1) {
+            card_snapshot_mark((uint16_t)(w * 32 + __builtin_ctz(bits)));
+        }
+    }
+    esp_err_t ret = card_snapshot_save();
+
+    for (uint32_t w = 0; w < DIRTY_WORDS(s_slot_count) && ret == ESP_OK; w++) {
+        while (s_dirty_bits[w]) {
+            uint32_t slot = w * 32 + __builtin_ctz(s_dirty_bits[w]);
+            if (s_cards[slot].uid_len != 0) {
+                size_t len = 0;
+                ret = card_persist_hot(slot, &len);
+                if (ret != ESP_OK) {
+                    break;
+                }
+                records++;
+                bytes += len;
+            }
+            card_clear_dirty(slot);
+        }
+    }
+
+    if (ret == ESP_OK) {
+        ret = card_persist_commit();
+    }
+    if (ret != ESP_OK) {
+        printf("Erro no flush do cache: %s\n", esp_err_to_name(ret));
+        s_cache_stats.flush_errors++;
+        return ret;
+    }
+
+    uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start);
+    s_cache_stats.flush_count++;
+    s_cache_stats.records_written += records;
+    s_cache_stats.bytes_written += bytes;
+    s_cache_stats.last_flush_us = elapsed_us;
+    s_cache_stats.total_flush_us += elapsed_us;
+    if (elapsed_us > s_cache_stats.max_flush_us) {
+        s_cache_stats.max_flush_us = elapsed_us;
+    }
+    return ESP_OK;
+}
+
+// Grava um pedaço da fotografia dos índices se ela estiver desatualizada;
+// true se ainda falta gravar
+static bool card_snapshot_step_locked(void) {
+    uint32_t max_dirty = s_slot_count / DATABASE_SNAPSHOT_DIRTY_DIV;
+    if (max_dirty < DATABASE_SNAPSHOT_MIN_DIRTY) {
+        max_dirty = DATABASE_SNAPSHOT_MIN_DIRTY;
+    }
+    if (card_batch_active() || !card_snapshot_due(s_slot_count, max_dirty)) {
+        return false;
+    }
+    bool done = false;
+    esp_err_t ret = card_snapshot_step(s_cards, (const char (*)[CARD_QUERY_NAME_KEY_LEN])s_card_query.name_keys,
+                                       s_slot_count, &done);
+    return ret == ESP_OK && !done;
+}
+
+// Task de flush: acorda por intervalo ou quando o limiar de sujos é atingido
+static void database_flush_task(void *pvParameters) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(s_flush_interval_ms));
+        if (s_flush_stop) {
+            break;
+        }
+        DB_LOCK();
+        card_flush_locked();
+        if (!card_batch_active()) {
+            if (s_compact_pauses == 0) {
+                card_compact_locked(DATABASE_COMPACT_BATCH);
+            }
+            if (card_view_stale(&s_card_view)) {
+                card_view_rebuild(&s_card_view, s_cards, s_slot_count);
+            }
+        }
+        DB_UNLOCK();
+        access_log_flush();
+
+        // Fotografia um pedaço por vez, liberando o lock entre eles
+        bool more = true;
+        while (more) {
+            DB_LOCK();
+            more = card_snapshot_step_locked();
+            DB_UNLOCK();
+        }
+    }
+    // Fora dos locks; o último flush e a fotografia ficam com database_close
+    xSemaphoreGive(s_flush_done);
+    vTaskDelete(NULL);
+}
+
+static void database_shutdown_handler(void) {
+    database_flush();
+    access_log_flush();
+}
+
+// Remove o anel de logs antigo do NVS (substituído pela partição de log)
+static void database_drop_legacy_logs(void) {
+    uint32_t log_count = 0;
+    if (storage_get_u32(s_store, LOG_COUNT_KEY, &log_count) != ESP_OK) {
+        return;
+    }
+    for (int i = 0; i < LEGACY_LOG_SLOTS; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "%s%d", LOG_PREFIX, i);
+        storage_erase(s_store, key);
+    }
+    storage_erase(s_store, LOG_COUNT_KEY);
+    storage_commit(s_store);
+    printf("Logs antigos do NVS removidos (%" PRIu32 " registros)\n", log_count);
+}
+
+static void database_stats_record(const char *uid, const char *action, uint32_t timestamp) {
+    card_uid_key_t key = { .uid_len = 0 };
+    if (card_uid_parse(uid, key.uid, &key.uid_len) != ESP_OK) {
+        key.uid_len = 0;
+    }
+    access_stats_record(key.uid, key.uid_len, access_stats_classify(action), timestamp);
+}
+
+// Todo evento passa por aqui: log em flash + estatísticas incrementais
+static esp_err_t database_log_event(const char *uid, const char *action, uint32_t timestamp) {
+    database_stats_record(uid, action, timestamp);
+    return access_log_append(uid, action, timestamp);
+}
+
+// Refaz os anéis de estatísticas a partir do log retido (só no boot). Só os
+// dias que /api/stats retorna, contados do evento mais recente (o relógio
+// pode ainda não ter sincronizado): o resto do log não é lido
+#define STATS_SECONDS_PER_DAY   86400u
+
+static bool database_stats_replay_cb(const access_log_t *entry, void *ctx) {
+    database_stats_record(entry->uid, entry->action, (uint32_t)entry->timestamp);
+    (*(uint32_t *)ctx)++;
+    return true;
+}
+
+static void database_stats_replay(void) {
+    uint32_t last_day = access_log_last_timestamp() / STATS_SECONDS_PER_DAY;
+    uint32_t from = last_day >= DATABASE_STATS_DAYS ?
+                    (last_day - (DATABASE_STATS_DAYS - 1)) * STATS_SECONDS_PER_DAY : 0;
+    uint32_t replayed = 0;
+    if (access_log_scan(from, database_stats_replay_cb, &replayed) == ESP_OK) {
+        printf("Estatísticas refeitas a partir de %" PRIu32 " logs\n", replayed);
+    }
+}
+
+static esp_err_t card_write_cold(uint32_t slot, uint32_t first_seen, const char *name) {
+    uint8_t blob[CARD_COLD_MAX_SIZE];
+    size_t name_len = strnlen(name, MAX_NAME_LENGTH - 1);
+    memcpy(blob, &first_seen, sizeof(first_seen));
+    memcpy(&blob[sizeof(first_seen)], name, name_len);
+    char key[16];
+    card_slot_key(CARD_COLD_PREFIX, slot, key, sizeof(key));
+    return storage_set(s_store, key, blob, sizeof(first_seen) + name_len);
+}
+
+static bool card_cold_view(uint32_t slot, uint32_t *first_seen, const char **name, char *scratch, size_t scratch_size);
+
+// Monta o rfid_record_t público a partir do registro quente e, se pedido,
+// do registro frio (uma leitura NVS)
+static void card_fill_record(uint32_t slot, rfid_record_t *record, bool with_cold) {
+    const card_hot_t *card = &s_cards[slot];
+    memset(record, 0, sizeof(*record));
+    record->id = slot + 1;
+    card_uid_format(card->uid, card->uid_len, record->uid, sizeof(record->uid));
+    record->last_seen = card->last_seen;
+    record->access_count = card->access_count;
+    record->access_level = card->access_level;
+
+    if (!with_cold) {
+        return;
+    }
+
+    uint32_t first_seen = 0;
+    const char *name = NULL;
+    if (card_cold_view(slot, &first_seen, &name, record->name, sizeof(record->name))) {
+        record->first_seen = first_seen;
+        if (name != record->name) {
+            strncpy(record->name, name, MAX_NAME_LENGTH - 1);
+        }
+    }
+}
+
+// Lê c_<slot> para a tabela em RAM; slot fica livre se não existir
+static void card_read_hot(uint32_t slot) {
+    char key[16];
+    card_slot_key(CARD_HOT_PREFIX, slot, key, sizeof(key));
+
+    uint8_t blob[CARD_HOT_MAX_ENCODED];
+    size_t len = sizeof(blob);
+    if (storage_get(s_store, key, blob, &len) != ESP_OK ||
+        card_hot_decode(blob, len, &s_cards[slot]) != ESP_OK) {
+        memset(&s_cards[slot], 0, sizeof(card_hot_t));
+    }
+}
+
+// Lê first_seen e nome do registro frio NVS para 'name' (buffer do chamador)
+static bool card_read_cold_nvs(uint32_t slot, uint32_t *first_seen, char *name, size_t name_size) {
+    uint8_t blob[CARD_COLD_MAX_SIZE];
+    size_t len = sizeof(blob);
+    char key[16];
+    card_slot_key(CARD_COLD_PREFIX, slot, key, sizeof(key));
+    if (storage_get(s_store, key, blob, &len) != ESP_OK || len < sizeof(uint32_t)) {
+        return false;
+    }
+    memcpy(first_seen, blob, sizeof(uint32_t));
+    size_t name_len = len - sizeof(uint32_t);
+    if (name_len >= name_size) {
+        name_len = name_size - 1;
+    }
+    memcpy(name, &blob[sizeof(uint32_t)], name_len);
+    name[name_len] = '\0';
+    return true;
+}
+
+// --- Persistência dos cartões: chaves c_/n_ no backend ou tabela mapeada (card_mmap) ---
+
+#if DATABASE_STORAGE_MMAP
+
+static esp_err_t card_persist_hot(uint32_t slot, size_t *written) {
+    esp_err_t ret = card_mmap_put((uint16_t)slot, &s_cards[slot], 0, NULL);
+    if (ret == ESP_ERR_NO_MEM) {
+        // Área delta cheia: a compactação grava todos os contadores da RAM
+        ret = card_mmap_compact(s_cards, s_slot_count, NULL, NULL);
+    }
+    if (written) {
+        *written = sizeof(card_mmap_record_t);
+    }
+    return ret;
+}
+
+static esp_err_t card_persist_new(uint32_t slot, uint32_t first_seen, const char *name) {
+    esp_err_t ret = card_mmap_put((uint16_t)slot, &s_cards[slot], first_seen, name);
+    if (ret == ESP_ERR_NO_MEM) {
+        ret = card_mmap_compact(s_cards, s_slot_count, NULL, NULL);
+        if (ret == ESP_OK) {
+            ret = card_mmap_put((uint16_t)slot, &s_cards[slot], first_seen, name);
+        }
+    }
+    return ret;
+}
+
+static esp_err_t card_persist_delete(uint32_t slot) {
+    esp_err_t ret = card_mmap_delete((uint16_t)slot);
+    if (ret == ESP_ERR_NO_MEM) {
+        // Compactar sem o slot removido
+        card_hot_t removed = s_cards[slot];
+        s_cards[slot].uid_len = 0;
+        ret = card_mmap_compact(s_cards, s_slot_count, NULL, NULL);
+        s_cards[slot] = removed;
+    }
+    return ret;
+}
+
+static esp_err_t card_persist_commit(void) {
+    return ESP_OK; // gravações na partição mapeada são imediatas
+}
+
+// Sem chaves de cartão no backend, nada a agrupar no journal
+static bool card_journal_begin(void) {
+    return false;
+}
+
+// Nome aponta direto para a memória mapeada (sem cópia)
+static bool card_cold_view(uint32_t slot, uint32_t *first_seen, const char **name, char *scratch, size_t scratch_size) {
+    (void)scratch;
+    (void)scratch_size;
+    const card_mmap_record_t *rec = card_mmap_get((uint16_t)slot);
+    if (!rec) {
+        return false;
+    }
+    *first_seen = rec->first_seen;
+    *name = rec->name;
+    return true;
+}
+
+#else
+
+// O slot entra na lista da fotografia antes do registro mudar (sem
+// fotografia aberta não faz nada)
+static esp_err_t card_snapshot_touch(uint32_t slot) {
+    card_snapshot_mark((uint16_t)slot);
+    return card_snapshot_save();
+}
+
+static esp_err_t card_persist_hot(uint32_t slot, size_t *written) {
+    esp_err_t ret = card_snapshot_touch(slot);
+    return ret == ESP_OK ? card_write_hot_len(slot, written) : ret;
+}
+
+static esp_err_t card_persist_new(uint32_t slot, uint32_t first_seen, const char *name) {
+    esp_err_t ret = card_snapshot_touch(slot);
+    if (ret == ESP_OK) {
+        ret = card_write_hot(slot);
+    }
+    if (ret == ESP_OK) {
+        ret = card_write_cold(slot, first_seen, name);
+    }
+    if (ret == ESP_OK && slot + 1 > s_slot_count && !card_batch_active()) {
+        ret = storage_set_u32(s_store, CARD_COUNT_KEY, slot + 1);
+    }
+    return ret;
+}
+
+static esp_err_t card_persist_delete(uint32_t slot) {
+    esp_err_t ret = card_snapshot_touch(slot);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    char key[16];
+    card_slot_key(CARD_HOT_PREFIX, slot, key, sizeof(key));
+    ret = storage_erase(s_store, key);
+    if (ret != ESP_OK && ret != ESP_ERR_NOT_FOUND) {
+        return ret;
+    }
+    card_slot_key(CARD_COLD_PREFIX, slot, key, sizeof(key));
+    storage_erase(s_store, key);
+    return ESP_OK;
+}
+
+static esp_err_t card_persist_commit(void) {
+    return storage_commit(s_store);
+}
+
+// As chaves de uma mutação (c_/n_/card_count/free_slots) viram um único
+// registro do journal, aplicado no próximo card_persist_commit. false se
+// já há um grupo aberto (transação) ou o journal está desligado.
+static bool card_journal_begin(void) {
+    return storage_journal_begin();
+}
+
+// Nome copiado do NVS para 'scratch' (buffer do chamador, sem heap)
+static bool card_cold_view(uint32_t slot, uint32_t *first_seen, const char **name, char *scratch, size_t scratch_size) {
+    if (!card_read_cold_nvs(slot, first_seen, scratch, scratch_size)) {
+        return false;
+    }
+    *name = scratch;
+    return true;
+}
+
+#endif // DATABASE_STORAGE_MMAP
+
+// --- Alocador de slots ---
+
+static esp_err_t card_free_push(uint16_t slot) {
+    if (s_free_count == s_free_capacity) {
+        uint32_t new_capacity = s_free_capacity ? s_free_capacity * 2 : 16;
+        uint16_t *slots = realloc(s_free_slots, new_capacity * sizeof(uint16_t));
+        if (!slots) {
+            return ESP_ERR_NO_MEM;
+        }
+        s_free_slots = slots;
+        s_free_capacity = new_capacity;
+    }
+    s_free_slots[s_free_count++] = slot;
+    return ESP_OK;
+}
+
+// Remove os slots >= limit (buracos que saíram do intervalo em uso)
+static void card_free_drop_from(uint32_t limit) {
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < s_free_count; i++) {
+        if (s_free_slots[i] < limit) {
+            s_free_slots[kept++] = s_free_slots[i];
+        }
+    }
+    s_free_count = kept;
+}
+
+// Reconstrói a pilha a partir dos buracos da tabela quente
+static esp_err_t card_free_rebuild(void) {
+    s_free_count = 0;
+    for (uint32_t i = s_slot_count; i-- > 0;) {
+        if (s_cards[i].uid_len == 0) {
+            esp_err_t ret = card_free_push((uint16_t)i);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+#if DATABASE_STORAGE_MMAP
+// A própria tabela mapeada marca os slots livres
+static esp_err_t card_persist_slots(void) {
+    return ESP_OK;
+}
+#else
+// A lista livre evita ler chaves inexistentes no boot. Invariante: slot
+// na lista => sem registro no NVS (a lista é gravada antes de reusar um
+// slot e depois de apagá-lo).
+static esp_err_t card_persist_slots(void) {
+    esp_err_t ret = storage_set_u32(s_store, CARD_COUNT_KEY, s_slot_count);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (s_free_count == 0) {
+        ret = storage_erase(s_store, FREE_SLOTS_KEY);
+        return ret == ESP_ERR_NOT_FOUND ? ESP_OK : ret;
+    }
+    return storage_set(s_store, FREE_SLOTS_KEY, s_free_slots,
+                       s_free_count * sizeof(uint16_t));
+}
+#endif
+
+// Descarta buracos no fim do intervalo em uso
+static void card_trim_tail(void) {
+    uint32_t count = s_slot_count;
+    while (count > 0 && s_cards[count - 1].uid_len == 0) {
+        count--;
+    }
+    if (count != s_slot_count) {
+        s_slot_count = count;
+        card_free_drop_from(count);
+    }
+}
+
+// Move o último cartão para o buraco 'to'
+static esp_err_t card_move_slot(uint32_t from, uint16_t to) {
+    uint32_t first_seen = 0;
+    const char *name = "";
+    char scratch[MAX_NAME_LENGTH];
+    card_cold_view(from, &first_seen, &name, scratch, sizeof(scratch));
+    if (name != scratch) {
+        // a compactação do mmap pode invalidar o ponteiro
+        strncpy(scratch, name, sizeof(scratch) - 1);
+        scratch[sizeof(scratch) - 1] = '\0';
+    }
+
+    s_cards[to] = s_cards[from];
+    esp_err_t ret = card_persist_new(to, first_seen, scratch);
+    if (ret == ESP_OK) {
+        ret = card_persist_delete(from);
+    }
+    if (ret != ESP_OK) {
+        s_cards[to].uid_len = 0;
+        return ret;
+    }
+
+    card_uid_key_t key = { .uid_len = s_cards[from].uid_len };
+    memcpy(key.uid, s_cards[from].uid, key.uid_len);
+    uint32_t hash = card_uid_hash(&key);
+    card_index_remove(&s_card_index, hash, card_slot_matches, &key);
+    card_query_move(&s_card_query, s_cards, (uint16_t)from, to);
+    memset(&s_cards[from], 0, sizeof(card_hot_t));
+    card_clear_dirty(from);
+    return card_index_insert(&s_card_index, hash, to);
+}
+
+// Compactação em segundo plano: até max_moves cartões por chamada, para
+// não segurar o lock por muito tempo
+static esp_err_t card_compact_locked(uint32_t max_moves) {
+    uint32_t old_count = s_slot_count;
+    card_trim_tail();
+    if (s_free_count == 0 && s_slot_count == old_count) {
+        return ESP_OK;
+    }
+
+    // Movimentos do ciclo num único registro do journal
+    card_journal_begin();
+    esp_err_t ret = ESP_OK;
+    uint32_t moves = 0;
+    while (s_free_count > 0 && moves < max_moves) {
+        uint16_t to = s_free_slots[--s_free_count];
+        ret = card_persist_slots(); // tirar 'to' da lista antes de gravar nele
+        if (ret == ESP_OK) {
+            ret = card_move_slot(s_slot_count - 1, to);
+        }
+        if (ret != ESP_OK) {
+            card_free_push(to);
+            break;
+        }
+        moves++;
+        card_trim_tail();
+    }
+
+    esp_err_t commit_ret = card_persist_slots();
+    if (commit_ret == ESP_OK) {
+        commit_ret = card_persist_commit();
+    }
+    s_cache_stats.compacted_slots += moves;
+    if (moves > 0) {
+        s_layout_generation++; // cursores de iteração antigos deixam de valer
+        printf("Compactação: %" PRIu32 " cartões movidos, %" PRIu32 " slots em uso\n", moves, s_slot_count);
+    }
+    return ret != ESP_OK ? ret : commit_ret;
+}
+
+// Converte os blobs card_<n> (rfid_record_t) para o formato compacto
+static esp_err_t database_migrate_legacy(uint32_t card_count) {
+    uint32_t migrated = 0;
+
+    for (uint32_t i = 0; i < card_count; i++) {
+        char key[16];
+        card_slot_key(CARD_PREFIX, i, key, sizeof(key));
+
+        rfid_record_t legacy;
+        size_t required_size = sizeof(legacy);
+        esp_err_t ret = storage_get(s_store, key, &legacy, &required_size);
+        if (ret != ESP_OK) {
+            card_read_hot(i); // slot vazio ou já migrado numa tentativa anterior
+            continue;
+        }
+        legacy.uid[MAX_UID_LENGTH - 1] = '\0';
+        legacy.name[MAX_NAME_LENGTH - 1] = '\0';
+
+        card_hot_t *card = &s_cards[i];
+        memset(card, 0, sizeof(*card));
+        if (card_uid_parse(legacy.uid, card->uid, &card->uid_len) != ESP_OK) {
+            printf("Migração: UID inválido descartado: %s\n", legacy.uid);
+            card->uid_len = 0;
+        } else {
+            card->access_level = legacy.access_level;
+            card->last_seen = (uint32_t)legacy.last_seen;
+            card->access_count = legacy.access_count;
+
+            ret = card_write_hot(i);
+            if (ret == ESP_OK) {
+                ret = card_write_cold(i, (uint32_t)legacy.first_seen, legacy.name);
+            }
+            if (ret != ESP_OK) {
+                printf("Migração: erro ao gravar slot %" PRIu32 ": %s\n", i, esp_err_to_name(ret));
+                return ret;
+            }
+            migrated++;
+        }
+
+        storage_erase(s_store, key);
+    }
+
+    esp_err_t ret = storage_set_u32(s_store, DB_VERSION_KEY, DB_VERSION);
+    if (ret == ESP_OK) {
+        ret = storage_commit(s_store);
+    }
+    printf("Migração concluída: %" PRIu32 " cartões convertidos\n", migrated);
+    return ret;
+}
+
+#if CARD_USE_SNAPSHOT
+// Relê c_/n_ de um slot; o nome vai cru para name_keys (card_query_add
+// normaliza na montagem do índice)
+static void card_reload_slot(uint32_t slot) {
+    card_read_hot(slot);
+    memset(s_card_query.name_keys[slot], 0, CARD_QUERY_NAME_KEY_LEN);
+    uint32_t first_seen = 0;
+    char name[MAX_NAME_LENGTH];
+    if (s_cards[slot].uid_len != 0 && card_read_cold_nvs(slot, &first_seen, name, sizeof(name))) {
+        memcpy(s_card_query.name_keys[slot], name, strnlen(name, CARD_QUERY_NAME_KEY_LEN));
+    }
+}
+
+// Tabela quente e chaves de nome da fotografia; só os slots alterados
+// depois dela e os acrescentados além dela são lidos do backend
+static esp_err_t card_table_load_snapshot(uint32_t card_count) {
+    uint32_t covered = card_snapshot_slot_count();
+    if (covered > card_count) {
+        covered = card_count;
+    }
+    esp_err_t ret = card_snapshot_load(s_cards, s_card_query.name_keys, covered);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    const uint16_t *dirty = NULL;
+    uint32_t dirty_count = card_snapshot_dirty(&dirty);
+    for (uint32_t i = 0; i < dirty_count; i++) {
+        if (dirty[i] < covered) {
+            card_reload_slot(dirty[i]);
+        }
+    }
+    for (uint32_t slot = covered; slot < card_count; slot++) {
+        card_reload_slot(slot);
+    }
+    printf("Tabela carregada da fotografia: %" PRIu32 " slots, %" PRIu32 " relidos\n",
+           covered, dirty_count + (card_count - covered));
+    return ESP_OK;
+}
+#endif
+
+// Carrega a tabela quente do backend (ou migra o formato antigo)
+static esp_err_t card_table_load_nvs(void) {
+    uint32_t card_count = 0;
+    storage_get_u32(s_store, CARD_COUNT_KEY, &card_count);
+    if (card_count > CARD_INDEX_MAX_SLOT + 1) {
+        card_count = CARD_INDEX_MAX_SLOT + 1;
+    }
+
+    esp_err_t ret = card_table_reserve(card_count);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    s_slot_count = card_count;
+
+    uint32_t version = 0;
+    storage_get_u32(s_store, DB_VERSION_KEY, &version);
+    if (version < DB_VERSION) {
+        card_snapshot_invalidate();
+        return database_migrate_legacy(card_count);
+    }
+
+#if CARD_USE_SNAPSHOT
+    ret = card_table_load_snapshot(card_count);
+    if (ret == ESP_OK) {
+        s_names_loaded = true;
+        return ESP_OK;
+    }
+    if (ret != ESP_ERR_INVALID_STATE) {
+        printf("Fotografia dos índices inutilizável (%s), leitura completa\n", esp_err_to_name(ret));
+        card_snapshot_invalidate();
+    }
+#endif
+
+    // Slots da lista livre não têm registro: marcados vazios sem leitura
+    if (card_count > 0) {
+        memset(s_cards, 0, card_count * sizeof(card_hot_t));
+    }
+    size_t free_size = 0;
+    uint16_t *free_slots = NULL;
+    if (storage_get(s_store, FREE_SLOTS_KEY, NULL, &free_size) == ESP_OK && free_size > 0) {
+        free_slots = malloc(free_size);
+        if (free_slots && storage_get(s_store, FREE_SLOTS_KEY, free_slots, &free_size) == ESP_OK) {
+            for (size_t i = 0; i < free_size / sizeof(uint16_t); i++) {
+                if (free_slots[i] < card_count) {
+                    s_cards[free_slots[i]].uid_len = 0xFF; // marcador temporário
+                }
+            }
+        }
+        free(free_slots);
+    }
+    for (uint32_t i = 0; i < card_count; i++) {
+        if (s_cards[i].uid_len == 0xFF) {
+            s_cards[i].uid_len = 0;
+        } else {
+            card_read_hot(i);
+        }
+    }
+    return ESP_OK;
+}
+
+#if DATABASE_STORAGE_MMAP
+static bool card_nvs_cold(uint16_t slot, uint32_t *first_seen, const char **name, void *ctx) {
+    char *scratch = (char *)ctx;
+    if (!card_read_cold_nvs(slot, first_seen, scratch, MAX_NAME_LENGTH)) {
+        return false;
+    }
+    *name = scratch;
+    return true;
+}
+
+// Tabela mapeada; na primeira execução importa os cartões do NVS
+static esp_err_t card_table_load_mmap(void) {
+    esp_err_t ret = card_mmap_init(NULL, NULL);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // Contadores quentes continuam em RAM; só os slots até o último vivo
+    uint32_t slot_count = 0;
+    for (uint32_t i = 0; i < card_mmap_slot_capacity(); i++) {
+        if (card_mmap_get((uint16_t)i)) {
+            slot_count = i + 1;
+        }
+    }
+    ret = card_table_reserve(slot_count);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    for (uint32_t i = 0; i < slot_count; i++) {
+        const card_mmap_record_t *rec = card_mmap_get((uint16_t)i);
+        if (rec) {
+            s_cards[i] = rec->hot;
+        } else {
+            memset(&s_cards[i], 0, sizeof(card_hot_t));
+        }
+    }
+    s_slot_count = slot_count;
+    if (s_slot_count > 0) {
+        return ESP_OK;
+    }
+
+    ret = card_table_load_nvs();
+    if (ret != ESP_OK || s_slot_count == 0) {
+        return ret;
+    }
+    printf("Importando %" PRIu32 " slots do NVS para a tabela mapeada\n", s_slot_count);
+    char scratch[MAX_NAME_LENGTH];
+    return card_mmap_compact(s_cards, s_slot_count, card_nvs_cold, scratch);
+}
+#endif
+
+// Carrega a tabela quente e monta o índice em RAM
+static esp_err_t card_table_load(void) {
+    card_query_init(&s_card_query);
+    card_view_init(&s_card_view);
+    s_access_total = 0;
+#if DATABASE_STORAGE_MMAP
+    esp_err_t ret = card_table_load_mmap();
+#else
+    esp_err_t ret = card_table_load_nvs();
+#endif
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    ret = card_index_init(&s_card_index, s_slot_count);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    for (uint32_t i = 0; i < s_slot_count; i++) {
+        if (s_cards[i].uid_len == 0) {
+            continue;
+        }
+        card_uid_key_t key = { .uid_len = s_cards[i].uid_len };
+        memcpy(key.uid, s_cards[i].uid, key.uid_len);
+        if (card_index_find(&s_card_index, card_uid_hash(&key), card_slot_matches, &key, NULL)) {
+            // Compactação interrompida: a cópia no slot mais alto é a origem
+            card_persist_delete(i);
+            memset(&s_cards[i], 0, sizeof(card_hot_t));
+            continue;
+        }
+        ret = card_index_insert(&s_card_index, card_uid_hash(&key), (uint16_t)i);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    card_trim_tail();
+    ret = card_free_rebuild();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // Índices secundários: nomes vêm da fotografia ou do registro frio (uma
+    // leitura por cartão)
+    char name[MAX_NAME_LENGTH];
+    card_query_bulk_begin(&s_card_query);
+    for (uint32_t i = 0; i < s_slot_count; i++) {
+        if (s_cards[i].uid_len == 0) {
+            continue;
+        }
+        uint32_t first_seen = 0;
+        const char *card_name = name;
+        if (s_names_loaded) {
+            memcpy(name, s_card_query.name_keys[i], CARD_QUERY_NAME_KEY_LEN);
+            name[CARD_QUERY_NAME_KEY_LEN] = '\0';
+        } else {
+            card_name = "";
+            card_cold_view(i, &first_seen, &card_name, name, sizeof(name));
+        }
+        card_query_add(&s_card_query, s_cards, (uint16_t)i, card_name);
+        s_access_total += s_cards[i].access_count;
+    }
+    card_query_bulk_end(&s_card_query, s_cards);
+
+    // Folga de 1/4 para cadastros sem recriar o filtro (que cresce sozinho)
+    ret = card_filter_rebuild(s_card_index.count + s_card_index.count / 4);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = card_view_rebuild(&s_card_view, s_cards, s_slot_count);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    printf("Tabela de cartões carregada: %" PRIu32 " cartões (%u bytes em RAM, filtro %" PRIu32 " bytes, índices %" PRIu32 " bytes, visão %" PRIu32 " bytes)\n",
+           s_card_index.count, (unsigned)(s_slot_capacity * sizeof(card_hot_t)),
+           card_filter_memory(&s_card_filter), card_query_memory(&s_card_query), s_card_view.memory_bytes);
+    return ESP_OK;
+}
+
+static void card_table_free(void) {
+#if DATABASE_STORAGE_MMAP
+    card_mmap_deinit();
+#endif
+    card_snapshot_close();
+    s_names_loaded = false;
+    card_view_free(&s_card_view);
+    card_index_free(&s_card_index);
+    card_filter_free(&s_card_filter);
+    card_query_free(&s_card_query);
+    free(s_free_slots);
+    s_free_slots = NULL;
+    s_free_count = 0;
+    s_free_capacity = 0;
+    free(s_cards);
+    free(s_dirty_bits);
+    s_cards = NULL;
+    s_dirty_bits = NULL;
+    s_dirty_count = 0;
+    s_slot_count = 0;
+    s_slot_capacity = 0;
+}
 
 esp_err_t database_init(void) {
     esp_err_t ret;
     
-    // Inicializar NVS
+    // Inicializar NVS (também usado pelo Wi-Fi, qualquer que seja o backend)
     ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
         ESP_ERROR_CHECK(nvs_flash_erase());
         ret = nvs_flash_init();
     }
-    ESP_ERROR_CHECK(ret);
+    ESP_ERROR_CHECK(ret);
+
+#if DATABASE_STORAGE_BACKEND == 1
+    return database_init_with_backend(storage_raw_backend(STORAGE_RAW_PARTITION_LABEL));
+#elif DATABASE_STORAGE_BACKEND == 2
+    // Uma instância só: sem arquivo o conteúdo em RAM sobrevive a close/init
+    static const storage_backend_t *s_file_store = NULL;
+    if (!s_file_store) {
+        s_file_store = storage_file_backend(DATABASE_STORAGE_FILE_PATH);
+    }
+    return database_init_with_backend(s_file_store);
+#elif DATABASE_STORAGE_SHARDS >= 1
+    _Static_assert(DATABASE_STORAGE_SHARDS <= STORAGE_SHARD_MAX, "DATABASE_STORAGE_SHARDS > STORAGE_SHARD_MAX");
+    const storage_backend_t *shards[DATABASE_STORAGE_SHARDS];
+    for (unsigned i = 0; i < DATABASE_STORAGE_SHARDS; i++) {
+        char label[16];
+        snprintf(label, sizeof(label), DATABASE_STORAGE_SHARD_LABEL, i);
+        shards[i] = storage_nvs_partition_backend(label);
+    }
+    // Banco antigo na partição padrão é migrado para os shards
+    return database_init_with_backend(storage_shard_backend(shards, DATABASE_STORAGE_SHARDS,
+                                                            storage_nvs_backend()));
+#else
+    return database_init_with_backend(storage_nvs_backend());
+#endif
+}
+
+esp_err_t database_init_with_backend(const storage_backend_t *backend) {
+    esp_err_t ret;
+
+    if (!backend) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int64_t start = esp_timer_get_time();
+#if DATABASE_JOURNAL
+    // Registros pendentes são refeitos no open, antes de carregar a tabela
+    backend = storage_journal_backend(backend);
+#endif
+    if (!s_db_mutex) {
+        s_db_mutex = xSemaphoreCreateRecursiveMutex();
+        if (!s_db_mutex) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    
+    // Abrir namespace do banco
+    ret = backend->open(backend->ctx, "rfid_storage");
+    if (ret != ESP_OK) {
+        printf("Erro ao abrir armazenamento %s: %s\n", backend->name, esp_err_to_name(ret));
+        return ret;
+    }
+    s_store = backend;
+
+#if CARD_USE_SNAPSHOT
+    ret = card_snapshot_open(s_store);
+    if (ret != ESP_OK && ret != ESP_ERR_NOT_FOUND) {
+        printf("Fotografia dos índices descartada: %s\n", esp_err_to_name(ret));
+    }
+#endif
+    
+    // Carregar tabela quente e construir índice em RAM
+    ret = card_table_load();
+    if (ret != ESP_OK) {
+        printf("Erro ao carregar tabela de cartões: %s\n", esp_err_to_name(ret));
+        card_table_free();
+        s_store->close(s_store->ctx);
+        return ret;
+    }
+    
+    // Estatísticas por hora/dia; refeitas do log logo abaixo
+    if (access_stats_init() != ESP_OK) {
+        printf("Estatísticas de acesso indisponíveis\n");
+    }
+    
+    // Log de acesso na partição dedicada; sem ela o sistema segue sem logs
+    ret = access_log_init();
+    if (ret != ESP_OK) {
+        printf("Log de acesso indisponível: %s\n", esp_err_to_name(ret));
+    } else {
+        database_drop_legacy_logs();
+        database_stats_replay();
+    }
+    
+    // Task de flush do cache write-back
+    memset(&s_cache_stats, 0, sizeof(s_cache_stats));
+    if (!s_flush_done) {
+        s_flush_done = xSemaphoreCreateBinary();
+    }
+    s_flush_stop = false;
+    if (!s_flush_done ||
+        xTaskCreate(database_flush_task, "db_flush", 3072, NULL, 2, &s_flush_task) != pdPASS) {
+        printf("Erro ao criar task de flush\n");
+        card_table_free();
+        s_store->close(s_store->ctx);
+        return ESP_ERR_NO_MEM;
+    }
+    esp_register_shutdown_handler(database_shutdown_handler);
+    
+    s_ready_ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+    printf("Banco de dados inicializado com sucesso (backend %s, %" PRIu32 " ms)\n", s_store->name, s_ready_ms);
+    return ESP_OK;
+}
+
+esp_err_t database_close(void) {
+    esp_unregister_shutdown_handler(database_shutdown_handler);
+    if (s_flush_task) {
+        s_flush_stop = true;
+        xTaskNotifyGive(s_flush_task);
+        xSemaphoreTake(s_flush_done, portMAX_DELAY);
+        s_flush_task = NULL;
+    }
+    
+    // Gravar contadores pendentes e a fotografia antes de fechar
+    DB_LOCK();
+    card_flush_locked();
+    while (card_snapshot_step_locked()) {
+    }
+    card_table_free();
+    DB_UNLOCK();
+    access_log_deinit();
+    access_stats_deinit();
+    s_store->close(s_store->ctx);
+    printf("Banco de dados fechado\n");
+    return ESP_OK;
+}
+
+// Grava um cartão novo (UID já verificado como inexistente)
+static esp_err_t card_insert_locked(const card_uid_key_t *key, const char *name, uint8_t access_level,
+                                    uint32_t first_seen, uint32_t last_seen, uint32_t access_count) {
+    // Reusar um slot livre (O(1)); senão estender o intervalo em uso.
+    // Importação e transação só acrescentam no fim: card_count é gravado
+    // no commit, o que torna o lote invisível após uma queda.
+    txn_op_t *op = txn_reserve_op();
+    if (s_txn.active && !op) {
+        return ESP_ERR_NO_MEM; // transação cheia
+    }
+    bool reused = s_free_count > 0 && !card_batch_active();
+    uint32_t slot = reused ? s_free_slots[s_free_count - 1] : s_slot_count;
+#if DATABASE_STORAGE_MMAP
+    if (!reused && slot >= card_mmap_slot_capacity()) {
+#else
+    if (!reused && slot > CARD_INDEX_MAX_SLOT) {
+#endif
+        printf("Limite de slots de cartões atingido\n");
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t ret = card_table_reserve(slot + 1);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    // Criar novo registro e indexar antes de gravar: o que pode falhar em RAM
+    // falha com o armazenamento intacto; depois do commit nada mais falha
+    card_hot_t *card = &s_cards[slot];
+    memset(card, 0, sizeof(*card));
+    memcpy(card->uid, key->uid, key->uid_len);
+    card->uid_len = key->uid_len;
+    card->access_level = access_level;
+    card->last_seen = last_seen;
+    card->access_count = access_count;
+    ret = card_index_insert(&s_card_index, card_uid_hash(key), (uint16_t)slot);
+    if (ret != ESP_OK) {
+        printf("Erro ao indexar cartão: %s\n", esp_err_to_name(ret));
+        card->uid_len = 0;
+        return ret;
+    }
+    
+    // Fora de lote o cartão e card_count/lista livre vão num registro só do
+    // journal; a importação grava direto (slots além de card_count)
+    bool journaled = !s_import_active && card_journal_begin();
+    if (reused) {
+        s_free_count--;
+        ret = card_persist_slots(); // tirar da lista antes de gravar no slot
+        if (ret != ESP_OK) {
+            s_free_count++;
+            if (journaled) {
+                storage_journal_abort();
+            }
+            card_index_remove(&s_card_index, card_uid_hash(key), card_slot_matches, (void *)key);
+            card->uid_len = 0;
+            return ret;
+        }
+    }
+    
+    // Salvar registros quente e frio; em lote o commit é feito no fim
+    ret = card_persist_new(slot, first_seen, name);
+    if (ret == ESP_OK && !card_batch_active()) {
+        ret = card_persist_commit();
+    }
+    if (ret != ESP_OK) {
+        printf("Erro ao salvar cartão: %s\n", esp_err_to_name(ret));
+        if (journaled) {
+            storage_journal_abort(); // sem efeito se o commit já fechou o grupo
+        }
+        card_index_remove(&s_card_index, card_uid_hash(key), card_slot_matches, (void *)key);
+        card->uid_len = 0;
+        if (reused) {
+            card_free_push((uint16_t)slot);
+        }
+        return ret;
+    }
+    if (!reused) {
+        s_slot_count = slot + 1;
+    }
+    if (op) {
+        op->type = TXN_OP_ADD;
+        op->slot = (uint16_t)slot;
+        s_txn.op_count++;
+    }
+    
+    if (!card_batch_active()) {
+        card_view_put(&s_card_view, key->uid, key->uid_len, access_level);
+    }
+    card_query_add(&s_card_query, s_cards, (uint16_t)slot, name);
+    s_access_total += access_count;
+    card_filter_add(card_uid_hash(key));
+    return ESP_OK;
+}
+
+static esp_err_t card_add_locked(const char *uid, const char *name, uint8_t access_level) {
+    if (!uid || !name) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (s_import_active) {
+        return ESP_ERR_INVALID_STATE; // a importação só acrescenta; cadastrar depois do end
+    }
+    
+    card_uid_key_t key;
+    if (card_uid_parse(uid, key.uid, &key.uid_len) != ESP_OK) {
+        printf("UID inválido: %s\n", uid);
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    // Verificar se cartão já existe
+    if (card_find_slot(&key, NULL)) {
+        printf("Cartão %s já existe\n", uid);
+        return ESP_FAIL; // Mudado de ESP_ERR_DUPLICATE_KEY para ESP_FAIL
+    }
+    
+    uint32_t now = (uint32_t)time(NULL);
+    esp_err_t ret = card_insert_locked(&key, name, access_level, now, now, 0);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    printf("Cartão adicionado: %s - %s\n", uid, name);
+    return ESP_OK;
+}
+
+esp_err_t database_add_card(const char *uid, const char *name, uint8_t access_level) {
+    DB_LOCK();
+    esp_err_t ret = card_add_locked(uid, name, access_level);
+    DB_UNLOCK();
+    return ret;
+}
+
+static esp_err_t card_update_access_locked(const char *uid) {
+    if (!uid) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    card_uid_key_t key;
+    uint16_t slot;
+    if (card_uid_parse(uid, key.uid, &key.uid_len) != ESP_OK || !card_find_slot(&key, &slot)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    
+    txn_op_t *op = txn_reserve_op();
+    if (s_txn.active && !op) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (op) {
+        op->type = TXN_OP_UPDATE;
+        op->slot = slot;
+        op->before = s_cards[slot];
+        s_txn.op_count++;
+    }
+    
+    // Atualizar informações de acesso (gravadas no próximo flush)
+    s_cards[slot].last_seen = (uint32_t)time(NULL);
+    s_cards[slot].access_count++;
+    s_access_total++;
+    card_mark_dirty(slot);
+    card_query_touch(&s_card_query, s_cards, slot);
+    
+    if (s_dirty_count >= DATABASE_FLUSH_DIRTY_THRESHOLD && s_flush_task) {
+        xTaskNotifyGive(s_flush_task);
+    }
+    
+    return ESP_OK;
+}
+
+esp_err_t database_import_begin(void) {
+    if (!s_db_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    DB_LOCK();
+    if (s_import_active || s_txn.active) {
+        DB_UNLOCK();
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_import_active = true;
+    s_import_base = s_slot_count;
+    card_query_bulk_begin(&s_card_query); // ordenado uma vez em import_end
+    memset(&s_import_stats, 0, sizeof(s_import_stats));
+    s_import_start_us = esp_timer_get_time();
+    DB_UNLOCK();
+    return ESP_OK;
+}
+
+esp_err_t database_import_add(const rfid_record_t *record) {
+    if (!record) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    // Lock por registro: rfid_task continua atendendo durante a importação
+    DB_LOCK();
+    if (!s_import_active) {
+        DB_UNLOCK();
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    card_uid_key_t key;
+    if (card_uid_parse(record->uid, key.uid, &key.uid_len) != ESP_OK) {
+        s_import_stats.invalid++;
+        DB_UNLOCK();
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (card_find_slot(&key, NULL)) {
+        s_import_stats.duplicates++;
+        DB_UNLOCK();
+        return ESP_OK; // duplicado não interrompe o lote
+    }
+    
+    uint32_t now = (uint32_t)time(NULL);
+    uint32_t first_seen = record->first_seen ? (uint32_t)record->first_seen : now;
+    uint32_t last_seen = record->last_seen ? (uint32_t)record->last_seen : first_seen;
+    esp_err_t ret = card_insert_locked(&key, record->name, record->access_level,
+                                       first_seen, last_seen, record->access_count);
+    if (ret == ESP_OK) {
+        s_import_stats.imported++;
+    }
+    DB_UNLOCK();
+    return ret;
+}
+
+esp_err_t database_import_end(database_import_stats_t *stats) {
+    DB_LOCK();
+    if (!s_import_active) {
+        DB_UNLOCK();
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    // Único commit do lote: card_count passa a incluir os novos slots
+    card_journal_begin();
+    esp_err_t ret = card_persist_slots();
+    if (ret == ESP_OK) {
+        ret = card_persist_commit();
+    }
+    s_import_active = false;
+    card_query_bulk_end(&s_card_query, s_cards);
+    card_view_rebuild(&s_card_view, s_cards, s_slot_count);
+    
+    int64_t elapsed_us = esp_timer_get_time() - s_import_start_us;
+    s_import_stats.elapsed_ms = (uint32_t)(elapsed_us / 1000);
+    s_import_stats.records_per_sec = elapsed_us > 0 ?
+        (uint32_t)((uint64_t)s_import_stats.imported * 1000000 / (uint64_t)elapsed_us) : 0;
+    if (stats) {
+        *stats = s_import_stats;
+    }
+    DB_UNLOCK();
+    
+    printf("Importação: %" PRIu32 " cartões, %" PRIu32 " duplicados, %" PRIu32 " inválidos em %" PRIu32 " ms (%" PRIu32 " registros/s)\n",
+           s_import_stats.imported, s_import_stats.duplicates, s_import_stats.invalid,
+           s_import_stats.elapsed_ms, s_import_stats.records_per_sec);
+    return ret;
+}
+
+void database_import_abort(void) {
+    if (!s_db_mutex) {
+        return;
+    }
+    DB_LOCK();
+    if (!s_import_active) {
+        DB_UNLOCK();
+        return;
+    }
+    
+    // Os cartões do lote estão todos a partir de s_import_base e fora de
+    // card_count: apagar as chaves gravadas e voltar ao intervalo anterior
+    s_import_active = false;
+    card_query_bulk_end(&s_card_query, s_cards);
+    card_journal_begin();
+    for (uint32_t slot = s_slot_count; slot-- > s_import_base;) {
+        card_hot_t *card = &s_cards[slot];
+        if (card->uid_len == 0) {
+            continue;
+        }
+        card_uid_key_t key;
+        key.uid_len = card->uid_len;
+        memcpy(key.uid, card->uid, key.uid_len);
+        card_persist_delete(slot);
+        if (card_index_remove(&s_card_index, card_uid_hash(&key), card_slot_matches, &key)) {
+            card_filter_remove(&s_card_filter, card_uid_hash(&key));
+        }
+        card_query_remove(&s_card_query, s_cards, (uint16_t)slot);
+        s_access_total -= card->access_count;
+        card_clear_dirty(slot);
+        memset(card, 0, sizeof(*card));
+    }
+    s_slot_count = s_import_base;
+    card_free_drop_from(s_slot_count);
+    esp_err_t ret = card_persist_slots();
+    if (ret == ESP_OK) {
+        ret = card_persist_commit();
+    }
+    DB_UNLOCK();
+    
+    printf("Importação desfeita: %" PRIu32 " cartões descartados (%s)\n",
+           s_import_stats.imported, esp_err_to_name(ret));
+}
+
+void database_compact_pause(void) {
+    if (!s_db_mutex) {
+        return;
+    }
+    DB_LOCK();
+    s_compact_pauses++;
+    DB_UNLOCK();
+}
+
+void database_compact_resume(void) {
+    if (!s_db_mutex) {
+        return;
+    }
+    DB_LOCK();
+    if (s_compact_pauses > 0) {
+        s_compact_pauses--;
+    }
+    DB_UNLOCK();
+}
+
+esp_err_t database_update_card_access(const char *uid) {
+    DB_LOCK();
+    esp_err_t ret = card_update_access_locked(uid);
+    DB_UNLOCK();
+    return ret;
+}
+
+static esp_err_t card_lookup_locked(const char *uid, card_hot_t *card) {
+    if (!uid || !card) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    card_uid_key_t key;
+    uint16_t slot;
+    if (card_uid_parse(uid, key.uid, &key.uid_len) != ESP_OK || !card_find_slot(&key, &slot)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    
+    *card = s_cards[slot];
+    return ESP_OK;
+}
+
+esp_err_t database_lookup_card(const char *uid, card_hot_t *card) {
+    DB_LOCK();
+    esp_err_t ret = card_lookup_locked(uid, card);
+    DB_UNLOCK();
+    return ret;
+}
+
+esp_err_t database_lookup_access(const char *uid, uint8_t *access_level) {
+    if (!uid || !access_level) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    card_uid_key_t key;
+    if (card_uid_parse(uid, key.uid, &key.uid_len) != ESP_OK) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    esp_err_t ret = card_view_lookup(&s_card_view, key.uid, key.uid_len, access_level);
+    if (ret != ESP_ERR_INVALID_STATE) {
+        return ret;
+    }
+
+    // Visão desatualizada (cópia sem memória): consulta com lock
+    card_hot_t card;
+    DB_LOCK();
+    s_view_fallbacks++;
+    ret = card_lookup_locked(uid, &card);
+    DB_UNLOCK();
+    if (ret == ESP_OK) {
+        *access_level = card.access_level;
+    }
+    return ret;
+}
+
+static esp_err_t card_get_locked(const char *uid, rfid_record_t *record) {
+    if (!uid || !record) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    card_uid_key_t key;
+    uint16_t slot;
+    if (card_uid_parse(uid, key.uid, &key.uid_len) != ESP_OK || !card_find_slot(&key, &slot)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    
+    card_fill_record(slot, record, true);
+    return ESP_OK;
+}
+
+esp_err_t database_get_card(const char *uid, rfid_record_t *record) {
+    DB_LOCK();
+    esp_err_t ret = card_get_locked(uid, record);
+    DB_UNLOCK();
+    return ret;
+}
+
+static esp_err_t card_delete_locked(const char *uid) {
+    if (!uid) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_import_active) {
+        return ESP_ERR_INVALID_STATE; // database_import_abort desfaz só o que a importação acrescentou
+    }
+    
+    card_uid_key_t key;
+    uint16_t slot;
+    if (card_uid_parse(uid, key.uid, &key.uid_len) != ESP_OK || !card_find_slot(&key, &slot)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    
+    // Na transação guardar o registro completo para o abort
+    txn_op_t *op = txn_reserve_op();
+    if (s_txn.active && !op) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (op) {
+        const char *name = "";
+        op->type = TXN_OP_DELETE;
+        op->slot = slot;
+        op->before = s_cards[slot];
+        op->first_seen = 0;
+        card_cold_view(slot, &op->first_seen, &name, op->name, sizeof(op->name));
+        if (name != op->name) {
+            strncpy(op->name, name, sizeof(op->name) - 1);
+            op->name[sizeof(op->name) - 1] = '\0';
+        }
+    }
+    
+    bool journaled = card_journal_begin();
+    esp_err_t ret = card_persist_delete(slot);
+    if (ret != ESP_OK) {
+        printf("Erro ao deletar cartão: %s\n", esp_err_to_name(ret));
+        if (journaled) {
+            storage_journal_abort();
+        }
+        return ret;
+    }
+    if (op) {
+        s_txn.op_count++;
+    }
+    
+    card_index_remove(&s_card_index, card_uid_hash(&key), card_slot_matches, &key);
+    card_filter_remove(&s_card_filter, card_uid_hash(&key));
+    if (!card_batch_active()) {
+        card_view_remove(&s_card_view, key.uid, key.uid_len);
+    }
+    card_query_remove(&s_card_query, s_cards, slot);
+    s_access_total -= s_cards[slot].access_count;
+    card_clear_dirty(slot);
+    memset(&s_cards[slot], 0, sizeof(card_hot_t));
+    
+    // Slot volta para a lista livre; a compactação fecha o buraco depois
+    ret = card_free_push(slot);
+    if (ret == ESP_OK) {
+        ret = card_persist_slots();
+    }
+    if (!card_batch_active()) {
+        // Mesmo sem a lista livre o apagamento precisa chegar ao flash
+        esp_err_t commit_ret = card_persist_commit();
+        if (ret == ESP_OK) {
+            ret = commit_ret;
+        }
+    }
+    if (ret != ESP_OK) {
+        printf("Erro ao commit: %s\n", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    printf("Cartão deletado: %s\n", uid);
+    return ESP_OK;
+}
+
+esp_err_t database_delete_card(const char *uid) {
+    DB_LOCK();
+    esp_err_t ret = card_delete_locked(uid);
+    DB_UNLOCK();
+    return ret;
+}
+
+static void card_free_remove(uint16_t slot) {
+    for (uint32_t i = 0; i < s_free_count; i++) {
+        if (s_free_slots[i] == slot) {
+            s_free_slots[i] = s_free_slots[--s_free_count];
+            return;
+        }
+    }
+}
+
+// Desfaz as mutações da transação em ordem inversa. No abort o grupo da
+// transação ainda está aberto e o commit final grava só o estado anterior;
+// após um commit com erro as regravações formam um grupo novo.
+static void txn_rollback_locked(void) {
+    card_journal_begin();
+    while (s_txn.op_count > 0) {
+        txn_op_t *op = &s_txn.ops[--s_txn.op_count];
+        card_hot_t *card = &s_cards[op->slot];
+        card_uid_key_t key;
+        
+        switch (op->type) {
+        case TXN_OP_ADD:
+            key.uid_len = card->uid_len;
+            memcpy(key.uid, card->uid, key.uid_len);
+            card_persist_delete(op->slot);
+            if (card_index_remove(&s_card_index, card_uid_hash(&key), card_slot_matches, &key)) {
+                card_filter_remove(&s_card_filter, card_uid_hash(&key));
+            }
+            card_query_remove(&s_card_query, s_cards, op->slot);
+            s_access_total -= card->access_count;
+            card_clear_dirty(op->slot);
+            memset(card, 0, sizeof(*card));
+            card_free_push(op->slot);
+            break;
+            
+        case TXN_OP_UPDATE:
+            s_access_total -= card->access_count - op->before.access_count;
+            *card = op->before;
+            card_query_touch(&s_card_query, s_cards, op->slot);
+            break;
+            
+        case TXN_OP_DELETE:
+            // Tirar da lista livre antes de regravar o slot
+            card_free_remove(op->slot);
+            card_persist_slots();
+            *card = op->before;
+            card_persist_new(op->slot, op->first_seen, op->name);
+            key.uid_len = card->uid_len;
+            memcpy(key.uid, card->uid, key.uid_len);
+            card_index_insert(&s_card_index, card_uid_hash(&key), op->slot);
+            card_filter_add(card_uid_hash(&key));
+            card_query_add(&s_card_query, s_cards, op->slot, op->name);
+            s_access_total += card->access_count;
+            break;
+        }
+    }
+    card_trim_tail();
+    card_persist_slots();
+    card_persist_commit();
+}
+
+// Leva à visão sem lock os cadastros e remoções da transação, na ordem
+static void txn_publish_locked(void) {
+    for (uint32_t i = 0; i < s_txn.op_count; i++) {
+        const txn_op_t *op = &s_txn.ops[i];
+        if (op->type == TXN_OP_ADD) {
+            const card_hot_t *card = &s_cards[op->slot];
+            card_view_put(&s_card_view, card->uid, card->uid_len, card->access_level);
+        } else if (op->type == TXN_OP_DELETE) {
+            card_view_remove(&s_card_view, op->before.uid, op->before.uid_len);
+        }
+    }
+}
+
+static void txn_finish_locked(void) {
+    s_txn.active = false;
+    s_txn.op_count = 0;
+    s_txn.log_count = 0;
+}
+
+esp_err_t database_txn_begin(void) {
+    if (!s_db_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    DB_LOCK();
+    if (s_txn.active || s_import_active) {
+        DB_UNLOCK();
+        return ESP_ERR_INVALID_STATE; // sem transações aninhadas
+    }
+    txn_finish_locked();
+    s_txn.active = true;
+    card_journal_begin(); // fechado no commit: a transação é um registro só
+    return ESP_OK; // lock mantido até commit/abort
+}
+
+esp_err_t database_txn_commit(void) {
+    if (!s_db_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    DB_LOCK();
+    if (!s_txn.active) {
+        DB_UNLOCK();
+        return ESP_ERR_INVALID_STATE;
+    }
     
-    // Abrir namespace NVS
-    ret = nvs_open("rfid_storage", NVS_READWRITE, &nvs_database_handle);
+    // Único commit: card_count/lista livre + registros gravados na transação
+    esp_err_t ret = card_persist_slots();
+    if (ret == ESP_OK) {
+        ret = card_persist_commit();
+    }
     if (ret != ESP_OK) {
-        printf("Erro ao abrir NVS: %s\n", esp_err_to_name(ret));
-        return ret;
+        printf("Erro no commit da transação: %s\n", esp_err_to_name(ret));
+        txn_rollback_locked();
+    } else {
+        txn_publish_locked();
+        for (uint32_t i = 0; i < s_txn.log_count; i++) {
+            database_log_event(s_txn.logs[i].uid, s_txn.logs[i].action, s_txn.logs[i].timestamp);
+        }
+        if (s_dirty_count >= DATABASE_FLUSH_DIRTY_THRESHOLD && s_flush_task) {
+            xTaskNotifyGive(s_flush_task);
+        }
     }
-    
-    printf("Banco de dados NVS inicializado com sucesso\n");
-    return ESP_OK;
+    txn_finish_locked();
+    DB_UNLOCK();    // deste commit
+    DB_UNLOCK();    // de database_txn_begin
+    return ret;
 }
 
-esp_err_t database_close(void) {
-    nvs_close(nvs_database_handle);
-    printf("Banco de dados fechado\n");
-    return ESP_OK;
+void database_txn_abort(void) {
+    if (!s_db_mutex) {
+        return;
+    }
+    DB_LOCK();
+    if (!s_txn.active) {
+        DB_UNLOCK();
+        return;
+    }
+    txn_rollback_locked();
+    txn_finish_locked();
+    DB_UNLOCK();
+    DB_UNLOCK();
 }
 
-esp_err_t database_add_card(const char *uid, const char *name, uint8_t access_level) {
-    if (!uid || !name) {
+static esp_err_t card_get_all_locked(rfid_record_t **records, int *count) {
+    if (!records || !count) {
         return ESP_ERR_INVALID_ARG;
     }
-      // Verificar se cartão já existe
-    rfid_record_t existing_card;
-    if (database_get_card(uid, &existing_card) == ESP_OK) {
-        printf("Cartão %s já existe\n", uid);
-        return ESP_FAIL; // Mudado de ESP_ERR_DUPLICATE_KEY para ESP_FAIL
-    }
     
-    // Obter contagem atual de cartões
-    uint32_t card_count = 0;
-    nvs_get_u32(nvs_database_handle, CARD_COUNT_KEY, &card_count);
-      // Criar novo registro
-    rfid_record_t new_card = {0};
-    new_card.id = card_count + 1;
-    strncpy(new_card.uid, uid, MAX_UID_LENGTH - 1);
-    strncpy(new_card.name, name, MAX_NAME_LENGTH - 1);
-    new_card.access_level = access_level;
-    new_card.first_seen = time(NULL);
-    new_card.last_seen = time(NULL);
-    new_card.access_count = 0;
-      // Salvar cartão no NVS usando índice numérico
-    char key[32];
-    snprintf(key, sizeof(key), "%s%" PRIu32, CARD_PREFIX, card_count);
-    esp_err_t ret = nvs_set_blob(nvs_database_handle, key, &new_card, sizeof(new_card));
-    if (ret != ESP_OK) {
-        printf("Erro ao salvar cartão: %s\n", esp_err_to_name(ret));
-        return ret;
+    *records = NULL;
+    *count = 0;
+    if (s_card_index.count == 0) {
+        return ESP_OK;
     }
     
-    // Atualizar contagem
-    card_count++;
-    ret = nvs_set_u32(nvs_database_handle, CARD_COUNT_KEY, card_count);
-    if (ret != ESP_OK) {
-        printf("Erro ao atualizar contagem: %s\n", esp_err_to_name(ret));
-        return ret;
+    // Alocar memória para os registros
+    *records = malloc(s_card_index.count * sizeof(rfid_record_t));
+    if (!*records) {
+        printf("Erro ao alocar memória para %" PRIu32 " cartões\n", s_card_index.count);
+        return ESP_ERR_NO_MEM;
     }
     
-    // Commit mudanças
-    ret = nvs_commit(nvs_database_handle);
-    if (ret != ESP_OK) {
-        printf("Erro ao commit: %s\n", esp_err_to_name(ret));
-        return ret;
+    int valid_cards = 0;
+    for (uint32_t i = 0; i < s_slot_count && valid_cards < (int)s_card_index.count; i++) {
+        if (s_cards[i].uid_len == 0) {
+            continue;
+        }
+        card_fill_record(i, &(*records)[valid_cards], true);
+        valid_cards++;
     }
     
-    printf("Cartão adicionado: %s - %s\n", uid, name);
+    *count = valid_cards;
+    printf("Recuperados %d cartões do NVS\n", valid_cards);
     return ESP_OK;
 }
 
-esp_err_t database_update_card_access(const char *uid) {
-    if (!uid) {
+esp_err_t database_get_all_cards(rfid_record_t **records, int *count) {
+    DB_LOCK();
+    esp_err_t ret = card_get_all_locked(records, count);
+    DB_UNLOCK();
+    return ret;
+}
+
+esp_err_t database_foreach_card(database_card_cb_t cb, void *ctx) {
+    if (!cb) {
         return ESP_ERR_INVALID_ARG;
     }
     
-    // Buscar cartão existente
-    rfid_record_t card;
-    esp_err_t ret = database_get_card(uid, &card);
-    if (ret != ESP_OK) {
-        return ret;
+    char name[MAX_NAME_LENGTH];
+    DB_LOCK();
+    for (uint32_t i = 0; i < s_slot_count; i++) {
+        if (s_cards[i].uid_len == 0) {
+            continue;
+        }
+        database_card_view_t view = { .hot = &s_cards[i], .name = "", .first_seen = 0 };
+        card_cold_view(i, &view.first_seen, &view.name, name, sizeof(name));
+        if (!cb(&view, ctx)) {
+            break;
+        }
     }
-      // Atualizar informações de acesso
-    card.last_seen = time(NULL);
-    card.access_count++;
-    
-    // Buscar a chave correta do cartão no NVS
-    uint32_t card_count = 0;
-    esp_err_t ret2 = nvs_get_u32(nvs_database_handle, CARD_COUNT_KEY, &card_count);
-    if (ret2 != ESP_OK) {
-        return ret2;
+    DB_UNLOCK();
+    return ESP_OK;
+}
+
+// Confere os critérios que o índice escolhido não garante
+static bool card_query_matches(const database_card_query_t *query, uint32_t slot, bool check_name) {
+    const card_hot_t *card = &s_cards[slot];
+    if (query->access_level && card->access_level != query->access_level) {
+        return false;
     }
-    
-    // Buscar pelo UID para encontrar a chave correta
-    for (uint32_t i = 0; i < card_count; i++) {
-        char key[32];
-        snprintf(key, sizeof(key), "%s%" PRIu32, CARD_PREFIX, i);
-        
-        rfid_record_t temp_card;
-        size_t required_size = sizeof(rfid_record_t);
-        esp_err_t ret3 = nvs_get_blob(nvs_database_handle, key, &temp_card, &required_size);
-        if (ret3 == ESP_OK && strcmp(temp_card.uid, uid) == 0) {
-            // Encontrou o cartão, atualizar
-            ret = nvs_set_blob(nvs_database_handle, key, &card, sizeof(card));
-            if (ret != ESP_OK) {
-                printf("Erro ao atualizar cartão: %s\n", esp_err_to_name(ret));
-                return ret;
+    if (query->seen_before && card->last_seen >= query->seen_before) {
+        return false;
+    }
+    if (query->seen_after && card->last_seen < query->seen_after) {
+        return false;
+    }
+    if (check_name) {
+        // Prefixo maior que a chave do índice: confirmar no registro frio
+        char scratch[MAX_NAME_LENGTH];
+        uint32_t first_seen = 0;
+        const char *name = "";
+        card_cold_view(slot, &first_seen, &name, scratch, sizeof(scratch));
+        return card_query_name_has_prefix(name, query->name_prefix);
+    }
+    return true;
+}
+
+typedef struct {
+    const database_card_query_t *query;
+    rfid_record_t *records;
+    uint32_t max;
+    uint32_t count;
+    uint16_t last_slot;         // último entregue (cursor das listas)
+} card_query_page_t;
+
+// Retorna false quando a página está cheia
+static bool card_query_emit(card_query_page_t *page, uint32_t slot, bool check_name) {
+    if (!card_query_matches(page->query, slot, check_name)) {
+        return true;
+    }
+    card_fill_record(slot, &page->records[page->count++], true);
+    page->last_slot = (uint16_t)slot;
+    return page->count < page->max;
+}
+
+// Cursor de consulta, menor que 2^53 para passar exato por um número JSON:
+// índice usado (bits 50+) | 32 bits | 16 bits. Nome: geração do vetor |
+// próxima posição; listas por last_seen: last_seen | slot do último
+// entregue; nível e varredura: geração do layout | próximo slot.
+#define QUERY_CURSOR_SCAN       1
+#define QUERY_CURSOR_NAME       2
+#define QUERY_CURSOR_BEFORE     3
+#define QUERY_CURSOR_AFTER      4
+#define QUERY_CURSOR(kind, high, low) \
+    (((uint64_t)(kind) << 50) | ((uint64_t)(uint32_t)(high) << 16) | ((uint64_t)(low) & 0xFFFF))
+#define QUERY_CURSOR_KIND(cursor)   ((uint32_t)((cursor) >> 50))
+#define QUERY_CURSOR_HIGH(cursor)   ((uint32_t)((cursor) >> 16))
+#define QUERY_CURSOR_LOW(cursor)    ((uint16_t)((cursor) & 0xFFFF))
+
+// Próximo slot da lista depois do último entregue. A lista é ordenada por
+// (last_seen, slot): se o cartão foi tocado ou movido desde então, continua
+// pelo par guardado no cursor.
+static uint16_t card_query_list_resume(uint64_t cursor, bool oldest_first) {
+    uint16_t last = QUERY_CURSOR_LOW(cursor);
+    uint32_t last_seen = QUERY_CURSOR_HIGH(cursor);
+    if (last < s_slot_count && s_cards[last].uid_len != 0 && s_cards[last].last_seen == last_seen) {
+        return oldest_first ? s_card_query.next[last] : s_card_query.prev[last];
+    }
+    uint16_t slot;
+    if (oldest_first) {
+        slot = s_card_query.head;
+        while (slot != CARD_QUERY_NIL && (s_cards[slot].last_seen < last_seen ||
+                                          (s_cards[slot].last_seen == last_seen && slot <= last))) {
+            slot = s_card_query.next[slot];
+        }
+    } else {
+        slot = s_card_query.tail;
+        while (slot != CARD_QUERY_NIL && (s_cards[slot].last_seen > last_seen ||
+                                          (s_cards[slot].last_seen == last_seen && slot >= last))) {
+            slot = s_card_query.prev[slot];
+        }
+    }
+    return slot;
+}
+
+esp_err_t database_query_cards(const database_card_query_t *query, uint64_t *cursor,
+                               rfid_record_t *records, uint32_t max, uint32_t *count) {
+    if (!query || !cursor || !records || !count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *count = 0;
+    if (!s_db_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (max == 0) {
+        return ESP_OK;
+    }
+
+    // Índice mais seletivo: nome > last_seen > nível > varredura
+    uint32_t kind = QUERY_CURSOR_SCAN;
+    if (query->name_prefix && query->name_prefix[0]) {
+        kind = QUERY_CURSOR_NAME;
+    } else if (query->seen_before) {
+        kind = QUERY_CURSOR_BEFORE;
+    } else if (query->seen_after) {
+        kind = QUERY_CURSOR_AFTER;
+    }
+    uint64_t from = *cursor;
+    if (from != 0 && QUERY_CURSOR_KIND(from) != kind) {
+        return ESP_ERR_INVALID_ARG; // cursor de outra consulta
+    }
+
+    card_query_page_t page = { .query = query, .records = records, .max = max };
+    esp_err_t ret = ESP_OK;
+    uint64_t next = 0;
+    DB_LOCK();
+    if (s_card_query.bulk) {
+        // Importação em andamento: ordenar o que já entrou
+        card_query_bulk_end(&s_card_query, s_cards);
+        card_query_bulk_begin(&s_card_query);
+    }
+
+    if (kind == QUERY_CURSOR_NAME) {
+        bool check_name = strlen(query->name_prefix) > CARD_QUERY_NAME_KEY_LEN;
+        uint32_t first = 0;
+        uint32_t end = card_query_name_range(&s_card_query, query->name_prefix, &first);
+        end += first;
+        uint32_t i = first;
+        if (from != 0) {
+            // Cadastro/remoção desloca as posições: a geração do vetor expira o cursor
+            if (QUERY_CURSOR_HIGH(from) != s_card_query.name_generation) {
+                ret = ESP_ERR_INVALID_STATE;
+                end = first;
+            } else if (QUERY_CURSOR_LOW(from) > i) {
+                i = QUERY_CURSOR_LOW(from);
             }
-            break;
+        }
+        for (; i < end; i++) {
+            if (!card_query_emit(&page, s_card_query.by_name[i], check_name)) {
+                if (i + 1 < end) {
+                    next = QUERY_CURSOR(kind, s_card_query.name_generation, i + 1);
+                }
+                break;
+            }
+        }
+    } else if (kind == QUERY_CURSOR_BEFORE || kind == QUERY_CURSOR_AFTER) {
+        // seen_before: do mais antigo até o corte; seen_after: do mais recente
+        bool oldest_first = (kind == QUERY_CURSOR_BEFORE);
+        uint16_t slot = from ? card_query_list_resume(from, oldest_first) :
+                        (oldest_first ? s_card_query.head : s_card_query.tail);
+        while (slot != CARD_QUERY_NIL &&
+               (oldest_first ? s_cards[slot].last_seen < query->seen_before :
+                               s_cards[slot].last_seen >= query->seen_after)) {
+            if (!card_query_emit(&page, slot, false)) {
+                next = QUERY_CURSOR(kind, s_cards[slot].last_seen, slot);
+                break;
+            }
+            slot = oldest_first ? s_card_query.next[slot] : s_card_query.prev[slot];
+        }
+    } else {
+        // Nível pelo bitmap, senão todos os slots; a compactação expira o cursor
+        uint32_t slot = 0;
+        if (from != 0) {
+            if (QUERY_CURSOR_HIGH(from) != s_layout_generation) {
+                ret = ESP_ERR_INVALID_STATE;
+                slot = s_slot_count;
+            } else {
+                slot = QUERY_CURSOR_LOW(from);
+            }
+        }
+        for (;;) {
+            if (query->access_level) {
+                slot = card_query_level_next(&s_card_query, query->access_level, slot);
+            } else {
+                while (slot < s_slot_count && s_cards[slot].uid_len == 0) {
+                    slot++;
+                }
+            }
+            if (slot >= s_slot_count) {
+                break;
+            }
+            if (!card_query_emit(&page, slot, false)) {
+                if (slot + 1 < s_slot_count) {
+                    next = QUERY_CURSOR(kind, s_layout_generation, slot + 1);
+                }
+                break;
+            }
+            slot++;
         }
     }
-    
-    ret = nvs_commit(nvs_database_handle);
-    if (ret != ESP_OK) {
-        printf("Erro ao commit: %s\n", esp_err_to_name(ret));
-        return ret;
+    DB_UNLOCK();
+
+    *count = page.count;
+    *cursor = next;
+    return ret;
+}
+
+// Cursor de cartões: geração do layout (16 bits) | slot (16 bits)
+#define CARDS_CURSOR(gen, slot)   ((((gen) & 0xFFFF) << 16) | ((slot) & 0xFFFF))
+
+esp_err_t database_cards_iter_begin(database_cards_iter_t *iter, uint32_t cursor,
+                                    database_card_filter_t filter, void *ctx) {
+    if (!iter) {
+        return ESP_ERR_INVALID_ARG;
     }
+    if (!s_db_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    DB_LOCK();
+    uint32_t generation = s_layout_generation;
+    DB_UNLOCK();
     
+    memset(iter, 0, sizeof(*iter));
+    iter->generation = generation;
+    iter->filter = filter;
+    iter->filter_ctx = ctx;
+    if (cursor != 0) {
+        if ((cursor >> 16) != (generation & 0xFFFF)) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        iter->slot = cursor & 0xFFFF;
+    }
     return ESP_OK;
 }
 
-esp_err_t database_get_card(const char *uid, rfid_record_t *record) {
-    if (!uid || !record) {
+esp_err_t database_cards_iter_next(database_cards_iter_t *iter, rfid_record_t *record) {
+    if (!iter || !record) {
         return ESP_ERR_INVALID_ARG;
     }
     
-    // Obter número de cartões armazenados
-    uint32_t card_count = 0;
-    esp_err_t ret = nvs_get_u32(nvs_database_handle, CARD_COUNT_KEY, &card_count);
-    if (ret != ESP_OK || card_count == 0) {
-        return ESP_ERR_NOT_FOUND;
-    }
-    
-    // Buscar pelo UID em todos os registros
-    for (uint32_t i = 0; i < card_count; i++) {
-        char key[32];
-        snprintf(key, sizeof(key), "%s%" PRIu32, CARD_PREFIX, i);
+    for (;;) {
+        // Um cartão por vez sob o lock; o predicado roda fora dele
+        DB_LOCK();
+        if (iter->generation != s_layout_generation) {
+            DB_UNLOCK();
+            return ESP_ERR_INVALID_STATE;
+        }
+        while (iter->slot < s_slot_count && s_cards[iter->slot].uid_len == 0) {
+            iter->slot++;
+        }
+        if (iter->slot >= s_slot_count) {
+            DB_UNLOCK();
+            return ESP_ERR_NOT_FOUND;
+        }
+        card_fill_record(iter->slot, record, true);
+        iter->slot++;
+        DB_UNLOCK();
         
-        size_t required_size = sizeof(rfid_record_t);
-        ret = nvs_get_blob(nvs_database_handle, key, record, &required_size);
-        if (ret == ESP_OK && strcmp(record->uid, uid) == 0) {
-            return ESP_OK; // Encontrado!
+        if (!iter->filter || iter->filter(record, iter->filter_ctx)) {
+            return ESP_OK;
         }
     }
-    
-    return ESP_ERR_NOT_FOUND;
 }
 
-esp_err_t database_delete_card(const char *uid) {
-    if (!uid) {
+uint32_t database_cards_iter_cursor(const database_cards_iter_t *iter) {
+    return iter ? CARDS_CURSOR(iter->generation, iter->slot) : 0;
+}
+
+void database_cards_iter_end(database_cards_iter_t *iter) {
+    if (iter) {
+        memset(iter, 0, sizeof(*iter));
+    }
+}
+
+esp_err_t database_flush(void) {
+    if (!s_db_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    DB_LOCK();
+    esp_err_t ret = card_flush_locked();
+    DB_UNLOCK();
+    return ret;
+}
+
+void database_set_flush_interval(uint32_t interval_ms) {
+    s_flush_interval_ms = interval_ms ? interval_ms : DATABASE_FLUSH_INTERVAL_MS;
+    if (s_flush_task) {
+        xTaskNotifyGive(s_flush_task);
+    }
+}
+
+esp_err_t database_get_cache_stats(database_cache_stats_t *stats) {
+    if (!stats) {
         return ESP_ERR_INVALID_ARG;
     }
-    
-    char key[32];
-    snprintf(key, sizeof(key), "%s%s", CARD_PREFIX, uid);
-    
-    esp_err_t ret = nvs_erase_key(nvs_database_handle, key);
-    if (ret != ESP_OK && ret != ESP_ERR_NVS_NOT_FOUND) {
-        printf("Erro ao deletar cartão: %s\n", esp_err_to_name(ret));
-        return ret;
+    DB_LOCK();
+    *stats = s_cache_stats;
+    stats->dirty_records = s_dirty_count;
+    stats->free_slots = s_free_count;
+    DB_UNLOCK();
+    return ESP_OK;
+}
+
+esp_err_t database_get_concurrency_stats(database_concurrency_stats_t *stats) {
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
     }
-    
-    ret = nvs_commit(nvs_database_handle);
-    if (ret != ESP_OK) {
-        printf("Erro ao commit: %s\n", esp_err_to_name(ret));
-        return ret;
+    DB_LOCK();
+    *stats = s_lock_stats;
+    stats->view_fallbacks = s_view_fallbacks;
+    card_view_get_stats(&s_card_view, &stats->view);
+    DB_UNLOCK();
+    return ESP_OK;
+}
+
+esp_err_t database_get_filter_stats(card_filter_stats_t *stats) {
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
     }
-    
-    printf("Cartão deletado: %s\n", uid);
+    DB_LOCK();
+    *stats = s_filter_stats;
+    stats->items = s_card_filter.count;
+    stats->capacity = s_card_filter.bucket_count * CARD_FILTER_BUCKET_SIZE;
+    stats->memory_bytes = card_filter_memory(&s_card_filter);
+    stats->fingerprint_bits = CARD_FILTER_FINGERPRINT_BITS;
+    stats->expected_fp_ppm = card_filter_expected_fp_ppm(&s_card_filter);
+    DB_UNLOCK();
     return ESP_OK;
 }
 
-esp_err_t database_get_all_cards(rfid_record_t **records, int *count) {
-    if (!records || !count) {
+esp_err_t database_get_journal_stats(storage_journal_stats_t *stats, uint32_t *ready_ms) {
+    if (!stats) {
         return ESP_ERR_INVALID_ARG;
     }
-    
-    esp_err_t ret;
-    size_t required_size = sizeof(uint32_t);
-    uint32_t card_count = 0;
-      // Obter número de cartões armazenados
-    ret = nvs_get_u32(nvs_database_handle, CARD_COUNT_KEY, &card_count);
-    printf("DEBUG: Card count from NVS: %" PRIu32 ", ret: %s\n", card_count, esp_err_to_name(ret));
-    
-    if (ret != ESP_OK || card_count == 0) {
-        printf("DEBUG: Nenhum cartão encontrado ou erro ao ler contagem\n");
-        *records = NULL;
-        *count = 0;
-        return ESP_OK;
+    DB_LOCK();
+    storage_journal_get_stats(stats);
+    if (ready_ms) {
+        *ready_ms = s_ready_ms;
     }
-      // Alocar memória para os registros
-    *records = malloc(card_count * sizeof(rfid_record_t));
-    if (!*records) {
-        printf("DEBUG: Erro ao alocar memória\n");
-        return ESP_ERR_NO_MEM;
+    DB_UNLOCK();
+    return ESP_OK;
+}
+
+esp_err_t database_get_snapshot_stats(card_snapshot_stats_t *stats) {
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
     }
-    
-    printf("DEBUG: Alocou memória para %" PRIu32 " cartões\n", card_count);
-      int valid_cards = 0;
-    for (uint32_t i = 0; i < card_count; i++) {
-        char key[32];
-        snprintf(key, sizeof(key), "%s%" PRIu32, CARD_PREFIX, i);
-        
-        required_size = sizeof(rfid_record_t);
-        ret = nvs_get_blob(nvs_database_handle, key, &(*records)[valid_cards], &required_size);
-        printf("DEBUG: Tentando ler chave %s, ret: %s\n", key, esp_err_to_name(ret));
-        
-        if (ret == ESP_OK) {
-            printf("DEBUG: Cartão encontrado: %s (%s)\n", (*records)[valid_cards].uid, (*records)[valid_cards].name);
-            valid_cards++;
-        }
+    DB_LOCK();
+    card_snapshot_get_stats(stats);
+    DB_UNLOCK();
+    return ESP_OK;
+}
+
+esp_err_t database_get_shard_stats(storage_shard_stats_t *stats, uint32_t max, uint32_t *count) {
+    if (!stats || !count) {
+        return ESP_ERR_INVALID_ARG;
     }
-    
-    *count = valid_cards;
-    printf("DEBUG: Total de cartões válidos: %d\n", valid_cards);
-    printf("Recuperados %d cartões do NVS\n", valid_cards);
+    DB_LOCK();
+    *count = storage_shard_get_stats(stats, max);
+    DB_UNLOCK();
     return ESP_OK;
 }
 
@@ -246,35 +2284,36 @@ esp_err_t database_add_access_log(const char *uid, const char *action) {
         return ESP_ERR_INVALID_ARG;
     }
     
-    // Obter contagem atual de logs
-    uint32_t log_count = 0;
-    nvs_get_u32(nvs_database_handle, LOG_COUNT_KEY, &log_count);
-    
-    // Criar novo log
-    access_log_t new_log = {0};
-    new_log.id = log_count + 1;
-    strncpy(new_log.uid, uid, MAX_UID_LENGTH - 1);
-    strncpy(new_log.action, action, 32 - 1);
-    new_log.timestamp = time(NULL);
-    
-    // Salvar log no NVS (manter apenas os últimos 50 logs)
-    char key[32];
-    uint32_t log_index = log_count % 50; // Circular buffer
-    snprintf(key, sizeof(key), "%s%" PRIu32, LOG_PREFIX, log_index);
+    // Dentro de uma transação o log só é gravado no commit
+    if (s_db_mutex) {
+        DB_LOCK();
+    }
+    if (s_db_mutex && s_txn.active) {
+        esp_err_t ret = ESP_OK;
+        if (s_txn.log_count < DATABASE_TXN_MAX_LOGS) {
+            txn_log_t *log = &s_txn.logs[s_txn.log_count++];
+            strncpy(log->uid, uid, sizeof(log->uid) - 1);
+            log->uid[sizeof(log->uid) - 1] = '\0';
+            strncpy(log->action, action, sizeof(log->action) - 1);
+            log->action[sizeof(log->action) - 1] = '\0';
+            log->timestamp = (uint32_t)time(NULL);
+        } else {
+            ret = ESP_ERR_NO_MEM;
+        }
+        DB_UNLOCK();
+        return ret;
+    }
+    if (s_db_mutex) {
+        DB_UNLOCK();
+    }
     
-    esp_err_t ret = nvs_set_blob(nvs_database_handle, key, &new_log, sizeof(new_log));
+    // Append em RAM; o setor é gravado em lote (ver access_log.c)
+    esp_err_t ret = database_log_event(uid, action, (uint32_t)time(NULL));
     if (ret != ESP_OK) {
         printf("Erro ao salvar log: %s\n", esp_err_to_name(ret));
         return ret;
     }
     
-    // Atualizar contagem
-    log_count++;
-    ret = nvs_set_u32(nvs_database_handle, LOG_COUNT_KEY, log_count);
-    if (ret == ESP_OK) {
-        ret = nvs_commit(nvs_database_handle);
-    }
-    
     printf("Log de acesso: %s - %s\n", uid, action);
     return ESP_OK;
 }
@@ -284,19 +2323,19 @@ esp_err_t database_get_access_logs(access_log_t **logs, int *count, int limit) {
         return ESP_ERR_INVALID_ARG;
     }
     
-    // Obter contagem total de logs
-    uint32_t total_logs = 0;
-    esp_err_t ret = nvs_get_u32(nvs_database_handle, LOG_COUNT_KEY, &total_logs);
-    if (ret != ESP_OK || total_logs == 0) {
-        *logs = NULL;
-        *count = 0;
-        return ESP_OK;
+    *logs = NULL;
+    *count = 0;
+    
+    access_log_reader_t reader;
+    esp_err_t ret = access_log_reader_begin(&reader);
+    if (ret != ESP_OK) {
+        return ret;
     }
     
-    // Calcular quantos logs recuperar (máximo 50 devido ao circular buffer)
-    int logs_to_get = (total_logs > 50) ? 50 : total_logs;
-    if (limit > 0 && limit < logs_to_get) {
-        logs_to_get = limit;
+    uint32_t available = reader.next_seq >= reader.oldest_seq ? reader.next_seq - reader.oldest_seq + 1 : 0;
+    int logs_to_get = (limit > 0 && (uint32_t)limit < available) ? limit : (int)available;
+    if (logs_to_get == 0) {
+        return ESP_OK;
     }
     
     // Alocar memória para os logs
@@ -305,38 +2344,117 @@ esp_err_t database_get_access_logs(access_log_t **logs, int *count, int limit) {
         return ESP_ERR_NO_MEM;
     }
     
+    // Do mais recente para o mais antigo
     int valid_logs = 0;
-    for (int i = 0; i < logs_to_get && valid_logs < logs_to_get; i++) {
-        char key[32];
-        snprintf(key, sizeof(key), "%s%d", LOG_PREFIX, i);
-        
-        size_t required_size = sizeof(access_log_t);
-        ret = nvs_get_blob(nvs_database_handle, key, &(*logs)[valid_logs], &required_size);
-        if (ret == ESP_OK) {
-            valid_logs++;
-        }
+    while (valid_logs < logs_to_get &&
+           access_log_reader_next(&reader, &(*logs)[valid_logs]) == ESP_OK) {
+        valid_logs++;
     }
     
     *count = valid_logs;
-    printf("Recuperados %d logs do NVS\n", valid_logs);
+    printf("Recuperados %d logs\n", valid_logs);
+    return ESP_OK;
+}
+
+// Cursor de logs: seq do próximo registro + 1 (0 = mais recente)
+esp_err_t database_logs_iter_begin(database_logs_iter_t *iter, uint32_t cursor,
+                                   database_log_filter_t filter, void *ctx) {
+    if (!iter) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    access_log_reader_t reader;
+    esp_err_t ret = access_log_reader_begin(&reader);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    memset(iter, 0, sizeof(*iter));
+    iter->next_seq = reader.next_seq;
+    iter->oldest_seq = reader.oldest_seq;
+    iter->filter = filter;
+    iter->filter_ctx = ctx;
+    if (cursor != 0 && cursor - 1 < iter->next_seq) {
+        iter->next_seq = cursor - 1;
+    }
     return ESP_OK;
 }
 
+esp_err_t database_logs_query_begin(database_logs_iter_t *iter, uint32_t cursor,
+                                    const database_log_query_t *query) {
+    if (!query) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = database_logs_iter_begin(iter, cursor, NULL, NULL);
+    if (ret == ESP_OK) {
+        iter->has_query = true;
+        iter->query = *query;
+    }
+    return ret;
+}
+
+esp_err_t database_logs_iter_next(database_logs_iter_t *iter, access_log_t *entry) {
+    if (!iter || !entry) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    access_log_reader_t reader = {
+        .next_seq = iter->next_seq,
+        .oldest_seq = iter->oldest_seq,
+    };
+    esp_err_t ret;
+    const database_log_query_t *query = iter->has_query ? &iter->query : NULL;
+    while ((ret = access_log_reader_next_match(&reader, query, entry)) == ESP_OK) {
+        if (!iter->filter || iter->filter(entry, iter->filter_ctx)) {
+            break;
+        }
+    }
+    iter->next_seq = reader.next_seq;
+    return ret;
+}
+
+uint32_t database_logs_iter_cursor(const database_logs_iter_t *iter) {
+    return iter ? iter->next_seq + 1 : 0;
+}
+
+void database_logs_iter_end(database_logs_iter_t *iter) {
+    if (iter) {
+        memset(iter, 0, sizeof(*iter));
+    }
+}
+
 esp_err_t database_get_stats(int *total_cards, int *total_accesses) {
     if (!total_cards || !total_accesses) {
         return ESP_ERR_INVALID_ARG;
     }
     
-    // Obter contagem de cartões
-    uint32_t card_count = 0;
-    nvs_get_u32(nvs_database_handle, CARD_COUNT_KEY, &card_count);
+    DB_LOCK();
+    *total_cards = s_card_index.count;
+    *total_accesses = s_access_total;
+    DB_UNLOCK();
     
-    // Obter contagem de logs/acessos
-    uint32_t log_count = 0;
-    nvs_get_u32(nvs_database_handle, LOG_COUNT_KEY, &log_count);
+    return ESP_OK;
+}
+
+// Tudo mantido incrementalmente: nenhuma varredura de cartões ou logs
+esp_err_t database_get_access_stats(database_access_stats_t *stats) {
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
     
-    *total_cards = card_count;
-    *total_accesses = log_count;
+    memset(stats, 0, sizeof(*stats));
+    DB_LOCK();
+    stats->total_cards = s_card_index.count;
+    stats->card_accesses = s_access_total;
+    for (int i = 0; i < CARD_QUERY_LEVELS; i++) {
+        stats->cards_by_level[i] = s_card_query.level_count[i];
+    }
+    DB_UNLOCK();
     
+    uint32_t now = (uint32_t)time(NULL);
+    stats->log_records = access_log_total();
+    access_stats_totals(&stats->events);
+    access_stats_hours(now, stats->hours, DATABASE_STATS_HOURS);
+    access_stats_days(now, stats->days, DATABASE_STATS_DAYS);
     return ESP_OK;
 }
@@ -9,110 +9,93 @@
 #include "esp_log.h"
 #include "esp_err.h"
 #include "esp_sntp.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 
 // Includes dos componentes do projeto
 #include "rc522.h"
+#include "rfid_scheduler.h"
 #include "database.h"
 #include "web_server.h"
 #include "wifi_manager.h"
 
 static const char *TAG = "MAIN";
 
+// Leitores no barramento SPI do RC522: cada um com o seu CS e, se ligado,
+// o seu IRQ (-1 = polling). O escalonador intercala os WUPAs entre eles.
+static const rc522_config_t rfid_readers_config[] = {
+    RC522_CONFIG_DEFAULT(),
+    // { .id = 1, .pin_cs = 38, .pin_irq = -1, .pin_rst = -1 },  // ex.: leitor de saída
+};
+#define RFID_READER_COUNT (sizeof(rfid_readers_config) / sizeof(rfid_readers_config[0]))
+
 // Variáveis globais
 static web_server_t web_server;
-static rc522_handle_t rc522_handle;
+static rc522_handle_t rc522_handles[RFID_READER_COUNT];
+static size_t rc522_reader_count = 0;
 static bool system_ready = false;
 
-// Task para leitura do RFID
+// Task para leitura do RFID: consome os UIDs entregues pelo escalonador,
+// que já fez a detecção, a leitura e a espera pela remoção em cada leitor
 void rfid_task(void *pvParameters) {
-    char uid_str[MAX_UID_LENGTH];
-    rfid_record_t card_record;
-    
-    ESP_LOGI(TAG, "Task RFID iniciada");
+    rfid_scan_event_t event;
+    uint8_t access_level = 0;
     
-    // Log inicial para debug
-    ESP_LOGI(TAG, "RC522 handle inicializado: %s", rc522_handle.initialized ? "SIM" : "NÃO");
+    ESP_LOGI(TAG, "Task RFID iniciada - %d leitor(es)", (int)rfid_scheduler_reader_count());
     
     while (1) {
-        // Debug: Log periodicamente para mostrar que a task está rodando
-        static int debug_counter = 0;
-        if (debug_counter % 500 == 0) { // A cada 50 segundos (500 * 100ms)
-            ESP_LOGI(TAG, "Task RFID ativa - verificando cartões...");
+        if (rfid_scheduler_receive(&event, portMAX_DELAY) != ESP_OK) {
+            continue;
         }
-        debug_counter++;
+        const char *uid_str = event.uid;
+        ESP_LOGI(TAG, "Cartão detectado no leitor %d: %s (%lu us até o UID)",
+                 event.reader_id, uid_str, (unsigned long)event.latency_us);
+        
+        // Informar ao servidor web sobre o novo cartão
+        web_server_set_last_card(uid_str);
         
-        // Aguardar cartão ser detectado
-        int card_status = rc522_card_present(&rc522_handle);
-        if (card_status == RC522_OK) {
-            ESP_LOGI(TAG, "Cartão detectado pelo RC522!");
+        // Verificar se cartão está no banco de dados (só RAM, sem
+        // esperar cadastros ou flush em andamento)
+        if (database_lookup_access(uid_str, &access_level) == ESP_OK) {
+            // Cartão já cadastrado - atualizar acesso
+            ESP_LOGI(TAG, "Acesso autorizado para: %s (nível %d)", uid_str, access_level);
+            database_update_card_access(uid_str);
+            database_add_access_log(uid_str, "ACCESS_GRANTED");
             
-            // Aguardar um pouco antes de tentar ler
-            vTaskDelay(pdMS_TO_TICKS(50));
+            // Aqui você pode adicionar ação para acesso autorizado
+            // Ex: acionar relé, LED verde, etc.
             
-            // Tentar ler UID até 3 vezes
-            int read_attempts = 0;
-            esp_err_t read_result = ESP_FAIL;
+        } else {
+            // Cartão novo - adicionar automaticamente ao sistema
+            char default_name[64];
+            snprintf(default_name, sizeof(default_name), "Cartao_%s", uid_str);
             
-            while (read_attempts < 3 && read_result != ESP_OK) {
-                read_result = rc522_read_card_uid(&rc522_handle, uid_str, sizeof(uid_str));
-                if (read_result != ESP_OK) {
-                    read_attempts++;
-                    ESP_LOGW(TAG, "Tentativa %d/3 de leitura falhou", read_attempts);
-                    vTaskDelay(pdMS_TO_TICKS(50));
-                }
-            }
+            ESP_LOGI(TAG, "Novo cartão detectado: %s - Adicionando ao sistema", uid_str);
             
-            if (read_result == ESP_OK) {
-                ESP_LOGI(TAG, "Cartão detectado: %s", uid_str);
-                
-                // Informar ao servidor web sobre o novo cartão
-                web_server_set_last_card(uid_str);
-                
-                // Verificar se cartão está no banco de dados
-                if (database_get_card(uid_str, &card_record) == ESP_OK) {
-                    // Cartão já cadastrado - atualizar acesso
-                    ESP_LOGI(TAG, "Acesso autorizado para: %s (%s)", card_record.name, uid_str);
+            // Cadastro, acesso e logs num único commit
+            esp_err_t txn_ret = database_txn_begin();
+            if (txn_ret == ESP_OK) {
+                txn_ret = database_add_card(uid_str, default_name, ACCESS_LEVEL_USER);
+                if (txn_ret == ESP_OK) {
+                    database_add_access_log(uid_str, "CARD_ADDED");
+                    // Conceder acesso imediatamente após adicionar
                     database_update_card_access(uid_str);
                     database_add_access_log(uid_str, "ACCESS_GRANTED");
-                    
-                    // Aqui você pode adicionar ação para acesso autorizado
-                    // Ex: acionar relé, LED verde, etc.
-                    
+                    txn_ret = database_txn_commit();
                 } else {
-                    // Cartão novo - adicionar automaticamente ao sistema
-                    char default_name[64];
-                    snprintf(default_name, sizeof(default_name), "Cartao_%s", uid_str);
-                    
-                    ESP_LOGI(TAG, "Novo cartão detectado: %s - Adicionando ao sistema", uid_str);
-                    
-                    // Adicionar cartão com nível de usuário padrão
-                    if (database_add_card(uid_str, default_name, ACCESS_LEVEL_USER) == ESP_OK) {
-                        ESP_LOGI(TAG, "Cartão %s adicionado com sucesso como: %s", uid_str, default_name);
-                        database_add_access_log(uid_str, "CARD_ADDED");
-                        
-                        // Conceder acesso imediatamente após adicionar
-                        database_update_card_access(uid_str);
-                        database_add_access_log(uid_str, "ACCESS_GRANTED");
-                        
-                        ESP_LOGI(TAG, "Acesso concedido para novo cartão: %s", uid_str);
-                    } else {
-                        ESP_LOGW(TAG, "Falha ao adicionar cartão: %s", uid_str);
-                        database_add_access_log(uid_str, "ADD_FAILED");
-                    }
-                }
-                
-                // Aguardar cartão ser removido para evitar leituras duplicadas
-                while (rc522_card_present(&rc522_handle)) {
-                    vTaskDelay(pdMS_TO_TICKS(100));
+                    database_txn_abort();
                 }
+            }
+            
+            if (txn_ret == ESP_OK) {
+                ESP_LOGI(TAG, "Cartão %s adicionado com sucesso como: %s", uid_str, default_name);
+                ESP_LOGI(TAG, "Acesso concedido para novo cartão: %s", uid_str);
             } else {
-                ESP_LOGW(TAG, "Falha ao ler UID do cartão detectado");
+                ESP_LOGW(TAG, "Falha ao adicionar cartão: %s", uid_str);
+                database_add_access_log(uid_str, "ADD_FAILED");
             }
         }
-        
-        vTaskDelay(pdMS_TO_TICKS(100)); // Verificar a cada 100ms
     }
 }
 
@@ -132,6 +115,38 @@ void system_monitor_task(void *pvParameters) {
             if (database_get_stats(&total_cards, &total_accesses) == ESP_OK) {
                 ESP_LOGI(TAG, "Sistema ativo - Cartões: %d, Acessos: %d", total_cards, total_accesses);
             }
+            
+            for (size_t i = 0; i < rc522_reader_count; i++) {
+                rc522_handle_t *reader = &rc522_handles[i];
+                rfid_reader_stats_t sched;
+                if (rfid_scheduler_get_stats(i, &sched) == ESP_OK && sched.polls > 0) {
+                    ESP_LOGI(TAG, "Leitor %d - Verificações: %lu (%lu/s), atraso médio: %lu us (máx %lu), "
+                             "leituras: %lu, falhas: %lu, descartadas: %lu, detecção -> UID: %lu us (máx %lu)",
+                             sched.reader_id, (unsigned long)sched.polls, (unsigned long)sched.poll_hz,
+                             (unsigned long)sched.avg_lag_us, (unsigned long)sched.max_lag_us,
+                             (unsigned long)sched.scans, (unsigned long)sched.read_failures,
+                             (unsigned long)sched.dropped, (unsigned long)sched.avg_uid_us,
+                             (unsigned long)sched.max_uid_us);
+                }
+                
+                rc522_stats_t rfid;
+                if (rfid_scheduler_get_driver_stats(i, &rfid) == ESP_OK && rfid.commands > 0) {
+                    ESP_LOGI(TAG, "RC522 %d (%s) - Comandos: %lu, espera média: %lu us (máx %lu), CPU média: %lu us, "
+                             "leituras COMM_IRQ/comando: %lu, timeouts: %lu",
+                             reader->config.id, reader->irq_mode ? "IRQ" : "polling", (unsigned long)rfid.commands,
+                             (unsigned long)(rfid.wait_us / rfid.commands), (unsigned long)rfid.max_wait_us,
+                             (unsigned long)(rfid.busy_us / rfid.commands),
+                             (unsigned long)(rfid.status_reads / rfid.commands), (unsigned long)rfid.timeouts);
+                }
+                if (rfid.card_reads > 0) {
+                    ESP_LOGI(TAG, "RC522 %d - Leituras: %lu, transações SPI/leitura: %lu, tempo médio: %lu us, "
+                             "acima de %d us: %lu",
+                             reader->config.id, (unsigned long)rfid.card_reads,
+                             (unsigned long)(rfid.read_spi / rfid.card_reads),
+                             (unsigned long)(rfid.read_us / rfid.card_reads),
+                             RC522_UID_BUDGET_US, (unsigned long)rfid.over_budget);
+                }
+            }
         }
         
         vTaskDelay(pdMS_TO_TICKS(30000)); // Log a cada 30 segundos
@@ -191,7 +206,41 @@ void app_main(void)
         return;
     }
     
-    // 3. Inicializar Wi-Fi
+    // 3. Leitores RC522 (barramento SPI compartilhado) e tasks do toque logo
+    // depois do banco: a porta aceita cartões antes de Wi-Fi, SNTP (até
+    // ~20 s) e servidor web. Sem SNTP os primeiros logs saem com a hora
+    // local.
+    for (size_t i = 0; i < RFID_READER_COUNT; i++) {
+        const rc522_config_t *config = &rfid_readers_config[i];
+        ESP_LOGI(TAG, "Inicializando leitor RFID RC522 %d (CS %d)...", config->id, config->pin_cs);
+        ret = rc522_init_with_config(&rc522_handles[rc522_reader_count], config);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Falha ao inicializar RC522 %d: %s", config->id, esp_err_to_name(ret));
+            continue;
+        }
+        
+        // Testar comunicação com RC522
+        ESP_LOGI(TAG, "Testando comunicação com RC522 %d...", config->id);
+        if (rc522_test_communication(&rc522_handles[rc522_reader_count]) != ESP_OK) {
+            ESP_LOGW(TAG, "Teste de comunicação RC522 %d falhou - verifique conexões", config->id);
+        }
+        rc522_reader_count++;
+    }
+    if (rc522_reader_count == 0) {
+        ESP_LOGE(TAG, "Nenhum leitor RC522 inicializado");
+        return;
+    }
+    
+    // Escalonador dos leitores e task que consome os UIDs lidos
+    ret = rfid_scheduler_start(rc522_handles, rc522_reader_count);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Falha ao iniciar escalonador RFID: %s", esp_err_to_name(ret));
+        return;
+    }
+    xTaskCreate(rfid_task, "rfid_task", 4096, NULL, 5, NULL);
+    ESP_LOGI(TAG, "Leitores prontos em %lld ms desde o boot", (long long)(esp_timer_get_time() / 1000));
+    
+    // 4. Inicializar Wi-Fi
     ESP_LOGI(TAG, "Inicializando Wi-Fi...");
     ret = wifi_manager_init();
     if (ret != ESP_OK) {
@@ -199,7 +248,7 @@ void app_main(void)
         return;
     }
     
-    // 4. Conectar ao Wi-Fi em modo STA
+    // 5. Conectar ao Wi-Fi em modo STA
     ESP_LOGI(TAG, "Conectando ao Wi-Fi: %s", WIFI_SSID);
     ret = wifi_manager_connect_sta(WIFI_SSID, WIFI_PASS);
     
@@ -211,10 +260,10 @@ void app_main(void)
         ESP_LOGE(TAG, "Sistema continuará sem Wi-Fi...");
     }
     
-    // 5. Configurar SNTP para sincronização de horário
+    // 6. Configurar SNTP para sincronização de horário
     configure_sntp();
     
-    // 6. Inicializar servidor web
+    // 7. Inicializar servidor web
     ESP_LOGI(TAG, "Inicializando servidor web...");
     ret = web_server_init(&web_server);
     if (ret != ESP_OK) {
@@ -223,30 +272,6 @@ void app_main(void)
     }
     ESP_LOGI(TAG, "Servidor web iniciado na porta %d", WEB_SERVER_PORT);
     
-    // 7. Inicializar RC522
-    ESP_LOGI(TAG, "Inicializando leitor RFID RC522...");
-    ret = rc522_init(&rc522_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Falha ao inicializar RC522: %s", esp_err_to_name(ret));
-        return;
-    }
-    
-    // Testar comunicação com RC522
-    ESP_LOGI(TAG, "Testando comunicação com RC522...");
-    ret = rc522_test_communication(&rc522_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "Teste de comunicação RC522 falhou - verifique conexões");
-    }
-    
-    // 8. Sistema pronto para reconhecer qualquer cartão RFID
-    ESP_LOGI(TAG, "Sistema configurado para reconhecer automaticamente cartões RFID");
-    
-    // 9. Criar tasks do sistema
-    ESP_LOGI(TAG, "Criando tasks do sistema...");
-    
-    // Task para leitura RFID
-    xTaskCreate(rfid_task, "rfid_task", 4096, NULL, 5, NULL);
-    
     // Task para monitoramento (aumentar stack)
     xTaskCreate(system_monitor_task, "monitor_task", 4096, NULL, 3, NULL);
     
@@ -2,6 +2,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
 #include <string.h>
 
 static const char *TAG = "RC522";
@@ -11,17 +13,83 @@ static esp_err_t rc522_write_reg(rc522_handle_t *handle, uint8_t reg, uint8_t da
 static esp_err_t rc522_read_reg(rc522_handle_t *handle, uint8_t reg, uint8_t *data);
 static esp_err_t rc522_set_reg_bits(rc522_handle_t *handle, uint8_t reg, uint8_t mask);
 static esp_err_t rc522_clear_reg_bits(rc522_handle_t *handle, uint8_t reg, uint8_t mask);
-static int rc522_communicate_with_picc(rc522_handle_t *handle, uint8_t command, uint8_t *send_data, uint8_t send_len, uint8_t *back_data, uint8_t *back_len, uint8_t *valid_bits);
+static esp_err_t rc522_read_regs(rc522_handle_t *handle, const uint8_t *regs, uint8_t count, uint8_t *values);
+static esp_err_t rc522_read_fifo(rc522_handle_t *handle, uint8_t *data, uint8_t len);
+static int rc522_communicate_with_picc(rc522_handle_t *handle, uint8_t command, uint8_t bit_framing, uint8_t *send_data, uint8_t send_len, uint8_t *back_data, uint8_t *back_len, uint8_t *valid_bits);
 static int rc522_picc_request(rc522_handle_t *handle, uint8_t req_mode, uint8_t *tag_type);
-static int rc522_picc_anticoll(rc522_handle_t *handle, uint8_t *serial_num);
+static int rc522_picc_anticoll(rc522_handle_t *handle, uint8_t sel, uint8_t *serial_num);
+static int rc522_picc_select(rc522_handle_t *handle, uint8_t sel, const uint8_t *serial_num, uint8_t *sak);
+static uint16_t rc522_crc_a(const uint8_t *data, uint8_t len);
 static void rc522_reset(rc522_handle_t *handle);
+static int rc522_wait_command(rc522_handle_t *handle, uint8_t wait_irq);
+
+// Lote de escritas: cada item é um quadro (um registrador ou a FIFO
+// inteira), todos enfileirados antes de recolher os resultados
+typedef struct {
+    spi_transaction_t trans[RC522_SPI_QUEUE_SIZE];
+    WORD_ALIGNED_ATTR uint8_t fifo[1 + RC522_FIFO_SIZE];
+    uint8_t count;
+    bool overflow;
+} rc522_batch_t;
+
+static void rc522_batch_write(rc522_batch_t *batch, uint8_t reg, uint8_t data);
+static void rc522_batch_write_fifo(rc522_batch_t *batch, const uint8_t *data, uint8_t len);
+static esp_err_t rc522_batch_run(rc522_handle_t *handle, rc522_batch_t *batch);
+
+static void IRAM_ATTR rc522_irq_isr(void *arg) {
+    rc522_handle_t *handle = (rc522_handle_t *)arg;
+    TaskHandle_t waiter = handle->waiter;
+    BaseType_t woken = pdFALSE;
+    if (waiter) {
+        vTaskNotifyGiveFromISR(waiter, &woken);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+// Pino IRQ com borda de descida (IRqInv) e COMM_IE; precisa vir depois do
+// soft reset, que volta COMM_IE para 0x80
+static esp_err_t rc522_irq_init(rc522_handle_t *handle) {
+    gpio_config_t irq_conf = {
+        .pin_bit_mask = (1ULL << handle->config.pin_irq),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,   // saída do RC522 é open-drain por padrão
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    esp_err_t ret = gpio_config(&irq_conf);
+    if (ret == ESP_OK) {
+        ret = gpio_install_isr_service(0);
+        if (ret == ESP_ERR_INVALID_STATE) {
+            ret = ESP_OK; // serviço já instalado por outro driver
+        }
+    }
+    if (ret == ESP_OK) {
+        ret = gpio_isr_handler_add(handle->config.pin_irq, rc522_irq_isr, handle);
+    }
+    if (ret == ESP_OK) {
+        ret = rc522_write_reg(handle, RC522_REG_COMM_IE, RC522_COMM_IE_WAIT);
+        if (ret != ESP_OK) {
+            gpio_isr_handler_remove(handle->config.pin_irq);
+        }
+    }
+    return ret;
+}
 
 esp_err_t rc522_init(rc522_handle_t *handle) {
+    rc522_config_t config = RC522_CONFIG_DEFAULT();
+    return rc522_init_with_config(handle, &config);
+}
+
+// Vários leitores dividem o barramento: o primeiro inicializa, os demais só
+// acrescentam o dispositivo com o seu CS
+esp_err_t rc522_init_with_config(rc522_handle_t *handle, const rc522_config_t *config) {
     esp_err_t ret;
     
-    ESP_LOGI(TAG, "Inicializando RC522...");
-    ESP_LOGI(TAG, "Pinos configurados - MISO:%d, MOSI:%d, CLK:%d, CS:%d, RST:%d", 
-             RC522_PIN_MISO, RC522_PIN_MOSI, RC522_PIN_CLK, RC522_PIN_CS, RC522_PIN_RST);
+    handle->config = *config;
+    
+    ESP_LOGI(TAG, "Inicializando RC522 %d...", config->id);
+    ESP_LOGI(TAG, "Pinos configurados - MISO:%d, MOSI:%d, CLK:%d, CS:%d, RST:%d, IRQ:%d", 
+             RC522_PIN_MISO, RC522_PIN_MOSI, RC522_PIN_CLK, config->pin_cs, config->pin_rst, config->pin_irq);
     
     // Configuração SPI
     spi_bus_config_t buscfg = {
@@ -34,7 +102,7 @@ esp_err_t rc522_init(rc522_handle_t *handle) {
     };    spi_device_interface_config_t devcfg = {
         .clock_speed_hz = 500000,   // Reduzir para 500kHz para testar
         .mode = 0,
-        .spics_io_num = RC522_PIN_CS,
+        .spics_io_num = config->pin_cs,
         .queue_size = 7,
     };
     
@@ -52,21 +120,25 @@ esp_err_t rc522_init(rc522_handle_t *handle) {
         return ret;
     }
     
+    memset(&handle->stats, 0, sizeof(handle->stats));
+    
     // Configurar pino RST
-    gpio_config_t io_conf = {
-        .pin_bit_mask = (1ULL << RC522_PIN_RST),
-        .mode = GPIO_MODE_OUTPUT,
-        .pull_up_en = GPIO_PULLUP_DISABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE,
-    };
-    gpio_config(&io_conf);
-      // Reset do RC522 (mais robusto)
-    ESP_LOGI(TAG, "Executando reset do RC522...");
-    gpio_set_level(RC522_PIN_RST, 0);
-    vTaskDelay(pdMS_TO_TICKS(10));
-    gpio_set_level(RC522_PIN_RST, 1);
-    vTaskDelay(pdMS_TO_TICKS(50));
+    if (config->pin_rst >= 0) {
+        gpio_config_t io_conf = {
+            .pin_bit_mask = (1ULL << config->pin_rst),
+            .mode = GPIO_MODE_OUTPUT,
+            .pull_up_en = GPIO_PULLUP_DISABLE,
+            .pull_down_en = GPIO_PULLDOWN_DISABLE,
+            .intr_type = GPIO_INTR_DISABLE,
+        };
+        gpio_config(&io_conf);
+        // Reset do RC522 (mais robusto)
+        ESP_LOGI(TAG, "Executando reset do RC522...");
+        gpio_set_level(config->pin_rst, 0);
+        vTaskDelay(pdMS_TO_TICKS(10));
+        gpio_set_level(config->pin_rst, 1);
+        vTaskDelay(pdMS_TO_TICKS(50));
+    }
     
     // Fazer soft reset
     rc522_write_reg(handle, RC522_REG_COMMAND, RC522_CMD_SOFT_RESET);
@@ -75,23 +147,48 @@ esp_err_t rc522_init(rc522_handle_t *handle) {
     // Configurar RC522
     vTaskDelay(pdMS_TO_TICKS(50));
     
+    rc522_batch_t setup = { .count = 0 };
+    
     // Timer mode
-    rc522_write_reg(handle, RC522_REG_T_MODE, 0x8D);
-    rc522_write_reg(handle, RC522_REG_T_PRESCALER, 0x3E);
-    rc522_write_reg(handle, RC522_REG_T_RELOAD_L, 30);
-    rc522_write_reg(handle, RC522_REG_T_RELOAD_H, 0);
+    rc522_batch_write(&setup, RC522_REG_T_MODE, 0x8D);
+    rc522_batch_write(&setup, RC522_REG_T_PRESCALER, 0x3E);
+    rc522_batch_write(&setup, RC522_REG_T_RELOAD_L, RC522_TIMER_RELOAD);
+    rc522_batch_write(&setup, RC522_REG_T_RELOAD_H, 0);
     
     // Force 100% ASK modulation
-    rc522_write_reg(handle, RC522_REG_TX_AUTO, 0x40);
+    rc522_batch_write(&setup, RC522_REG_TX_AUTO, 0x40);
     
     // Set the preset value for the CRC coprocessor for the CalcCRC command to 0x6363 (ISO 14443-3 part 6.2.4)
-    rc522_write_reg(handle, RC522_REG_MODE, 0x3D);
+    rc522_batch_write(&setup, RC522_REG_MODE, 0x3D);
+    
+    // ValuesAfterColl = 0: bits recebidos depois de uma colisão vêm zerados
+    rc522_batch_write(&setup, RC522_REG_COLL, 0x00);
+    
+    ret = rc522_batch_run(handle, &setup);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Falha ao configurar RC522: %s", esp_err_to_name(ret));
+        return ret;
+    }
     
     // Enable antenna
     rc522_antenna_on(handle);
     
+    handle->waiter = NULL;
+    handle->card_ready = false;
+    memset(&handle->trace, 0, sizeof(handle->trace));
+    handle->irq_mode = false;
+    if (config->pin_irq >= 0) {
+        ret = rc522_irq_init(handle);
+        if (ret == ESP_OK) {
+            handle->irq_mode = true;
+        } else {
+            ESP_LOGW(TAG, "IRQ no GPIO %d indisponível (%s), usando polling",
+                     config->pin_irq, esp_err_to_name(ret));
+        }
+    }
+    
     handle->initialized = true;
-    ESP_LOGI(TAG, "RC522 inicializado com sucesso");
+    ESP_LOGI(TAG, "RC522 %d inicializado com sucesso (espera por %s)", config->id, handle->irq_mode ? "IRQ" : "polling");
     
     return ESP_OK;
 }
@@ -102,8 +199,13 @@ esp_err_t rc522_deinit(rc522_handle_t *handle) {
     }
     
     rc522_antenna_off(handle);
+    if (handle->irq_mode) {
+        rc522_write_reg(handle, RC522_REG_COMM_IE, 0x80);
+        gpio_isr_handler_remove(handle->config.pin_irq);
+        handle->irq_mode = false;
+    }
     spi_bus_remove_device(handle->spi_handle);
-    spi_bus_free(RC522_SPI_HOST);
+    spi_bus_free(RC522_SPI_HOST);   // falha enquanto houver outro leitor no barramento
     
     handle->initialized = false;
     ESP_LOGI(TAG, "RC522 desinicializado");
@@ -123,6 +225,22 @@ void rc522_antenna_off(rc522_handle_t *handle) {
     rc522_clear_reg_bits(handle, RC522_REG_TX_CONTROL, 0x03);
 }
 
+esp_err_t rc522_get_stats(rc522_handle_t *handle, rc522_stats_t *stats) {
+    if (!handle || !stats || !handle->initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    *stats = handle->stats;
+    return ESP_OK;
+}
+
+esp_err_t rc522_get_trace(rc522_handle_t *handle, rc522_trace_t *trace) {
+    if (!handle || !trace || !handle->initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    *trace = handle->trace;
+    return ESP_OK;
+}
+
 int rc522_card_present(rc522_handle_t *handle) {
     if (!handle || !handle->initialized) {
         ESP_LOGW(TAG, "RC522 handle não inicializado");
@@ -130,7 +248,19 @@ int rc522_card_present(rc522_handle_t *handle) {
     }
     
     uint8_t tag_type[2];
-    int result = rc522_picc_request(handle, 0x52, tag_type);
+    int64_t start = esp_timer_get_time();
+    uint32_t spi_start = handle->stats.spi_transactions;
+    int result = rc522_picc_request(handle, RC522_PICC_WUPA, tag_type);
+    handle->stats.polls++;
+    
+    // Cartão respondeu e ficou em READY: rc522_read_card segue direto
+    // para a anticolisão
+    handle->card_ready = (result == RC522_OK);
+    if (handle->card_ready) {
+        handle->detect_us = start;
+        handle->detect_request_us = (uint32_t)(esp_timer_get_time() - start);
+        handle->detect_request_spi = (uint16_t)(handle->stats.spi_transactions - spi_start);
+    }
       // Debug: Log ocasional para mostrar que está verificando
     static int check_counter = 0;
     if (check_counter % 10000 == 0) { // A cada 1000 segundos
@@ -145,69 +275,146 @@ esp_err_t rc522_read_card_uid(rc522_handle_t *handle, char *uid_str, size_t uid_
     rc522_card_t card;
     int status;
     
-    ESP_LOGI(TAG, "Tentando ler UID do cartão...");
+    ESP_LOGD(TAG, "Tentando ler UID do cartão...");
     
     // Ler cartão
     status = rc522_read_card(handle, &card);
-    ESP_LOGI(TAG, "rc522_read_card retornou status: %d", status);
+    ESP_LOGD(TAG, "rc522_read_card retornou status: %d", status);
     
     if (status != RC522_OK) {
         ESP_LOGW(TAG, "Falha ao ler cartão, status: %d", status);
         return ESP_FAIL;
     }
     
-    ESP_LOGI(TAG, "Cartão lido com sucesso! UID length: %d", card.uid_len);
+    ESP_LOGD(TAG, "Cartão lido com sucesso! UID length: %d", card.uid_len);
+    
+    rc522_uid_to_string(&card, uid_str, uid_str_size);
     
-    // Converter UID para string hexadecimal
+    ESP_LOGD(TAG, "UID convertido para string: %s", uid_str);
+    
+    return ESP_OK;
+}
+
+// Converter UID para string hexadecimal ("AA:BB:...")
+void rc522_uid_to_string(const rc522_card_t *card, char *uid_str, size_t uid_str_size) {
     int written = 0;
-    for (int i = 0; i < card.uid_len && written < (uid_str_size - 3); i++) {
+    for (int i = 0; i < card->uid_len && written < (int)(uid_str_size - 3); i++) {
         if (i > 0) {
             uid_str[written++] = ':';
         }
-        written += snprintf(&uid_str[written], uid_str_size - written, "%02X", card.uid[i]);
+        written += snprintf(&uid_str[written], uid_str_size - written, "%02X", card->uid[i]);
     }
     uid_str[written] = '\0';
-    
-    ESP_LOGI(TAG, "UID convertido para string: %s", uid_str);
-    
-    return ESP_OK;
 }
 
+// Máquina de estados detecção -> UID. Parte do ATQA de rc522_card_present
+// quando houver (cartão em READY) e senão faz o WUPA; depois anticolisão e
+// SELECT em cada nível da cascata enquanto o SAK indicar UID incompleto
+// (4, 7 ou 10 bytes). Qualquer falha volta ao WUPA, que acorda o cartão de
+// novo. Cada comando é limitado pelo timer do RC522, sem vTaskDelay, e os
+// logs ficam fora do caminho (ESP_LOGD)
 int rc522_read_card(rc522_handle_t *handle, rc522_card_t *card) {
-    int status;
+    static const uint8_t sel_codes[3] = {RC522_PICC_SEL_CL1, RC522_PICC_SEL_CL2, RC522_PICC_SEL_CL3};
+    enum { STAGE_REQUEST, STAGE_ANTICOLL, STAGE_SELECT, STAGE_DONE } stage;
+    rc522_trace_t *trace = &handle->trace;
+    int status = RC522_ERR_NO_CARD;
     uint8_t tag_type[2];
-    
-    ESP_LOGI(TAG, "Iniciando leitura do cartão...");
-    
-    // Request card com timeout maior
-    status = rc522_picc_request(handle, 0x26, tag_type); // REQIDL em vez de REQALL
-    ESP_LOGI(TAG, "PICC request status: %d, tag_type: 0x%02X%02X", status, tag_type[0], tag_type[1]);
-    if (status != RC522_OK) {
-        // Tentar REQALL como fallback
-        vTaskDelay(pdMS_TO_TICKS(10));
-        status = rc522_picc_request(handle, 0x52, tag_type);
-        ESP_LOGI(TAG, "PICC request fallback status: %d", status);
+    uint8_t serial_num[5];
+    uint8_t level = 0;
+    
+    int64_t start = esp_timer_get_time();
+    uint32_t spi_start = handle->stats.spi_transactions;
+    int64_t detect = start;
+    
+    memset(trace, 0, sizeof(*trace));
+    card->uid_len = 0;
+    if (handle->card_ready) {
+        detect = handle->detect_us;
+        trace->request_us = handle->detect_request_us;
+        trace->request_spi = handle->detect_request_spi;
+        trace->reused_atqa = true;
+        trace->attempts = 1;
+        stage = STAGE_ANTICOLL;
+    } else {
+        stage = STAGE_REQUEST;
+    }
+    handle->card_ready = false;
+    
+    while (stage != STAGE_DONE && (stage != STAGE_REQUEST || trace->attempts < RC522_SELECT_ATTEMPTS)) {
+        int64_t t = esp_timer_get_time();
+        uint32_t spi = handle->stats.spi_transactions;
+        switch (stage) {
+            case STAGE_REQUEST:
+                trace->attempts++;
+                level = 0;
+                card->uid_len = 0;
+                status = rc522_picc_request(handle, RC522_PICC_WUPA, tag_type);
+                trace->request_us += esp_timer_get_time() - t;
+                trace->request_spi += handle->stats.spi_transactions - spi;
+                break;
+            case STAGE_ANTICOLL:
+                status = rc522_picc_anticoll(handle, sel_codes[level], serial_num);
+                trace->anticoll_us += esp_timer_get_time() - t;
+                trace->anticoll_spi += handle->stats.spi_transactions - spi;
+                break;
+            case STAGE_SELECT:
+                status = rc522_picc_select(handle, sel_codes[level], serial_num, &card->sak);
+                trace->select_us += esp_timer_get_time() - t;
+                trace->select_spi += handle->stats.spi_transactions - spi;
+                break;
+            default:
+                break;
+        }
         if (status != RC522_OK) {
-            ESP_LOGW(TAG, "PICC request falhou");
-            return status;
+            ESP_LOGD(TAG, "Estágio %d (nível %d) falhou (status %d, tentativa %d)",
+                     stage, level + 1, status, trace->attempts);
+            stage = STAGE_REQUEST;
+            continue;
+        }
+        if (stage != STAGE_SELECT) {
+            stage++;
+            continue;
+        }
+        
+        // SAK com o bit de cascata: este nível trouxe CT (0x88) + 3 bytes
+        if ((card->sak & 0x04) && level < 2) {
+            memcpy(&card->uid[card->uid_len], &serial_num[1], 3);
+            card->uid_len += 3;
+            level++;
+            stage = STAGE_ANTICOLL;
+        } else if (card->sak & 0x04) {
+            status = RC522_ERR_NO_CARD;  // mais de três níveis
+            stage = STAGE_REQUEST;
+        } else {
+            memcpy(&card->uid[card->uid_len], serial_num, 4);
+            card->uid_len += 4;
+            stage = STAGE_DONE;
         }
     }
-    
-    // Pequeno delay antes do anti-collision
-    vTaskDelay(pdMS_TO_TICKS(5));
-    
-    // Anti-collision
-    status = rc522_picc_anticoll(handle, card->uid);
-    ESP_LOGI(TAG, "Anti-collision status: %d", status);
+    trace->levels = level + 1;
     if (status != RC522_OK) {
-        ESP_LOGW(TAG, "Anti-collision falhou");
+        ESP_LOGD(TAG, "Leitura do cartão falhou após %d tentativas", trace->attempts);
         return status;
     }
     
-    card->uid_len = 4; // UID padrão de 4 bytes
+    int64_t now = esp_timer_get_time();
+    trace->total_us = (uint32_t)(now - detect);
+    handle->stats.card_reads++;
+    handle->stats.read_spi += handle->stats.spi_transactions - spi_start;
+    handle->stats.read_us += now - start;
+    handle->stats.uid_us += trace->total_us;
+    if (trace->total_us > handle->stats.max_uid_us) {
+        handle->stats.max_uid_us = trace->total_us;
+    }
+    if (trace->total_us > RC522_UID_BUDGET_US) {
+        handle->stats.over_budget++;
+    }
     
-    ESP_LOGI(TAG, "Cartão detectado - UID: %02X:%02X:%02X:%02X", 
-             card->uid[0], card->uid[1], card->uid[2], card->uid[3]);
+    ESP_LOGD(TAG, "Cartão detectado - UID de %d bytes, SAK 0x%02X", card->uid_len, card->sak);
+    ESP_LOGD(TAG, "Detecção -> UID: %lu us (request %lu, anticolisão %lu, select %lu, níveis %d, tentativas %d%s)",
+             (unsigned long)trace->total_us, (unsigned long)trace->request_us,
+             (unsigned long)trace->anticoll_us, (unsigned long)trace->select_us,
+             trace->levels, trace->attempts, trace->reused_atqa ? ", ATQA reaproveitado" : "");
     
     return RC522_OK;
 }
@@ -249,10 +456,12 @@ esp_err_t rc522_test_communication(rc522_handle_t *handle) {
 
 // Funções privadas
 static void rc522_reset(rc522_handle_t *handle) {
-    gpio_set_level(RC522_PIN_RST, 0);
-    vTaskDelay(pdMS_TO_TICKS(10));
-    gpio_set_level(RC522_PIN_RST, 1);
-    vTaskDelay(pdMS_TO_TICKS(50));
+    if (handle->config.pin_rst >= 0) {
+        gpio_set_level(handle->config.pin_rst, 0);
+        vTaskDelay(pdMS_TO_TICKS(10));
+        gpio_set_level(handle->config.pin_rst, 1);
+        vTaskDelay(pdMS_TO_TICKS(50));
+    }
     
     // Software reset
     rc522_write_reg(handle, RC522_REG_COMMAND, RC522_CMD_SOFT_RESET);
@@ -266,6 +475,7 @@ static esp_err_t rc522_write_reg(rc522_handle_t *handle, uint8_t reg, uint8_t da
         .flags = SPI_TRANS_USE_TXDATA
     };
     
+    handle->stats.spi_transactions++;
     return spi_device_transmit(handle->spi_handle, &trans);
 }
 
@@ -276,6 +486,7 @@ static esp_err_t rc522_read_reg(rc522_handle_t *handle, uint8_t reg, uint8_t *da
         .flags = SPI_TRANS_USE_TXDATA | SPI_TRANS_USE_RXDATA
     };
     
+    handle->stats.spi_transactions++;
     esp_err_t ret = spi_device_transmit(handle->spi_handle, &trans);
     if (ret == ESP_OK) {
         *data = trans.rx_data[1];
@@ -284,6 +495,102 @@ static esp_err_t rc522_read_reg(rc522_handle_t *handle, uint8_t reg, uint8_t *da
     return ret;
 }
 
+// Leitura de vários registradores num quadro: cada byte enviado é o endereço
+// seguinte e o recebido é o valor do anterior; o último envio é 0x00
+static esp_err_t rc522_read_regs(rc522_handle_t *handle, const uint8_t *regs, uint8_t count, uint8_t *values) {
+    WORD_ALIGNED_ATTR uint8_t tx[RC522_FIFO_SIZE + 4];
+    WORD_ALIGNED_ATTR uint8_t rx[RC522_FIFO_SIZE + 4];
+    
+    if (count == 0 || count > RC522_FIFO_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        tx[i] = ((regs[i] << 1) & 0x7E) | 0x80;
+    }
+    tx[count] = 0x00;
+    
+    spi_transaction_t trans = {
+        .length = (count + 1) * 8,
+        .tx_buffer = tx,
+        .rx_buffer = rx,
+    };
+    
+    handle->stats.spi_transactions++;
+    esp_err_t ret = spi_device_transmit(handle->spi_handle, &trans);
+    if (ret == ESP_OK) {
+        memcpy(values, &rx[1], count);
+    }
+    
+    return ret;
+}
+
+static esp_err_t rc522_read_fifo(rc522_handle_t *handle, uint8_t *data, uint8_t len) {
+    uint8_t regs[RC522_FIFO_SIZE];
+    
+    if (len == 0 || len > RC522_FIFO_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memset(regs, RC522_REG_FIFO_DATA, len);
+    return rc522_read_regs(handle, regs, len, data);
+}
+
+static void rc522_batch_write(rc522_batch_t *batch, uint8_t reg, uint8_t data) {
+    if (batch->count >= RC522_SPI_QUEUE_SIZE) {
+        batch->overflow = true;
+        return;
+    }
+    spi_transaction_t *trans = &batch->trans[batch->count++];
+    memset(trans, 0, sizeof(*trans));
+    trans->length = 16;
+    trans->flags = SPI_TRANS_USE_TXDATA;
+    trans->tx_data[0] = (reg << 1) & 0x7E;
+    trans->tx_data[1] = data;
+}
+
+// Escrita em sequência: todos os bytes depois do endereço vão para FIFO_DATA
+static void rc522_batch_write_fifo(rc522_batch_t *batch, const uint8_t *data, uint8_t len) {
+    if (len == 0) {
+        return;
+    }
+    if (batch->count >= RC522_SPI_QUEUE_SIZE || len > RC522_FIFO_SIZE) {
+        batch->overflow = true;
+        return;
+    }
+    batch->fifo[0] = (RC522_REG_FIFO_DATA << 1) & 0x7E;
+    memcpy(&batch->fifo[1], data, len);
+    
+    spi_transaction_t *trans = &batch->trans[batch->count++];
+    memset(trans, 0, sizeof(*trans));
+    trans->length = (len + 1) * 8;
+    trans->tx_buffer = batch->fifo;
+}
+
+// A fila do dispositivo preserva a ordem; os resultados só são recolhidos
+// depois de tudo enfileirado
+static esp_err_t rc522_batch_run(rc522_handle_t *handle, rc522_batch_t *batch) {
+    esp_err_t ret = batch->overflow ? ESP_ERR_INVALID_SIZE : ESP_OK;
+    uint8_t queued = 0;
+    
+    for (; ret == ESP_OK && queued < batch->count; queued++) {
+        ret = spi_device_queue_trans(handle->spi_handle, &batch->trans[queued], portMAX_DELAY);
+        if (ret != ESP_OK) {
+            break;
+        }
+    }
+    handle->stats.spi_transactions += queued;
+    
+    for (uint8_t i = 0; i < queued; i++) {
+        spi_transaction_t *done;
+        esp_err_t res = spi_device_get_trans_result(handle->spi_handle, &done, portMAX_DELAY);
+        if (ret == ESP_OK) {
+            ret = res;
+        }
+    }
+    batch->count = 0;
+    
+    return ret;
+}
+
 static esp_err_t rc522_set_reg_bits(rc522_handle_t *handle, uint8_t reg, uint8_t mask) {
     uint8_t temp;
     esp_err_t ret = rc522_read_reg(handle, reg, &temp);
@@ -302,14 +609,16 @@ static esp_err_t rc522_clear_reg_bits(rc522_handle_t *handle, uint8_t reg, uint8
     return ret;
 }
 
-static int rc522_communicate_with_picc(rc522_handle_t *handle, uint8_t command, 
+static int rc522_communicate_with_picc(rc522_handle_t *handle, uint8_t command, uint8_t bit_framing,
                                      uint8_t *send_data, uint8_t send_len, 
                                      uint8_t *back_data, uint8_t *back_len, 
                                      uint8_t *valid_bits) {
+    static const uint8_t status_regs[4] = {RC522_REG_ERROR, RC522_REG_COLL, RC522_REG_FIFO_LEVEL, RC522_REG_CONTROL};
     uint8_t wait_irq = 0x00;
+    uint8_t status[4];
+    int result = RC522_OK;
     uint8_t last_bits;
     uint8_t n;
-    uint16_t i = 2000;
     
     switch (command) {
         case RC522_CMD_AUTH:
@@ -322,50 +631,49 @@ static int rc522_communicate_with_picc(rc522_handle_t *handle, uint8_t command,
             break;
     }
     
-    rc522_write_reg(handle, RC522_REG_COMM_IRQ, 0x7F);
-    rc522_clear_reg_bits(handle, RC522_REG_FIFO_LEVEL, 0x80);
-    rc522_write_reg(handle, RC522_REG_COMMAND, RC522_CMD_IDLE);
-    
-    // Escrever dados para FIFO
-    for (i = 0; i < send_len; i++) {
-        rc522_write_reg(handle, RC522_REG_FIFO_DATA, send_data[i]);
+    if (handle->irq_mode) {
+        // Descarta borda de um comando anterior antes de disparar este
+        handle->waiter = xTaskGetCurrentTaskHandle();
+        ulTaskNotifyTake(pdTRUE, 0);
     }
     
-    // Executar comando
-    rc522_write_reg(handle, RC522_REG_COMMAND, command);
+    // Limpar IRQs, esvaziar a FIFO (FlushBuffer), escrever os dados e
+    // executar o comando num lote só; StartSend vai junto com os bits de
+    // enquadramento, sem ler BIT_FRAMING antes
+    rc522_batch_t batch = { .count = 0 };
+    rc522_batch_write(&batch, RC522_REG_COMM_IRQ, 0x7F);
+    rc522_batch_write(&batch, RC522_REG_FIFO_LEVEL, 0x80);
+    rc522_batch_write(&batch, RC522_REG_COMMAND, RC522_CMD_IDLE);
+    rc522_batch_write_fifo(&batch, send_data, send_len);
+    rc522_batch_write(&batch, RC522_REG_COMMAND, command);
     if (command == RC522_CMD_TRANSCEIVE) {
-        rc522_set_reg_bits(handle, RC522_REG_BIT_FRAMING, 0x80);
+        rc522_batch_write(&batch, RC522_REG_BIT_FRAMING, bit_framing | 0x80);
+    }
+    if (rc522_batch_run(handle, &batch) != ESP_OK) {
+        return RC522_ERR_TIMEOUT;
     }
     
     // Aguardar interrupção
-    i = 2000;
-    do {
-        uint8_t irq;
-        rc522_read_reg(handle, RC522_REG_COMM_IRQ, &irq);
-        if (irq & wait_irq) {
-            break;
-        }
-        if (irq & 0x01) {
-            return RC522_ERR_TIMEOUT;
-        }
-        i--;
-    } while (i != 0);
-    
-    if (i == 0) {
+    if (rc522_wait_command(handle, wait_irq) != RC522_OK) {
         return RC522_ERR_TIMEOUT;
     }
     
-    // Verificar erro
-    uint8_t error_reg;
-    rc522_read_reg(handle, RC522_REG_ERROR, &error_reg);
-    if (error_reg & 0x13) {
+    // Verificar erro (com colisão, nível da FIFO e bits válidos no mesmo quadro)
+    if (rc522_read_regs(handle, status_regs, (back_data && back_len) ? 4 : 2, status) != ESP_OK) {
+        return RC522_ERR_TIMEOUT;
+    }
+    if (status[0] & 0x13) {
         return RC522_ERR_CRC;
     }
+    // Colisão: os dados até o bit disputado ainda valem para a anticolisão
+    if (status[0] & 0x08) {
+        handle->last_coll = status[1];
+        result = RC522_ERR_COLLISION;
+    }
     
     if (back_data && back_len) {
-        rc522_read_reg(handle, RC522_REG_FIFO_LEVEL, &n);
-        rc522_read_reg(handle, RC522_REG_CONTROL, &last_bits);
-        last_bits &= 0x07;
+        n = status[2];
+        last_bits = status[3] & 0x07;
         
         if (last_bits) {
             *back_len = (n - 1) * 8 + last_bits;
@@ -380,57 +688,197 @@ static int rc522_communicate_with_picc(rc522_handle_t *handle, uint8_t command,
             n = 16;
         }
         
-        for (i = 0; i < n; i++) {
-            rc522_read_reg(handle, RC522_REG_FIFO_DATA, &back_data[i]);
-        }
+        rc522_read_fifo(handle, back_data, n);
         
         if (valid_bits) {
             *valid_bits = last_bits;
         }
     }
     
-    return RC522_OK;
+    return result;
+}
+
+// Espera wait_irq (ou TimerIRq = timeout) em COMM_IRQ. Com IRQ a task dorme
+// até a borda e lê COMM_IRQ uma vez; sem, lê COMM_IRQ em laço (até 2000
+// leituras SPI). busy_us é o tempo fora da notificação
+static int rc522_wait_command(rc522_handle_t *handle, uint8_t wait_irq) {
+    rc522_stats_t *stats = &handle->stats;
+    int64_t start = esp_timer_get_time();
+    int64_t blocked_us = 0;
+    int status = RC522_ERR_TIMEOUT;
+    uint8_t irq = 0;
+    
+    if (handle->irq_mode) {
+        while (1) {
+            int64_t t = esp_timer_get_time();
+            uint32_t woke = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(RC522_IRQ_WAIT_MS) + 1);
+            blocked_us += esp_timer_get_time() - t;
+            rc522_read_reg(handle, RC522_REG_COMM_IRQ, &irq);
+            stats->status_reads++;
+            if (woke) {
+                stats->irq_wakeups++;
+            }
+            if (irq & wait_irq) {
+                if (!woke) {
+                    stats->irq_missed++;
+                }
+                status = RC522_OK;
+                break;
+            }
+            if ((irq & 0x01) || !woke) {
+                break;
+            }
+        }
+    } else {
+        for (uint16_t i = 2000; i > 0; i--) {
+            rc522_read_reg(handle, RC522_REG_COMM_IRQ, &irq);
+            stats->status_reads++;
+            if (irq & wait_irq) {
+                status = RC522_OK;
+                break;
+            }
+            if (irq & 0x01) {
+                break;
+            }
+        }
+    }
+    
+    uint32_t waited = (uint32_t)(esp_timer_get_time() - start);
+    stats->commands++;
+    stats->wait_us += waited;
+    stats->busy_us += waited - (uint32_t)blocked_us;
+    if (waited > stats->max_wait_us) {
+        stats->max_wait_us = waited;
+    }
+    if (status != RC522_OK) {
+        stats->timeouts++;
+    }
+    return status;
 }
 
 static int rc522_picc_request(rc522_handle_t *handle, uint8_t req_mode, uint8_t *tag_type) {
     uint8_t back_len;
     int status;
     
-    rc522_write_reg(handle, RC522_REG_BIT_FRAMING, 0x07);
-    
+    // REQA/WUPA: quadro curto de 7 bits
     tag_type[0] = req_mode;
-    status = rc522_communicate_with_picc(handle, RC522_CMD_TRANSCEIVE, tag_type, 1, tag_type, &back_len, NULL);
+    status = rc522_communicate_with_picc(handle, RC522_CMD_TRANSCEIVE, 0x07, tag_type, 1, tag_type, &back_len, NULL);
     
-    if ((status != RC522_OK) || (back_len != 0x10)) {
+    // ATQA diferentes de vários cartões colidem, mas há cartão no campo
+    if ((status != RC522_OK && status != RC522_ERR_COLLISION) || (back_len != 0x10)) {
         status = RC522_ERR_NO_CARD;
+    } else {
+        status = RC522_OK;
     }
     
     return status;
 }
 
-static int rc522_picc_anticoll(rc522_handle_t *handle, uint8_t *serial_num) {
-    int status;
-    uint8_t i;
-    uint8_t ser_chk = 0;
+// Anticolisão de um nível da cascata (sel = 0x93/0x95/0x97): envia os bits
+// já conhecidos (NVB) e, numa colisão, fixa o bit disputado em 1 e repete
+// com os bits até ele; devolve os 4 bytes do nível e o BCC
+static int rc522_picc_anticoll(rc522_handle_t *handle, uint8_t sel, uint8_t *serial_num) {
+    uint8_t frame[7] = {sel};
+    uint8_t back[16];
     uint8_t back_len;
-    uint8_t send_data[2];
+    uint8_t known = 0;      // bits de UID/BCC já conhecidos
     
-    rc522_write_reg(handle, RC522_REG_BIT_FRAMING, 0x00);
+    while (1) {
+        uint8_t full = known / 8;
+        uint8_t tx_bits = known % 8;
+        uint8_t index = 2 + full;
+        
+        // NVB: bytes (SEL, NVB e UID completos) e bits do último byte
+        frame[1] = (index << 4) | tx_bits;
+        // RxAlign = TxLastBits: a resposta continua no bit seguinte
+        int status = rc522_communicate_with_picc(handle, RC522_CMD_TRANSCEIVE, (tx_bits << 4) | tx_bits,
+                                                 frame, index + (tx_bits ? 1 : 0), back, &back_len, NULL);
+        if (status != RC522_OK && status != RC522_ERR_COLLISION) {
+            return status;
+        }
+        
+        // Juntar a resposta aos bits conhecidos; o primeiro byte recebido
+        // só vale a partir de RxAlign
+        uint8_t keep = (1 << tx_bits) - 1;
+        frame[index] = (frame[index] & keep) | (back[0] & ~keep);
+        for (uint8_t i = 1; index + i < sizeof(frame); i++) {
+            frame[index + i] = back[i];
+        }
+        
+        if (status == RC522_OK) {
+            break;
+        }
+        
+        // CollPos: 1..31, 0 = bit 32; CollPosNotValid = fora do quadro
+        uint8_t coll = handle->last_coll;
+        uint8_t pos = coll & 0x1F;
+        if (coll & 0x20) {
+            return RC522_ERR_COLLISION;
+        }
+        if (pos == 0) {
+            pos = 32;
+        }
+        if (pos <= known) {
+            return RC522_ERR_COLLISION;
+        }
+        known = pos;
+        frame[2 + (known - 1) / 8] |= 1 << ((known - 1) % 8);
+        // Bits depois do escolhido vêm na próxima resposta
+        if (known % 8) {
+            frame[2 + (known - 1) / 8] &= (1 << (known % 8)) - 1;
+        }
+        for (uint8_t i = 2 + (known + 7) / 8; i < sizeof(frame); i++) {
+            frame[i] = 0;
+        }
+    }
     
-    send_data[0] = 0x93;
-    send_data[1] = 0x20;
+    // Verificar checksum
+    if ((frame[2] ^ frame[3] ^ frame[4] ^ frame[5]) != frame[6]) {
+        return RC522_ERR_CRC;
+    }
+    memcpy(serial_num, &frame[2], 5);
     
-    status = rc522_communicate_with_picc(handle, RC522_CMD_TRANSCEIVE, send_data, 2, serial_num, &back_len, NULL);
+    return RC522_OK;
+}
+
+// SELECT de um nível: UID + BCC com CRC_A; a resposta é o SAK com CRC_A
+static int rc522_picc_select(rc522_handle_t *handle, uint8_t sel, const uint8_t *serial_num, uint8_t *sak) {
+    uint8_t frame[9];
+    uint8_t back[16];
+    uint8_t back_len;
     
-    if (status == RC522_OK) {
-        // Verificar checksum
-        for (i = 0; i < 4; i++) {
-            ser_chk ^= serial_num[i];
-        }
-        if (ser_chk != serial_num[i]) {
-            status = RC522_ERR_CRC;
-        }
+    frame[0] = sel;
+    frame[1] = 0x70;
+    memcpy(&frame[2], serial_num, 5);   // UID e BCC da anticolisão
+    uint16_t crc = rc522_crc_a(frame, 7);
+    frame[7] = crc & 0xFF;
+    frame[8] = crc >> 8;
+    
+    int status = rc522_communicate_with_picc(handle, RC522_CMD_TRANSCEIVE, 0x00, frame, 9, back, &back_len, NULL);
+    if (status != RC522_OK) {
+        return status;
+    }
+    if (back_len != 24) {
+        return RC522_ERR_NO_CARD;
+    }
+    crc = rc522_crc_a(back, 1);
+    if (back[1] != (crc & 0xFF) || back[2] != (crc >> 8)) {
+        return RC522_ERR_CRC;
     }
     
-    return status;
+    *sak = back[0];
+    return RC522_OK;
+}
+
+// CRC_A da ISO14443-3 (polinômio 0x8408, início 0x6363), byte baixo primeiro
+static uint16_t rc522_crc_a(const uint8_t *data, uint8_t len) {
+    uint16_t crc = 0x6363;
+    
+    for (uint8_t i = 0; i < len; i++) {
+        uint8_t b = data[i] ^ (uint8_t)(crc & 0xFF);
+        b ^= b << 4;
+        crc = (crc >> 8) ^ ((uint16_t)b << 8) ^ ((uint16_t)b << 3) ^ (b >> 4);
+    }
+    
+    return crc;
 }
@@ -3,6 +3,8 @@
 
 #include "driver/spi_master.h"
 #include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 // #define RC522_SPI_BUS_GPIO_MISO    (37)
 // #define RC522_SPI_BUS_GPIO_MOSI    (35)
@@ -11,13 +13,36 @@
 // #define RC522_SCANNER_GPIO_RST     (-1) // soft-reset
 
 
-// Pinos para ESP32-S3
+// Pinos para ESP32-S3 (barramento compartilhado por todos os leitores; CS,
+// IRQ e RST abaixo são os do leitor padrão, ver rc522_config_t)
 #define RC522_SPI_HOST          SPI2_HOST
 #define RC522_PIN_MISO          37
 #define RC522_PIN_MOSI          35
 #define RC522_PIN_CLK           36
 #define RC522_PIN_CS            39
 #define RC522_PIN_RST           -1
+#define RC522_PIN_IRQ           -1      // IRQ do RC522 (ex.: 40); -1 = espera por polling
+
+// Timeout de hardware de cada comando: o timer do RC522 parte no fim do
+// envio (TAuto) com passos de ~0,5ms; o cartão responde REQA, anticolisão
+// e SELECT em menos de 1ms, então 5ms ainda deixa espaço para repetir
+#define RC522_TIMER_RELOAD      10
+
+// Espera do comando pelo pino IRQ: o pino cai com RxIRq, IdleIRq ou
+// TimerIRq (o timeout acima) e a task dorme numa notificação;
+// RC522_IRQ_WAIT_MS só cobre um pino desligado ou perdido
+#define RC522_COMM_IE_WAIT      0xB1    // IRqInv | RxIEn | IdleIEn | TimerIEn
+#define RC522_IRQ_WAIT_MS       10
+
+// Detecção -> UID: REQA/WUPA, anticolisão e SELECT sem pausas, repetindo do
+// WUPA em caso de falha; o orçamento só conta leituras acima dele
+#define RC522_SELECT_ATTEMPTS   3
+#define RC522_UID_BUDGET_US     15000
+
+// Transações SPI: a FIFO é enchida e esvaziada num quadro só, e sequências
+// de escritas vão enfileiradas em lote (até RC522_SPI_QUEUE_SIZE)
+#define RC522_SPI_QUEUE_SIZE    7
+#define RC522_FIFO_SIZE         64
 
 // Comandos RC522
 #define RC522_CMD_IDLE          0x00
@@ -31,6 +56,13 @@
 #define RC522_CMD_AUTH          0x0E
 #define RC522_CMD_SOFT_RESET    0x0F
 
+// Comandos ISO14443A para o cartão
+#define RC522_PICC_REQA         0x26
+#define RC522_PICC_WUPA         0x52
+#define RC522_PICC_SEL_CL1      0x93    // níveis da cascata: 4, 7 e 10 bytes
+#define RC522_PICC_SEL_CL2      0x95
+#define RC522_PICC_SEL_CL3      0x97
+
 // Registradores RC522
 #define RC522_REG_COMMAND       0x01
 #define RC522_REG_COMM_IE       0x02
@@ -85,19 +117,82 @@ typedef struct {
     uint8_t sak;
 } rc522_card_t;
 
+// Espera dos comandos (transceive/auth), nos dois modos
+typedef struct {
+    uint32_t commands;
+    uint32_t timeouts;
+    uint32_t irq_wakeups;       // acordadas pelo pino IRQ
+    uint32_t irq_missed;        // concluídos sem a borda do IRQ (pego na leitura final)
+    uint32_t status_reads;      // leituras de COMM_IRQ durante a espera
+    uint32_t max_wait_us;
+    uint64_t wait_us;           // disparo -> conclusão, somado
+    uint64_t busy_us;           // parte da espera fora da notificação (CPU/SPI)
+    uint32_t spi_transactions;
+    uint32_t card_reads;        // rc522_read_card com sucesso
+    uint32_t read_spi;          // transações SPI nessas leituras, somadas
+    uint64_t read_us;           // duração dessas leituras, somada
+    uint32_t polls;             // rc522_card_present
+    uint64_t uid_us;            // detecção -> UID, somado
+    uint32_t max_uid_us;        // maior detecção -> UID
+    uint32_t over_budget;       // leituras acima de RC522_UID_BUDGET_US
+} rc522_stats_t;
+
+// Tempos por estágio da última leitura (detecção -> UID), somando tentativas
+typedef struct {
+    uint32_t request_us;        // REQA/WUPA até o ATQA
+    uint32_t anticoll_us;
+    uint32_t select_us;
+    uint32_t total_us;          // início do REQA/WUPA que achou o cartão -> UID
+    uint16_t request_spi;       // transações SPI de cada estágio
+    uint16_t anticoll_spi;
+    uint16_t select_spi;
+    uint8_t attempts;
+    uint8_t levels;             // níveis da cascata (1, 2 ou 3)
+    bool reused_atqa;           // partiu do ATQA de rc522_card_present
+} rc522_trace_t;
+
+// Um leitor no barramento RC522_SPI_HOST: CS próprio e IRQ/RST opcionais
+typedef struct {
+    uint8_t id;
+    int pin_cs;
+    int pin_irq;                // -1 = espera por polling
+    int pin_rst;                // -1 = só soft reset
+} rc522_config_t;
+
+#define RC522_CONFIG_DEFAULT() { \
+    .id = 0, \
+    .pin_cs = RC522_PIN_CS, \
+    .pin_irq = RC522_PIN_IRQ, \
+    .pin_rst = RC522_PIN_RST, \
+}
+
 typedef struct {
     spi_device_handle_t spi_handle;
+    rc522_config_t config;
     bool initialized;
+    bool irq_mode;                      // false = polling de COMM_IRQ
+    volatile TaskHandle_t waiter;       // task notificada pela ISR
+    bool card_ready;                    // último REQA/WUPA respondido: cartão em READY
+    uint8_t last_coll;                  // CollReg do último comando com colisão
+    int64_t detect_us;                  // início desse REQA/WUPA
+    uint32_t detect_request_us;         // duração dele
+    uint16_t detect_request_spi;        // e as transações SPI dele
+    rc522_trace_t trace;
+    rc522_stats_t stats;
 } rc522_handle_t;
 
 // Funções públicas
 esp_err_t rc522_init(rc522_handle_t *handle);
+esp_err_t rc522_init_with_config(rc522_handle_t *handle, const rc522_config_t *config);
 esp_err_t rc522_deinit(rc522_handle_t *handle);
 esp_err_t rc522_test_communication(rc522_handle_t *handle);
 int rc522_card_present(rc522_handle_t *handle);
 int rc522_read_card(rc522_handle_t *handle, rc522_card_t *card);
 esp_err_t rc522_read_card_uid(rc522_handle_t *handle, char *uid_str, size_t uid_str_size);
+void rc522_uid_to_string(const rc522_card_t *card, char *uid_str, size_t uid_str_size);
 void rc522_antenna_on(rc522_handle_t *handle);
 void rc522_antenna_off(rc522_handle_t *handle);
+esp_err_t rc522_get_stats(rc522_handle_t *handle, rc522_stats_t *stats);
+esp_err_t rc522_get_trace(rc522_handle_t *handle, rc522_trace_t *trace);
 
 #endif // RC522_H
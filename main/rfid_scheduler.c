@@ -0,0 +1,252 @@
+#include "rfid_scheduler.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "RFID_SCHED";
+
+typedef enum {
+    READER_IDLE,        // sem cartão: WUPA a cada intervalo do leitor
+    READER_PENDING,     // cartão visto sem UID: próximo da vez
+    READER_PRESENT,     // UID já entregue: só espera a remoção
+} rfid_reader_state_t;
+
+typedef struct {
+    uint32_t polls;
+    uint32_t scans;
+    uint32_t read_failures;
+    uint32_t dropped;
+    uint64_t lag_us;
+    uint32_t max_lag_us;
+} rfid_reader_counters_t;
+
+typedef struct {
+    rc522_handle_t *handle;
+    rfid_reader_state_t state;
+    int64_t next_poll_us;
+    uint8_t tries;              // PENDING: leituras sem UID
+    uint8_t misses;             // PRESENT: WUPAs seguidos sem resposta
+    rfid_reader_counters_t counters;    // só a task do escalonador mexe
+    rfid_reader_counters_t published;   // cópias para outras tasks, sob s_stats_lock
+    rc522_stats_t published_driver;
+} rfid_reader_t;
+
+static rfid_reader_t s_readers[RFID_MAX_READERS];
+// Os contadores de 64 bits (aqui e no rc522_stats_t) rasgariam numa leitura
+// sem trava no núcleo de 32 bits: o escalonador publica uma cópia ao fim de
+// cada turno
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static size_t s_count = 0;
+static size_t s_next = 0;       // rodízio entre leitores vencidos
+static int64_t s_started_us = 0;
+static QueueHandle_t s_events = NULL;
+static TaskHandle_t s_task = NULL;
+
+static uint32_t rfid_reader_interval_ms(const rfid_reader_t *reader) {
+    if (reader->state == READER_PRESENT) {
+        return RFID_PRESENT_POLL_MS;
+    }
+    return reader->handle->irq_mode ? RFID_POLL_IRQ_MS : RFID_POLL_MS;
+}
+
+// Próximo leitor a partir do rodízio: PENDING primeiro, depois o primeiro
+// com prazo vencido; NULL se nenhum venceu
+static rfid_reader_t *rfid_scheduler_pick(int64_t now) {
+    rfid_reader_t *due = NULL;
+    size_t due_index = 0;
+
+    for (size_t k = 0; k < s_count; k++) {
+        size_t i = (s_next + k) % s_count;
+        rfid_reader_t *reader = &s_readers[i];
+        if (reader->state == READER_PENDING) {
+            s_next = (i + 1) % s_count;
+            return reader;
+        }
+        if (!due && reader->next_poll_us <= now) {
+            due = reader;
+            due_index = i;
+        }
+    }
+    if (due) {
+        s_next = (due_index + 1) % s_count;
+    }
+    return due;
+}
+
+static void rfid_scheduler_emit(rfid_reader_t *reader, const rc522_card_t *card) {
+    rfid_scan_event_t event = {
+        .reader_id = reader->handle->config.id,
+        .uid_len = card->uid_len,
+        .sak = card->sak,
+        .latency_us = reader->handle->trace.total_us,
+        .timestamp_us = esp_timer_get_time(),
+    };
+    rc522_uid_to_string(card, event.uid, sizeof(event.uid));
+
+    reader->counters.scans++;
+    if (xQueueSend(s_events, &event, 0) != pdTRUE) {
+        reader->counters.dropped++;
+        ESP_LOGW(TAG, "Fila de eventos cheia, leitura de %s no leitor %d descartada",
+                 event.uid, event.reader_id);
+    }
+}
+
+static void rfid_scheduler_publish(rfid_reader_t *reader) {
+    taskENTER_CRITICAL(&s_stats_lock);
+    reader->published = reader->counters;
+    reader->published_driver = reader->handle->stats;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+static void rfid_scheduler_poll(rfid_reader_t *reader, int64_t now) {
+    rc522_handle_t *handle = reader->handle;
+    rfid_reader_counters_t *counters = &reader->counters;
+    rc522_card_t card;
+
+    if (reader->state != READER_PENDING && now > reader->next_poll_us) {
+        uint32_t lag = (uint32_t)(now - reader->next_poll_us);
+        counters->lag_us += lag;
+        if (lag > counters->max_lag_us) {
+            counters->max_lag_us = lag;
+        }
+    }
+    counters->polls++;
+
+    int status = rc522_card_present(handle);
+    if (reader->state == READER_PRESENT) {
+        // O cartão selecionado ignora o primeiro WUPA, então só duas
+        // falhas seguidas contam como remoção
+        reader->misses = (status == RC522_OK) ? 0 : reader->misses + 1;
+        if (reader->misses >= 2) {
+            reader->state = READER_IDLE;
+        }
+    } else if (status == RC522_OK) {
+        // Do ATQA direto para o UID, no mesmo turno do leitor
+        if (rc522_read_card(handle, &card) == RC522_OK) {
+            rfid_scheduler_emit(reader, &card);
+            reader->state = READER_PRESENT;
+            reader->misses = 0;
+            reader->tries = 0;
+        } else if (++reader->tries >= RFID_PENDING_TRIES) {
+            counters->read_failures++;
+            reader->state = READER_IDLE;
+            reader->tries = 0;
+        } else {
+            reader->state = READER_PENDING;
+        }
+    } else {
+        reader->state = READER_IDLE;
+        reader->tries = 0;
+    }
+
+    reader->next_poll_us = esp_timer_get_time() + (int64_t)rfid_reader_interval_ms(reader) * 1000;
+    rfid_scheduler_publish(reader);
+}
+
+static void rfid_scheduler_task(void *pvParameters) {
+    ESP_LOGI(TAG, "Escalonador iniciado com %d leitor(es)", (int)s_count);
+
+    while (1) {
+        int64_t now = esp_timer_get_time();
+        rfid_reader_t *reader = rfid_scheduler_pick(now);
+        if (reader) {
+            rfid_scheduler_poll(reader, now);
+            continue;
+        }
+
+        // Nenhum vencido: dormir até o prazo mais próximo
+        int64_t earliest = s_readers[0].next_poll_us;
+        for (size_t i = 1; i < s_count; i++) {
+            if (s_readers[i].next_poll_us < earliest) {
+                earliest = s_readers[i].next_poll_us;
+            }
+        }
+        TickType_t ticks = pdMS_TO_TICKS((earliest - now + 999) / 1000);
+        vTaskDelay(ticks > 0 ? ticks : 1);
+    }
+}
+
+esp_err_t rfid_scheduler_start(rc522_handle_t *readers, size_t count) {
+    if (s_task) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (count == 0 || count > RFID_MAX_READERS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_events = xQueueCreate(RFID_EVENT_QUEUE_LEN, sizeof(rfid_scan_event_t));
+    if (!s_events) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(s_readers, 0, sizeof(s_readers));
+    s_started_us = esp_timer_get_time();
+    for (size_t i = 0; i < count; i++) {
+        s_readers[i].handle = &readers[i];
+        s_readers[i].state = READER_IDLE;
+        s_readers[i].next_poll_us = s_started_us;
+    }
+    s_count = count;
+    s_next = 0;
+
+    if (xTaskCreate(rfid_scheduler_task, "rfid_sched", 4096, NULL, 5, &s_task) != pdPASS) {
+        vQueueDelete(s_events);
+        s_events = NULL;
+        s_count = 0;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t rfid_scheduler_receive(rfid_scan_event_t *event, TickType_t wait) {
+    if (!s_events) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return xQueueReceive(s_events, event, wait) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+size_t rfid_scheduler_reader_count(void) {
+    return s_count;
+}
+
+esp_err_t rfid_scheduler_get_stats(size_t index, rfid_reader_stats_t *stats) {
+    if (index >= s_count || !stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    rfid_reader_t *reader = &s_readers[index];
+    rfid_reader_counters_t counters;
+    rc522_stats_t rc;
+    taskENTER_CRITICAL(&s_stats_lock);
+    counters = reader->published;
+    rc = reader->published_driver;
+    taskEXIT_CRITICAL(&s_stats_lock);
+
+    int64_t elapsed = esp_timer_get_time() - s_started_us;
+    uint32_t divisor = counters.polls > 0 ? counters.polls : 1;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->reader_id = reader->handle->config.id;
+    stats->polls = counters.polls;
+    stats->poll_hz = elapsed > 0 ? (uint32_t)((uint64_t)counters.polls * 1000000 / elapsed) : 0;
+    stats->scans = counters.scans;
+    stats->read_failures = counters.read_failures;
+    stats->dropped = counters.dropped;
+    stats->avg_lag_us = (uint32_t)(counters.lag_us / divisor);
+    stats->max_lag_us = counters.max_lag_us;
+    stats->avg_uid_us = rc.card_reads ? (uint32_t)(rc.uid_us / rc.card_reads) : 0;
+    stats->max_uid_us = rc.max_uid_us;
+    return ESP_OK;
+}
+
+esp_err_t rfid_scheduler_get_driver_stats(size_t index, rc522_stats_t *stats) {
+    if (index >= s_count || !stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    taskENTER_CRITICAL(&s_stats_lock);
+    *stats = s_readers[index].published_driver;
+    taskEXIT_CRITICAL(&s_stats_lock);
+    return ESP_OK;
+}
@@ -0,0 +1,55 @@
+#ifndef RFID_SCHEDULER_H
+#define RFID_SCHEDULER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "rc522.h"
+
+// Escalonador de leitores: uma task só fala com todos os RC522 do
+// barramento, um comando por vez. Cada leitor tem um prazo para o próximo
+// WUPA; entre os vencidos a vez gira entre os leitores, e um leitor que viu
+// cartão mas ainda não leu o UID passa na frente. Cartão já lido só é
+// verificado a cada RFID_PRESENT_POLL_MS até sair do campo. Cada UID lido
+// vira um evento com o id do leitor numa fila (rfid_scheduler_receive), e
+// o acesso ao banco fica fora da task do barramento.
+#define RFID_MAX_READERS        4
+#define RFID_POLL_MS            100     // leitor com polling: a espera ocupa a CPU
+#define RFID_POLL_IRQ_MS        10      // leitor com IRQ: o WUPA vazio dorme
+#define RFID_PRESENT_POLL_MS    100     // cartão lido, esperando remoção
+#define RFID_PENDING_TRIES      3       // leituras seguidas com cartão visto e sem UID
+#define RFID_EVENT_QUEUE_LEN    8
+#define RFID_UID_STR_LEN        32
+
+typedef struct {
+    uint8_t reader_id;
+    char uid[RFID_UID_STR_LEN];
+    uint8_t uid_len;
+    uint8_t sak;
+    uint32_t latency_us;        // detecção -> UID
+    int64_t timestamp_us;
+} rfid_scan_event_t;
+
+typedef struct {
+    uint8_t reader_id;
+    uint32_t polls;
+    uint32_t poll_hz;           // média desde o início
+    uint32_t scans;             // eventos gerados
+    uint32_t read_failures;     // cartão visto sem UID depois de RFID_PENDING_TRIES
+    uint32_t dropped;           // eventos perdidos com a fila cheia
+    uint32_t avg_lag_us;        // atraso do WUPA em relação ao prazo (barramento ocupado)
+    uint32_t max_lag_us;
+    uint32_t avg_uid_us;        // detecção -> UID
+    uint32_t max_uid_us;
+} rfid_reader_stats_t;
+
+esp_err_t rfid_scheduler_start(rc522_handle_t *readers, size_t count);
+esp_err_t rfid_scheduler_receive(rfid_scan_event_t *event, TickType_t wait);
+size_t rfid_scheduler_reader_count(void);
+esp_err_t rfid_scheduler_get_stats(size_t index, rfid_reader_stats_t *stats);
+// rc522_stats_t do leitor como publicado no último turno do escalonador;
+// fora da task do barramento use esta em vez de rc522_get_stats
+esp_err_t rfid_scheduler_get_driver_stats(size_t index, rc522_stats_t *stats);
+
+#endif // RFID_SCHEDULER_H
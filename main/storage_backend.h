@@ -0,0 +1,133 @@
+#ifndef STORAGE_BACKEND_H
+#define STORAGE_BACKEND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Armazenamento chave/valor usado pelo banco de dados. Todas as
+// implementações seguem a semântica do NVS: chaves de até 15 caracteres,
+// valores binários, ESP_ERR_NOT_FOUND para chave inexistente e gravações
+// confirmadas por commit().
+#define STORAGE_KEY_MAX_LEN  15
+
+// Retorna false para interromper a iteração
+typedef bool (*storage_iter_cb_t)(const char *key, size_t value_len, void *ctx);
+
+typedef struct {
+    const char *name;
+    esp_err_t (*open)(void *ctx, const char *name_space);
+    void (*close)(void *ctx);
+    // value == NULL retorna só o tamanho em *len; buffer pequeno -> ESP_ERR_INVALID_SIZE
+    esp_err_t (*get)(void *ctx, const char *key, void *value, size_t *len);
+    esp_err_t (*set)(void *ctx, const char *key, const void *value, size_t len);
+    esp_err_t (*erase)(void *ctx, const char *key);
+    esp_err_t (*commit)(void *ctx);
+    // Chaves que começam com 'prefix' ("" = todas); a ordem não é definida
+    esp_err_t (*iterate)(void *ctx, const char *prefix, storage_iter_cb_t cb, void *cb_ctx);
+    void *ctx;
+} storage_backend_t;
+
+// NVS (padrão)
+const storage_backend_t *storage_nvs_backend(void);
+// NVS numa partição só do banco, inicializada no open (shards)
+const storage_backend_t *storage_nvs_partition_backend(const char *partition_label);
+// Entradas NVS usadas/total da partição; ESP_ERR_NOT_SUPPORTED fora do NVS
+esp_err_t storage_nvs_usage(const storage_backend_t *be, size_t *used_entries, size_t *total_entries);
+// Log chave/valor numa partição de dados crua (ver partitions.csv)
+#define STORAGE_RAW_PARTITION_LABEL    "rfidkv"
+#define STORAGE_RAW_PARTITION_SUBTYPE  0x42
+const storage_backend_t *storage_raw_backend(const char *partition_label);
+// Tabela em RAM, opcionalmente gravada num arquivo no commit (path NULL =
+// só RAM). Pensado para o alvo linux do ESP-IDF e benchmarks no host. Cada
+// chamada cria uma instância nova (NULL sem memória), liberada com
+// storage_file_backend_free depois do close.
+const storage_backend_t *storage_file_backend(const char *path);
+void storage_file_backend_free(const storage_backend_t *backend);
+
+// Chaves distribuídas entre vários backends (shards), cada um com as
+// próprias páginas, tabela de hash e coleta de lixo do NVS. Chaves que
+// terminam em número (c_<slot>, n_<slot>, snap_<n>, wal_<n>) vão para o
+// shard número % count; as demais (card_count, free_slots...) ficam no
+// shard 0. O número de shards fica gravado no shard 0 ("shard_count") e
+// não muda depois; na primeira abertura as chaves de 'legacy' (banco sem
+// shards, pode ser NULL) são copiadas e apagadas de lá.
+#define STORAGE_SHARD_MAX   8
+
+typedef struct {
+    const char *name;
+    uint32_t gets;
+    uint32_t sets;
+    uint32_t erases;
+    size_t used_entries;        // 0/0 se o backend não informa
+    size_t total_entries;
+} storage_shard_stats_t;
+
+const storage_backend_t *storage_shard_backend(const storage_backend_t *const *shards, uint32_t count,
+                                               const storage_backend_t *legacy);
+// Preenche até 'max' shards; retorna quantos existem
+uint32_t storage_shard_get_stats(storage_shard_stats_t *stats, uint32_t max);
+
+// Journal de escrita antecipada sobre outro backend. Depois de
+// storage_journal_begin, set/erase ficam num grupo em RAM até o próximo
+// commit: o grupo é gravado como um registro com CRC e número de sequência
+// (chaves "wal_<n>", anel de STORAGE_JOURNAL_SLOTS), aplicado ao backend e
+// só então confirmado. No open só os registros após o último checkpoint
+// são refeitos, sem validar o resto do banco. Fora de um grupo as chamadas
+// passam direto. Um registro gravado cuja aplicação falha fica pendente:
+// as leituras já o enxergam e as gravações seguintes falham até ele ser
+// aplicado; com o armazenamento cheio só passa um grupo que apaga chaves,
+// gravado junto com o pendente para liberar o espaço.
+#define STORAGE_JOURNAL_SLOTS       4
+#define STORAGE_JOURNAL_MAX_RECORD  4000    // grupos maiores são aplicados sem journal
+
+typedef struct {
+    uint32_t seq;               // último registro gravado
+    uint32_t records;           // grupos gravados desde o open
+    uint32_t bytes;
+    uint32_t unjournaled;       // grupos grandes demais, aplicados direto
+    uint32_t replayed;          // registros refeitos no open
+    uint32_t deferred;          // aplicações adiadas (armazenamento cheio etc.)
+    bool pending;               // há registro esperando aplicação; gravações falham
+    uint32_t recovery_us;
+} storage_journal_stats_t;
+
+const storage_backend_t *storage_journal_backend(const storage_backend_t *inner);
+// Abre um grupo; false se já havia um aberto (o commit fecha o de fora)
+bool storage_journal_begin(void);
+// Descarta o grupo aberto sem gravar nada
+void storage_journal_abort(void);
+void storage_journal_get_stats(storage_journal_stats_t *stats);
+
+static inline esp_err_t storage_get(const storage_backend_t *be, const char *key, void *value, size_t *len) {
+    return be->get(be->ctx, key, value, len);
+}
+
+static inline esp_err_t storage_set(const storage_backend_t *be, const char *key, const void *value, size_t len) {
+    return be->set(be->ctx, key, value, len);
+}
+
+static inline esp_err_t storage_erase(const storage_backend_t *be, const char *key) {
+    return be->erase(be->ctx, key);
+}
+
+static inline esp_err_t storage_commit(const storage_backend_t *be) {
+    return be->commit(be->ctx);
+}
+
+static inline esp_err_t storage_iterate(const storage_backend_t *be, const char *prefix,
+                                        storage_iter_cb_t cb, void *cb_ctx) {
+    return be->iterate(be->ctx, prefix, cb, cb_ctx);
+}
+
+static inline esp_err_t storage_get_u32(const storage_backend_t *be, const char *key, uint32_t *value) {
+    size_t len = sizeof(*value);
+    return be->get(be->ctx, key, value, &len);
+}
+
+static inline esp_err_t storage_set_u32(const storage_backend_t *be, const char *key, uint32_t value) {
+    return be->set(be->ctx, key, &value, sizeof(value));
+}
+
+#endif // STORAGE_BACKEND_H
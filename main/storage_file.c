@@ -0,0 +1,285 @@
+#include "storage_backend.h"
+#include "card_index.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+// Tabela chave/valor em RAM. Com 'path' definido, o conteúdo é carregado
+// no open e regravado inteiro no commit (arquivo temporário + rename, então
+// uma queda deixa a versão anterior). Sem 'path' é só RAM, útil para medir
+// o banco no host sem o custo do flash.
+typedef struct {
+    char key[STORAGE_KEY_MAX_LEN + 1];
+    uint8_t *value;         // NULL = entrada apagada
+    size_t len;
+} file_entry_t;
+
+typedef struct {
+    storage_backend_t backend;  // ctx aponta para a própria instância
+    char *path;                 // NULL = só RAM
+    file_entry_t *entries;
+    uint32_t entry_count;
+    uint32_t entry_capacity;
+    card_index_t index;     // hash da chave -> entrada
+    bool dirty;
+} storage_file_t;
+
+typedef struct {
+    storage_file_t *file;
+    const char *key;
+} file_key_match_t;
+
+static bool file_key_matches(uint16_t id, void *ctx) {
+    file_key_match_t *match = (file_key_match_t *)ctx;
+    return id < match->file->entry_count && strcmp(match->file->entries[id].key, match->key) == 0;
+}
+
+static file_entry_t *file_find(storage_file_t *file, const char *key) {
+    uint16_t id;
+    file_key_match_t match = { .file = file, .key = key };
+    if (!card_index_find(&file->index, card_index_hash(key, strlen(key)), file_key_matches, &match, &id)) {
+        return NULL;
+    }
+    return &file->entries[id];
+}
+
+static esp_err_t file_put(storage_file_t *file, const char *key, const void *value, size_t len) {
+    size_t key_len = strlen(key);
+    if (key_len == 0 || key_len > STORAGE_KEY_MAX_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t *copy = malloc(len ? len : 1);
+    if (!copy) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (len > 0) {
+        memcpy(copy, value, len);
+    }
+
+    file_entry_t *entry = file_find(file, key);
+    if (entry) {
+        free(entry->value);
+        entry->value = copy;
+        entry->len = len;
+        file->dirty = true;
+        return ESP_OK;
+    }
+
+    if (file->entry_count > CARD_INDEX_MAX_SLOT) {
+        free(copy);
+        return ESP_ERR_NO_MEM;
+    }
+    if (file->entry_count == file->entry_capacity) {
+        uint32_t new_capacity = file->entry_capacity ? file->entry_capacity * 2 : 64;
+        file_entry_t *entries = realloc(file->entries, new_capacity * sizeof(file_entry_t));
+        if (!entries) {
+            free(copy);
+            return ESP_ERR_NO_MEM;
+        }
+        file->entries = entries;
+        file->entry_capacity = new_capacity;
+    }
+    esp_err_t ret = card_index_insert(&file->index, card_index_hash(key, key_len), (uint16_t)file->entry_count);
+    if (ret != ESP_OK) {
+        free(copy);
+        return ret;
+    }
+    entry = &file->entries[file->entry_count++];
+    memcpy(entry->key, key, key_len + 1);
+    entry->value = copy;
+    entry->len = len;
+    file->dirty = true;
+    return ESP_OK;
+}
+
+static void file_clear(storage_file_t *file) {
+    for (uint32_t i = 0; i < file->entry_count; i++) {
+        free(file->entries[i].value);
+    }
+    free(file->entries);
+    card_index_free(&file->index);
+    file->entries = NULL;
+    file->entry_count = 0;
+    file->entry_capacity = 0;
+}
+
+// Formato: sequência de [u8 key_len][chave][u32 len][valor]
+static esp_err_t file_load(storage_file_t *file) {
+    FILE *f = fopen(file->path, "rb");
+    if (!f) {
+        return ESP_OK; // primeira execução
+    }
+    esp_err_t ret = ESP_OK;
+    uint8_t key_len;
+    while (ret == ESP_OK && fread(&key_len, 1, 1, f) == 1) {
+        char key[STORAGE_KEY_MAX_LEN + 1];
+        uint32_t len = 0;
+        if (key_len == 0 || key_len > STORAGE_KEY_MAX_LEN ||
+            fread(key, 1, key_len, f) != key_len || fread(&len, sizeof(len), 1, f) != 1) {
+            ret = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+        key[key_len] = '\0';
+        uint8_t *value = malloc(len ? len : 1);
+        if (!value) {
+            ret = ESP_ERR_NO_MEM;
+        } else if (fread(value, 1, len, f) != len) {
+            ret = ESP_ERR_INVALID_SIZE;
+        } else {
+            ret = file_put(file, key, value, len);
+        }
+        free(value);
+    }
+    fclose(f);
+    if (ret != ESP_OK) {
+        printf("storage_file: %s corrompido, ignorando o restante\n", file->path);
+    }
+    file->dirty = false;
+    return ESP_OK;
+}
+
+static esp_err_t file_save(storage_file_t *file) {
+    char tmp_path[256];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", file->path);
+    FILE *f = fopen(tmp_path, "wb");
+    if (!f) {
+        return ESP_FAIL;
+    }
+    bool ok = true;
+    for (uint32_t i = 0; i < file->entry_count && ok; i++) {
+        const file_entry_t *entry = &file->entries[i];
+        if (!entry->value) {
+            continue;
+        }
+        uint8_t key_len = (uint8_t)strlen(entry->key);
+        uint32_t len = (uint32_t)entry->len;
+        ok = fwrite(&key_len, 1, 1, f) == 1 &&
+             fwrite(entry->key, 1, key_len, f) == key_len &&
+             fwrite(&len, sizeof(len), 1, f) == 1 &&
+             fwrite(entry->value, 1, len, f) == len;
+    }
+    if (fclose(f) != 0 || !ok) {
+        remove(tmp_path);
+        return ESP_FAIL;
+    }
+    return rename(tmp_path, file->path) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t storage_file_open(void *ctx, const char *name_space) {
+    (void)name_space; // um arquivo por banco
+    storage_file_t *file = (storage_file_t *)ctx;
+    if (!file->path && file->index.tags) {
+        return ESP_OK; // só RAM: o conteúdo sobrevive a close/open
+    }
+    file_clear(file);
+    esp_err_t ret = card_index_init(&file->index, 64);
+    if (ret != ESP_OK || !file->path) {
+        return ret;
+    }
+    return file_load(file);
+}
+
+static void storage_file_close(void *ctx) {
+    storage_file_t *file = (storage_file_t *)ctx;
+    if (file->path) {
+        file_clear(file);
+    }
+}
+
+static esp_err_t storage_file_get(void *ctx, const char *key, void *value, size_t *len) {
+    file_entry_t *entry = file_find((storage_file_t *)ctx, key);
+    if (!entry || !entry->value) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (value) {
+        if (*len < entry->len) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(value, entry->value, entry->len);
+    }
+    *len = entry->len;
+    return ESP_OK;
+}
+
+static esp_err_t storage_file_set(void *ctx, const char *key, const void *value, size_t len) {
+    return file_put((storage_file_t *)ctx, key, value, len);
+}
+
+// A entrada fica no índice com valor NULL; o arquivo só grava as vivas
+static esp_err_t storage_file_erase(void *ctx, const char *key) {
+    storage_file_t *file = (storage_file_t *)ctx;
+    file_entry_t *entry = file_find(file, key);
+    if (!entry || !entry->value) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    free(entry->value);
+    entry->value = NULL;
+    entry->len = 0;
+    file->dirty = true;
+    return ESP_OK;
+}
+
+static esp_err_t storage_file_commit(void *ctx) {
+    storage_file_t *file = (storage_file_t *)ctx;
+    if (!file->path || !file->dirty) {
+        return ESP_OK;
+    }
+    esp_err_t ret = file_save(file);
+    if (ret == ESP_OK) {
+        file->dirty = false;
+    }
+    return ret;
+}
+
+static esp_err_t storage_file_iterate(void *ctx, const char *prefix, storage_iter_cb_t cb, void *cb_ctx) {
+    storage_file_t *file = (storage_file_t *)ctx;
+    size_t prefix_len = strlen(prefix);
+    for (uint32_t i = 0; i < file->entry_count; i++) {
+        const file_entry_t *entry = &file->entries[i];
+        if (entry->value && strncmp(entry->key, prefix, prefix_len) == 0 &&
+            !cb(entry->key, entry->len, cb_ctx)) {
+            break;
+        }
+    }
+    return ESP_OK;
+}
+
+static const storage_backend_t s_file_backend = {
+    .name = "file",
+    .open = storage_file_open,
+    .close = storage_file_close,
+    .get = storage_file_get,
+    .set = storage_file_set,
+    .erase = storage_file_erase,
+    .commit = storage_file_commit,
+    .iterate = storage_file_iterate,
+};
+
+// Cada chamada cria uma instância própria (vários bancos no mesmo processo,
+// ex. benchmarks e testes no host)
+const storage_backend_t *storage_file_backend(const char *path) {
+    storage_file_t *file = calloc(1, sizeof(*file));
+    if (!file) {
+        return NULL;
+    }
+    if (path) {
+        file->path = strdup(path);
+        if (!file->path) {
+            free(file);
+            return NULL;
+        }
+    }
+    file->backend = s_file_backend;
+    file->backend.ctx = file;
+    return &file->backend;
+}
+
+void storage_file_backend_free(const storage_backend_t *backend) {
+    if (!backend || backend->open != storage_file_open) {
+        return;
+    }
+    storage_file_t *file = (storage_file_t *)backend->ctx;
+    file_clear(file);
+    free(file->path);
+    free(file);
+}
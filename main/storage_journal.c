@@ -0,0 +1,668 @@
+#include "storage_backend.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+// Journal de escrita antecipada (redo) sobre outro backend. Um grupo guarda
+// a última gravação de cada chave; no commit vira um registro
+//   [cabeçalho][u8 key_len][u8 flags][u16 value_len][chave][valor]...
+// gravado em "wal_<seq % SLOTS>" antes de tocar nas chaves do grupo. O
+// checkpoint ("wal_ckpt") diz até qual sequência tudo já foi aplicado; ele
+// só é gravado antes da primeira gravação fora do journal, então refazer
+// os registros seguintes em ordem é idempotente. Antes de gravar um
+// registro novo o pendente (aplicação interrompida por erro) é refeito,
+// logo no máximo o último registro do anel está incompleto no flash.
+//
+// Gravado o registro, o grupo está confirmado: se a aplicação falha (p.ex.
+// armazenamento cheio) ele fica pendente em RAM, as leituras o enxergam e
+// as gravações seguintes falham até ele ser aplicado. Com ESP_ERR_NO_MEM o
+// journal libera os slots já aplicados do anel, e um grupo que apaga
+// chaves é fundido ao pendente no mesmo slot (a troca da chave é atômica),
+// com os apagamentos aplicados primeiro: é assim que o espaço volta.
+#define JOURNAL_MAGIC        0x4A57      // "WJ"
+#define JOURNAL_VERSION      1
+#define JOURNAL_KEY_PREFIX   "wal_"
+#define JOURNAL_CKPT_KEY     "wal_ckpt"
+#define JOURNAL_FLAG_ERASE   0x01
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t reserved;
+    uint32_t seq;
+    uint16_t entry_count;
+    uint16_t reserved2;
+    uint32_t len;           // bytes após o cabeçalho
+    uint32_t crc;           // cabeçalho (até len) + entradas
+} journal_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t key_len;
+    uint8_t flags;
+    uint16_t value_len;
+} journal_entry_header_t;
+
+#define JOURNAL_HEADER_CRC_LEN  offsetof(journal_header_t, crc)
+
+typedef struct {
+    char key[STORAGE_KEY_MAX_LEN + 1];
+    bool erase;
+    uint8_t *value;
+    size_t len;
+} journal_op_t;
+
+typedef struct {
+    const storage_backend_t *inner;
+    bool open;
+    bool group;             // grupo aberto por storage_journal_begin
+    journal_op_t *ops;
+    uint32_t op_count;
+    uint32_t op_capacity;
+    size_t group_bytes;     // tamanho do registro serializado
+    uint32_t seq;           // último registro gravado
+    uint32_t checkpoint;    // valor de wal_ckpt no flash
+    bool pending;           // registro 'seq' gravado e ainda não aplicado por inteiro
+    uint8_t *pending_record; // cópia do registro pendente (cabeçalho + entradas)
+    storage_journal_stats_t stats;
+} storage_journal_t;
+
+static storage_journal_t s_journal;
+
+static void journal_slot_key(uint32_t seq, char *key, size_t key_size) {
+    snprintf(key, key_size, JOURNAL_KEY_PREFIX "%" PRIu32, seq % STORAGE_JOURNAL_SLOTS);
+}
+
+static uint32_t journal_crc(const journal_header_t *hdr, const uint8_t *payload) {
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)hdr, JOURNAL_HEADER_CRC_LEN);
+    return esp_rom_crc32_le(crc, payload, hdr->len);
+}
+
+static void journal_group_clear(storage_journal_t *j) {
+    for (uint32_t i = 0; i < j->op_count; i++) {
+        free(j->ops[i].value);
+    }
+    j->op_count = 0;
+    j->group_bytes = sizeof(journal_header_t);
+    j->group = false;
+}
+
+static bool journal_group_erases(const storage_journal_t *j) {
+    for (uint32_t i = 0; i < j->op_count; i++) {
+        if (j->ops[i].erase) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static journal_op_t *journal_group_find(storage_journal_t *j, const char *key) {
+    for (uint32_t i = 0; i < j->op_count; i++) {
+        if (strcmp(j->ops[i].key, key) == 0) {
+            return &j->ops[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t journal_group_put(storage_journal_t *j, const char *key, const void *value, size_t len, bool erase) {
+    size_t key_len = strlen(key);
+    if (key_len == 0 || key_len > STORAGE_KEY_MAX_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (len > UINT16_MAX) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    uint8_t *copy = NULL;
+    if (len > 0) {
+        copy = malloc(len);
+        if (!copy) {
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(copy, value, len);
+    }
+
+    journal_op_t *op = journal_group_find(j, key);
+    if (op) {
+        // Só a última gravação da chave vai para o registro
+        j->group_bytes -= op->len;
+        free(op->value);
+    } else {
+        if (j->op_count == j->op_capacity) {
+            uint32_t new_capacity = j->op_capacity ? j->op_capacity * 2 : 8;
+            journal_op_t *ops = realloc(j->ops, new_capacity * sizeof(journal_op_t));
+            if (!ops) {
+                free(copy);
+                return ESP_ERR_NO_MEM;
+            }
+            j->ops = ops;
+            j->op_capacity = new_capacity;
+        }
+        op = &j->ops[j->op_count++];
+        memcpy(op->key, key, key_len + 1);
+        j->group_bytes += sizeof(journal_entry_header_t) + key_len;
+    }
+    op->erase = erase;
+    op->value = copy;
+    op->len = len;
+    j->group_bytes += len;
+    return ESP_OK;
+}
+
+// Percorre as entradas de um registro já validado; 'cb' retorna false para parar
+typedef bool (*journal_entry_cb_t)(const char *key, const journal_entry_header_t *entry,
+                                   const uint8_t *value, void *ctx);
+
+static esp_err_t journal_record_foreach(const uint8_t *record, journal_entry_cb_t cb, void *ctx) {
+    journal_header_t hdr;
+    memcpy(&hdr, record, sizeof(hdr));
+    const uint8_t *payload = &record[sizeof(hdr)];
+    size_t pos = 0;
+    for (uint16_t i = 0; i < hdr.entry_count; i++) {
+        journal_entry_header_t entry;
+        if (pos + sizeof(entry) > hdr.len) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(&entry, &payload[pos], sizeof(entry));
+        pos += sizeof(entry);
+        if (entry.key_len == 0 || entry.key_len > STORAGE_KEY_MAX_LEN ||
+            pos + entry.key_len + entry.value_len > hdr.len) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        char key[STORAGE_KEY_MAX_LEN + 1];
+        memcpy(key, &payload[pos], entry.key_len);
+        key[entry.key_len] = '\0';
+        pos += entry.key_len;
+        if (!cb(key, &entry, &payload[pos], ctx)) {
+            break;
+        }
+        pos += entry.value_len;
+    }
+    return ESP_OK;
+}
+
+typedef struct {
+    const storage_backend_t *inner;
+    bool erases;            // passada dos apagamentos ou das gravações
+    esp_err_t ret;
+} journal_apply_t;
+
+static bool journal_apply_cb(const char *key, const journal_entry_header_t *entry, const uint8_t *value, void *ctx) {
+    journal_apply_t *apply = (journal_apply_t *)ctx;
+    bool erase = entry->flags & JOURNAL_FLAG_ERASE;
+    if (erase != apply->erases) {
+        return true;
+    }
+    if (erase) {
+        apply->ret = storage_erase(apply->inner, key);
+        if (apply->ret == ESP_ERR_NOT_FOUND) {
+            apply->ret = ESP_OK;
+        }
+    } else {
+        apply->ret = storage_set(apply->inner, key, value, entry->value_len);
+    }
+    return apply->ret == ESP_OK;
+}
+
+// Aplica um registro já validado. Cada chave aparece uma vez no registro,
+// então os apagamentos vão antes e liberam espaço para as gravações.
+static esp_err_t journal_replay(storage_journal_t *j, const uint8_t *record) {
+    journal_apply_t apply = { .inner = j->inner, .erases = true, .ret = ESP_OK };
+    esp_err_t ret = journal_record_foreach(record, journal_apply_cb, &apply);
+    if (ret == ESP_OK && apply.ret == ESP_OK) {
+        apply.erases = false;
+        ret = journal_record_foreach(record, journal_apply_cb, &apply);
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return apply.ret == ESP_OK ? storage_commit(j->inner) : apply.ret;
+}
+
+// Lê e valida o registro do slot; *record fica com o buffer (free pelo chamador)
+static esp_err_t journal_load_slot(storage_journal_t *j, uint32_t slot, uint8_t **record) {
+    char key[16];
+    journal_slot_key(slot, key, sizeof(key));
+    size_t len = 0;
+    esp_err_t ret = storage_get(j->inner, key, NULL, &len);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (len < sizeof(journal_header_t)) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    uint8_t *buf = malloc(len);
+    if (!buf) {
+        return ESP_ERR_NO_MEM;
+    }
+    ret = storage_get(j->inner, key, buf, &len);
+    if (ret != ESP_OK) {
+        free(buf);
+        return ret;
+    }
+    journal_header_t hdr;
+    memcpy(&hdr, buf, sizeof(hdr));
+    if (hdr.magic != JOURNAL_MAGIC || hdr.version != JOURNAL_VERSION ||
+        hdr.len != len - sizeof(hdr) || hdr.crc != journal_crc(&hdr, &buf[sizeof(hdr)])) {
+        free(buf);
+        return ESP_ERR_INVALID_CRC;
+    }
+    *record = buf;
+    return ESP_OK;
+}
+
+// Registro gravado que não pôde ser aplicado: fica em RAM até o próximo
+// journal_settle (ou o próximo boot) conseguir aplicá-lo
+static void journal_keep_pending(storage_journal_t *j, uint8_t *record, esp_err_t err) {
+    free(j->pending_record);
+    j->pending_record = record;
+    j->pending = true;
+    j->stats.deferred++;
+    printf("storage_journal: registro %" PRIu32 " pendente: %s\n", j->seq, esp_err_to_name(err));
+}
+
+static void journal_clear_pending(storage_journal_t *j) {
+    free(j->pending_record);
+    j->pending_record = NULL;
+    j->pending = false;
+}
+
+// Armazenamento cheio: os slots do anel além do pendente já foram
+// aplicados e podem sair do flash
+static void journal_reclaim(storage_journal_t *j) {
+    for (uint32_t slot = 0; slot < STORAGE_JOURNAL_SLOTS; slot++) {
+        if (slot == j->seq % STORAGE_JOURNAL_SLOTS) {
+            continue;
+        }
+        char key[16];
+        journal_slot_key(slot, key, sizeof(key));
+        storage_erase(j->inner, key);
+    }
+    storage_commit(j->inner);
+}
+
+// Refaz o registro cuja aplicação falhou
+static esp_err_t journal_settle(storage_journal_t *j) {
+    if (!j->pending) {
+        return ESP_OK;
+    }
+    esp_err_t ret = journal_replay(j, j->pending_record);
+    if (ret == ESP_ERR_NO_MEM) {
+        journal_reclaim(j);
+        ret = journal_replay(j, j->pending_record);
+    }
+    if (ret == ESP_OK) {
+        journal_clear_pending(j);
+    }
+    return ret;
+}
+
+typedef struct {
+    storage_journal_t *j;
+    esp_err_t ret;
+} journal_merge_t;
+
+// Entradas do pendente que o grupo não sobrescreve entram no grupo
+static bool journal_merge_cb(const char *key, const journal_entry_header_t *entry, const uint8_t *value, void *ctx) {
+    journal_merge_t *merge = (journal_merge_t *)ctx;
+    if (journal_group_find(merge->j, key)) {
+        return true;
+    }
+    merge->ret = journal_group_put(merge->j, key, value, entry->value_len, entry->flags & JOURNAL_FLAG_ERASE);
+    return merge->ret == ESP_OK;
+}
+
+typedef struct {
+    const char *key;
+    bool found;
+    journal_entry_header_t entry;
+    const uint8_t *value;
+} journal_lookup_t;
+
+static bool journal_lookup_cb(const char *key, const journal_entry_header_t *entry, const uint8_t *value, void *ctx) {
+    journal_lookup_t *lookup = (journal_lookup_t *)ctx;
+    if (strcmp(key, lookup->key) != 0) {
+        return true;
+    }
+    lookup->found = true;
+    lookup->entry = *entry;
+    lookup->value = value;
+    return false;
+}
+
+// Antes de uma gravação fora do journal: refazer os registros a partir do
+// checkpoint deixaria de ser idempotente, então ele avança
+static esp_err_t journal_mark(storage_journal_t *j) {
+    esp_err_t ret = journal_settle(j);
+    if (ret != ESP_OK || j->checkpoint == j->seq) {
+        return ret;
+    }
+    ret = storage_set_u32(j->inner, JOURNAL_CKPT_KEY, j->seq);
+    if (ret == ESP_OK) {
+        j->checkpoint = j->seq;
+    }
+    return ret;
+}
+
+// Serializa o grupo, grava o registro e aplica
+static esp_err_t journal_group_commit(storage_journal_t *j) {
+    esp_err_t ret = journal_settle(j);
+    bool merged = false;
+    if (ret == ESP_ERR_NO_MEM && journal_group_erases(j)) {
+        // O grupo pode liberar espaço: vai junto com o pendente, no lugar dele
+        journal_merge_t merge = { .j = j, .ret = ESP_OK };
+        journal_record_foreach(j->pending_record, journal_merge_cb, &merge);
+        ret = merge.ret;
+        merged = true;
+    }
+    if (ret != ESP_OK) {
+        journal_group_clear(j);
+        return ret;
+    }
+
+    if (j->op_count == 0) {
+        journal_group_clear(j);
+        return storage_commit(j->inner);
+    }
+    if (j->group_bytes > STORAGE_JOURNAL_MAX_RECORD && merged) {
+        journal_group_clear(j);
+        return ESP_ERR_NO_MEM;   // o pendente não pode ser aplicado sem journal
+    }
+    if (j->group_bytes > STORAGE_JOURNAL_MAX_RECORD) {
+        printf("storage_journal: grupo de %u bytes aplicado sem journal\n", (unsigned)j->group_bytes);
+        ret = journal_mark(j);
+        for (uint32_t i = 0; i < j->op_count && ret == ESP_OK; i++) {
+            const journal_op_t *op = &j->ops[i];
+            ret = op->erase ? storage_erase(j->inner, op->key) : storage_set(j->inner, op->key, op->value, op->len);
+            if (ret == ESP_ERR_NOT_FOUND && op->erase) {
+                ret = ESP_OK;
+            }
+        }
+        journal_group_clear(j);
+        j->stats.unjournaled++;
+        return ret == ESP_OK ? storage_commit(j->inner) : ret;
+    }
+
+    uint8_t *record = malloc(j->group_bytes);
+    if (!record) {
+        journal_group_clear(j);
+        return ESP_ERR_NO_MEM;
+    }
+    journal_header_t hdr = {
+        .magic = JOURNAL_MAGIC,
+        .version = JOURNAL_VERSION,
+        .seq = merged ? j->seq : j->seq + 1,
+        .entry_count = (uint16_t)j->op_count,
+        .len = (uint32_t)(j->group_bytes - sizeof(journal_header_t)),
+    };
+    size_t pos = sizeof(hdr);
+    for (uint32_t i = 0; i < j->op_count; i++) {
+        const journal_op_t *op = &j->ops[i];
+        journal_entry_header_t entry = {
+            .key_len = (uint8_t)strlen(op->key),
+            .flags = op->erase ? JOURNAL_FLAG_ERASE : 0,
+            .value_len = (uint16_t)op->len,
+        };
+        memcpy(&record[pos], &entry, sizeof(entry));
+        pos += sizeof(entry);
+        memcpy(&record[pos], op->key, entry.key_len);
+        pos += entry.key_len;
+        if (op->len > 0) {
+            memcpy(&record[pos], op->value, op->len);
+            pos += op->len;
+        }
+    }
+    hdr.crc = journal_crc(&hdr, &record[sizeof(hdr)]);
+    memcpy(record, &hdr, sizeof(hdr));
+
+    // O registro precisa estar no flash antes da primeira chave do grupo
+    char key[16];
+    journal_slot_key(hdr.seq, key, sizeof(key));
+    ret = storage_set(j->inner, key, record, j->group_bytes);
+    if (ret == ESP_OK) {
+        ret = storage_commit(j->inner);
+    }
+    if (ret != ESP_OK) {
+        free(record);
+        journal_group_clear(j);
+        return ret;
+    }
+    j->seq = hdr.seq;
+    j->stats.records++;
+    j->stats.bytes += j->group_bytes;
+    journal_group_clear(j);
+    if (merged) {
+        journal_clear_pending(j);
+    }
+
+    // Daqui em diante o grupo está confirmado, aplicado agora ou depois
+    ret = journal_replay(j, record);
+    if (ret == ESP_OK) {
+        free(record);
+    } else {
+        journal_keep_pending(j, record, ret);
+    }
+    return ESP_OK;
+}
+
+// Refaz os registros do anel posteriores ao checkpoint, em ordem
+static esp_err_t journal_recover(storage_journal_t *j) {
+    int64_t start = esp_timer_get_time();
+    uint32_t checkpoint = 0;
+    storage_get_u32(j->inner, JOURNAL_CKPT_KEY, &checkpoint);
+    j->checkpoint = checkpoint;
+    j->seq = checkpoint;
+
+    uint8_t *records[STORAGE_JOURNAL_SLOTS] = { NULL };
+    uint32_t seqs[STORAGE_JOURNAL_SLOTS];
+    uint32_t count = 0;
+    for (uint32_t slot = 0; slot < STORAGE_JOURNAL_SLOTS; slot++) {
+        uint8_t *record = NULL;
+        if (journal_load_slot(j, slot, &record) != ESP_OK) {
+            continue;   // vazio ou gravação interrompida
+        }
+        journal_header_t hdr;
+        memcpy(&hdr, record, sizeof(hdr));
+        if (hdr.seq > j->seq) {
+            j->seq = hdr.seq;
+        }
+        if (hdr.seq <= checkpoint) {
+            free(record);
+            continue;
+        }
+        // Inserção ordenada por sequência
+        uint32_t i = count++;
+        while (i > 0 && seqs[i - 1] > hdr.seq) {
+            seqs[i] = seqs[i - 1];
+            records[i] = records[i - 1];
+            i--;
+        }
+        seqs[i] = hdr.seq;
+        records[i] = record;
+    }
+
+    esp_err_t ret = ESP_OK;
+    for (uint32_t i = 0; i < count; i++) {
+        if (ret == ESP_OK) {
+            ret = journal_replay(j, records[i]);
+            if (ret != ESP_OK && i + 1 == count) {
+                // Só o último pode estar pendente: o banco abre vendo o registro
+                j->seq = seqs[i];
+                journal_keep_pending(j, records[i], ret);
+                records[i] = NULL;
+                ret = ESP_OK;
+            }
+        }
+        free(records[i]);
+    }
+    if (ret == ESP_OK && count > 0 && !j->pending) {
+        ret = journal_mark(j);
+        if (ret == ESP_ERR_NO_MEM) {
+            ret = ESP_OK;   // cheio: os registros são refeitos de novo no próximo boot
+        } else if (ret == ESP_OK) {
+            ret = storage_commit(j->inner);
+        }
+    }
+    j->stats.replayed = count;
+    j->stats.recovery_us = (uint32_t)(esp_timer_get_time() - start);
+    if (count > 0) {
+        printf("storage_journal: %" PRIu32 " registros refeitos em %" PRIu32 " us (seq %" PRIu32 ")\n",
+               count, j->stats.recovery_us, j->seq);
+    }
+    return ret;
+}
+
+static esp_err_t storage_journal_open(void *ctx, const char *name_space) {
+    storage_journal_t *j = (storage_journal_t *)ctx;
+    esp_err_t ret = j->inner->open(j->inner->ctx, name_space);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    memset(&j->stats, 0, sizeof(j->stats));
+    journal_clear_pending(j);
+    journal_group_clear(j);
+    ret = journal_recover(j);
+    if (ret != ESP_OK) {
+        printf("storage_journal: erro ao refazer o journal: %s\n", esp_err_to_name(ret));
+        j->inner->close(j->inner->ctx);
+        return ret;
+    }
+    j->open = true;
+    return ESP_OK;
+}
+
+static void storage_journal_close(void *ctx) {
+    storage_journal_t *j = (storage_journal_t *)ctx;
+    journal_group_clear(j);
+    // Fechamento limpo: o próximo boot não refaz nada
+    if (j->open && journal_mark(j) == ESP_OK) {
+        storage_commit(j->inner);
+    }
+    journal_clear_pending(j);   // se sobrou, o boot refaz do anel
+    free(j->ops);
+    j->ops = NULL;
+    j->op_capacity = 0;
+    j->open = false;
+    j->inner->close(j->inner->ctx);
+}
+
+static esp_err_t journal_copy_value(const void *src, size_t src_len, bool erase, void *value, size_t *len) {
+    if (erase) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (value) {
+        if (*len < src_len) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(value, src, src_len);
+    }
+    *len = src_len;
+    return ESP_OK;
+}
+
+// A leitura vê as gravações do grupo e as do registro pendente, ainda não
+// aplicadas
+static esp_err_t storage_journal_get(void *ctx, const char *key, void *value, size_t *len) {
+    storage_journal_t *j = (storage_journal_t *)ctx;
+    const journal_op_t *op = j->group ? journal_group_find(j, key) : NULL;
+    if (op) {
+        return journal_copy_value(op->value, op->len, op->erase, value, len);
+    }
+    if (j->pending) {
+        journal_lookup_t lookup = { .key = key, .found = false };
+        journal_record_foreach(j->pending_record, journal_lookup_cb, &lookup);
+        if (lookup.found) {
+            return journal_copy_value(lookup.value, lookup.entry.value_len,
+                                      lookup.entry.flags & JOURNAL_FLAG_ERASE, value, len);
+        }
+    }
+    return storage_get(j->inner, key, value, len);
+}
+
+static esp_err_t storage_journal_set(void *ctx, const char *key, const void *value, size_t len) {
+    storage_journal_t *j = (storage_journal_t *)ctx;
+    if (j->group) {
+        return journal_group_put(j, key, value, len, false);
+    }
+    esp_err_t ret = journal_mark(j);
+    return ret == ESP_OK ? storage_set(j->inner, key, value, len) : ret;
+}
+
+// No grupo a chave pode nem existir; o apagamento é aplicado no commit
+static esp_err_t storage_journal_erase(void *ctx, const char *key) {
+    storage_journal_t *j = (storage_journal_t *)ctx;
+    if (j->group) {
+        return journal_group_put(j, key, NULL, 0, true);
+    }
+    esp_err_t ret = journal_mark(j);
+    return ret == ESP_OK ? storage_erase(j->inner, key) : ret;
+}
+
+static esp_err_t storage_journal_commit(void *ctx) {
+    storage_journal_t *j = (storage_journal_t *)ctx;
+    if (j->group) {
+        return journal_group_commit(j);
+    }
+    return storage_commit(j->inner);
+}
+
+typedef struct {
+    storage_iter_cb_t cb;
+    void *cb_ctx;
+} journal_iter_t;
+
+static bool journal_iter_cb(const char *key, size_t value_len, void *ctx) {
+    journal_iter_t *it = (journal_iter_t *)ctx;
+    if (strncmp(key, JOURNAL_KEY_PREFIX, sizeof(JOURNAL_KEY_PREFIX) - 1) == 0) {
+        return true;
+    }
+    return it->cb(key, value_len, it->cb_ctx);
+}
+
+// Chaves do journal ficam ocultas; gravações do grupo aberto e do registro
+// pendente não aparecem
+static esp_err_t storage_journal_iterate(void *ctx, const char *prefix, storage_iter_cb_t cb, void *cb_ctx) {
+    storage_journal_t *j = (storage_journal_t *)ctx;
+    journal_iter_t it = { .cb = cb, .cb_ctx = cb_ctx };
+    return storage_iterate(j->inner, prefix, journal_iter_cb, &it);
+}
+
+static storage_backend_t s_journal_backend = {
+    .name = NULL,
+    .open = storage_journal_open,
+    .close = storage_journal_close,
+    .get = storage_journal_get,
+    .set = storage_journal_set,
+    .erase = storage_journal_erase,
+    .commit = storage_journal_commit,
+    .iterate = storage_journal_iterate,
+    .ctx = &s_journal,
+};
+
+const storage_backend_t *storage_journal_backend(const storage_backend_t *inner) {
+    s_journal.inner = inner;
+    s_journal_backend.name = inner->name;
+    return &s_journal_backend;
+}
+
+bool storage_journal_begin(void) {
+    if (!s_journal.open || s_journal.group) {
+        return false;
+    }
+    s_journal.group = true;
+    return true;
+}
+
+void storage_journal_abort(void) {
+    if (s_journal.group) {
+        journal_group_clear(&s_journal);
+    }
+}
+
+void storage_journal_get_stats(storage_journal_stats_t *stats) {
+    *stats = s_journal.stats;
+    stats->seq = s_journal.seq;
+    stats->pending = s_journal.pending;
+}
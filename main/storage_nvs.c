@@ -0,0 +1,206 @@
+#include "storage_backend.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include <string.h>
+#include <stdio.h>
+
+typedef struct {
+    nvs_handle_t handle;
+    char name_space[16];
+    char partition[16];     // "" = partição padrão (já inicializada pelo sistema)
+    bool open;
+} storage_nvs_t;
+
+static storage_nvs_t s_nvs;
+
+// Partições próprias (shards): inicializadas no primeiro open
+static storage_nvs_t s_nvs_parts[STORAGE_SHARD_MAX];
+static storage_backend_t s_nvs_part_backends[STORAGE_SHARD_MAX];
+static uint32_t s_nvs_part_count = 0;
+
+static inline const char *nvs_partition_name(const storage_nvs_t *nvs) {
+    return nvs->partition[0] ? nvs->partition : NVS_DEFAULT_PART_NAME;
+}
+
+static esp_err_t nvs_map_err(esp_err_t ret) {
+    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (ret == ESP_ERR_NVS_INVALID_LENGTH) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (ret == ESP_ERR_NVS_NOT_ENOUGH_SPACE) {
+        return ESP_ERR_NO_MEM;  // partição cheia, como no backend cru
+    }
+    return ret;
+}
+
+static esp_err_t storage_nvs_open(void *ctx, const char *name_space) {
+    storage_nvs_t *nvs = (storage_nvs_t *)ctx;
+    esp_err_t ret;
+    if (nvs->partition[0]) {
+        // Partição só do banco: pode ser apagada se estiver num formato antigo
+        ret = nvs_flash_init_partition(nvs->partition);
+        if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+            printf("Partição %s apagada (%s)\n", nvs->partition, esp_err_to_name(ret));
+            ret = nvs_flash_erase_partition(nvs->partition);
+            if (ret == ESP_OK) {
+                ret = nvs_flash_init_partition(nvs->partition);
+            }
+        }
+        if (ret == ESP_OK) {
+            ret = nvs_open_from_partition(nvs->partition, name_space, NVS_READWRITE, &nvs->handle);
+        }
+    } else {
+        // nvs_flash_init fica a cargo de quem inicializa o sistema (Wi-Fi também usa)
+        ret = nvs_open(name_space, NVS_READWRITE, &nvs->handle);
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    strncpy(nvs->name_space, name_space, sizeof(nvs->name_space) - 1);
+    nvs->open = true;
+    return ESP_OK;
+}
+
+static void storage_nvs_close(void *ctx) {
+    storage_nvs_t *nvs = (storage_nvs_t *)ctx;
+    if (nvs->open) {
+        nvs_close(nvs->handle);
+        nvs->open = false;
+    }
+}
+
+// Bancos gravados antes do backend guardavam card_count/db_version como
+// u32/u8; o NVS recusa ler ou regravar a chave com outro tipo
+static esp_err_t storage_nvs_get_legacy(storage_nvs_t *nvs, const char *key, void *value, size_t *len) {
+    uint32_t v32 = 0;
+    uint8_t v8 = 0;
+    esp_err_t ret = nvs_get_u32(nvs->handle, key, &v32);
+    if (ret != ESP_OK) {
+        ret = nvs_get_u8(nvs->handle, key, &v8);
+        if (ret != ESP_OK) {
+            return nvs_map_err(ret);
+        }
+        v32 = v8;
+    }
+    if (value && *len < sizeof(v32)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (value) {
+        memcpy(value, &v32, sizeof(v32));
+    }
+    *len = sizeof(v32);
+    return ESP_OK;
+}
+
+static esp_err_t storage_nvs_get(void *ctx, const char *key, void *value, size_t *len) {
+    storage_nvs_t *nvs = (storage_nvs_t *)ctx;
+    esp_err_t ret = nvs_get_blob(nvs->handle, key, value, len);
+    if (ret == ESP_ERR_NVS_TYPE_MISMATCH) {
+        return storage_nvs_get_legacy(nvs, key, value, len);
+    }
+    return nvs_map_err(ret);
+}
+
+static esp_err_t storage_nvs_set(void *ctx, const char *key, const void *value, size_t len) {
+    storage_nvs_t *nvs = (storage_nvs_t *)ctx;
+    esp_err_t ret = nvs_set_blob(nvs->handle, key, value, len);
+    if (ret != ESP_ERR_NVS_TYPE_MISMATCH) {
+        return nvs_map_err(ret);
+    }
+    // Chave antiga u32/u8: regravar no mesmo tipo (apagar e recriar como
+    // blob deixaria card_count ausente numa queda entre as duas operações)
+    if (len == sizeof(uint32_t)) {
+        uint32_t v32;
+        uint32_t old32;
+        uint8_t old8;
+        memcpy(&v32, value, sizeof(v32));
+        if (nvs_get_u32(nvs->handle, key, &old32) == ESP_OK) {
+            return nvs_map_err(nvs_set_u32(nvs->handle, key, v32));
+        }
+        if (v32 <= UINT8_MAX && nvs_get_u8(nvs->handle, key, &old8) == ESP_OK) {
+            return nvs_map_err(nvs_set_u8(nvs->handle, key, (uint8_t)v32));
+        }
+    }
+    nvs_erase_key(nvs->handle, key);
+    return nvs_map_err(nvs_set_blob(nvs->handle, key, value, len));
+}
+
+static esp_err_t storage_nvs_erase(void *ctx, const char *key) {
+    storage_nvs_t *nvs = (storage_nvs_t *)ctx;
+    return nvs_map_err(nvs_erase_key(nvs->handle, key));
+}
+
+static esp_err_t storage_nvs_commit(void *ctx) {
+    storage_nvs_t *nvs = (storage_nvs_t *)ctx;
+    return nvs_commit(nvs->handle);
+}
+
+static esp_err_t storage_nvs_iterate(void *ctx, const char *prefix, storage_iter_cb_t cb, void *cb_ctx) {
+    storage_nvs_t *nvs = (storage_nvs_t *)ctx;
+    size_t prefix_len = strlen(prefix);
+    nvs_iterator_t it = NULL;
+    esp_err_t ret = nvs_entry_find(nvs_partition_name(nvs), nvs->name_space, NVS_TYPE_ANY, &it);
+    while (ret == ESP_OK) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        if (strncmp(info.key, prefix, prefix_len) == 0) {
+            size_t len = 0;
+            if (storage_nvs_get(nvs, info.key, NULL, &len) == ESP_OK && !cb(info.key, len, cb_ctx)) {
+                break;
+            }
+        }
+        ret = nvs_entry_next(&it);
+    }
+    nvs_release_iterator(it);
+    return ret == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : nvs_map_err(ret);
+}
+
+static const storage_backend_t s_nvs_backend = {
+    .name = "nvs",
+    .open = storage_nvs_open,
+    .close = storage_nvs_close,
+    .get = storage_nvs_get,
+    .set = storage_nvs_set,
+    .erase = storage_nvs_erase,
+    .commit = storage_nvs_commit,
+    .iterate = storage_nvs_iterate,
+    .ctx = &s_nvs,
+};
+
+const storage_backend_t *storage_nvs_backend(void) {
+    return &s_nvs_backend;
+}
+
+const storage_backend_t *storage_nvs_partition_backend(const char *partition_label) {
+    for (uint32_t i = 0; i < s_nvs_part_count; i++) {
+        if (strcmp(s_nvs_parts[i].partition, partition_label) == 0) {
+            return &s_nvs_part_backends[i];
+        }
+    }
+    if (s_nvs_part_count >= STORAGE_SHARD_MAX || strlen(partition_label) >= sizeof(s_nvs_parts[0].partition)) {
+        return NULL;
+    }
+    storage_nvs_t *nvs = &s_nvs_parts[s_nvs_part_count];
+    storage_backend_t *be = &s_nvs_part_backends[s_nvs_part_count];
+    strcpy(nvs->partition, partition_label);
+    *be = s_nvs_backend;
+    be->name = nvs->partition;
+    be->ctx = nvs;
+    s_nvs_part_count++;
+    return be;
+}
+
+esp_err_t storage_nvs_usage(const storage_backend_t *be, size_t *used_entries, size_t *total_entries) {
+    if (be->open != storage_nvs_open) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    nvs_stats_t stats;
+    esp_err_t ret = nvs_get_stats(nvs_partition_name((const storage_nvs_t *)be->ctx), &stats);
+    if (ret == ESP_OK) {
+        *used_entries = stats.used_entries;
+        *total_entries = stats.total_entries;
+    }
+    return ret;
+}
@@ -0,0 +1,473 @@
+#include "storage_backend.h"
+#include "card_index.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+// Log chave/valor numa partição crua. A partição é dividida em duas metades;
+// a ativa tem um cabeçalho com geração e registros acrescentados em
+// sequência (o último valor de cada chave vale, lápide apaga). Quando a
+// metade enche, os registros vivos são copiados para a outra e a geração
+// sobe. Um índice em RAM (card_index) aponta cada chave para o seu último
+// registro.
+#define RAW_SECTOR_SIZE      4096
+#define RAW_HALF_MAGIC       0x31564B52  // "RKV1"
+#define RAW_RECORD_MAGIC     0x4B56      // "VK"
+#define RAW_ERASED_MAGIC     0xFFFF
+#define RAW_FLAG_TOMBSTONE   0x01
+#define RAW_COPY_CHUNK       256
+#define RAW_NO_OFFSET        UINT32_MAX
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t generation;
+    uint32_t reserved;
+    uint32_t crc;
+} raw_half_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t key_len;
+    uint8_t flags;
+    uint16_t value_len;
+    uint16_t reserved;
+    uint32_t crc;           // cabeçalho (até reserved) + chave + valor
+} raw_record_header_t;
+
+#define RAW_HEADER_CRC_LEN   offsetof(raw_record_header_t, crc)
+
+typedef struct {
+    const char *label;
+    const esp_partition_t *partition;
+    uint32_t half_size;
+    uint32_t active;        // 0 ou 1
+    uint32_t generation;
+    uint32_t write_pos;     // relativo ao início da metade ativa
+    uint32_t live_bytes;    // registros vivos (estimativa para a compactação)
+    uint32_t *offsets;      // id -> registro na metade ativa
+    uint32_t entry_count;
+    uint32_t entry_capacity;
+    card_index_t index;     // hash da chave -> id
+} storage_raw_t;
+
+static storage_raw_t s_raw;
+
+typedef struct {
+    storage_raw_t *raw;
+    const char *key;
+    size_t key_len;
+} raw_key_match_t;
+
+static inline uint32_t raw_align(uint32_t len) {
+    return (len + 3) & ~3u;
+}
+
+static inline uint32_t raw_record_size(const raw_record_header_t *hdr) {
+    return raw_align(sizeof(*hdr) + hdr->key_len + hdr->value_len);
+}
+
+static inline uint32_t raw_half_base(const storage_raw_t *raw, uint32_t half) {
+    return half * raw->half_size;
+}
+
+static esp_err_t raw_read(storage_raw_t *raw, uint32_t pos, void *data, size_t len) {
+    return esp_partition_read(raw->partition, raw_half_base(raw, raw->active) + pos, data, len);
+}
+
+// CRC do registro lido do flash em blocos (valores podem ser grandes)
+static esp_err_t raw_record_crc(storage_raw_t *raw, uint32_t half, uint32_t pos,
+                                const raw_record_header_t *hdr, uint32_t *crc) {
+    uint8_t chunk[RAW_COPY_CHUNK];
+    uint32_t c = esp_rom_crc32_le(0, (const uint8_t *)hdr, RAW_HEADER_CRC_LEN);
+    uint32_t remaining = hdr->key_len + hdr->value_len;
+    uint32_t addr = raw_half_base(raw, half) + pos + sizeof(*hdr);
+    while (remaining > 0) {
+        uint32_t n = remaining < sizeof(chunk) ? remaining : sizeof(chunk);
+        esp_err_t ret = esp_partition_read(raw->partition, addr, chunk, n);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        c = esp_rom_crc32_le(c, chunk, n);
+        addr += n;
+        remaining -= n;
+    }
+    *crc = c;
+    return ESP_OK;
+}
+
+static bool raw_key_matches(uint16_t id, void *ctx) {
+    raw_key_match_t *match = (raw_key_match_t *)ctx;
+    storage_raw_t *raw = match->raw;
+    if (id >= raw->entry_count || raw->offsets[id] == RAW_NO_OFFSET) {
+        return false;
+    }
+    raw_record_header_t hdr;
+    char key[STORAGE_KEY_MAX_LEN];
+    if (raw_read(raw, raw->offsets[id], &hdr, sizeof(hdr)) != ESP_OK ||
+        hdr.key_len != match->key_len ||
+        raw_read(raw, raw->offsets[id] + sizeof(hdr), key, hdr.key_len) != ESP_OK) {
+        return false;
+    }
+    return memcmp(key, match->key, hdr.key_len) == 0;
+}
+
+static bool raw_find(storage_raw_t *raw, const char *key, uint16_t *id) {
+    raw_key_match_t match = { .raw = raw, .key = key, .key_len = strlen(key) };
+    return card_index_find(&raw->index, card_index_hash(key, match.key_len), raw_key_matches, &match, id);
+}
+
+static esp_err_t raw_entry_add(storage_raw_t *raw, const char *key, size_t key_len, uint32_t offset) {
+    if (raw->entry_count > CARD_INDEX_MAX_SLOT) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (raw->entry_count == raw->entry_capacity) {
+        uint32_t new_capacity = raw->entry_capacity ? raw->entry_capacity * 2 : 64;
+        uint32_t *offsets = realloc(raw->offsets, new_capacity * sizeof(uint32_t));
+        if (!offsets) {
+            return ESP_ERR_NO_MEM;
+        }
+        raw->offsets = offsets;
+        raw->entry_capacity = new_capacity;
+    }
+    esp_err_t ret = card_index_insert(&raw->index, card_index_hash(key, key_len), (uint16_t)raw->entry_count);
+    if (ret == ESP_OK) {
+        raw->offsets[raw->entry_count++] = offset;
+    }
+    return ret;
+}
+
+// Atualiza o índice com o registro gravado em 'pos'
+static esp_err_t raw_apply(storage_raw_t *raw, const char *key, size_t key_len,
+                           const raw_record_header_t *hdr, uint32_t pos) {
+    uint16_t id;
+    raw_key_match_t match = { .raw = raw, .key = key, .key_len = key_len };
+    uint32_t hash = card_index_hash(key, key_len);
+    bool exists = card_index_find(&raw->index, hash, raw_key_matches, &match, &id);
+    if (exists) {
+        raw_record_header_t old;
+        if (raw_read(raw, raw->offsets[id], &old, sizeof(old)) == ESP_OK) {
+            raw->live_bytes -= raw_record_size(&old);
+        }
+    }
+    if (hdr->flags & RAW_FLAG_TOMBSTONE) {
+        if (exists) {
+            card_index_remove(&raw->index, hash, raw_key_matches, &match);
+            raw->offsets[id] = RAW_NO_OFFSET;
+        }
+        return ESP_OK;
+    }
+    raw->live_bytes += raw_record_size(hdr);
+    if (exists) {
+        raw->offsets[id] = pos;
+        return ESP_OK;
+    }
+    return raw_entry_add(raw, key, key_len, pos);
+}
+
+static esp_err_t raw_write_half_header(storage_raw_t *raw, uint32_t half, uint32_t generation) {
+    raw_half_header_t hdr = {
+        .magic = RAW_HALF_MAGIC,
+        .generation = generation,
+        .reserved = 0xFFFFFFFF,
+    };
+    hdr.crc = esp_rom_crc32_le(0, (const uint8_t *)&hdr, offsetof(raw_half_header_t, crc));
+    return esp_partition_write(raw->partition, raw_half_base(raw, half), &hdr, sizeof(hdr));
+}
+
+static bool raw_read_half_header(storage_raw_t *raw, uint32_t half, uint32_t *generation) {
+    raw_half_header_t hdr;
+    if (esp_partition_read(raw->partition, raw_half_base(raw, half), &hdr, sizeof(hdr)) != ESP_OK) {
+        return false;
+    }
+    if (hdr.magic != RAW_HALF_MAGIC ||
+        hdr.crc != esp_rom_crc32_le(0, (const uint8_t *)&hdr, offsetof(raw_half_header_t, crc))) {
+        return false;
+    }
+    *generation = hdr.generation;
+    return true;
+}
+
+static void raw_index_reset(storage_raw_t *raw) {
+    card_index_free(&raw->index);
+    raw->entry_count = 0;
+    raw->live_bytes = 0;
+}
+
+// Percorre a metade ativa reconstruindo o índice
+static esp_err_t raw_scan(storage_raw_t *raw) {
+    raw_index_reset(raw);
+    esp_err_t ret = card_index_init(&raw->index, 64);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    uint32_t pos = sizeof(raw_half_header_t);
+    while (pos + sizeof(raw_record_header_t) <= raw->half_size) {
+        raw_record_header_t hdr;
+        ret = raw_read(raw, pos, &hdr, sizeof(hdr));
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        if (hdr.magic == RAW_ERASED_MAGIC) {
+            break;
+        }
+        uint32_t size = raw_record_size(&hdr);
+        if (hdr.magic != RAW_RECORD_MAGIC || hdr.key_len == 0 ||
+            hdr.key_len > STORAGE_KEY_MAX_LEN || pos + size > raw->half_size) {
+            // Cabeçalho corrompido: não há como achar o próximo registro;
+            // a próxima gravação força a compactação
+            printf("storage_raw: registro inválido em 0x%" PRIx32 ", compactando\n", pos);
+            pos = raw->half_size;
+            break;
+        }
+        uint32_t crc = 0;
+        ret = raw_record_crc(raw, raw->active, pos, &hdr, &crc);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        if (crc == hdr.crc) {
+            char key[STORAGE_KEY_MAX_LEN + 1];
+            raw_read(raw, pos + sizeof(hdr), key, hdr.key_len);
+            key[hdr.key_len] = '\0';
+            ret = raw_apply(raw, key, hdr.key_len, &hdr, pos);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+        }
+        // CRC inválido = gravação interrompida; o registro é ignorado
+        pos += size;
+    }
+    raw->write_pos = pos;
+    return ESP_OK;
+}
+
+// Copia os registros vivos para a outra metade e a torna ativa. O cabeçalho
+// é gravado por último: uma queda no meio mantém a metade antiga.
+static esp_err_t raw_compact(storage_raw_t *raw) {
+    uint32_t target = raw->active ^ 1;
+    esp_err_t ret = esp_partition_erase_range(raw->partition, raw_half_base(raw, target), raw->half_size);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    uint8_t chunk[RAW_COPY_CHUNK];
+    uint32_t dest = sizeof(raw_half_header_t);
+    for (uint32_t id = 0; id < raw->entry_count; id++) {
+        if (raw->offsets[id] == RAW_NO_OFFSET) {
+            continue;
+        }
+        raw_record_header_t hdr;
+        ret = raw_read(raw, raw->offsets[id], &hdr, sizeof(hdr));
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        uint32_t size = raw_record_size(&hdr);
+        uint32_t src = raw_half_base(raw, raw->active) + raw->offsets[id];
+        for (uint32_t done = 0; done < size; done += sizeof(chunk)) {
+            uint32_t n = size - done < sizeof(chunk) ? size - done : sizeof(chunk);
+            ret = esp_partition_read(raw->partition, src + done, chunk, n);
+            if (ret == ESP_OK) {
+                ret = esp_partition_write(raw->partition, raw_half_base(raw, target) + dest + done, chunk, n);
+            }
+            if (ret != ESP_OK) {
+                return ret;
+            }
+        }
+        dest += size;
+    }
+
+    ret = raw_write_half_header(raw, target, raw->generation + 1);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    raw->active = target;
+    raw->generation++;
+    // Ids renumerados sem as lápides
+    ret = raw_scan(raw);
+    if (ret == ESP_OK) {
+        printf("storage_raw: compactado (geração %" PRIu32 ", %" PRIu32 " bytes vivos)\n",
+               raw->generation, raw->live_bytes);
+    }
+    return ret;
+}
+
+static esp_err_t raw_append(storage_raw_t *raw, const char *key, const void *value, size_t len, uint8_t flags) {
+    size_t key_len = strlen(key);
+    if (key_len == 0 || key_len > STORAGE_KEY_MAX_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (len > UINT16_MAX) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    raw_record_header_t hdr = {
+        .magic = RAW_RECORD_MAGIC,
+        .key_len = (uint8_t)key_len,
+        .flags = flags,
+        .value_len = (uint16_t)len,
+        .reserved = 0xFFFF,
+    };
+    uint32_t size = raw_record_size(&hdr);
+    if (raw->write_pos + size > raw->half_size) {
+        if (sizeof(raw_half_header_t) + raw->live_bytes + size > raw->half_size) {
+            return ESP_ERR_NO_MEM;
+        }
+        esp_err_t ret = raw_compact(raw);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        if (raw->write_pos + size > raw->half_size) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)&hdr, RAW_HEADER_CRC_LEN);
+    crc = esp_rom_crc32_le(crc, (const uint8_t *)key, key_len);
+    if (len > 0) {
+        crc = esp_rom_crc32_le(crc, value, len);
+    }
+    hdr.crc = crc;
+
+    // Cabeçalho + chave num bloco, valor em seguida; o preenchimento de
+    // alinhamento fica apagado (0xFF)
+    uint8_t head[sizeof(hdr) + STORAGE_KEY_MAX_LEN];
+    memcpy(head, &hdr, sizeof(hdr));
+    memcpy(&head[sizeof(hdr)], key, key_len);
+    uint32_t addr = raw_half_base(raw, raw->active) + raw->write_pos;
+    esp_err_t ret = esp_partition_write(raw->partition, addr, head, sizeof(hdr) + key_len);
+    if (ret == ESP_OK && len > 0) {
+        ret = esp_partition_write(raw->partition, addr + sizeof(hdr) + key_len, value, len);
+    }
+    uint32_t pos = raw->write_pos;
+    raw->write_pos += size; // mesmo com erro o espaço pode estar sujo
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return raw_apply(raw, key, key_len, &hdr, pos);
+}
+
+static esp_err_t storage_raw_open(void *ctx, const char *name_space) {
+    (void)name_space; // a partição inteira é um namespace
+    storage_raw_t *raw = (storage_raw_t *)ctx;
+    raw->partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                              STORAGE_RAW_PARTITION_SUBTYPE, raw->label);
+    if (!raw->partition) {
+        printf("storage_raw: partição '%s' não encontrada\n", raw->label);
+        return ESP_ERR_NOT_FOUND;
+    }
+    raw->half_size = (raw->partition->size / 2) & ~(RAW_SECTOR_SIZE - 1);
+    if (raw->half_size < RAW_SECTOR_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint32_t gen0 = 0;
+    uint32_t gen1 = 0;
+    bool valid0 = raw_read_half_header(raw, 0, &gen0);
+    bool valid1 = raw_read_half_header(raw, 1, &gen1);
+    if (!valid0 && !valid1) {
+        esp_err_t ret = esp_partition_erase_range(raw->partition, 0, raw->half_size);
+        if (ret == ESP_OK) {
+            ret = raw_write_half_header(raw, 0, 1);
+        }
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        valid0 = true;
+        gen0 = 1;
+    }
+    raw->active = (valid1 && (!valid0 || gen1 > gen0)) ? 1 : 0;
+    raw->generation = raw->active ? gen1 : gen0;
+    return raw_scan(raw);
+}
+
+static void storage_raw_close(void *ctx) {
+    storage_raw_t *raw = (storage_raw_t *)ctx;
+    raw_index_reset(raw);
+    free(raw->offsets);
+    raw->offsets = NULL;
+    raw->entry_capacity = 0;
+    raw->partition = NULL;
+}
+
+static esp_err_t storage_raw_get(void *ctx, const char *key, void *value, size_t *len) {
+    storage_raw_t *raw = (storage_raw_t *)ctx;
+    uint16_t id;
+    if (!raw_find(raw, key, &id)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    raw_record_header_t hdr;
+    esp_err_t ret = raw_read(raw, raw->offsets[id], &hdr, sizeof(hdr));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (value) {
+        if (*len < hdr.value_len) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        ret = raw_read(raw, raw->offsets[id] + sizeof(hdr) + hdr.key_len, value, hdr.value_len);
+    }
+    *len = hdr.value_len;
+    return ret;
+}
+
+static esp_err_t storage_raw_set(void *ctx, const char *key, const void *value, size_t len) {
+    return raw_append((storage_raw_t *)ctx, key, value, len, 0);
+}
+
+static esp_err_t storage_raw_erase(void *ctx, const char *key) {
+    storage_raw_t *raw = (storage_raw_t *)ctx;
+    uint16_t id;
+    if (!raw_find(raw, key, &id)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return raw_append(raw, key, NULL, 0, RAW_FLAG_TOMBSTONE);
+}
+
+static esp_err_t storage_raw_commit(void *ctx) {
+    (void)ctx;
+    return ESP_OK; // cada registro já está no flash
+}
+
+// Não alterar o armazenamento dentro do callback (a compactação renumera os ids)
+static esp_err_t storage_raw_iterate(void *ctx, const char *prefix, storage_iter_cb_t cb, void *cb_ctx) {
+    storage_raw_t *raw = (storage_raw_t *)ctx;
+    size_t prefix_len = strlen(prefix);
+    for (uint32_t id = 0; id < raw->entry_count; id++) {
+        if (raw->offsets[id] == RAW_NO_OFFSET) {
+            continue;
+        }
+        raw_record_header_t hdr;
+        char key[STORAGE_KEY_MAX_LEN + 1];
+        esp_err_t ret = raw_read(raw, raw->offsets[id], &hdr, sizeof(hdr));
+        if (ret == ESP_OK) {
+            ret = raw_read(raw, raw->offsets[id] + sizeof(hdr), key, hdr.key_len);
+        }
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        key[hdr.key_len] = '\0';
+        if (strncmp(key, prefix, prefix_len) == 0 && !cb(key, hdr.value_len, cb_ctx)) {
+            break;
+        }
+    }
+    return ESP_OK;
+}
+
+static storage_backend_t s_raw_backend = {
+    .name = "raw",
+    .open = storage_raw_open,
+    .close = storage_raw_close,
+    .get = storage_raw_get,
+    .set = storage_raw_set,
+    .erase = storage_raw_erase,
+    .commit = storage_raw_commit,
+    .iterate = storage_raw_iterate,
+    .ctx = &s_raw,
+};
+
+const storage_backend_t *storage_raw_backend(const char *partition_label) {
+    s_raw.label = partition_label;
+    return &s_raw_backend;
+}
@@ -0,0 +1,263 @@
+#include "storage_backend.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <inttypes.h>
+
+#define SHARD_COUNT_KEY   "shard_count"
+
+typedef struct {
+    const storage_backend_t *shards[STORAGE_SHARD_MAX];
+    uint32_t count;
+    const storage_backend_t *legacy;
+    uint32_t gets[STORAGE_SHARD_MAX];
+    uint32_t sets[STORAGE_SHARD_MAX];
+    uint32_t erases[STORAGE_SHARD_MAX];
+} storage_shard_t;
+
+static storage_shard_t s_shard;
+
+// Número no fim da chave % count; chaves sem número ficam no shard 0
+static uint32_t shard_of(const storage_shard_t *sh, const char *key) {
+    size_t len = strlen(key);
+    size_t start = len;
+    while (start > 0 && isdigit((unsigned char)key[start - 1])) {
+        start--;
+    }
+    if (start == len || start == 0) {
+        return 0;
+    }
+    return (uint32_t)strtoul(&key[start], NULL, 10) % sh->count;
+}
+
+typedef struct {
+    char (*keys)[STORAGE_KEY_MAX_LEN + 1];
+    uint32_t count;
+    uint32_t capacity;
+    bool failed;
+} shard_key_list_t;
+
+static bool shard_collect_cb(const char *key, size_t value_len, void *ctx) {
+    (void)value_len;
+    shard_key_list_t *list = (shard_key_list_t *)ctx;
+    if (list->count == list->capacity) {
+        uint32_t new_capacity = list->capacity ? list->capacity * 2 : 64;
+        char (*keys)[STORAGE_KEY_MAX_LEN + 1] = realloc(list->keys, new_capacity * sizeof(*keys));
+        if (!keys) {
+            list->failed = true;
+            return false;
+        }
+        list->keys = keys;
+        list->capacity = new_capacity;
+    }
+    strncpy(list->keys[list->count], key, STORAGE_KEY_MAX_LEN);
+    list->keys[list->count][STORAGE_KEY_MAX_LEN] = '\0';
+    list->count++;
+    return true;
+}
+
+// Copia as chaves do banco sem shards; só apaga de lá depois que os shards
+// confirmaram tudo e shard_count foi gravado (uma queda antes refaz a cópia)
+static esp_err_t shard_migrate(storage_shard_t *sh, const char *name_space) {
+    const storage_backend_t *legacy = sh->legacy;
+    esp_err_t ret = legacy->open(legacy->ctx, name_space);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    shard_key_list_t list = { 0 };
+    ret = storage_iterate(legacy, "", shard_collect_cb, &list);
+    if (ret == ESP_OK && list.failed) {
+        ret = ESP_ERR_NO_MEM;
+    }
+
+    uint8_t *value = NULL;
+    for (uint32_t i = 0; i < list.count && ret == ESP_OK; i++) {
+        size_t len = 0;
+        ret = storage_get(legacy, list.keys[i], NULL, &len);
+        if (ret != ESP_OK) {
+            break;
+        }
+        uint8_t *buf = realloc(value, len ? len : 1);
+        if (!buf) {
+            ret = ESP_ERR_NO_MEM;
+            break;
+        }
+        value = buf;
+        ret = storage_get(legacy, list.keys[i], value, &len);
+        if (ret == ESP_OK) {
+            ret = storage_set(sh->shards[shard_of(sh, list.keys[i])], list.keys[i], value, len);
+        }
+    }
+    free(value);
+
+    for (uint32_t s = 0; s < sh->count && ret == ESP_OK; s++) {
+        ret = storage_commit(sh->shards[s]);
+    }
+    if (ret == ESP_OK) {
+        ret = storage_set_u32(sh->shards[0], SHARD_COUNT_KEY, sh->count);
+    }
+    if (ret == ESP_OK) {
+        ret = storage_commit(sh->shards[0]);
+    }
+    if (ret == ESP_OK) {
+        for (uint32_t i = 0; i < list.count; i++) {
+            storage_erase(legacy, list.keys[i]);
+        }
+        storage_commit(legacy);
+        if (list.count > 0) {
+            printf("Shards: %" PRIu32 " chaves migradas do banco sem shards para %" PRIu32 " shards\n",
+                   list.count, sh->count);
+        }
+    }
+    free(list.keys);
+    legacy->close(legacy->ctx);
+    return ret;
+}
+
+static void storage_shard_close(void *ctx) {
+    storage_shard_t *sh = (storage_shard_t *)ctx;
+    for (uint32_t s = 0; s < sh->count; s++) {
+        sh->shards[s]->close(sh->shards[s]->ctx);
+    }
+}
+
+static esp_err_t storage_shard_open(void *ctx, const char *name_space) {
+    storage_shard_t *sh = (storage_shard_t *)ctx;
+    esp_err_t ret = ESP_OK;
+    uint32_t opened = 0;
+    for (; opened < sh->count && ret == ESP_OK; opened++) {
+        ret = sh->shards[opened]->open(sh->shards[opened]->ctx, name_space);
+    }
+    if (ret != ESP_OK) {
+        printf("Shard %s não abriu: %s\n", sh->shards[opened - 1]->name, esp_err_to_name(ret));
+        for (uint32_t s = 0; s + 1 < opened; s++) {
+            sh->shards[s]->close(sh->shards[s]->ctx);
+        }
+        return ret;
+    }
+
+    uint32_t stored = 0;
+    ret = storage_get_u32(sh->shards[0], SHARD_COUNT_KEY, &stored);
+    if (ret == ESP_ERR_NOT_FOUND) {
+        if (sh->legacy) {
+            ret = shard_migrate(sh, name_space);
+        } else {
+            ret = storage_set_u32(sh->shards[0], SHARD_COUNT_KEY, sh->count);
+            if (ret == ESP_OK) {
+                ret = storage_commit(sh->shards[0]);
+            }
+        }
+    } else if (ret == ESP_OK && stored != sh->count) {
+        // Mudar a quantidade remapearia as chaves: exige migração explícita
+        printf("Banco gravado com %" PRIu32 " shards, configurado com %" PRIu32 "\n", stored, sh->count);
+        ret = ESP_ERR_INVALID_STATE;
+    }
+    if (ret != ESP_OK) {
+        storage_shard_close(sh);
+    }
+    return ret;
+}
+
+static esp_err_t storage_shard_get(void *ctx, const char *key, void *value, size_t *len) {
+    storage_shard_t *sh = (storage_shard_t *)ctx;
+    uint32_t s = shard_of(sh, key);
+    sh->gets[s]++;
+    return storage_get(sh->shards[s], key, value, len);
+}
+
+static esp_err_t storage_shard_set(void *ctx, const char *key, const void *value, size_t len) {
+    storage_shard_t *sh = (storage_shard_t *)ctx;
+    uint32_t s = shard_of(sh, key);
+    sh->sets[s]++;
+    return storage_set(sh->shards[s], key, value, len);
+}
+
+static esp_err_t storage_shard_erase(void *ctx, const char *key) {
+    storage_shard_t *sh = (storage_shard_t *)ctx;
+    uint32_t s = shard_of(sh, key);
+    sh->erases[s]++;
+    return storage_erase(sh->shards[s], key);
+}
+
+static esp_err_t storage_shard_commit(void *ctx) {
+    storage_shard_t *sh = (storage_shard_t *)ctx;
+    esp_err_t ret = ESP_OK;
+    for (uint32_t s = 0; s < sh->count; s++) {
+        esp_err_t shard_ret = storage_commit(sh->shards[s]);
+        if (ret == ESP_OK) {
+            ret = shard_ret;
+        }
+    }
+    return ret;
+}
+
+typedef struct {
+    storage_iter_cb_t cb;
+    void *cb_ctx;
+    bool stopped;
+} shard_iter_ctx_t;
+
+static bool shard_iter_cb(const char *key, size_t value_len, void *ctx) {
+    shard_iter_ctx_t *it = (shard_iter_ctx_t *)ctx;
+    if (strcmp(key, SHARD_COUNT_KEY) == 0) {
+        return true;
+    }
+    if (!it->cb(key, value_len, it->cb_ctx)) {
+        it->stopped = true;
+        return false;
+    }
+    return true;
+}
+
+static esp_err_t storage_shard_iterate(void *ctx, const char *prefix, storage_iter_cb_t cb, void *cb_ctx) {
+    storage_shard_t *sh = (storage_shard_t *)ctx;
+    shard_iter_ctx_t it = { .cb = cb, .cb_ctx = cb_ctx, .stopped = false };
+    esp_err_t ret = ESP_OK;
+    for (uint32_t s = 0; s < sh->count && ret == ESP_OK && !it.stopped; s++) {
+        ret = storage_iterate(sh->shards[s], prefix, shard_iter_cb, &it);
+    }
+    return ret;
+}
+
+static const storage_backend_t s_shard_backend = {
+    .name = "shard",
+    .open = storage_shard_open,
+    .close = storage_shard_close,
+    .get = storage_shard_get,
+    .set = storage_shard_set,
+    .erase = storage_shard_erase,
+    .commit = storage_shard_commit,
+    .iterate = storage_shard_iterate,
+    .ctx = &s_shard,
+};
+
+const storage_backend_t *storage_shard_backend(const storage_backend_t *const *shards, uint32_t count,
+                                               const storage_backend_t *legacy) {
+    if (count == 0 || count > STORAGE_SHARD_MAX) {
+        return NULL;
+    }
+    for (uint32_t s = 0; s < count; s++) {
+        if (!shards[s]) {
+            return NULL;
+        }
+    }
+    memset(&s_shard, 0, sizeof(s_shard));
+    memcpy(s_shard.shards, shards, count * sizeof(shards[0]));
+    s_shard.count = count;
+    s_shard.legacy = legacy;
+    return &s_shard_backend;
+}
+
+uint32_t storage_shard_get_stats(storage_shard_stats_t *stats, uint32_t max) {
+    for (uint32_t s = 0; s < s_shard.count && s < max; s++) {
+        storage_shard_stats_t *st = &stats[s];
+        memset(st, 0, sizeof(*st));
+        st->name = s_shard.shards[s]->name;
+        st->gets = s_shard.gets[s];
+        st->sets = s_shard.sets[s];
+        st->erases = s_shard.erases[s];
+        storage_nvs_usage(s_shard.shards[s], &st->used_entries, &st->total_entries);
+    }
+    return s_shard.count;
+}
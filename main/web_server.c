@@ -6,6 +6,7 @@
 #include <string.h>
 #include <time.h>
 #include <stdlib.h>
+#include <errno.h>
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
@@ -30,6 +31,8 @@ esp_err_t api_card_add_handler(httpd_req_t *req);
 esp_err_t api_card_delete_handler(httpd_req_t *req);
 esp_err_t api_logs_handler(httpd_req_t *req);
 esp_err_t api_last_card_handler(httpd_req_t *req);
+esp_err_t api_cards_import_handler(httpd_req_t *req);
+esp_err_t api_cards_export_handler(httpd_req_t *req);
 
 // Arquivos web incorporados
 extern const uint8_t index_html_start[] asm("_binary_index_html_start");
@@ -120,6 +123,23 @@ esp_err_t web_server_init(web_server_t *server) {
         };
         httpd_register_uri_handler(server->server, &api_cards_post_uri);
         
+        // Importação/exportação em lote (CSV); antes do curinga /api/cards/*
+        httpd_uri_t api_cards_import_uri = {
+            .uri = "/api/cards/import",
+            .method = HTTP_POST,
+            .handler = api_cards_import_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server->server, &api_cards_import_uri);
+        
+        httpd_uri_t api_cards_export_uri = {
+            .uri = "/api/cards/export",
+            .method = HTTP_GET,
+            .handler = api_cards_export_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(server->server, &api_cards_export_uri);
+        
         httpd_uri_t api_cards_delete_uri = {
             .uri = "/api/cards/*",
             .method = HTTP_DELETE,
@@ -198,6 +218,145 @@ esp_err_t api_stats_handler(httpd_req_t *req) {
     if (database_get_stats(&total_cards, &total_accesses) == ESP_OK) {
         cJSON_AddNumberToObject(json, "total_cards", total_cards);
         cJSON_AddNumberToObject(json, "total_accesses", total_accesses);
+        
+        // Estatísticas do cache write-back
+        database_cache_stats_t cache;
+        if (database_get_cache_stats(&cache) == ESP_OK) {
+            cJSON *cache_obj = cJSON_CreateObject();
+            cJSON_AddNumberToObject(cache_obj, "flush_count", cache.flush_count);
+            cJSON_AddNumberToObject(cache_obj, "flush_errors", cache.flush_errors);
+            cJSON_AddNumberToObject(cache_obj, "dirty_records", cache.dirty_records);
+            cJSON_AddNumberToObject(cache_obj, "free_slots", cache.free_slots);
+            cJSON_AddNumberToObject(cache_obj, "compacted_slots", cache.compacted_slots);
+            cJSON_AddNumberToObject(cache_obj, "records_written", cache.records_written);
+            cJSON_AddNumberToObject(cache_obj, "bytes_written", cache.bytes_written);
+            cJSON_AddNumberToObject(cache_obj, "last_flush_us", cache.last_flush_us);
+            cJSON_AddNumberToObject(cache_obj, "max_flush_us", cache.max_flush_us);
+            cJSON_AddNumberToObject(cache_obj, "avg_flush_us",
+                                    cache.flush_count ? (double)cache.total_flush_us / cache.flush_count : 0);
+            cJSON_AddItemToObject(json, "cache", cache_obj);
+        }
+        
+        // Filtro de UIDs desconhecidos
+        card_filter_stats_t filter;
+        if (database_get_filter_stats(&filter) == ESP_OK) {
+            cJSON *filter_obj = cJSON_CreateObject();
+            cJSON_AddNumberToObject(filter_obj, "items", filter.items);
+            cJSON_AddNumberToObject(filter_obj, "capacity", filter.capacity);
+            cJSON_AddNumberToObject(filter_obj, "memory_bytes", filter.memory_bytes);
+            cJSON_AddNumberToObject(filter_obj, "fingerprint_bits", filter.fingerprint_bits);
+            cJSON_AddNumberToObject(filter_obj, "expected_fp_rate", filter.expected_fp_ppm / 1e6);
+            cJSON_AddNumberToObject(filter_obj, "lookups", filter.lookups);
+            cJSON_AddNumberToObject(filter_obj, "rejected", filter.rejected);
+            cJSON_AddNumberToObject(filter_obj, "false_positives", filter.false_positives);
+            cJSON_AddItemToObject(json, "filter", filter_obj);
+        }
+        
+        // Journal de escrita antecipada e tempo até o banco ficar pronto
+        storage_journal_stats_t journal;
+        uint32_t ready_ms = 0;
+        if (database_get_journal_stats(&journal, &ready_ms) == ESP_OK) {
+            cJSON *journal_obj = cJSON_CreateObject();
+            cJSON_AddNumberToObject(journal_obj, "seq", journal.seq);
+            cJSON_AddNumberToObject(journal_obj, "records", journal.records);
+            cJSON_AddNumberToObject(journal_obj, "bytes", journal.bytes);
+            cJSON_AddNumberToObject(journal_obj, "unjournaled", journal.unjournaled);
+            cJSON_AddNumberToObject(journal_obj, "replayed", journal.replayed);
+            cJSON_AddNumberToObject(journal_obj, "deferred", journal.deferred);
+            cJSON_AddBoolToObject(journal_obj, "pending", journal.pending);
+            cJSON_AddNumberToObject(journal_obj, "recovery_us", journal.recovery_us);
+            cJSON_AddNumberToObject(journal_obj, "ready_ms", ready_ms);
+            cJSON_AddItemToObject(json, "journal", journal_obj);
+        }
+        
+        // Lock do banco e consultas de acesso sem lock
+        database_concurrency_stats_t conc;
+        if (database_get_concurrency_stats(&conc) == ESP_OK) {
+            cJSON *conc_obj = cJSON_CreateObject();
+            cJSON_AddNumberToObject(conc_obj, "lock_acquires", conc.lock_acquires);
+            cJSON_AddNumberToObject(conc_obj, "lock_contended", conc.lock_contended);
+            cJSON_AddNumberToObject(conc_obj, "lock_wait_max_us", conc.lock_wait_max_us);
+            cJSON_AddNumberToObject(conc_obj, "lock_wait_total_us", (double)conc.lock_wait_total_us);
+            cJSON_AddNumberToObject(conc_obj, "view_reads", conc.view.reads);
+            cJSON_AddNumberToObject(conc_obj, "view_read_max_us", conc.view.read_max_us);
+            cJSON_AddNumberToObject(conc_obj, "view_read_avg_us",
+                                    conc.view.reads ? (double)conc.view.read_total_us / conc.view.reads : 0);
+            cJSON_AddNumberToObject(conc_obj, "view_retries", conc.view.read_retries);
+            cJSON_AddNumberToObject(conc_obj, "view_publishes", conc.view.publishes);
+            cJSON_AddNumberToObject(conc_obj, "grace_waits", conc.view.grace_waits);
+            cJSON_AddNumberToObject(conc_obj, "grace_max_us", conc.view.grace_max_us);
+            cJSON_AddNumberToObject(conc_obj, "view_bytes", conc.view.memory_bytes);
+            cJSON_AddNumberToObject(conc_obj, "view_fallbacks", conc.view_fallbacks);
+            cJSON_AddNumberToObject(conc_obj, "view_rebuilds", conc.view.rebuilds);
+            cJSON_AddNumberToObject(conc_obj, "view_rebuild_us", conc.view.rebuild_us);
+            cJSON_AddItemToObject(json, "concurrency", conc_obj);
+        }
+        
+        // Fotografia dos índices lida no boot
+        card_snapshot_stats_t snapshot;
+        if (database_get_snapshot_stats(&snapshot) == ESP_OK) {
+            cJSON *snapshot_obj = cJSON_CreateObject();
+            cJSON_AddNumberToObject(snapshot_obj, "generation", snapshot.generation);
+            cJSON_AddNumberToObject(snapshot_obj, "slots", snapshot.slot_count);
+            cJSON_AddNumberToObject(snapshot_obj, "chunks", snapshot.chunk_count);
+            cJSON_AddNumberToObject(snapshot_obj, "dirty", snapshot.dirty_count);
+            cJSON_AddNumberToObject(snapshot_obj, "writes", snapshot.writes);
+            cJSON_AddNumberToObject(snapshot_obj, "last_write_ms", snapshot.last_write_ms);
+            cJSON_AddBoolToObject(snapshot_obj, "writing", snapshot.writing);
+            cJSON_AddItemToObject(json, "snapshot", snapshot_obj);
+        }
+
+        storage_shard_stats_t shards[STORAGE_SHARD_MAX];
+        uint32_t shard_count = 0;
+        if (database_get_shard_stats(shards, STORAGE_SHARD_MAX, &shard_count) == ESP_OK && shard_count > 0) {
+            cJSON *shards_arr = cJSON_CreateArray();
+            for (uint32_t i = 0; i < shard_count && i < STORAGE_SHARD_MAX; i++) {
+                cJSON *shard_obj = cJSON_CreateObject();
+                cJSON_AddStringToObject(shard_obj, "name", shards[i].name);
+                cJSON_AddNumberToObject(shard_obj, "gets", shards[i].gets);
+                cJSON_AddNumberToObject(shard_obj, "sets", shards[i].sets);
+                cJSON_AddNumberToObject(shard_obj, "erases", shards[i].erases);
+                cJSON_AddNumberToObject(shard_obj, "used_entries", shards[i].used_entries);
+                cJSON_AddNumberToObject(shard_obj, "total_entries", shards[i].total_entries);
+                cJSON_AddItemToArray(shards_arr, shard_obj);
+            }
+            cJSON_AddItemToObject(json, "shards", shards_arr);
+        }
+
+        // Contadores incrementais: totais por nível e séries por hora/dia
+        database_access_stats_t *stats = malloc(sizeof(*stats));
+        if (stats && database_get_access_stats(stats) == ESP_OK) {
+            cJSON *levels = cJSON_CreateArray();
+            for (int i = 0; i < CARD_QUERY_LEVELS; i++) {
+                cJSON_AddItemToArray(levels, cJSON_CreateNumber(stats->cards_by_level[i]));
+            }
+            cJSON_AddItemToObject(json, "cards_by_level", levels);
+            cJSON_AddNumberToObject(json, "log_records", stats->log_records);
+            cJSON_AddNumberToObject(json, "granted", stats->events.granted);
+            cJSON_AddNumberToObject(json, "denied", stats->events.denied);
+            
+            cJSON *hours = cJSON_CreateArray();
+            for (int i = 0; i < DATABASE_STATS_HOURS; i++) {
+                cJSON *bucket = cJSON_CreateObject();
+                cJSON_AddNumberToObject(bucket, "start", stats->hours[i].start);
+                cJSON_AddNumberToObject(bucket, "granted", stats->hours[i].granted);
+                cJSON_AddNumberToObject(bucket, "denied", stats->hours[i].denied);
+                cJSON_AddItemToArray(hours, bucket);
+            }
+            cJSON_AddItemToObject(json, "hours", hours);
+            
+            cJSON *days = cJSON_CreateArray();
+            for (int i = 0; i < DATABASE_STATS_DAYS; i++) {
+                cJSON *bucket = cJSON_CreateObject();
+                cJSON_AddNumberToObject(bucket, "start", stats->days[i].start);
+                cJSON_AddNumberToObject(bucket, "granted", stats->days[i].granted);
+                cJSON_AddNumberToObject(bucket, "denied", stats->days[i].denied);
+                cJSON_AddNumberToObject(bucket, "unique_cards", stats->days[i].unique_cards);
+                cJSON_AddItemToArray(days, bucket);
+            }
+            cJSON_AddItemToObject(json, "days", days);
+        }
+        free(stats);
         cJSON_AddBoolToObject(json, "success", true);
     } else {
         cJSON_AddBoolToObject(json, "success", false);
@@ -213,56 +372,201 @@ esp_err_t api_stats_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
-esp_err_t api_cards_handler(httpd_req_t *req) {
-    ESP_LOGI("WEB_SERVER", "API /api/cards chamada");
-    
-    cJSON *json = cJSON_CreateObject();
-    cJSON *cards_array = cJSON_CreateArray();
-    
-    rfid_record_t *records = NULL;
-    int count = 0;
-    
-    ESP_LOGI("WEB_SERVER", "Buscando cartões no banco de dados...");
-    esp_err_t result = database_get_all_cards(&records, &count);
-    ESP_LOGI("WEB_SERVER", "database_get_all_cards retornou: %s, count: %d", esp_err_to_name(result), count);
-    
-    if (result == ESP_OK) {
-        ESP_LOGI("WEB_SERVER", "Processando %d cartões", count);
-        for (int i = 0; i < count; i++) {
-            cJSON *card_obj = cJSON_CreateObject();
-            cJSON_AddStringToObject(card_obj, "uid", records[i].uid);
-            cJSON_AddStringToObject(card_obj, "name", records[i].name);
-            cJSON_AddNumberToObject(card_obj, "access_level", records[i].access_level);
-            cJSON_AddNumberToObject(card_obj, "first_seen", records[i].first_seen);
-            cJSON_AddNumberToObject(card_obj, "last_seen", records[i].last_seen);
-            cJSON_AddNumberToObject(card_obj, "access_count", records[i].access_count);
-            cJSON_AddItemToArray(cards_array, card_obj);
-            
-            ESP_LOGI("WEB_SERVER", "Cartão %d: %s (%s)", i, records[i].uid, records[i].name);
-        }
-        
-        if (records) {
-            free(records);
-        }
-        
-        cJSON_AddItemToObject(json, "cards", cards_array);
-        cJSON_AddBoolToObject(json, "success", true);
-    } else {
-        ESP_LOGW("WEB_SERVER", "Falha ao obter cartões: %s", esp_err_to_name(result));
-        cJSON_Delete(cards_array);
-        cJSON_AddBoolToObject(json, "success", false);
-        cJSON_AddStringToObject(json, "message", "Erro ao obter cartões");
+// Lê um parâmetro numérico da query string (?chave=valor), sempre em base
+// 10 ("010" é dez, não oito). Valor presente mas inválido (vazio, sinal,
+// sobra de texto ou estouro) zera *valid e devolve o padrão
+static uint64_t query_get_u64(httpd_req_t *req, const char *key, uint64_t default_value, bool *valid) {
+    char query[128];
+    char value[24];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, key, value, sizeof(value)) != ESP_OK) {
+        return default_value;
     }
-    
+    char *end;
+    errno = 0;
+    unsigned long long parsed = strtoull(value, &end, 10);
+    if (value[0] < '0' || value[0] > '9' || *end != '\0' || errno == ERANGE) {
+        *valid = false;
+        return default_value;
+    }
+    return (uint64_t)parsed;
+}
+
+static uint32_t query_get_u32(httpd_req_t *req, const char *key, uint32_t default_value, bool *valid) {
+    uint64_t value = query_get_u64(req, key, default_value, valid);
+    if (value > UINT32_MAX) {
+        *valid = false;
+        return default_value;
+    }
+    return (uint32_t)value;
+}
+
+// Resposta de erro das listagens: {"success":false,"message":...}
+static esp_err_t send_json_failure(httpd_req_t *req, const char *message) {
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddBoolToObject(json, "success", false);
+    cJSON_AddStringToObject(json, "message", message);
     char *json_string = cJSON_Print(json);
     httpd_resp_set_type(req, "application/json");
     httpd_resp_send(req, json_string, strlen(json_string));
-    
     free(json_string);
     cJSON_Delete(json);
     return ESP_OK;
 }
 
+// Lê um parâmetro de texto da query string, já decodificado
+static bool query_get_str(httpd_req_t *req, const char *key, char *value, size_t value_size) {
+    char query[128];
+    char raw[64];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, key, raw, sizeof(raw)) != ESP_OK) {
+        return false;
+    }
+    url_decode(raw, value, value_size);
+    return true;
+}
+
+// Envia um item do array JSON em streaming (memória constante por item)
+static esp_err_t stream_json_item(httpd_req_t *req, cJSON *item, bool first) {
+    char *item_string = cJSON_PrintUnformatted(item);
+    cJSON_Delete(item);
+    if (!item_string) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t ret = ESP_OK;
+    if (!first) {
+        ret = httpd_resp_sendstr_chunk(req, ",");
+    }
+    if (ret == ESP_OK) {
+        ret = httpd_resp_sendstr_chunk(req, item_string);
+    }
+    free(item_string);
+    return ret;
+}
+
+// Fecha o array e o objeto: next_cursor != 0 indica que há mais itens
+static esp_err_t stream_json_end(httpd_req_t *req, bool success, uint64_t next_cursor) {
+    char tail[64];
+    snprintf(tail, sizeof(tail), "],\"success\":%s,\"next_cursor\":%llu}",
+             success ? "true" : "false", (unsigned long long)next_cursor);
+    httpd_resp_sendstr_chunk(req, tail);
+    return httpd_resp_sendstr_chunk(req, NULL);
+}
+
+static cJSON *card_record_to_json(const rfid_record_t *record) {
+    cJSON *card_obj = cJSON_CreateObject();
+    cJSON_AddStringToObject(card_obj, "uid", record->uid);
+    cJSON_AddStringToObject(card_obj, "name", record->name);
+    cJSON_AddNumberToObject(card_obj, "access_level", record->access_level);
+    cJSON_AddNumberToObject(card_obj, "first_seen", record->first_seen);
+    cJSON_AddNumberToObject(card_obj, "last_seen", record->last_seen);
+    cJSON_AddNumberToObject(card_obj, "access_count", record->access_count);
+    return card_obj;
+}
+
+#define API_QUERY_PAGE 8    // registros copiados por vez sob o lock do banco
+
+// Listagem filtrada pelos índices secundários; o cursor é a posição no
+// índice devolvida pelo banco, então cada página continua de onde a
+// anterior parou
+static esp_err_t api_cards_query(httpd_req_t *req, const database_card_query_t *query,
+                                 uint64_t cursor, uint32_t limit) {
+    rfid_record_t *page = malloc(API_QUERY_PAGE * sizeof(rfid_record_t));
+    if (!page) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr_chunk(req, "{\"cards\":[");
+    
+    uint32_t sent = 0;
+    esp_err_t result = ESP_OK;
+    do {
+        uint32_t want = API_QUERY_PAGE;
+        if (limit != 0 && limit - sent < want) {
+            want = limit - sent;
+        }
+        uint32_t got = 0;
+        result = database_query_cards(query, &cursor, page, want, &got);
+        for (uint32_t i = 0; i < got; i++) {
+            if (stream_json_item(req, card_record_to_json(&page[i]), sent == 0) != ESP_OK) {
+                free(page);
+                return ESP_FAIL; // conexão perdida
+            }
+            sent++;
+        }
+    } while (result == ESP_OK && cursor != 0 && (limit == 0 || sent < limit));
+    free(page);
+    
+    if (result != ESP_OK) {
+        ESP_LOGW("WEB_SERVER", "Consulta de cartões interrompida: %s", esp_err_to_name(result));
+    }
+    ESP_LOGI("WEB_SERVER", "API /api/cards (consulta): %lu cartões enviados", (unsigned long)sent);
+    return stream_json_end(req, result == ESP_OK, result == ESP_OK ? cursor : 0);
+}
+
+// GET /api/cards[?cursor=&limit=&level=&q=&inactive_days=&active_days=]:
+// lista em streaming, um cartão por vez; sem limit retorna todos. q (prefixo
+// do nome), level e *_days usam os índices secundários do banco.
+esp_err_t api_cards_handler(httpd_req_t *req) {
+    bool params_ok = true;
+    uint64_t cursor = query_get_u64(req, "cursor", 0, &params_ok);
+    uint32_t limit = query_get_u32(req, "limit", 0, &params_ok);
+    
+    char name_prefix[MAX_NAME_LENGTH];
+    database_card_query_t query = {
+        .name_prefix = query_get_str(req, "q", name_prefix, sizeof(name_prefix)) ? name_prefix : NULL,
+        .access_level = (uint8_t)query_get_u32(req, "level", 0, &params_ok),
+    };
+    // Em 64 bits: dias * 86400 estoura 32 bits a partir de 49711 dias
+    uint64_t now = (uint64_t)time(NULL);
+    uint64_t inactive_span = (uint64_t)query_get_u32(req, "inactive_days", 0, &params_ok) * 86400;
+    uint64_t active_span = (uint64_t)query_get_u32(req, "active_days", 0, &params_ok) * 86400;
+    if (!params_ok) {
+        return send_json_failure(req, "Parâmetro numérico inválido");
+    }
+    if (inactive_span) {
+        query.seen_before = now > inactive_span ? (uint32_t)(now - inactive_span) : 1;
+    }
+    if (active_span) {
+        query.seen_after = now > active_span ? (uint32_t)(now - active_span) : 1;
+    }
+    if ((query.name_prefix && query.name_prefix[0]) || query.access_level ||
+        query.seen_before || query.seen_after) {
+        return api_cards_query(req, &query, cursor, limit);
+    }
+    
+    database_cards_iter_t iter;
+    esp_err_t result = database_cards_iter_begin(&iter, (uint32_t)cursor, NULL, NULL);
+    if (result != ESP_OK) {
+        ESP_LOGW("WEB_SERVER", "Falha ao iniciar listagem: %s", esp_err_to_name(result));
+        return send_json_failure(req, result == ESP_ERR_INVALID_STATE ?
+                                 "Cursor expirado, recomece a listagem" : "Erro ao obter cartões");
+    }
+    
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr_chunk(req, "{\"cards\":[");
+    
+    rfid_record_t record;
+    uint32_t count = 0;
+    while ((limit == 0 || count < limit) &&
+           (result = database_cards_iter_next(&iter, &record)) == ESP_OK) {
+        if (stream_json_item(req, card_record_to_json(&record), count == 0) != ESP_OK) {
+            database_cards_iter_end(&iter);
+            return ESP_FAIL; // conexão perdida
+        }
+        count++;
+    }
+    
+    bool more = (limit != 0 && count == limit);
+    bool success = more || result == ESP_ERR_NOT_FOUND;
+    uint32_t next_cursor = more ? database_cards_iter_cursor(&iter) : 0;
+    database_cards_iter_end(&iter);
+    ESP_LOGI("WEB_SERVER", "API /api/cards: %lu cartões enviados", (unsigned long)count);
+    return stream_json_end(req, success, next_cursor);
+}
+
 esp_err_t api_card_add_handler(httpd_req_t *req) {
     char content[512];
     size_t recv_size = MIN(req->content_len, sizeof(content) - 1);
@@ -315,6 +619,208 @@ esp_err_t api_card_add_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
+// --- Importação/exportação CSV: uid,name,access_level,first_seen,last_seen,access_count ---
+
+#define CSV_HEADER "uid,name,access_level,first_seen,last_seen,access_count\n"
+#define CSV_LINE_MAX 160
+
+// Extrai um campo CSV (aceita aspas com "" escapado); retorna o início do próximo
+static const char *csv_next_field(const char *p, char *out, size_t out_size) {
+    size_t len = 0;
+    if (*p == '"') {
+        p++;
+        while (*p && !(*p == '"' && p[1] != '"')) {
+            if (*p == '"') {
+                p++; // "" -> "
+            }
+            if (len < out_size - 1) {
+                out[len++] = *p;
+            }
+            p++;
+        }
+        if (*p == '"') {
+            p++;
+        }
+    } else {
+        while (*p && *p != ',') {
+            if (len < out_size - 1) {
+                out[len++] = *p;
+            }
+            p++;
+        }
+    }
+    out[len] = '\0';
+    return *p == ',' ? p + 1 : p;
+}
+
+static esp_err_t csv_import_line(char *line) {
+    size_t len = strlen(line);
+    while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == ' ')) {
+        line[--len] = '\0';
+    }
+    if (len == 0 || strncmp(line, "uid,", 4) == 0) {
+        return ESP_OK; // linha vazia ou cabeçalho
+    }
+    
+    rfid_record_t record;
+    char field[16];
+    memset(&record, 0, sizeof(record));
+    const char *p = csv_next_field(line, record.uid, sizeof(record.uid));
+    p = csv_next_field(p, record.name, sizeof(record.name));
+    p = csv_next_field(p, field, sizeof(field));
+    record.access_level = field[0] ? (uint8_t)atoi(field) : ACCESS_LEVEL_USER;
+    p = csv_next_field(p, field, sizeof(field));
+    record.first_seen = strtoul(field, NULL, 10);
+    p = csv_next_field(p, field, sizeof(field));
+    record.last_seen = strtoul(field, NULL, 10);
+    csv_next_field(p, field, sizeof(field));
+    record.access_count = strtoul(field, NULL, 10);
+    return database_import_add(&record);
+}
+
+// Processa uma linha completa; linha maior que CSV_LINE_MAX conta como
+// inválida. Só erro de escrita interrompe o lote.
+static esp_err_t csv_import_feed(char *line, size_t line_len, bool too_long, uint32_t *invalid) {
+    if (too_long) {
+        (*invalid)++;
+        return ESP_OK;
+    }
+    line[line_len] = '\0';
+    esp_err_t ret = csv_import_line(line);
+    return (ret == ESP_OK || ret == ESP_ERR_INVALID_ARG) ? ESP_OK : ret;
+}
+
+// POST /api/cards/import: corpo CSV lido em blocos, sem carregar o lote
+esp_err_t api_cards_import_handler(httpd_req_t *req) {
+    cJSON *response = cJSON_CreateObject();
+    esp_err_t result = database_import_begin();
+    if (result != ESP_OK) {
+        cJSON_AddBoolToObject(response, "success", false);
+        cJSON_AddStringToObject(response, "message", "Importação já em andamento");
+    } else {
+        char buf[512];
+        char line[CSV_LINE_MAX];
+        size_t line_len = 0;
+        bool too_long = false;
+        uint32_t too_long_count = 0;
+        size_t remaining = req->content_len;
+        
+        while (remaining > 0 && result == ESP_OK) {
+            int received = httpd_req_recv(req, buf, MIN(remaining, sizeof(buf)));
+            if (received <= 0) {
+                result = ESP_FAIL; // conexão caiu: corpo incompleto
+                break;
+            }
+            remaining -= received;
+            for (int i = 0; i < received && result == ESP_OK; i++) {
+                if (buf[i] == '\n') {
+                    result = csv_import_feed(line, line_len, too_long, &too_long_count);
+                    line_len = 0;
+                    too_long = false;
+                } else if (line_len < sizeof(line) - 1) {
+                    line[line_len++] = buf[i];
+                } else {
+                    too_long = true;
+                }
+            }
+        }
+        if ((line_len > 0 || too_long) && result == ESP_OK) {
+            result = csv_import_feed(line, line_len, too_long, &too_long_count);
+        }
+        
+        // Corpo incompleto ou erro de escrita: nada do lote fica gravado
+        database_import_stats_t stats;
+        memset(&stats, 0, sizeof(stats));
+        if (result == ESP_OK) {
+            result = database_import_end(&stats);
+        } else {
+            database_import_abort();
+        }
+        stats.invalid += too_long_count;
+        bool success = (result == ESP_OK);
+        cJSON_AddBoolToObject(response, "success", success);
+        cJSON_AddNumberToObject(response, "imported", stats.imported);
+        cJSON_AddNumberToObject(response, "duplicates", stats.duplicates);
+        cJSON_AddNumberToObject(response, "invalid", stats.invalid);
+        cJSON_AddNumberToObject(response, "elapsed_ms", stats.elapsed_ms);
+        cJSON_AddNumberToObject(response, "records_per_sec", stats.records_per_sec);
+        if (!success) {
+            cJSON_AddStringToObject(response, "message", "Erro durante a importação; nenhum cartão foi importado");
+            ESP_LOGW(TAG, "Importação via API desfeita: %s", esp_err_to_name(result));
+        } else {
+            ESP_LOGI(TAG, "Importação via API: %lu cartões (%lu/s)",
+                     (unsigned long)stats.imported, (unsigned long)stats.records_per_sec);
+        }
+    }
+    
+    char *response_string = cJSON_Print(response);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, response_string, strlen(response_string));
+    
+    free(response_string);
+    cJSON_Delete(response);
+    return ESP_OK;
+}
+
+// GET /api/cards/export: CSV no mesmo formato aceito pela importação
+esp_err_t api_cards_export_handler(httpd_req_t *req) {
+    // Sem compactação até o fim o cursor não é invalidado no meio do arquivo
+    database_cards_iter_t iter;
+    database_compact_pause();
+    if (database_cards_iter_begin(&iter, 0, NULL, NULL) != ESP_OK) {
+        database_compact_resume();
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    
+    httpd_resp_set_type(req, "text/csv");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"cards.csv\"");
+    httpd_resp_sendstr_chunk(req, CSV_HEADER);
+    
+    rfid_record_t record;
+    char line[CSV_LINE_MAX + MAX_NAME_LENGTH];
+    uint32_t count = 0;
+    esp_err_t result;
+    while ((result = database_cards_iter_next(&iter, &record)) == ESP_OK) {
+        // Nome entre aspas quando contém separadores
+        char name[2 * MAX_NAME_LENGTH + 3];
+        if (strpbrk(record.name, ",\"\n")) {
+            size_t n = 0;
+            name[n++] = '"';
+            for (const char *c = record.name; *c && n < sizeof(name) - 2; c++) {
+                if (*c == '"') {
+                    name[n++] = '"';
+                }
+                name[n++] = (*c == '\n') ? ' ' : *c;
+            }
+            name[n++] = '"';
+            name[n] = '\0';
+        } else {
+            strcpy(name, record.name);
+        }
+        snprintf(line, sizeof(line), "%s,%s,%u,%lu,%lu,%lu\n", record.uid, name,
+                 record.access_level, (unsigned long)record.first_seen,
+                 (unsigned long)record.last_seen, (unsigned long)record.access_count);
+        if (httpd_resp_sendstr_chunk(req, line) != ESP_OK) {
+            database_cards_iter_end(&iter);
+            database_compact_resume();
+            return ESP_FAIL;
+        }
+        count++;
+    }
+    database_cards_iter_end(&iter);
+    database_compact_resume();
+    
+    // Só ESP_ERR_NOT_FOUND é fim dos dados; sem o chunk final a conexão é
+    // fechada e o cliente não recebe um CSV truncado como completo
+    if (result != ESP_ERR_NOT_FOUND) {
+        ESP_LOGE(TAG, "Exportação interrompida após %lu cartões: %s", (unsigned long)count, esp_err_to_name(result));
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Exportação via API: %lu cartões", (unsigned long)count);
+    return httpd_resp_sendstr_chunk(req, NULL);
+}
+
 esp_err_t api_card_delete_handler(httpd_req_t *req) {
     // Extrair UID da URI
     char uid[64];
@@ -353,41 +859,58 @@ esp_err_t api_card_delete_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
+// GET /api/logs[?cursor=&limit=&from=&to=&uid=]: mais recentes primeiro,
+// em streaming; from/to (epoch) e uid usam os resumos dos blocos do log
 esp_err_t api_logs_handler(httpd_req_t *req) {
-    cJSON *json = cJSON_CreateObject();
-    cJSON *logs_array = cJSON_CreateArray();
-    
-    access_log_t *logs = NULL;
-    int count = 0;
-    
-    if (database_get_access_logs(&logs, &count, 50) == ESP_OK) { // Últimos 50 logs
-        for (int i = 0; i < count; i++) {
-            cJSON *log_obj = cJSON_CreateObject();
-            cJSON_AddStringToObject(log_obj, "uid", logs[i].uid);
-            cJSON_AddStringToObject(log_obj, "action", logs[i].action);
-            cJSON_AddNumberToObject(log_obj, "timestamp", logs[i].timestamp);
-            cJSON_AddItemToArray(logs_array, log_obj);
-        }
-        
-        if (logs) {
-            free(logs);
-        }
-        
-        cJSON_AddItemToObject(json, "logs", logs_array);
-        cJSON_AddBoolToObject(json, "success", true);
-    } else {
-        cJSON_Delete(logs_array);
-        cJSON_AddBoolToObject(json, "success", false);
-        cJSON_AddStringToObject(json, "message", "Erro ao obter logs");
+    bool params_ok = true;
+    uint32_t cursor = query_get_u32(req, "cursor", 0, &params_ok);
+    uint32_t limit = query_get_u32(req, "limit", 50, &params_ok); // Últimos 50 logs por padrão
+    
+    database_log_query_t query = {
+        .from = query_get_u32(req, "from", 0, &params_ok),
+        .to = query_get_u32(req, "to", 0, &params_ok),
+    };
+    if (!params_ok) {
+        return send_json_failure(req, "Parâmetro numérico inválido");
+    }
+    char uid[MAX_UID_LENGTH];
+    bool uid_ok = true;
+    if (query_get_str(req, "uid", uid, sizeof(uid))) {
+        uid_ok = card_uid_parse(uid, query.uid, &query.uid_len) == ESP_OK;
+    }
+    bool has_query = query.from || query.to || query.uid_len;
+    
+    database_logs_iter_t iter;
+    esp_err_t ret = !uid_ok ? ESP_ERR_INVALID_ARG :
+                    has_query ? database_logs_query_begin(&iter, cursor, &query) :
+                                database_logs_iter_begin(&iter, cursor, NULL, NULL);
+    if (ret != ESP_OK) {
+        return send_json_failure(req, uid_ok ? "Erro ao obter logs" : "UID inválido");
     }
     
-    char *json_string = cJSON_Print(json);
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, json_string, strlen(json_string));
+    httpd_resp_sendstr_chunk(req, "{\"logs\":[");
+    
+    access_log_t entry;
+    uint32_t count = 0;
+    esp_err_t result = ESP_OK;
+    while ((limit == 0 || count < limit) &&
+           (result = database_logs_iter_next(&iter, &entry)) == ESP_OK) {
+        cJSON *log_obj = cJSON_CreateObject();
+        cJSON_AddStringToObject(log_obj, "uid", entry.uid);
+        cJSON_AddStringToObject(log_obj, "action", entry.action);
+        cJSON_AddNumberToObject(log_obj, "timestamp", entry.timestamp);
+        if (stream_json_item(req, log_obj, count == 0) != ESP_OK) {
+            database_logs_iter_end(&iter);
+            return ESP_FAIL;
+        }
+        count++;
+    }
     
-    free(json_string);
-    cJSON_Delete(json);
-    return ESP_OK;
+    bool more = (limit != 0 && count == limit);
+    uint32_t next_cursor = more ? database_logs_iter_cursor(&iter) : 0;
+    database_logs_iter_end(&iter);
+    return stream_json_end(req, more || result == ESP_ERR_NOT_FOUND, next_cursor);
 }
 
 esp_err_t api_scan_handler(httpd_req_t *req) {
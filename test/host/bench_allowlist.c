@@ -0,0 +1,110 @@
+// Visão do caminho do toque (baldes compilados em hash perfeito): tempo de
+// reconstrução, bytes por cartão, custo da consulta e de uma mudança, com
+// UIDs de 4, 7 e 10 bytes e buracos na tabela quente. Confere cada UID
+// presente e UIDs que com certeza não estão na tabela.
+//   bench_allowlist [consultas=200000] [cartões=1000] [cartões=...]
+#include <string.h>
+#include "test_util.h"
+#include "card_view.h"
+
+#define ABSENT_CHECKS   20000
+#define PUTS            2000
+
+static double ns_per(int64_t us, uint32_t count) {
+    return count ? us * 1000.0 / count : 0.0;
+}
+
+// Tabela quente com ~1/11 dos slots livres, como depois de remoções
+static card_hot_t *make_cards(uint32_t slots, unsigned seed) {
+    card_hot_t *cards = calloc(slots ? slots : 1, sizeof(card_hot_t));
+    CHECK(cards);
+    for (uint32_t i = 0; i < slots; i++) {
+        if (i % 11 == 5) {
+            continue;
+        }
+        card_hot_t *card = &cards[i];
+        card->uid_len = i % 17 == 0 ? 10 : i % 3 == 0 ? 7 : 4;
+        for (uint8_t b = 0; b < card->uid_len; b++) {
+            card->uid[b] = (uint8_t)rand_r(&seed);
+        }
+        // Bytes iniciais distintos: nenhum UID repetido
+        card->uid[0] = (uint8_t)i;
+        card->uid[1] = (uint8_t)(i >> 8);
+        card->uid[2] = (uint8_t)(i >> 16);
+        card->access_level = (uint8_t)(ACCESS_LEVEL_USER + i % 3);
+    }
+    return cards;
+}
+
+static void run(uint32_t count, uint32_t lookups) {
+    uint32_t slots = count + count / 10;
+    unsigned seed = count + 1;
+    card_hot_t *cards = make_cards(slots, seed);
+
+    card_view_t view;
+    card_view_init(&view);
+    CHECK_OK(card_view_rebuild(&view, cards, slots));
+    card_view_stats_t stats;
+    card_view_get_stats(&view, &stats);
+
+    uint32_t present = 0;
+    for (uint32_t i = 0; i < slots; i++) {
+        if (!cards[i].uid_len) {
+            continue;
+        }
+        uint8_t level = 0;
+        CHECK_OK(card_view_lookup(&view, cards[i].uid, cards[i].uid_len, &level));
+        CHECK(level == cards[i].access_level);
+        present++;
+    }
+    CHECK(present == stats.entries);
+    // Os três primeiros bytes são o slot: além de 'slots' nada foi cadastrado
+    for (uint32_t i = 0; i < ABSENT_CHECKS; i++) {
+        uint32_t absent = slots + i;
+        uint8_t uid[4] = { (uint8_t)absent, (uint8_t)(absent >> 8), (uint8_t)(absent >> 16), (uint8_t)rand_r(&seed) };
+        CHECK(card_view_lookup(&view, uid, sizeof(uid), NULL) == ESP_ERR_NOT_FOUND);
+    }
+
+    // Consultas em ordem espalhada sobre a tabela (com os slots livres)
+    volatile uint32_t sink = 0;
+    uint8_t level;
+    uint32_t span = slots ? slots : 1;
+    int64_t start = test_now_us();
+    for (uint32_t k = 0; k < lookups; k++) {
+        const card_hot_t *card = &cards[(k * 2654435761u) % span];
+        sink += card_view_lookup(&view, card->uid, card->uid_len, &level) == ESP_OK;
+    }
+    int64_t view_us = test_now_us() - start;
+
+    // Troca de nível: monta e publica de novo só o balde do cartão
+    uint32_t puts = 0;
+    start = test_now_us();
+    for (uint32_t k = 0; k < PUTS && present; k++) {
+        const card_hot_t *card = &cards[(k * 2654435761u) % span];
+        if (card->uid_len) {
+            CHECK_OK(card_view_put(&view, card->uid, card->uid_len, (uint8_t)(card->access_level + 1)));
+            puts++;
+        }
+    }
+    int64_t put_us = test_now_us() - start;
+
+    printf("bench_allowlist: %6" PRIu32 " cartões | reconstrução %7" PRIu32 " us, %7" PRIu32 " bytes (%.1f por cartão)"
+           " | card_view_lookup %5.1f ns, card_view_put %6.0f ns\n",
+           stats.entries, stats.rebuild_us, stats.memory_bytes,
+           stats.entries ? (double)stats.memory_bytes / stats.entries : 0.0,
+           ns_per(view_us, lookups), ns_per(put_us, puts));
+    (void)sink;
+    card_view_free(&view);
+    free(cards);
+}
+
+int main(int argc, char **argv) {
+    uint32_t lookups = (uint32_t)test_arg(argc, argv, 1, 200000);
+    if (argc < 3) {
+        run(1000, lookups);
+    }
+    for (int i = 2; i < argc; i++) {
+        run((uint32_t)test_arg(argc, argv, i, 1000), lookups);
+    }
+    return 0;
+}
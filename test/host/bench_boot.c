@@ -0,0 +1,78 @@
+// Tempo do boot até o banco ficar pronto: database_init após um
+// fechamento limpo e após uma queda com registros do journal a refazer.
+//   bench_boot [cartões=1000] [cartões=...]
+#include <string.h>
+#include "test_util.h"
+#include "database.h"
+
+#define CRASH_ADDS  4
+
+typedef struct {
+    int64_t us;
+    uint64_t reads;
+    uint32_t ready_ms;
+    storage_journal_stats_t journal;
+} boot_t;
+
+static void boot(boot_t *out) {
+    fake_nvs_counters_t before, after;
+    fake_nvs_get_counters(&before);
+    int64_t start = test_now_us();
+    CHECK_OK(database_init());
+    out->us = test_now_us() - start;
+    fake_nvs_get_counters(&after);
+    out->reads = after.reads - before.reads;
+    CHECK_OK(database_get_journal_stats(&out->journal, &out->ready_ms));
+}
+
+static void run(uint32_t cards) {
+    test_reset_flash();
+    fake_nvs_set_partition_size("rfid0", 0);
+    CHECK_OK(database_init());
+    CHECK_OK(database_import_begin());
+    for (uint32_t i = 0; i < cards; i++) {
+        rfid_record_t record = { .access_level = ACCESS_LEVEL_USER };
+        test_uid(i, record.uid, sizeof(record.uid));
+        snprintf(record.name, sizeof(record.name), "Cartao %" PRIu32, i);
+        CHECK_OK(database_import_add(&record));
+    }
+    CHECK_OK(database_import_end(NULL));
+    CHECK_OK(database_close());
+
+    boot_t clean;
+    boot(&clean);
+    CHECK(clean.journal.replayed == 0);
+
+    // Queda logo após alguns cadastros: o próximo boot refaz o fim do journal
+    char uid[MAX_UID_LENGTH];
+    for (uint32_t i = 0; i < CRASH_ADDS; i++) {
+        test_uid(cards + i, uid, sizeof(uid));
+        CHECK_OK(database_add_card(uid, "Novo", ACCESS_LEVEL_USER));
+    }
+    fake_nvs_fail_after(0);
+    database_close();
+    fake_nvs_fail_after(-1);
+
+    boot_t crash;
+    boot(&crash);
+    CHECK(crash.journal.replayed <= STORAGE_JOURNAL_SLOTS);
+    int total = 0, accesses = 0;
+    CHECK_OK(database_get_stats(&total, &accesses));
+    CHECK(total == (int)(cards + CRASH_ADDS));
+    CHECK_OK(database_close());
+
+    printf("bench_boot: %6" PRIu32 " cartões | limpo %8.2f ms %7" PRIu64 " leituras NVS (journal %" PRIu32
+           " us) | após queda %8.2f ms %7" PRIu64 " leituras, %" PRIu32 " refeitos em %" PRIu32 " us\n",
+           cards, clean.us / 1000.0, clean.reads, clean.journal.recovery_us, crash.us / 1000.0, crash.reads,
+           crash.journal.replayed, crash.journal.recovery_us);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        run(1000);
+    }
+    for (int i = 1; i < argc; i++) {
+        run((uint32_t)test_arg(argc, argv, i, 1000));
+    }
+    return 0;
+}
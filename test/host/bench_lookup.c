@@ -0,0 +1,66 @@
+// Busca de cartões por UID: leituras do NVS por database_get_card (índice
+// hash UID -> slot) e tempo das buscas só em RAM, com acerto e com erro.
+//   bench_lookup [cartões=2000] [buscas=20000]
+#include <string.h>
+#include "test_util.h"
+#include "database.h"
+
+int main(int argc, char **argv) {
+    uint32_t cards = (uint32_t)test_arg(argc, argv, 1, 2000);
+    uint32_t lookups = (uint32_t)test_arg(argc, argv, 2, 20000);
+
+    test_reset_flash();
+    fake_nvs_set_partition_size("rfid0", 0);
+    CHECK_OK(database_init());
+
+    char uid[MAX_UID_LENGTH];
+    CHECK_OK(database_import_begin());
+    for (uint32_t i = 0; i < cards; i++) {
+        rfid_record_t record = { .access_level = ACCESS_LEVEL_USER };
+        test_uid(i, record.uid, sizeof(record.uid));
+        snprintf(record.name, sizeof(record.name), "Cartao %" PRIu32, i);
+        CHECK_OK(database_import_add(&record));
+    }
+    CHECK_OK(database_import_end(NULL));
+
+    // database_get_card: o índice aponta o slot e o registro é lido uma vez
+    fake_nvs_counters_t before, after;
+    fake_nvs_get_counters(&before);
+    int64_t start = test_now_us();
+    for (uint32_t i = 0; i < cards; i++) {
+        rfid_record_t record;
+        test_uid(i, uid, sizeof(uid));
+        CHECK_OK(database_get_card(uid, &record));
+        CHECK(strcmp(record.uid, uid) == 0);
+    }
+    int64_t get_us = test_now_us() - start;
+    fake_nvs_get_counters(&after);
+    double reads_per_get = (double)(after.reads - before.reads) / cards;
+    CHECK(reads_per_get <= 2.0);
+
+    card_hot_t hot;
+    start = test_now_us();
+    for (uint32_t i = 0; i < lookups; i++) {
+        test_uid(i % cards, uid, sizeof(uid));
+        CHECK_OK(database_lookup_card(uid, &hot));
+    }
+    int64_t hit_us = test_now_us() - start;
+
+    uint8_t level;
+    start = test_now_us();
+    for (uint32_t i = 0; i < lookups; i++) {
+        test_uid(cards + i, uid, sizeof(uid)); // nunca cadastrado
+        CHECK(database_lookup_access(uid, &level) == ESP_ERR_NOT_FOUND);
+    }
+    int64_t miss_us = test_now_us() - start;
+    fake_nvs_get_counters(&before);
+    CHECK(before.reads == after.reads); // buscas em RAM não tocam o NVS
+
+    printf("bench_lookup: %" PRIu32 " cartões\n", cards);
+    printf("  database_get_card:      %.2f leituras NVS, %.0f ns por busca\n",
+           reads_per_get, get_us * 1000.0 / cards);
+    printf("  database_lookup_card:   %.0f ns por busca (acerto)\n", hit_us * 1000.0 / lookups);
+    printf("  database_lookup_access: %.0f ns por busca (UID desconhecido)\n", miss_us * 1000.0 / lookups);
+    CHECK_OK(database_close());
+    return 0;
+}
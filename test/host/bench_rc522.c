@@ -0,0 +1,124 @@
+// Detecção -> UID no RC522 emulado com o modelo de tempo (fake_rc522.c), com
+// UIDs de 4, 7 e 10 bytes, colisões e uma resposta perdida:
+// transações e tempo por estágio (WUPA, anticolisão, SELECT), bytes SPI,
+// tempo de barramento e no ar e o total no relógio virtual, com espera por
+// polling e pelo pino IRQ. O SPI usa o clock que o driver configura
+// (500 kHz); preparo por transação e latência da ISR são parâmetros do
+// modelo. Toda leitura tem de caber em RC522_UID_BUDGET_US.
+//   bench_rc522 [preparo_us=20] [irq_us=15]
+#include <string.h>
+#include "test_util.h"
+#include "rc522.h"
+
+#define BENCH_PIN_IRQ   40
+
+typedef struct {
+    const char *name;
+    fake_picc_t cards[FAKE_RC522_MAX_CARDS];
+    int count;
+    int winner;                 // cartão que sai da anticolisão (bit disputado em 1)
+    int lost_anticoll;          // respostas de anticolisão perdidas no ar
+} bench_case_t;
+
+#define PICC4(...)   { .uid = {__VA_ARGS__}, .uid_len = 4, .sak = 0x08 }
+#define PICC7(...)   { .uid = {__VA_ARGS__}, .uid_len = 7, .sak = 0x00 }
+#define PICC10(...)  { .uid = {__VA_ARGS__}, .uid_len = 10, .sak = 0x20 }
+
+static const bench_case_t s_cases[] = {
+    { "4 bytes", { PICC4(0xDE, 0xAD, 0xBE, 0xEF) }, 1, 0, 0 },
+    { "7 bytes", { PICC7(0x04, 0xA1, 0xB2, 0xC3, 0xD4, 0xE5, 0xF6) }, 1, 0, 0 },
+    { "10 bytes", { PICC10(0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99) }, 1, 0, 0 },
+    { "2x4, colisão em CL1", { PICC4(0x12, 0x34, 0x56, 0x78), PICC4(0x13, 0x34, 0x56, 0x78) }, 2, 1, 0 },
+    { "2x7, colisão em CL2", { PICC7(0x04, 0xA1, 0xB2, 0xC3, 0xD4, 0xE5, 0xF6),
+                               PICC7(0x04, 0xA1, 0xB2, 0x03, 0xD4, 0xE5, 0xF6) }, 2, 0, 0 },
+    { "3x10, colisão em CL3", { PICC10(0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x01),
+                                PICC10(0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x02),
+                                PICC10(0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x03) }, 3, 2, 0 },
+    { "4 bytes, anticol. perdida", { PICC4(0xDE, 0xAD, 0xBE, 0xEF) }, 1, 0, 1 },
+};
+
+typedef struct {
+    uint32_t spi;
+    uint32_t bytes;
+    uint64_t spi_us;
+    uint64_t air_us;
+    rc522_trace_t trace;
+} read_cost_t;
+
+// WUPA de rc522_card_present e rc522_read_card, como no rfid_task
+static void read_once(rc522_handle_t *handle, const bench_case_t *c, read_cost_t *cost) {
+    rc522_stats_t before, after;
+    fake_rc522_bus_t bus_before, bus_after;
+    rc522_card_t card;
+
+    fake_rc522_set_cards(c->cards, c->count);
+    fake_rc522_lose_anticoll(c->lost_anticoll);
+    CHECK_OK(rc522_get_stats(handle, &before));
+    fake_rc522_get_bus(&bus_before);
+    CHECK(rc522_card_present(handle) == RC522_OK);
+    CHECK(rc522_read_card(handle, &card) == RC522_OK);
+    CHECK_OK(rc522_get_trace(handle, &cost->trace));
+    CHECK_OK(rc522_get_stats(handle, &after));
+    fake_rc522_get_bus(&bus_after);
+
+    const fake_picc_t *want = &c->cards[c->winner];
+    CHECK(card.uid_len == want->uid_len && memcmp(card.uid, want->uid, card.uid_len) == 0);
+    CHECK(cost->trace.attempts == 1 + c->lost_anticoll);
+    cost->spi = after.spi_transactions - before.spi_transactions;
+    cost->bytes = bus_after.bytes - bus_before.bytes;
+    cost->spi_us = bus_after.spi_us - bus_before.spi_us;
+    cost->air_us = bus_after.air_us - bus_before.air_us;
+    CHECK(cost->spi == bus_after.frames - bus_before.frames);
+    CHECK(cost->spi == (uint32_t)cost->trace.request_spi + cost->trace.anticoll_spi + cost->trace.select_spi);
+}
+
+// Colunas em caracteres, não em bytes (nomes com acento em UTF-8)
+static int text_width(const char *text) {
+    int width = 0;
+    for (; *text; text++) {
+        width += ((unsigned char)*text & 0xC0) != 0x80;
+    }
+    return width;
+}
+
+static void run(const char *mode, int pin_irq) {
+    rc522_handle_t handle;
+    rc522_config_t config = RC522_CONFIG_DEFAULT();
+
+    config.pin_irq = pin_irq;
+    memset(&handle, 0, sizeof(handle));
+    CHECK_OK(rc522_init_with_config(&handle, &config));
+    CHECK(handle.irq_mode == (pin_irq >= 0));
+
+    printf("%s:\n", mode);
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) {
+        read_cost_t cost;
+        fake_clock_set_virtual(true);
+        read_once(&handle, &s_cases[i], &cost);
+        fake_clock_set_virtual(false);
+
+        const rc522_trace_t *t = &cost.trace;
+        printf("  %s%*s WUPA %5" PRIu32 " us %3u tr | anticol. %5" PRIu32 " us %3u tr | "
+               "SELECT %5" PRIu32 " us %3u tr | %3" PRIu32 " tr %4" PRIu32 " B, SPI %5" PRIu64 " us, "
+               "ar %5" PRIu64 " us | total %5" PRIu32 " us\n",
+               s_cases[i].name, 26 - text_width(s_cases[i].name), "", t->request_us, t->request_spi, t->anticoll_us, t->anticoll_spi,
+               t->select_us, t->select_spi, cost.spi, cost.bytes, cost.spi_us, cost.air_us, t->total_us);
+        CHECK(t->total_us < RC522_UID_BUDGET_US);
+    }
+    CHECK_OK(rc522_deinit(&handle));
+}
+
+int main(int argc, char **argv) {
+    fake_rc522_timing_t timing = {
+        .frame_us = (uint32_t)test_arg(argc, argv, 1, 20),
+        .irq_us = (uint32_t)test_arg(argc, argv, 2, 15),
+    };
+    fake_rc522_set_timing(&timing);
+    printf("SPI a 500 kHz, preparo %" PRIu32 " us por transação, ISR %" PRIu32 " us, orçamento %d us\n",
+           timing.frame_us, timing.irq_us, RC522_UID_BUDGET_US);
+
+    run("polling", -1);
+    run("IRQ", BENCH_PIN_IRQ);
+    printf("bench_rc522: ok\n");
+    return 0;
+}
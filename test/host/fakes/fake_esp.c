@@ -0,0 +1,87 @@
+#include "fake_host.h"
+#include "esp_err.h"
+#include "esp_system.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SHUTDOWN_HANDLERS_MAX 8
+
+static shutdown_handler_t s_shutdown_handlers[SHUTDOWN_HANDLERS_MAX];
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+    case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_NOT_ENOUGH_SPACE: return "ESP_ERR_NVS_NOT_ENOUGH_SPACE";
+    case ESP_ERR_NVS_INVALID_LENGTH: return "ESP_ERR_NVS_INVALID_LENGTH";
+    default: return "UNKNOWN ERROR";
+    }
+}
+
+void esp_error_check_failed(esp_err_t rc, const char *file, int line, const char *expression) {
+    fprintf(stderr, "ESP_ERROR_CHECK falhou: %s (%s) em %s:%d\n", esp_err_to_name(rc), expression, file, line);
+    abort();
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle) {
+    for (int i = 0; i < SHUTDOWN_HANDLERS_MAX; i++) {
+        if (!s_shutdown_handlers[i]) {
+            s_shutdown_handlers[i] = handle;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_unregister_shutdown_handler(shutdown_handler_t handle) {
+    for (int i = 0; i < SHUTDOWN_HANDLERS_MAX; i++) {
+        if (s_shutdown_handlers[i] == handle) {
+            s_shutdown_handlers[i] = NULL;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_STATE;
+}
+
+void fake_esp_run_shutdown_handlers(void) {
+    for (int i = SHUTDOWN_HANDLERS_MAX - 1; i >= 0; i--) {
+        if (s_shutdown_handlers[i]) {
+            s_shutdown_handlers[i]();
+        }
+    }
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+uint8_t esp_rom_crc8_le(uint8_t crc, const uint8_t *buf, uint32_t len) {
+    crc = (uint8_t)~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (uint8_t)((crc >> 1) ^ (0x8C & (0u - (crc & 1))));
+        }
+    }
+    return (uint8_t)~crc;
+}
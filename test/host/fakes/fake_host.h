@@ -0,0 +1,80 @@
+#ifndef FAKE_HOST_H
+#define FAKE_HOST_H
+
+// Controles dos fakes do ESP-IDF usados pelos testes no host
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+typedef struct {
+    uint64_t reads;
+    uint64_t writes;            // set e erase
+    uint64_t commits;
+} fake_nvs_counters_t;
+
+// Apaga todas as partições NVS (como um flash novo)
+void fake_nvs_reset(void);
+// Limita a partição a 'bytes' como o NVS real (126 entradas de 32 bytes por
+// página de 4KB, uma página reservada); 0 = sem limite
+void fake_nvs_set_partition_size(const char *label, size_t bytes);
+// Queda de energia: depois de 'writes' gravações as seguintes falham com
+// ESP_FAIL sem alterar nada; -1 desliga
+void fake_nvs_fail_after(int64_t writes);
+void fake_nvs_get_counters(fake_nvs_counters_t *counters);
+
+// Partição de dados em RAM com semântica de flash (gravar só zera bits,
+// apagar volta a 0xFF em setores de 4KB)
+void fake_partition_add(const char *label, int subtype, uint32_t size);
+void fake_partition_reset(void);
+
+// Roda os handlers de esp_register_shutdown_handler, como no esp_restart
+void fake_esp_run_shutdown_handlers(void);
+
+// Relógio virtual: esp_timer_get_time (e o tick) param e só andam com
+// fake_clock_advance_us, que os fakes chamam com o tempo modelado; fora
+// dele fake_clock_advance_us não faz nada
+void fake_clock_set_virtual(bool on);
+bool fake_clock_is_virtual(void);
+void fake_clock_advance_us(int64_t us);
+
+// PICC ISO 14443-3 no campo do RC522 emulado (fake_rc522.c); UID de 4, 7
+// ou 10 bytes e SAK do último nível da cascata
+#define FAKE_RC522_MAX_CARDS    4
+
+typedef struct {
+    uint8_t uid[10];
+    uint8_t uid_len;
+    uint8_t sak;
+} fake_picc_t;
+
+// Troca os cartões no campo; todos começam em IDLE
+void fake_rc522_set_cards(const fake_picc_t *cards, int count);
+// Respostas de anticolisão com colisão desde o último fake_rc522_set_cards
+uint32_t fake_rc522_collisions(void);
+// As próximas 'count' respostas de anticolisão se perdem no ar (o leitor vê
+// o timeout); fake_rc522_set_cards zera
+void fake_rc522_lose_anticoll(int count);
+
+// Modelo de tempo no relógio virtual (fake_clock_set_virtual): cada quadro
+// SPI custa frame_us mais 8 bits por byte no clock_speed_hz do dispositivo;
+// o Transceive conclui depois do envio, FDT e resposta a 106 kbit/s, ou do
+// timer do RC522 (TMode/TPrescaler/TReload) sem resposta. Com o pino IRQ a
+// task acorda irq_us depois da conclusão. NULL = conclusão na hora
+typedef struct {
+    uint32_t frame_us;          // preparo de cada transação no driver SPI
+    uint32_t irq_us;            // borda do IRQ -> task acordada
+} fake_rc522_timing_t;
+
+// Contadores acumulados desde o início do processo
+typedef struct {
+    uint32_t frames;
+    uint32_t bytes;
+    uint64_t spi_us;            // tempo de barramento modelado
+    uint64_t air_us;            // tempo no ar modelado (inclui timeouts)
+} fake_rc522_bus_t;
+
+void fake_rc522_set_timing(const fake_rc522_timing_t *timing);
+void fake_rc522_get_bus(fake_rc522_bus_t *bus);
+
+#endif // FAKE_HOST_H
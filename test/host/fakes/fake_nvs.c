@@ -0,0 +1,487 @@
+// NVS em RAM: entradas por partição/namespace/chave numa tabela hash, com
+// o custo em entradas de 32 bytes do NVS real para simular partição cheia
+#include "fake_host.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NVS_PARTITIONS_MAX      16
+#define NVS_HANDLES_MAX         64
+#define NVS_BUCKETS             65536
+#define NVS_ENTRIES_PER_PAGE    126
+#define NVS_PAGE_SIZE           4096
+
+typedef struct {
+    char label[16];
+    int64_t capacity;           // entradas; -1 = sem limite
+    int64_t used;
+} nvs_part_t;
+
+typedef struct {
+    int part;
+    char name_space[16];
+} nvs_open_t;
+
+typedef struct {
+    bool used;
+    int handle;                 // índice em s_handles (partição + namespace)
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_type_t type;
+    uint8_t *data;
+    size_t len;
+    int32_t next;               // próximo no balde ou na lista livre
+} nvs_entry_t;
+
+struct nvs_opaque_iterator_t {
+    int part;
+    char name_space[16];
+    nvs_type_t type;
+    uint32_t pos;
+};
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static nvs_part_t s_parts[NVS_PARTITIONS_MAX];
+static int s_part_count = 0;
+static nvs_open_t s_handles[NVS_HANDLES_MAX];
+static int s_handle_count = 0;
+static nvs_entry_t *s_entries = NULL;
+static uint32_t s_entry_count = 0;
+static uint32_t s_entry_capacity = 0;
+static int32_t s_free_head = -1;
+static int32_t s_buckets[NVS_BUCKETS];
+static bool s_buckets_ready = false;
+static int64_t s_fail_after = -1;
+static fake_nvs_counters_t s_counters;
+
+static void buckets_init(void) {
+    if (!s_buckets_ready) {
+        for (uint32_t i = 0; i < NVS_BUCKETS; i++) {
+            s_buckets[i] = -1;
+        }
+        s_buckets_ready = true;
+    }
+}
+
+static int part_find_or_add(const char *label) {
+    for (int i = 0; i < s_part_count; i++) {
+        if (strcmp(s_parts[i].label, label) == 0) {
+            return i;
+        }
+    }
+    if (s_part_count >= NVS_PARTITIONS_MAX) {
+        abort();
+    }
+    nvs_part_t *part = &s_parts[s_part_count];
+    snprintf(part->label, sizeof(part->label), "%s", label);
+    part->capacity = -1;
+    part->used = 0;
+    return s_part_count++;
+}
+
+static uint32_t key_hash(int handle, const char *key) {
+    uint32_t hash = 2166136261u ^ (uint32_t)handle;
+    for (; *key; key++) {
+        hash = (hash ^ (uint8_t)*key) * 16777619u;
+    }
+    return hash % NVS_BUCKETS;
+}
+
+// Entradas de 32 bytes ocupadas, como no NVS: cabeçalho + dados
+static int64_t entry_cost(nvs_type_t type, size_t len) {
+    switch (type) {
+    case NVS_TYPE_U8:
+    case NVS_TYPE_U32:
+        return 1;
+    case NVS_TYPE_STR:
+        return 1 + (int64_t)((len + 31) / 32);
+    default:
+        return 2 + (int64_t)((len + 31) / 32); // índice do blob + dados
+    }
+}
+
+static nvs_entry_t *entry_find(int handle, const char *key) {
+    for (int32_t i = s_buckets[key_hash(handle, key)]; i >= 0; i = s_entries[i].next) {
+        nvs_entry_t *entry = &s_entries[i];
+        if (entry->handle == handle && strcmp(entry->key, key) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void entry_remove(nvs_entry_t *entry) {
+    int32_t index = (int32_t)(entry - s_entries);
+    int32_t *link = &s_buckets[key_hash(entry->handle, entry->key)];
+    while (*link != index) {
+        link = &s_entries[*link].next;
+    }
+    *link = entry->next;
+    s_parts[s_handles[entry->handle].part].used -= entry_cost(entry->type, entry->len);
+    free(entry->data);
+    memset(entry, 0, sizeof(*entry));
+    entry->next = s_free_head;
+    s_free_head = index;
+}
+
+static nvs_entry_t *entry_alloc(int handle, const char *key) {
+    int32_t index;
+    if (s_free_head >= 0) {
+        index = s_free_head;
+        s_free_head = s_entries[index].next;
+    } else {
+        if (s_entry_count == s_entry_capacity) {
+            uint32_t capacity = s_entry_capacity ? s_entry_capacity * 2 : 1024;
+            nvs_entry_t *entries = realloc(s_entries, capacity * sizeof(nvs_entry_t));
+            if (!entries) {
+                return NULL;
+            }
+            s_entries = entries;
+            s_entry_capacity = capacity;
+        }
+        index = (int32_t)s_entry_count++;
+    }
+    nvs_entry_t *entry = &s_entries[index];
+    memset(entry, 0, sizeof(*entry));
+    entry->used = true;
+    entry->handle = handle;
+    snprintf(entry->key, sizeof(entry->key), "%s", key);
+    uint32_t bucket = key_hash(handle, key);
+    entry->next = s_buckets[bucket];
+    s_buckets[bucket] = index;
+    return entry;
+}
+
+static bool write_allowed(void) {
+    if (s_fail_after >= 0 && (int64_t)s_counters.writes >= s_fail_after) {
+        return false;
+    }
+    s_counters.writes++;
+    return true;
+}
+
+static esp_err_t handle_check(nvs_handle_t handle) {
+    return (handle == 0 || handle > (nvs_handle_t)s_handle_count) ? ESP_ERR_NVS_INVALID_HANDLE : ESP_OK;
+}
+
+static esp_err_t nvs_set_value(nvs_handle_t handle, const char *key, nvs_type_t type, const void *value,
+                               size_t len) {
+    if (strlen(key) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+    pthread_mutex_lock(&s_lock);
+    esp_err_t ret = handle_check(handle);
+    if (ret != ESP_OK) {
+        pthread_mutex_unlock(&s_lock);
+        return ret;
+    }
+    int h = (int)handle - 1;
+    nvs_part_t *part = &s_parts[s_handles[h].part];
+    nvs_entry_t *entry = entry_find(h, key);
+    if (entry && entry->type != type) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+    }
+    int64_t delta = entry_cost(type, len) - (entry ? entry_cost(entry->type, entry->len) : 0);
+    if (part->capacity >= 0 && part->used + delta > part->capacity) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    uint8_t *copy = malloc(len ? len : 1);
+    if (!copy || !write_allowed()) {
+        free(copy);
+        pthread_mutex_unlock(&s_lock);
+        return copy ? ESP_FAIL : ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, value, len);
+    if (!entry) {
+        entry = entry_alloc(h, key);
+        if (!entry) {
+            free(copy);
+            pthread_mutex_unlock(&s_lock);
+            return ESP_ERR_NO_MEM;
+        }
+    } else {
+        free(entry->data);
+    }
+    part->used += delta;
+    entry->type = type;
+    entry->data = copy;
+    entry->len = len;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+static esp_err_t nvs_get_value(nvs_handle_t handle, const char *key, nvs_type_t type, void *value, size_t *len) {
+    pthread_mutex_lock(&s_lock);
+    esp_err_t ret = handle_check(handle);
+    if (ret == ESP_OK) {
+        s_counters.reads++;
+        nvs_entry_t *entry = entry_find((int)handle - 1, key);
+        if (!entry) {
+            ret = ESP_ERR_NVS_NOT_FOUND;
+        } else if (entry->type != type) {
+            ret = ESP_ERR_NVS_TYPE_MISMATCH;
+        } else if (value && *len < entry->len) {
+            ret = ESP_ERR_NVS_INVALID_LENGTH;
+        } else {
+            if (value) {
+                memcpy(value, entry->data, entry->len);
+            }
+            *len = entry->len;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ret;
+}
+
+void fake_nvs_reset(void) {
+    pthread_mutex_lock(&s_lock);
+    for (uint32_t i = 0; i < s_entry_count; i++) {
+        free(s_entries[i].data);
+    }
+    free(s_entries);
+    s_entries = NULL;
+    s_entry_count = 0;
+    s_entry_capacity = 0;
+    s_free_head = -1;
+    s_buckets_ready = false;
+    buckets_init();
+    for (int i = 0; i < s_part_count; i++) {
+        s_parts[i].used = 0;
+    }
+    s_fail_after = -1;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void fake_nvs_set_partition_size(const char *label, size_t bytes) {
+    pthread_mutex_lock(&s_lock);
+    nvs_part_t *part = &s_parts[part_find_or_add(label)];
+    part->capacity = bytes ? (int64_t)(bytes / NVS_PAGE_SIZE - 1) * NVS_ENTRIES_PER_PAGE : -1;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void fake_nvs_fail_after(int64_t writes) {
+    pthread_mutex_lock(&s_lock);
+    s_fail_after = writes < 0 ? -1 : (int64_t)s_counters.writes + writes;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void fake_nvs_get_counters(fake_nvs_counters_t *counters) {
+    pthread_mutex_lock(&s_lock);
+    *counters = s_counters;
+    pthread_mutex_unlock(&s_lock);
+}
+
+esp_err_t nvs_flash_init(void) {
+    return nvs_flash_init_partition(NVS_DEFAULT_PART_NAME);
+}
+
+esp_err_t nvs_flash_erase(void) {
+    return nvs_flash_erase_partition(NVS_DEFAULT_PART_NAME);
+}
+
+esp_err_t nvs_flash_init_partition(const char *partition_label) {
+    pthread_mutex_lock(&s_lock);
+    buckets_init();
+    part_find_or_add(partition_label);
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase_partition(const char *partition_label) {
+    pthread_mutex_lock(&s_lock);
+    int part = part_find_or_add(partition_label);
+    for (uint32_t i = 0; i < s_entry_count; i++) {
+        if (s_entries[i].used && s_handles[s_entries[i].handle].part == part) {
+            entry_remove(&s_entries[i]);
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_open_from_partition(const char *part_name, const char *name_space, nvs_open_mode_t open_mode,
+                                  nvs_handle_t *out_handle) {
+    (void)open_mode;
+    pthread_mutex_lock(&s_lock);
+    buckets_init();
+    int part = part_find_or_add(part_name);
+    for (int i = 0; i < s_handle_count; i++) {
+        if (s_handles[i].part == part && strcmp(s_handles[i].name_space, name_space) == 0) {
+            *out_handle = (nvs_handle_t)i + 1;
+            pthread_mutex_unlock(&s_lock);
+            return ESP_OK;
+        }
+    }
+    if (s_handle_count >= NVS_HANDLES_MAX) {
+        pthread_mutex_unlock(&s_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    s_handles[s_handle_count].part = part;
+    snprintf(s_handles[s_handle_count].name_space, sizeof(s_handles[0].name_space), "%s", name_space);
+    *out_handle = (nvs_handle_t)++s_handle_count;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name_space, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+    return nvs_open_from_partition(NVS_DEFAULT_PART_NAME, name_space, open_mode, out_handle);
+}
+
+void nvs_close(nvs_handle_t handle) {
+    (void)handle; // handles ficam válidos: o mesmo namespace volta com o mesmo número
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value) {
+    return nvs_set_value(handle, key, NVS_TYPE_U8, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value) {
+    size_t len = sizeof(*out_value);
+    return nvs_get_value(handle, key, NVS_TYPE_U8, out_value, &len);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value) {
+    return nvs_set_value(handle, key, NVS_TYPE_U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value) {
+    size_t len = sizeof(*out_value);
+    return nvs_get_value(handle, key, NVS_TYPE_U32, out_value, &len);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value) {
+    return nvs_set_value(handle, key, NVS_TYPE_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length) {
+    return nvs_get_value(handle, key, NVS_TYPE_STR, out_value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+    return nvs_set_value(handle, key, NVS_TYPE_BLOB, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) {
+    return nvs_get_value(handle, key, NVS_TYPE_BLOB, out_value, length);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+    pthread_mutex_lock(&s_lock);
+    esp_err_t ret = handle_check(handle);
+    if (ret == ESP_OK) {
+        nvs_entry_t *entry = entry_find((int)handle - 1, key);
+        if (!entry) {
+            ret = ESP_ERR_NVS_NOT_FOUND;
+        } else if (!write_allowed()) {
+            ret = ESP_FAIL;
+        } else {
+            entry_remove(entry);
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ret;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    pthread_mutex_lock(&s_lock);
+    esp_err_t ret = handle_check(handle);
+    if (ret == ESP_OK && !write_allowed()) {
+        ret = ESP_FAIL;
+    }
+    for (uint32_t i = 0; ret == ESP_OK && i < s_entry_count; i++) {
+        if (s_entries[i].used && s_entries[i].handle == (int)handle - 1) {
+            entry_remove(&s_entries[i]);
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ret;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    pthread_mutex_lock(&s_lock);
+    esp_err_t ret = handle_check(handle);
+    if (ret == ESP_OK) {
+        s_counters.commits++;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ret;
+}
+
+esp_err_t nvs_get_stats(const char *part_name, nvs_stats_t *nvs_stats) {
+    pthread_mutex_lock(&s_lock);
+    const nvs_part_t *part = &s_parts[part_find_or_add(part_name ? part_name : NVS_DEFAULT_PART_NAME)];
+    memset(nvs_stats, 0, sizeof(*nvs_stats));
+    nvs_stats->used_entries = (size_t)part->used;
+    nvs_stats->total_entries = part->capacity < 0 ? 0 : (size_t)part->capacity;
+    if (nvs_stats->total_entries > nvs_stats->used_entries) {
+        nvs_stats->free_entries = nvs_stats->total_entries - nvs_stats->used_entries;
+    }
+    nvs_stats->available_entries = nvs_stats->free_entries;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+// Avança it->pos até a próxima entrada do namespace; lock já travado
+static bool iterator_seek(nvs_iterator_t it) {
+    for (; it->pos < s_entry_count; it->pos++) {
+        const nvs_entry_t *entry = &s_entries[it->pos];
+        if (entry->used && s_handles[entry->handle].part == it->part &&
+            strcmp(s_handles[entry->handle].name_space, it->name_space) == 0 &&
+            (it->type == NVS_TYPE_ANY || it->type == entry->type)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+esp_err_t nvs_entry_find(const char *part_name, const char *namespace_name, nvs_type_t type,
+                         nvs_iterator_t *output_iterator) {
+    nvs_iterator_t it = calloc(1, sizeof(*it));
+    if (!it) {
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_mutex_lock(&s_lock);
+    it->part = part_find_or_add(part_name);
+    snprintf(it->name_space, sizeof(it->name_space), "%s", namespace_name);
+    it->type = type;
+    bool found = iterator_seek(it);
+    pthread_mutex_unlock(&s_lock);
+    if (!found) {
+        free(it);
+        *output_iterator = NULL;
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *output_iterator = it;
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_next(nvs_iterator_t *iterator) {
+    pthread_mutex_lock(&s_lock);
+    (*iterator)->pos++;
+    bool found = iterator_seek(*iterator);
+    pthread_mutex_unlock(&s_lock);
+    if (!found) {
+        free(*iterator);
+        *iterator = NULL;
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_info(const nvs_iterator_t iterator, nvs_entry_info_t *out_info) {
+    pthread_mutex_lock(&s_lock);
+    const nvs_entry_t *entry = &s_entries[iterator->pos];
+    snprintf(out_info->namespace_name, sizeof(out_info->namespace_name), "%s", iterator->name_space);
+    snprintf(out_info->key, sizeof(out_info->key), "%s", entry->key);
+    out_info->type = entry->type;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+void nvs_release_iterator(nvs_iterator_t iterator) {
+    free(iterator);
+}
@@ -0,0 +1,117 @@
+// Partições de dados em RAM com semântica de flash NOR
+#include "fake_host.h"
+#include "esp_partition.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PARTITIONS_MAX      8
+#define SECTOR_SIZE         4096
+
+typedef struct {
+    esp_partition_t partition;  // primeiro campo: o ponteiro público aponta aqui
+    uint8_t *mem;
+} fake_partition_t;
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static fake_partition_t s_partitions[PARTITIONS_MAX];
+static int s_count = 0;
+
+void fake_partition_add(const char *label, int subtype, uint32_t size) {
+    pthread_mutex_lock(&s_lock);
+    if (s_count >= PARTITIONS_MAX) {
+        abort();
+    }
+    fake_partition_t *part = &s_partitions[s_count++];
+    memset(part, 0, sizeof(*part));
+    part->partition.type = ESP_PARTITION_TYPE_DATA;
+    part->partition.subtype = subtype;
+    part->partition.size = size;
+    part->partition.erase_size = SECTOR_SIZE;
+    strncpy(part->partition.label, label, sizeof(part->partition.label) - 1);
+    part->mem = malloc(size);
+    if (!part->mem) {
+        abort();
+    }
+    memset(part->mem, 0xFF, size);
+    pthread_mutex_unlock(&s_lock);
+}
+
+void fake_partition_reset(void) {
+    pthread_mutex_lock(&s_lock);
+    for (int i = 0; i < s_count; i++) {
+        free(s_partitions[i].mem);
+    }
+    memset(s_partitions, 0, sizeof(s_partitions));
+    s_count = 0;
+    pthread_mutex_unlock(&s_lock);
+}
+
+static fake_partition_t *fake_of(const esp_partition_t *partition) {
+    return (fake_partition_t *)partition;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label) {
+    const esp_partition_t *found = NULL;
+    pthread_mutex_lock(&s_lock);
+    for (int i = 0; i < s_count && !found; i++) {
+        const esp_partition_t *p = &s_partitions[i].partition;
+        if (p->type == type && (subtype == ESP_PARTITION_SUBTYPE_ANY || p->subtype == subtype) &&
+            (!label || strcmp(label, p->label) == 0)) {
+            found = p;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return found;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size) {
+    if (src_offset + size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    pthread_mutex_lock(&s_lock);
+    memcpy(dst, fake_of(partition)->mem + src_offset, size);
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+// Gravar só leva bits de 1 para 0, como no flash
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size) {
+    if (dst_offset + size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    pthread_mutex_lock(&s_lock);
+    uint8_t *mem = fake_of(partition)->mem + dst_offset;
+    for (size_t i = 0; i < size; i++) {
+        mem[i] &= ((const uint8_t *)src)[i];
+    }
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+    if (offset % SECTOR_SIZE || size % SECTOR_SIZE || offset + size > partition->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&s_lock);
+    memset(fake_of(partition)->mem + offset, 0xFF, size);
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t memory, const void **out_ptr,
+                             esp_partition_mmap_handle_t *out_handle) {
+    (void)memory;
+    if (offset + size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *out_ptr = fake_of(partition)->mem + offset;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle) {
+    (void)handle;
+}
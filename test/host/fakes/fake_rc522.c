@@ -0,0 +1,554 @@
+// RC522 emulado no nível dos quadros SPI: registradores, FIFO e os PICCs no
+// campo respondendo a REQA/WUPA, ANTICOLLISION e SELECT (ISO 14443-3). Sem
+// modelo de tempo o Transceive termina na hora: a próxima leitura de
+// COMM_IRQ já traz RxIRq|IdleIRq, ou TimerIRq quando nenhum cartão responde.
+// Com fake_rc522_set_timing cada quadro SPI e cada troca no ar andam o
+// relógio virtual, e COMM_IRQ só muda quando o relógio passa da conclusão
+#include "fake_host.h"
+#include "rc522.h"
+#include "driver/spi_master.h"
+#include "driver/gpio.h"
+#include "esp_timer.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REG_COUNT           64
+#define REG_VERSION         0x37
+#define QUEUE_MAX           16
+
+#define IRQ_TIMER           0x01
+#define IRQ_MASK            0x7F
+#define IRQ_RX_IDLE         0x30
+#define ERR_COLL            0x08
+#define COLL_POS_NOT_VALID  0x20
+
+// ISO 14443-A a 106 kbit/s: bit de 128/fc, quadro com início e fim e um bit
+// de paridade por byte; o PICC responde FDT depois do último bit enviado
+#define RF_FC_HZ            13560000u
+#define RF_BIT_FC           128u
+#define RF_FDT_FC           1172u
+
+typedef enum {
+    PICC_IDLE,
+    PICC_READY,                 // respondeu ao REQA/WUPA, no nível 'level'
+    PICC_ACTIVE,                // selecionado no último nível
+} picc_state_t;
+
+typedef struct {
+    fake_picc_t picc;
+    picc_state_t state;
+    uint8_t level;
+} picc_slot_t;
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static picc_slot_t s_cards[FAKE_RC522_MAX_CARDS];
+static int s_card_count = 0;
+static uint32_t s_collisions = 0;
+static int s_lost_anticoll = 0;
+
+static uint8_t s_regs[REG_COUNT];
+static uint8_t s_fifo[RC522_FIFO_SIZE];
+static uint8_t s_fifo_len = 0;
+static uint8_t s_fifo_pos = 0;
+static uint8_t s_error = 0;
+static uint8_t s_coll = COLL_POS_NOT_VALID;
+
+// Conclusão do Transceive: os bits de COMM_IRQ ficam pendentes até o
+// relógio chegar em s_done_at
+static uint8_t s_pending_irq = 0;
+static int64_t s_done_at = 0;
+static uint8_t s_reply_len = 0;
+
+static bool s_timing_on = false;
+static fake_rc522_timing_t s_timing;
+static uint32_t s_spi_hz = 0;
+static fake_rc522_bus_t s_bus;
+
+static gpio_isr_t s_isr = NULL;
+static void *s_isr_arg = NULL;
+static bool s_isr_due = false;
+
+static spi_transaction_t *s_queue[QUEUE_MAX];
+static int s_queue_size = 1;
+static unsigned s_queue_head = 0;
+static unsigned s_queue_tail = 0;
+
+void fake_rc522_set_cards(const fake_picc_t *cards, int count) {
+    if (count < 0 || count > FAKE_RC522_MAX_CARDS) {
+        abort();
+    }
+    pthread_mutex_lock(&s_lock);
+    memset(s_cards, 0, sizeof(s_cards));
+    for (int i = 0; i < count; i++) {
+        s_cards[i].picc = cards[i];
+    }
+    s_card_count = count;
+    s_collisions = 0;
+    s_lost_anticoll = 0;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void fake_rc522_lose_anticoll(int count) {
+    pthread_mutex_lock(&s_lock);
+    s_lost_anticoll = count;
+    pthread_mutex_unlock(&s_lock);
+}
+
+uint32_t fake_rc522_collisions(void) {
+    pthread_mutex_lock(&s_lock);
+    uint32_t count = s_collisions;
+    pthread_mutex_unlock(&s_lock);
+    return count;
+}
+
+void fake_rc522_set_timing(const fake_rc522_timing_t *timing) {
+    pthread_mutex_lock(&s_lock);
+    s_timing_on = timing != NULL;
+    if (timing) {
+        s_timing = *timing;
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+void fake_rc522_get_bus(fake_rc522_bus_t *bus) {
+    pthread_mutex_lock(&s_lock);
+    *bus = s_bus;
+    pthread_mutex_unlock(&s_lock);
+}
+
+// --- PICC ---
+
+static uint16_t crc_a(const uint8_t *data, int len) {
+    uint16_t crc = 0x6363;
+    for (int i = 0; i < len; i++) {
+        uint8_t b = data[i] ^ (uint8_t)crc;
+        b ^= b << 4;
+        crc = (crc >> 8) ^ ((uint16_t)b << 8) ^ ((uint16_t)b << 3) ^ (b >> 4);
+    }
+    return crc;
+}
+
+static uint8_t picc_levels(const fake_picc_t *picc) {
+    return picc->uid_len == 4 ? 1 : picc->uid_len == 7 ? 2 : 3;
+}
+
+// UID do nível (CT 0x88 + 3 bytes se houver nível seguinte) e BCC
+static void picc_level_bytes(const fake_picc_t *picc, uint8_t level, uint8_t out[5]) {
+    if (level < picc_levels(picc) - 1) {
+        out[0] = 0x88;
+        memcpy(&out[1], &picc->uid[3 * level], 3);
+    } else {
+        memcpy(out, &picc->uid[3 * level], 4);
+    }
+    out[4] = out[0] ^ out[1] ^ out[2] ^ out[3];
+}
+
+static int bit_at(const uint8_t *data, int pos) {
+    return (data[pos / 8] >> (pos % 8)) & 1;
+}
+
+static void reply(const uint8_t *data, uint8_t len) {
+    memcpy(s_fifo, data, len);
+    s_fifo_len = len;
+    s_reply_len = len;
+    s_pending_irq |= IRQ_RX_IDLE;
+}
+
+// Quadro inválido ou sem destinatário: quem estava em READY volta a IDLE e o
+// timer do RC522 estoura
+static void no_reply(void) {
+    for (int i = 0; i < s_card_count; i++) {
+        if (s_cards[i].state == PICC_READY) {
+            s_cards[i].state = PICC_IDLE;
+        }
+    }
+    s_pending_irq |= IRQ_TIMER;
+}
+
+static void picc_request(uint8_t command) {
+    bool any = false;
+    for (int i = 0; i < s_card_count; i++) {
+        picc_slot_t *card = &s_cards[i];
+        if (command == RC522_PICC_WUPA || card->state == PICC_IDLE) {
+            card->state = PICC_READY;
+            card->level = 0;
+            any = true;
+        } else {
+            card->state = PICC_IDLE;
+        }
+    }
+    if (!any) {
+        s_pending_irq |= IRQ_TIMER;
+        return;
+    }
+    static const uint8_t atqa[2] = {0x04, 0x00};
+    reply(atqa, sizeof(atqa));
+}
+
+// Os cartões em READY no nível cujos bits batem com os 'known' enviados
+// respondem o resto; o primeiro bit em que discordam é a colisão, e os
+// seguintes vêm zerados (ValuesAfterColl = 0)
+static void picc_anticoll(uint8_t level, const uint8_t *in, uint8_t len) {
+    int known = ((in[1] >> 4) - 2) * 8 + (in[1] & 0x07);
+    uint8_t bytes[FAKE_RC522_MAX_CARDS][5];
+    int count = 0;
+
+    if (known < 0 || known > 32 || len != 2 + (known + 7) / 8) {
+        no_reply();
+        return;
+    }
+    for (int i = 0; i < s_card_count; i++) {
+        picc_slot_t *card = &s_cards[i];
+        if (card->state != PICC_READY || card->level != level) {
+            continue;
+        }
+        picc_level_bytes(&card->picc, level, bytes[count]);
+        bool match = true;
+        for (int pos = 0; pos < known && match; pos++) {
+            match = bit_at(bytes[count], pos) == bit_at(&in[2], pos);
+        }
+        if (match) {
+            count++;
+        }
+    }
+    if (count == 0) {
+        no_reply();
+        return;
+    }
+    // Resposta perdida no ar: os cartões seguem em READY e o timer estoura
+    if (s_lost_anticoll > 0) {
+        s_lost_anticoll--;
+        s_pending_irq |= IRQ_TIMER;
+        return;
+    }
+
+    uint8_t out[5] = {0};
+    int coll = -1;
+    for (int pos = known; pos < 40 && coll < 0; pos++) {
+        int bit = bit_at(bytes[0], pos);
+        for (int k = 1; k < count; k++) {
+            if (bit_at(bytes[k], pos) != bit) {
+                coll = pos;
+            }
+        }
+        if (coll < 0 && bit) {
+            out[pos / 8] |= 1 << (pos % 8);
+        }
+    }
+    if (coll >= 0) {
+        s_error = ERR_COLL;
+        s_coll = (uint8_t)((coll + 1) & 0x1F);  // CollPos: 1..31, 0 = bit 32
+        s_collisions++;
+    }
+    reply(&out[known / 8], (uint8_t)(5 - known / 8));
+}
+
+// Cartões com o mesmo CT + 3 bytes respondem juntos e seguem todos para o
+// próximo nível; os demais em READY voltam a IDLE
+static void picc_select(uint8_t level, const uint8_t *in, uint8_t len) {
+    picc_slot_t *selected = NULL;
+
+    bool crc_ok = len == 9 && crc_a(in, 7) == (in[7] | in[8] << 8);
+    for (int i = 0; i < s_card_count; i++) {
+        picc_slot_t *card = &s_cards[i];
+        if (card->state != PICC_READY || card->level != level) {
+            continue;
+        }
+        uint8_t bytes[5];
+        picc_level_bytes(&card->picc, level, bytes);
+        if (!crc_ok || memcmp(bytes, &in[2], 5) != 0) {
+            card->state = PICC_IDLE;
+            continue;
+        }
+        selected = card;
+        if (level < picc_levels(&card->picc) - 1) {
+            card->level++;
+        } else {
+            card->state = PICC_ACTIVE;
+        }
+    }
+    if (!selected) {
+        no_reply();
+        return;
+    }
+
+    uint8_t out[3];
+    // SAK com o bit de cascata: UID continua no próximo nível
+    out[0] = selected->state == PICC_ACTIVE ? selected->picc.sak : 0x04;
+    uint16_t crc = crc_a(out, 1);
+    out[1] = crc & 0xFF;
+    out[2] = crc >> 8;
+    reply(out, sizeof(out));
+}
+
+// Tempo no ar do Transceive: envio, FDT e resposta, ou envio e o timer do
+// RC522 (TAuto: parte no fim do envio) quando ninguém responde
+static uint32_t transceive_air_us(uint8_t len, uint8_t tx_last_bits) {
+    uint32_t tx_bits = 2 + (tx_last_bits ? (len - 1) * 9u + tx_last_bits : len * 9u);
+    uint64_t fc = (uint64_t)tx_bits * RF_BIT_FC;
+    if (s_pending_irq & IRQ_RX_IDLE) {
+        fc += RF_FDT_FC + (2 + s_reply_len * 9u) * RF_BIT_FC;
+    } else {
+        uint32_t prescaler = ((s_regs[RC522_REG_T_MODE] & 0x0F) << 8) | s_regs[RC522_REG_T_PRESCALER];
+        uint32_t reload = (s_regs[RC522_REG_T_RELOAD_H] << 8) | s_regs[RC522_REG_T_RELOAD_L];
+        fc += (uint64_t)(2 * prescaler + 1) * (reload + 1);
+    }
+    return (uint32_t)((fc * 1000000 + RF_FC_HZ - 1) / RF_FC_HZ);
+}
+
+// Transceive com StartSend: a FIFO inteira é o quadro enviado
+static void transceive(void) {
+    uint8_t in[RC522_FIFO_SIZE];
+    uint8_t len = s_fifo_len - s_fifo_pos;
+    uint8_t tx_last_bits = s_regs[RC522_REG_BIT_FRAMING] & 0x07;
+
+    memcpy(in, &s_fifo[s_fifo_pos], len);
+    s_fifo_len = s_fifo_pos = 0;
+    s_error = 0;
+    s_coll = COLL_POS_NOT_VALID;
+    s_pending_irq = 0;
+    s_reply_len = 0;
+
+    int level = in[0] == RC522_PICC_SEL_CL1 ? 0 : in[0] == RC522_PICC_SEL_CL2 ? 1 : in[0] == RC522_PICC_SEL_CL3 ? 2 : -1;
+    if (len == 1 && tx_last_bits == 7 && (in[0] == RC522_PICC_REQA || in[0] == RC522_PICC_WUPA)) {
+        picc_request(in[0]);
+    } else if (level >= 0 && len >= 2 && in[1] == 0x70) {
+        picc_select((uint8_t)level, in, len);
+    } else if (level >= 0 && len >= 2 && in[1] < 0x70) {
+        picc_anticoll((uint8_t)level, in, len);
+    } else {
+        no_reply();
+    }
+
+    s_done_at = 0;
+    if (s_timing_on) {
+        uint32_t air_us = transceive_air_us(len, tx_last_bits);
+        s_bus.air_us += air_us;
+        s_done_at = esp_timer_get_time() + air_us;
+    }
+}
+
+// Bits de conclusão visíveis em COMM_IRQ quando o relógio chega em s_done_at
+static void complete_if_done(void) {
+    if (s_pending_irq && esp_timer_get_time() >= s_done_at) {
+        s_regs[RC522_REG_COMM_IRQ] |= s_pending_irq;
+        s_pending_irq = 0;
+    }
+}
+
+// Com o pino IRQ a task dorme até a borda: o relógio pula para a conclusão
+// mais a latência da ISR. true = a ISR tem de rodar (fora do lock)
+static bool irq_edge(void) {
+    if (!s_isr || !(s_regs[RC522_REG_COMM_IE] & s_pending_irq & IRQ_MASK)) {
+        return false;
+    }
+    if (s_timing_on) {
+        fake_clock_advance_us(s_done_at - esp_timer_get_time() + s_timing.irq_us);
+    }
+    complete_if_done();
+    return true;
+}
+
+// --- Registradores ---
+
+static uint8_t reg_read(uint8_t reg) {
+    switch (reg) {
+        case RC522_REG_FIFO_DATA:
+            return s_fifo_pos < s_fifo_len ? s_fifo[s_fifo_pos++] : 0;
+        case RC522_REG_FIFO_LEVEL:
+            return s_fifo_len - s_fifo_pos;
+        case RC522_REG_COMM_IRQ:
+            complete_if_done();
+            return s_regs[reg];
+        case RC522_REG_CONTROL:
+            return 0;                       // RxLastBits = 0: bytes completos
+        case RC522_REG_ERROR:
+            return s_error;
+        case RC522_REG_COLL:
+            return s_coll;
+        case REG_VERSION:
+            return 0x92;
+        default:
+            return s_regs[reg];
+    }
+}
+
+static void reg_write(uint8_t reg, uint8_t value) {
+    switch (reg) {
+        case RC522_REG_FIFO_DATA:
+            if (s_fifo_pos == s_fifo_len) {
+                s_fifo_len = s_fifo_pos = 0;
+            }
+            if (s_fifo_len < RC522_FIFO_SIZE) {
+                s_fifo[s_fifo_len++] = value;
+            }
+            break;
+        case RC522_REG_FIFO_LEVEL:
+            if (value & 0x80) {
+                s_fifo_len = s_fifo_pos = 0;
+            }
+            break;
+        case RC522_REG_COMM_IRQ:
+            // Set1: 1 liga os bits marcados, 0 desliga
+            if (value & 0x80) {
+                s_regs[reg] |= value & 0x7F;
+            } else {
+                s_regs[reg] &= ~value;
+            }
+            break;
+        case RC522_REG_COMMAND:
+            if ((value & 0x0F) == RC522_CMD_SOFT_RESET) {
+                memset(s_regs, 0, sizeof(s_regs));
+                s_fifo_len = s_fifo_pos = 0;
+                s_pending_irq = 0;
+                s_error = 0;
+                s_coll = COLL_POS_NOT_VALID;
+                break;
+            }
+            s_regs[reg] = value;
+            break;
+        case RC522_REG_BIT_FRAMING:
+            s_regs[reg] = value & 0x7F;
+            if ((value & 0x80) && (s_regs[RC522_REG_COMMAND] & 0x0F) == RC522_CMD_TRANSCEIVE) {
+                transceive();
+                s_isr_due = irq_edge();
+            }
+            break;
+        default:
+            s_regs[reg] = value;
+            break;
+    }
+}
+
+// Leitura: cada byte enviado é o próximo endereço e o recebido é o valor do
+// anterior. Escrita: todos os bytes depois do endereço vão para ele
+static void spi_frame(spi_transaction_t *trans) {
+    size_t len = trans->length / 8;
+    const uint8_t *tx = (trans->flags & SPI_TRANS_USE_TXDATA) ? trans->tx_data : trans->tx_buffer;
+    uint8_t *rx = (trans->flags & SPI_TRANS_USE_RXDATA) ? trans->rx_data : trans->rx_buffer;
+
+    if (len == 0 || !tx) {
+        abort();
+    }
+    pthread_mutex_lock(&s_lock);
+    s_bus.frames++;
+    s_bus.bytes += len;
+    if (s_timing_on && s_spi_hz > 0) {
+        uint32_t us = s_timing.frame_us + (uint32_t)((len * 8 * 1000000ull + s_spi_hz - 1) / s_spi_hz);
+        s_bus.spi_us += us;
+        fake_clock_advance_us(us);
+    }
+    if (tx[0] & 0x80) {
+        uint8_t addr = (tx[0] >> 1) & 0x3F;
+        for (size_t i = 1; i < len; i++) {
+            uint8_t value = reg_read(addr);
+            if (rx) {
+                rx[i] = value;
+            }
+            addr = (tx[i] >> 1) & 0x3F;
+        }
+        if (rx) {
+            rx[0] = 0;
+        }
+    } else {
+        uint8_t addr = (tx[0] >> 1) & 0x3F;
+        for (size_t i = 1; i < len; i++) {
+            reg_write(addr, tx[i]);
+        }
+        if (rx) {
+            memset(rx, 0, len);
+        }
+    }
+    bool isr_due = s_isr_due;
+    s_isr_due = false;
+    pthread_mutex_unlock(&s_lock);
+    if (isr_due) {
+        s_isr(s_isr_arg);
+    }
+}
+
+// --- SPI e GPIO do ESP-IDF ---
+
+esp_err_t spi_bus_initialize(spi_host_device_t host_id, const spi_bus_config_t *bus_config, int dma_chan) {
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t host_id) {
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host_id, const spi_device_interface_config_t *dev_config,
+                             spi_device_handle_t *handle) {
+    if (dev_config->queue_size < 1 || dev_config->queue_size > QUEUE_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_queue_size = dev_config->queue_size;
+    s_queue_head = s_queue_tail = 0;
+    s_spi_hz = (uint32_t)dev_config->clock_speed_hz;
+    *handle = (spi_device_handle_t)s_regs;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle) {
+    return ESP_OK;
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *trans_desc) {
+    spi_frame(trans_desc);
+    return ESP_OK;
+}
+
+// A fila roda em ordem na hora de enfileirar; como no driver real, passar
+// de queue_size transações pendentes é erro de quem chama
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans_desc, uint32_t ticks_to_wait) {
+    if (s_queue_tail - s_queue_head >= (unsigned)s_queue_size) {
+        return ESP_ERR_TIMEOUT;
+    }
+    spi_frame(trans_desc);
+    s_queue[s_queue_tail++ % QUEUE_MAX] = trans_desc;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans_desc,
+                                      uint32_t ticks_to_wait) {
+    if (s_queue_head == s_queue_tail) {
+        return ESP_ERR_TIMEOUT;
+    }
+    *trans_desc = s_queue[s_queue_head++ % QUEUE_MAX];
+    return ESP_OK;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config) {
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+    return 1;                               // IRQ open-drain em repouso
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags) {
+    return ESP_OK;
+}
+
+// Um leitor só: a ISR roda na conclusão de cada Transceive habilitado em
+// COMM_IE, na thread que enviou o StartSend
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args) {
+    pthread_mutex_lock(&s_lock);
+    s_isr = isr_handler;
+    s_isr_arg = args;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num) {
+    pthread_mutex_lock(&s_lock);
+    s_isr = NULL;
+    s_isr_arg = NULL;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
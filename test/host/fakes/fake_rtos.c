@@ -0,0 +1,442 @@
+// FreeRTOS sobre pthreads: cada task é uma thread, notificações e semáforos
+// usam mutex + variável de condição e o tick é de 1 ms
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "fake_host.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct host_task {
+    pthread_t thread;
+    bool has_thread;            // criada por xTaskCreate
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify_count;
+    volatile sig_atomic_t deleted;  // apagada por outra task
+    TaskFunction_t code;
+    void *parameters;
+    char name[16];
+};
+
+typedef enum {
+    SEM_MUTEX,
+    SEM_RECURSIVE,
+    SEM_BINARY,
+} host_semaphore_kind_t;
+
+struct host_semaphore {
+    host_semaphore_kind_t kind;
+    pthread_mutex_t mutex;      // SEM_MUTEX/SEM_RECURSIVE
+    pthread_mutex_t lock;       // SEM_BINARY
+    pthread_cond_t cond;
+    uint32_t count;
+};
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint8_t *items;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+static __thread struct host_task *t_current = NULL;
+
+static int64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t s_start_us = 0;
+
+static void rtos_clock_init(void) __attribute__((constructor));
+static void rtos_clock_init(void) {
+    s_start_us = monotonic_us();
+}
+
+// Relógio virtual (fake_clock_set_virtual): -1 = relógio real
+static _Atomic int64_t s_virtual_us = -1;
+
+int64_t esp_timer_get_time(void) {
+    int64_t virtual_us = atomic_load(&s_virtual_us);
+    return virtual_us >= 0 ? virtual_us : monotonic_us() - s_start_us;
+}
+
+void fake_clock_set_virtual(bool on) {
+    atomic_store(&s_virtual_us, on ? monotonic_us() - s_start_us : -1);
+}
+
+bool fake_clock_is_virtual(void) {
+    return atomic_load(&s_virtual_us) >= 0;
+}
+
+void fake_clock_advance_us(int64_t us) {
+    if (us > 0 && atomic_load(&s_virtual_us) >= 0) {
+        atomic_fetch_add(&s_virtual_us, us);
+    }
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(esp_timer_get_time() / 1000);
+}
+
+static void cond_init_monotonic(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static struct timespec deadline_after(TickType_t ticks) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ticks / 1000;
+    ts.tv_nsec += (long)(ticks % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+// Espera em 'cond' até pred() ou o prazo; 'lock' já travado. false = timeout
+static bool cond_wait_ticks(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks,
+                            bool (*pred)(void *), void *ctx) {
+    if (ticks == portMAX_DELAY) {
+        while (!pred(ctx)) {
+            pthread_cond_wait(cond, lock);
+        }
+        return true;
+    }
+    struct timespec deadline = deadline_after(ticks);
+    while (!pred(ctx)) {
+        if (pthread_cond_timedwait(cond, lock, &deadline) == ETIMEDOUT) {
+            return pred(ctx);
+        }
+    }
+    return true;
+}
+
+static struct host_task *task_alloc(const char *name) {
+    struct host_task *task = calloc(1, sizeof(*task));
+    if (!task) {
+        return NULL;
+    }
+    pthread_mutex_init(&task->lock, NULL);
+    cond_init_monotonic(&task->cond);
+    snprintf(task->name, sizeof(task->name), "%s", name);
+    return task;
+}
+
+// Threads criadas fora de xTaskCreate (main, pthreads dos testes) ganham
+// um descritor na primeira chamada
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    if (!t_current) {
+        t_current = task_alloc("thread");
+        if (!t_current) {
+            abort();
+        }
+    }
+    return t_current;
+}
+
+static void *task_entry(void *arg) {
+    struct host_task *task = (struct host_task *)arg;
+    t_current = task;
+    task->code(task->parameters);
+    fprintf(stderr, "fake_rtos: task %s retornou sem vTaskDelete(NULL)\n", task->name);
+    abort();
+    return NULL;
+}
+
+// Sinal que congela uma task apagada por outra
+#define TASK_DELETE_SIGNAL  SIGUSR2
+
+static void task_delete_handler(int signo) {
+    (void)signo;
+    if (t_current && t_current->deleted) {
+        for (;;) {
+            pause();
+        }
+    }
+}
+
+static pthread_once_t s_signal_once = PTHREAD_ONCE_INIT;
+
+static void task_signal_init(void) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = task_delete_handler;
+    sigemptyset(&action.sa_mask);
+    sigaction(TASK_DELETE_SIGNAL, &action, NULL);
+}
+
+BaseType_t xTaskCreate(TaskFunction_t task_code, const char *name, uint32_t stack_depth, void *parameters,
+                       UBaseType_t priority, TaskHandle_t *created_task) {
+    (void)stack_depth;
+    (void)priority;
+    pthread_once(&s_signal_once, task_signal_init);
+    struct host_task *task = task_alloc(name);
+    if (!task) {
+        return pdFAIL;
+    }
+    task->code = task_code;
+    task->parameters = parameters;
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int ret = pthread_create(&thread, &attr, task_entry, task);
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    task->thread = thread;
+    task->has_thread = true;
+    if (created_task) {
+        *created_task = task;
+    }
+    return pdPASS;
+}
+
+// Como no FreeRTOS, apagar outra task não solta os mutexes que ela
+// segura: a thread fica parada para sempre onde estiver (num handler de
+// sinal) e o que estava travado fica travado
+void vTaskDelete(TaskHandle_t task) {
+    if (!task || task == t_current) {
+        struct host_task *self = t_current;
+        t_current = NULL;
+        if (self) {
+            pthread_cond_destroy(&self->cond);
+            pthread_mutex_destroy(&self->lock);
+            free(self);
+        }
+        pthread_exit(NULL);
+    }
+    fprintf(stderr, "fake_rtos: task %s apagada por outra task\n", task->name);
+    if (task->has_thread) {
+        task->deleted = true;
+        pthread_kill(task->thread, TASK_DELETE_SIGNAL);
+    }
+}
+
+void vTaskDelay(TickType_t ticks) {
+    struct timespec ts = {
+        .tv_sec = ticks / 1000,
+        .tv_nsec = (long)(ticks % 1000) * 1000000L,
+    };
+    nanosleep(&ts, NULL);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    pthread_mutex_lock(&task->lock);
+    task->notify_count++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken) {
+    xTaskNotifyGive(task);
+    if (higher_priority_task_woken) {
+        *higher_priority_task_woken = pdTRUE;
+    }
+}
+
+static bool task_notified(void *ctx) {
+    return ((struct host_task *)ctx)->notify_count > 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait) {
+    struct host_task *task = xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&task->lock);
+    cond_wait_ticks(&task->cond, &task->lock, ticks_to_wait, task_notified, task);
+    uint32_t value = task->notify_count;
+    if (value > 0) {
+        task->notify_count = clear_count_on_exit ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+static SemaphoreHandle_t semaphore_alloc(host_semaphore_kind_t kind) {
+    struct host_semaphore *sem = calloc(1, sizeof(*sem));
+    if (!sem) {
+        return NULL;
+    }
+    sem->kind = kind;
+    if (kind == SEM_BINARY) {
+        pthread_mutex_init(&sem->lock, NULL);
+        cond_init_monotonic(&sem->cond);
+    } else {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        if (kind == SEM_RECURSIVE) {
+            pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+        }
+        pthread_mutex_init(&sem->mutex, &attr);
+        pthread_mutexattr_destroy(&attr);
+    }
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return semaphore_alloc(SEM_MUTEX);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void) {
+    return semaphore_alloc(SEM_RECURSIVE);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return semaphore_alloc(SEM_BINARY);
+}
+
+static bool semaphore_available(void *ctx) {
+    return ((struct host_semaphore *)ctx)->count > 0;
+}
+
+static BaseType_t mutex_take(pthread_mutex_t *mutex, TickType_t ticks_to_wait) {
+    if (ticks_to_wait == 0) {
+        return pthread_mutex_trylock(mutex) == 0 ? pdTRUE : pdFALSE;
+    }
+    if (ticks_to_wait == portMAX_DELAY) {
+        pthread_mutex_lock(mutex);
+        return pdTRUE;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ticks_to_wait / 1000;
+    deadline.tv_nsec += (long)(ticks_to_wait % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return pthread_mutex_timedlock(mutex, &deadline) == 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait) {
+    if (semaphore->kind != SEM_BINARY) {
+        return mutex_take(&semaphore->mutex, ticks_to_wait);
+    }
+    pthread_mutex_lock(&semaphore->lock);
+    bool taken = cond_wait_ticks(&semaphore->cond, &semaphore->lock, ticks_to_wait, semaphore_available, semaphore);
+    if (taken) {
+        semaphore->count = 0;
+    }
+    pthread_mutex_unlock(&semaphore->lock);
+    return taken ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    if (semaphore->kind != SEM_BINARY) {
+        pthread_mutex_unlock(&semaphore->mutex);
+        return pdTRUE;
+    }
+    pthread_mutex_lock(&semaphore->lock);
+    BaseType_t given = semaphore->count == 0 ? pdTRUE : pdFALSE;
+    semaphore->count = 1;
+    pthread_cond_signal(&semaphore->cond);
+    pthread_mutex_unlock(&semaphore->lock);
+    return given;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t ticks_to_wait) {
+    return mutex_take(&mutex->mutex, ticks_to_wait);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex) {
+    pthread_mutex_unlock(&mutex->mutex);
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    if (!semaphore) {
+        return;
+    }
+    if (semaphore->kind == SEM_BINARY) {
+        pthread_cond_destroy(&semaphore->cond);
+        pthread_mutex_destroy(&semaphore->lock);
+    } else {
+        pthread_mutex_destroy(&semaphore->mutex);
+    }
+    free(semaphore);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    struct host_queue *queue = calloc(1, sizeof(*queue));
+    if (!queue) {
+        return NULL;
+    }
+    queue->items = malloc((size_t)length * item_size);
+    if (!queue->items) {
+        free(queue);
+        return NULL;
+    }
+    queue->length = length;
+    queue->item_size = item_size;
+    pthread_mutex_init(&queue->lock, NULL);
+    cond_init_monotonic(&queue->cond);
+    return queue;
+}
+
+static bool queue_has_space(void *ctx) {
+    struct host_queue *queue = (struct host_queue *)ctx;
+    return queue->count < queue->length;
+}
+
+static bool queue_has_item(void *ctx) {
+    return ((struct host_queue *)ctx)->count > 0;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait) {
+    pthread_mutex_lock(&queue->lock);
+    bool ok = cond_wait_ticks(&queue->cond, &queue->lock, ticks_to_wait, queue_has_space, queue);
+    if (ok) {
+        UBaseType_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(queue->items + (size_t)tail * queue->item_size, item, queue->item_size);
+        queue->count++;
+        pthread_cond_broadcast(&queue->cond);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait) {
+    pthread_mutex_lock(&queue->lock);
+    bool ok = cond_wait_ticks(&queue->cond, &queue->lock, ticks_to_wait, queue_has_item, queue);
+    if (ok) {
+        memcpy(buffer, queue->items + (size_t)queue->head * queue->item_size, queue->item_size);
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_broadcast(&queue->cond);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    if (!queue) {
+        return;
+    }
+    pthread_cond_destroy(&queue->cond);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->items);
+    free(queue);
+}
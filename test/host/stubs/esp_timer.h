@@ -0,0 +1,9 @@
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+#include <stdint.h>
+
+// Microssegundos desde o início do processo
+int64_t esp_timer_get_time(void);
+
+#endif // HOST_ESP_TIMER_H
@@ -0,0 +1,165 @@
+// Codificação do log de acesso: índices de dicionário acima da tag (varint)
+// e deltas de timestamp grandes e negativos voltam iguais após reabrir.
+// Depois, consultas por intervalo (e UID) com o anel já tendo dado a volta
+// comparadas com a leitura de todos os eventos, e a leitura sequencial a
+// partir de um instante.
+#include <string.h>
+#include <unistd.h>
+#include "test_util.h"
+
+#define EVENTS      600
+#define UIDS        40
+
+static const char *const s_actions[] = { "ACCESS_GRANTED", "ACCESS_DENIED" };
+
+static uint32_t event_ts(uint32_t i) {
+    // Alterna saltos de dias para frente e de horas para trás
+    return 1700000000u + i * 86400u - (i % 3) * 7200u;
+}
+
+typedef struct {
+    uint32_t seen;
+    bool ok;
+} scan_ctx_t;
+
+static bool check_entry(const access_log_t *entry, void *arg) {
+    scan_ctx_t *ctx = arg;
+    char uid[MAX_UID_LENGTH];
+    uint32_t i = ctx->seen++;
+    test_uid(i % UIDS, uid, sizeof(uid));
+    if (strcmp(entry->uid, uid) != 0 || (uint32_t)entry->timestamp != event_ts(i) ||
+        strcmp(entry->action, s_actions[i % 2]) != 0) {
+        fprintf(stderr, "evento %" PRIu32 ": %s %s %" PRIu32 "\n", i, entry->uid, entry->action,
+                (uint32_t)entry->timestamp);
+        ctx->ok = false;
+        return false;
+    }
+    return true;
+}
+
+#define RANGE_EVENTS    200000  // mais que o anel de 512 KB: dá a volta
+#define RANGE_STEP      10      // segundos entre eventos
+
+static uint32_t range_ts(uint32_t i) {
+    return 1700000000u + i * RANGE_STEP;
+}
+
+static uint32_t count_matches(const database_log_query_t *query, bool filtered) {
+    access_log_reader_t reader;
+    access_log_t entry;
+    uint32_t count = 0;
+    CHECK_OK(access_log_reader_begin(&reader));
+    while (true) {
+        esp_err_t ret = filtered ? access_log_reader_next_match(&reader, query, &entry)
+                                 : access_log_reader_next(&reader, &entry);
+        if (ret == ESP_ERR_NOT_FOUND) {
+            break;
+        }
+        CHECK_OK(ret);
+        uint32_t ts = (uint32_t)entry.timestamp;
+        bool in_range = (!query->from || ts >= query->from) && (!query->to || ts <= query->to);
+        char uid[MAX_UID_LENGTH] = "";
+        if (query->uid_len) {
+            snprintf(uid, sizeof(uid), "%02X:%02X:%02X:%02X", query->uid[0], query->uid[1], query->uid[2],
+                     query->uid[3]);
+        }
+        bool match = in_range && (!query->uid_len || strcmp(entry.uid, uid) == 0);
+        CHECK(match || !filtered);
+        count += match;
+    }
+    return count;
+}
+
+typedef struct {
+    uint32_t from;
+    uint32_t seen;
+    uint32_t last_ts;
+    bool ok;
+} from_ctx_t;
+
+static bool check_from(const access_log_t *entry, void *arg) {
+    from_ctx_t *ctx = arg;
+    uint32_t ts = (uint32_t)entry->timestamp;
+    ctx->ok = ctx->ok && ts >= ctx->from && ts > ctx->last_ts;
+    ctx->last_ts = ts;
+    ctx->seen++;
+    return true;
+}
+
+static void check_ranges(void) {
+    test_reset_flash();
+    CHECK_OK(access_log_init());
+    char uid[MAX_UID_LENGTH];
+    for (uint32_t i = 0; i < RANGE_EVENTS; i++) {
+        test_uid(i % UIDS, uid, sizeof(uid));
+        CHECK_OK(access_log_append(uid, s_actions[i % 2], range_ts(i)));
+    }
+    CHECK_OK(access_log_flush());
+    uint32_t retained = access_log_retained();
+    uint32_t oldest = RANGE_EVENTS - retained;
+    CHECK(retained < RANGE_EVENTS);
+
+    const database_log_query_t queries[] = {
+        { .from = range_ts(RANGE_EVENTS - 50) },
+        { .from = range_ts(oldest + 1000), .to = range_ts(oldest + 1500) },
+        { .to = range_ts(oldest + 20) },
+        { .from = range_ts(RANGE_EVENTS / 2 + 3), .to = range_ts(RANGE_EVENTS / 2 + 4000),
+          .uid = {0x00, 0x00, 0x07, 0x8B}, .uid_len = 4 },     // test_uid(7)
+        { .from = range_ts(RANGE_EVENTS) },
+        { .to = range_ts(0) },
+    };
+    for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); q++) {
+        int64_t start = test_now_us();
+        uint32_t got = count_matches(&queries[q], true);
+        int64_t us = test_now_us() - start;
+        uint32_t want = count_matches(&queries[q], false);
+        printf("consulta %zu: %" PRIu32 " eventos em %" PRId64 " us (esperado %" PRIu32 ")\n", q, got, us, want);
+        CHECK(got == want);
+    }
+
+    // Leitura sequencial a partir de um instante (replay das estatísticas)
+    CHECK(access_log_last_timestamp() == range_ts(RANGE_EVENTS - 1));
+    const uint32_t tails[] = { 0, 1, 1233, retained / 2, retained, retained + 500 };
+    for (size_t t = 0; t < sizeof(tails) / sizeof(tails[0]); t++) {
+        uint32_t from = tails[t] ? range_ts(RANGE_EVENTS - tails[t]) - RANGE_STEP / 2 : range_ts(RANGE_EVENTS);
+        uint32_t want = tails[t] < retained ? tails[t] : retained;
+        from_ctx_t ctx = { .from = from, .seen = 0, .ok = true };
+        int64_t start = test_now_us();
+        CHECK_OK(access_log_scan(from, check_from, &ctx));
+        int64_t us = test_now_us() - start;
+        printf("scan desde -%" PRIu32 ": %" PRIu32 " eventos em %" PRId64 " us (esperado %" PRIu32 ")\n",
+               tails[t], ctx.seen, us, want);
+        CHECK(ctx.ok && ctx.seen == want);
+    }
+    access_log_deinit();
+}
+
+int main(void) {
+    alarm(120);
+    test_reset_flash();
+    CHECK_OK(access_log_init());
+    char uid[MAX_UID_LENGTH];
+    for (uint32_t i = 0; i < EVENTS; i++) {
+        test_uid(i % UIDS, uid, sizeof(uid));
+        CHECK_OK(access_log_append(uid, s_actions[i % 2], event_ts(i)));
+    }
+    CHECK_OK(access_log_flush());
+    access_log_deinit();
+
+    CHECK_OK(access_log_init());
+    CHECK(access_log_retained() == EVENTS);
+    scan_ctx_t ctx = { .seen = 0, .ok = true };
+    CHECK_OK(access_log_scan(0, check_entry, &ctx));
+    CHECK(ctx.ok && ctx.seen == EVENTS);
+
+    access_log_reader_t reader;
+    access_log_t entry;
+    CHECK_OK(access_log_reader_begin(&reader));
+    CHECK_OK(access_log_reader_next(&reader, &entry));
+    CHECK((uint32_t)entry.timestamp == event_ts(EVENTS - 1));
+    access_log_deinit();
+
+    check_ranges();
+    printf("test_access_log: ok\n");
+    return 0;
+}
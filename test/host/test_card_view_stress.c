@@ -0,0 +1,245 @@
+// Visão lock-free do caminho do toque com leitores concorrendo com o
+// escritor: épocas e período de graça não podem deixar um leitor ver um
+// balde liberado (ASan/TSan) nem responder errado. Primeiro direto na
+// card_view, depois pelo banco com a task de flush.
+//   test_card_view_stress [segundos por fase=1]
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+#include "test_util.h"
+#include "card_view.h"
+#include "database.h"
+
+#define STABLE      500         // sempre presentes
+#define TOGGLE      200         // entram e saem
+#define ABSENT_BASE 60000       // nunca cadastrados
+#define READERS     4
+
+static atomic_bool s_stop;
+static atomic_uint s_bad;
+static atomic_uint s_reads;
+
+static uint8_t level_of(uint32_t k) {
+    return (uint8_t)(ACCESS_LEVEL_USER + k % 3);
+}
+
+static void key_of(uint32_t k, uint8_t *uid, uint8_t *uid_len) {
+    uid[0] = (uint8_t)(k >> 8);
+    uid[1] = (uint8_t)k;
+    uid[2] = 0xCC;
+    uid[3] = (uint8_t)(k % 7);
+    *uid_len = 4;
+}
+
+static void uid_of(uint32_t k, char *uid, size_t size) {
+    uint8_t key[4], len;
+    key_of(k, key, &len);
+    snprintf(uid, size, "%02X:%02X:%02X:%02X", key[0], key[1], key[2], key[3]);
+}
+
+// Cartão estável: sempre achado com o nível certo. Alternado: achado ou
+// não, mas nunca com outro nível. Ausente: nunca achado.
+static void check_answer(uint32_t k, esp_err_t ret, uint8_t level) {
+    bool ok;
+    if (k < STABLE) {
+        ok = ret == ESP_OK && level == level_of(k);
+    } else if (k < STABLE + TOGGLE) {
+        ok = (ret == ESP_OK && level == level_of(k)) || ret == ESP_ERR_NOT_FOUND;
+    } else {
+        ok = ret == ESP_ERR_NOT_FOUND;
+    }
+    if (!ok) {
+        atomic_fetch_add(&s_bad, 1);
+    }
+    atomic_fetch_add(&s_reads, 1);
+}
+
+static uint32_t pick(unsigned *seed) {
+    switch (rand_r(seed) % 3) {
+    case 0: return (uint32_t)(rand_r(seed) % STABLE);
+    case 1: return STABLE + (uint32_t)(rand_r(seed) % TOGGLE);
+    default: return ABSENT_BASE + (uint32_t)(rand_r(seed) % 1000);
+    }
+}
+
+// --- Fase 1: card_view direto, um escritor ---
+
+static card_view_t s_view;
+static card_hot_t s_table[STABLE + TOGGLE];
+
+static void *view_reader(void *arg) {
+    unsigned seed = (unsigned)(uintptr_t)arg;
+    while (!atomic_load(&s_stop)) {
+        uint32_t k = pick(&seed);
+        uint8_t uid[4], uid_len, level = 0;
+        key_of(k, uid, &uid_len);
+        esp_err_t ret = card_view_lookup(&s_view, uid, uid_len, &level);
+        if (ret != ESP_ERR_INVALID_STATE) {
+            check_answer(k, ret, level);
+        }
+    }
+    return NULL;
+}
+
+static void table_set(uint32_t k, bool present) {
+    card_hot_t *card = &s_table[k];
+    memset(card, 0, sizeof(*card));
+    if (present) {
+        key_of(k, card->uid, &card->uid_len);
+        card->access_level = level_of(k);
+    }
+}
+
+static void *view_writer(void *arg) {
+    unsigned seed = 7;
+    uint32_t ops = 0;
+    while (!atomic_load(&s_stop)) {
+        uint32_t k = STABLE + (uint32_t)(rand_r(&seed) % TOGGLE);
+        uint8_t uid[4], uid_len;
+        key_of(k, uid, &uid_len);
+        int op = rand_r(&seed) % 100;
+        if (op < 45) {
+            table_set(k, true);
+            CHECK_OK(card_view_put(&s_view, uid, uid_len, level_of(k)));
+        } else if (op < 90) {
+            table_set(k, false);
+            card_view_remove(&s_view, uid, uid_len);
+        } else {
+            CHECK_OK(card_view_rebuild(&s_view, s_table, STABLE + TOGGLE));
+        }
+        ops++;
+    }
+    printf("card_view: %" PRIu32 " operações do escritor\n", ops);
+    return NULL;
+}
+
+static void stress_view(unsigned seconds) {
+    card_view_init(&s_view);
+    for (uint32_t k = 0; k < STABLE + TOGGLE; k++) {
+        table_set(k, k < STABLE);
+    }
+    CHECK_OK(card_view_rebuild(&s_view, s_table, STABLE + TOGGLE));
+
+    pthread_t threads[READERS + 1];
+    atomic_store(&s_stop, false);
+    for (uintptr_t i = 0; i < READERS; i++) {
+        CHECK(pthread_create(&threads[i], NULL, view_reader, (void *)(i + 1)) == 0);
+    }
+    CHECK(pthread_create(&threads[READERS], NULL, view_writer, NULL) == 0);
+    sleep(seconds);
+    atomic_store(&s_stop, true);
+    for (int i = 0; i <= READERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    card_view_stats_t stats;
+    card_view_get_stats(&s_view, &stats);
+    printf("card_view: %u leituras, %" PRIu32 " repetições, %" PRIu32 " publicações, %" PRIu32
+           " esperas de graça, %" PRIu32 " reconstruções\n",
+           atomic_load(&s_reads), stats.read_retries, stats.publishes, stats.grace_waits, stats.rebuilds);
+    printf("card_view: %u respostas erradas\n", atomic_load(&s_bad));
+    CHECK(stats.publishes > 0);
+    card_view_free(&s_view);
+}
+
+// --- Fase 2: pelo banco, com a task de flush ---
+
+static void *db_reader(void *arg) {
+    unsigned seed = (unsigned)(uintptr_t)arg;
+    char uid[MAX_UID_LENGTH];
+    while (!atomic_load(&s_stop)) {
+        uint32_t k = pick(&seed);
+        uint8_t level = 0;
+        uid_of(k, uid, sizeof(uid));
+        esp_err_t ret = database_lookup_access(uid, &level);
+        check_answer(k, ret, level);
+    }
+    return NULL;
+}
+
+static void *db_writer(void *arg) {
+    unsigned seed = 9;
+    char uid[MAX_UID_LENGTH], other[MAX_UID_LENGTH];
+    uint32_t ops = 0;
+    while (!atomic_load(&s_stop)) {
+        uint32_t k = STABLE + (uint32_t)(rand_r(&seed) % TOGGLE);
+        uid_of(k, uid, sizeof(uid));
+        int op = rand_r(&seed) % 10;
+        if (op < 4) {
+            database_add_card(uid, "Alternado", level_of(k));
+        } else if (op < 8) {
+            database_delete_card(uid);
+        } else if (op == 8 && database_txn_begin() == ESP_OK) {
+            database_add_card(uid, "Transacao", level_of(k));
+            uid_of(STABLE + (uint32_t)(rand_r(&seed) % TOGGLE), other, sizeof(other));
+            database_delete_card(other);
+            if (rand_r(&seed) & 1) {
+                database_txn_commit();
+            } else {
+                database_txn_abort();
+            }
+        } else {
+            uid_of((uint32_t)(rand_r(&seed) % STABLE), uid, sizeof(uid));
+            database_update_card_access(uid);
+        }
+        // Importação de tempos em tempos: reconstrói a visão inteira
+        if (++ops % 200 == 0) {
+            CHECK_OK(database_import_begin());
+            for (uint32_t j = 0; j < 50; j++) {
+                rfid_record_t record = { .access_level = ACCESS_LEVEL_USER };
+                uid_of(3000 + (ops / 200 % 40) * 50 + j, record.uid, sizeof(record.uid));
+                snprintf(record.name, sizeof(record.name), "Importado");
+                database_import_add(&record);
+            }
+            CHECK_OK(database_import_end(NULL));
+        }
+    }
+    printf("banco: %" PRIu32 " operações do escritor\n", ops);
+    return NULL;
+}
+
+static void stress_database(unsigned seconds) {
+    test_reset_flash();
+    fake_nvs_set_partition_size("rfid0", 0);
+    CHECK_OK(database_init());
+    CHECK_OK(database_import_begin());
+    for (uint32_t k = 0; k < STABLE; k++) {
+        rfid_record_t record = { .access_level = level_of(k) };
+        uid_of(k, record.uid, sizeof(record.uid));
+        snprintf(record.name, sizeof(record.name), "Estavel %" PRIu32, k);
+        CHECK_OK(database_import_add(&record));
+    }
+    CHECK_OK(database_import_end(NULL));
+    database_set_flush_interval(1);     // flush, compactação e compilação o tempo todo
+
+    pthread_t threads[READERS + 1];
+    atomic_store(&s_stop, false);
+    atomic_store(&s_reads, 0);
+    for (uintptr_t i = 0; i < READERS; i++) {
+        CHECK(pthread_create(&threads[i], NULL, db_reader, (void *)(i + 1)) == 0);
+    }
+    CHECK(pthread_create(&threads[READERS], NULL, db_writer, NULL) == 0);
+    sleep(seconds);
+    atomic_store(&s_stop, true);
+    for (int i = 0; i <= READERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    database_concurrency_stats_t stats;
+    CHECK_OK(database_get_concurrency_stats(&stats));
+    printf("banco: %u leituras, %" PRIu32 " pela visão, %" PRIu32 " pelo lock\n",
+           atomic_load(&s_reads), stats.view.reads, stats.view_fallbacks);
+    CHECK_OK(database_close());
+}
+
+int main(int argc, char **argv) {
+    unsigned seconds = (unsigned)test_arg(argc, argv, 1, 1);
+    alarm(60 + 4 * seconds);
+    stress_view(seconds);
+    stress_database(seconds);
+    printf("respostas erradas: %u\n", atomic_load(&s_bad));
+    CHECK(atomic_load(&s_bad) == 0);
+    printf("test_card_view_stress: ok\n");
+    return 0;
+}
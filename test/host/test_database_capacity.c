@@ -0,0 +1,59 @@
+// Capacidade do layout padrão de 2MB (partitions.csv): cadastra com nomes
+// do tamanho máximo até a partição rfid0 encher. Tem de caber ao menos
+// CARDS_MIN, o cadastro seguinte falha com ESP_ERR_NO_MEM, o banco cheio
+// continua abrindo e o heap dele cabe no orçamento do ESP32-S3 sem PSRAM.
+#include <string.h>
+#include <unistd.h>
+#include "test_util.h"
+#include "database.h"
+
+#define CARDS_MIN   2500    // ~2.750 com nomes de 63 caracteres
+#define HEAP_MAX    (256 * 1024)
+
+static esp_err_t add_card(uint32_t i) {
+    char uid[MAX_UID_LENGTH];
+    char name[MAX_NAME_LENGTH];
+    test_uid(i, uid, sizeof(uid));
+    // Nome com o tamanho máximo, que é o que mais ocupa no NVS
+    int len = snprintf(name, sizeof(name), "%" PRIu32 " ", i);
+    memset(&name[len], 'n', sizeof(name) - 1 - len);
+    name[sizeof(name) - 1] = '\0';
+    return database_add_card(uid, name, ACCESS_LEVEL_USER);
+}
+
+int main(void) {
+    alarm(240);
+    test_reset_flash();
+    CHECK_OK(database_init());
+
+    uint32_t cards = 0;
+    esp_err_t ret;
+    while ((ret = add_card(cards)) == ESP_OK) {
+        cards++;
+    }
+    CHECK(ret == ESP_ERR_NO_MEM);
+    CHECK_OK(database_close());
+
+    // Reabre cheio: mesma contagem e o próximo cadastro ainda é recusado.
+    // O heap é medido só no init para não contar o NVS emulado.
+    int total = 0;
+    int accesses = 0;
+    size_t before = test_heap_used();
+    CHECK_OK(database_init());
+    size_t heap = test_heap_used() - before;
+    CHECK_OK(database_get_stats(&total, &accesses));
+    CHECK((uint32_t)total == cards);
+    CHECK(add_card(cards) == ESP_ERR_NO_MEM);
+    rfid_record_t record;
+    char uid[MAX_UID_LENGTH];
+    test_uid(cards - 1, uid, sizeof(uid));
+    CHECK_OK(database_get_card(uid, &record));
+    CHECK_OK(database_close());
+
+    printf("partição rfid0 de %u KB: %" PRIu32 " cartões, %zu bytes de heap (%.1f por cartão)\n",
+           0xB0000 / 1024, cards, heap, (double)heap / cards);
+    CHECK(cards >= CARDS_MIN);
+    CHECK(heap <= HEAP_MAX);
+    printf("test_database_capacity: ok\n");
+    return 0;
+}
@@ -0,0 +1,44 @@
+// database_close com a task de flush ocupada: a task precisa sair sem
+// segurar o lock do banco nem o do log, senão o close ou o init seguinte
+// travam (o alarme derruba o teste)
+#include <string.h>
+#include <unistd.h>
+#include "test_util.h"
+#include "database.h"
+
+#define ROUNDS      60
+#define PER_ROUND   40
+
+int main(void) {
+    alarm(60);
+    test_reset_flash();
+    fake_nvs_set_partition_size("rfid0", 0);
+
+    char uid[MAX_UID_LENGTH];
+    uint32_t next = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        CHECK_OK(database_init());
+        // Flush a cada tick: o close cai no meio de flush, log ou fotografia
+        database_set_flush_interval(1);
+        for (int i = 0; i < PER_ROUND; i++, next++) {
+            test_uid(next, uid, sizeof(uid));
+            CHECK_OK(database_add_card(uid, "Teste", ACCESS_LEVEL_USER));
+            CHECK_OK(database_update_card_access(uid));
+            CHECK_OK(database_add_access_log(uid, "granted"));
+        }
+        usleep((round % 5) * 300);
+        CHECK_OK(database_close());
+    }
+
+    CHECK_OK(database_init());
+    int total = 0, accesses = 0;
+    CHECK_OK(database_get_stats(&total, &accesses));
+    CHECK(total == ROUNDS * PER_ROUND);
+    rfid_record_t record;
+    test_uid(next - 1, uid, sizeof(uid));
+    CHECK_OK(database_get_card(uid, &record));
+    CHECK(record.access_count == 1); // contador gravado pelo flush do close
+    CHECK_OK(database_close());
+    printf("test_database_close: ok\n");
+    return 0;
+}
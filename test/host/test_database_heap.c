@@ -0,0 +1,60 @@
+// Heap ocupado pelo banco aberto com N cartões (tabela quente, índices,
+// filtro e visão do caminho do toque), medido entre o antes e o depois do
+// database_init para não contar o NVS emulado. O ESP32-S3 sem PSRAM tem
+// ~512 KB de SRAM para tudo: o custo por cartão tem de ficar no orçamento e
+// um cadastro depois da carga não pode dobrar as tabelas.
+//   test_database_heap [cartões=2000] [cartões=...]
+#include <string.h>
+#include <unistd.h>
+#include "test_util.h"
+#include "database.h"
+
+#define BYTES_PER_CARD_MAX  68
+#define GROW_MAX            65536   // um passo é ~9 KB; dobrar com 2000 cartões passa de 100 KB
+
+static size_t boot_heap(uint32_t cards) {
+    test_reset_flash();
+    fake_nvs_set_partition_size("rfid0", 0);
+    CHECK_OK(database_init());
+    CHECK_OK(database_import_begin());
+    for (uint32_t i = 0; i < cards; i++) {
+        rfid_record_t record = { .access_level = ACCESS_LEVEL_USER };
+        test_uid(i, record.uid, sizeof(record.uid));
+        snprintf(record.name, sizeof(record.name), "Cartao %" PRIu32, i);
+        CHECK_OK(database_import_add(&record));
+    }
+    CHECK_OK(database_import_end(NULL));
+    CHECK_OK(database_close());
+
+    size_t before = test_heap_used();
+    CHECK_OK(database_init());
+    return test_heap_used() - before;
+}
+
+int main(int argc, char **argv) {
+    alarm(240);
+    size_t fixed = boot_heap(0);
+    CHECK_OK(database_close());
+    printf("sem cartões: %zu bytes\n", fixed);
+
+    for (int arg = 1; arg == 1 || arg < argc; arg++) {
+        uint32_t cards = (uint32_t)test_arg(argc, argv, arg, 2000);
+        size_t heap = boot_heap(cards);
+        double per_card = (double)(heap - fixed) / cards;
+
+        // Cadastro logo após a carga: cresce um passo, não a tabela inteira
+        char uid[MAX_UID_LENGTH];
+        size_t before = test_heap_used();
+        test_uid(cards, uid, sizeof(uid));
+        CHECK_OK(database_add_card(uid, "Novo", ACCESS_LEVEL_USER));
+        int64_t grow = (int64_t)test_heap_used() - (int64_t)before;
+
+        printf("%6" PRIu32 " cartões: %7zu bytes (%.1f por cartão), %+" PRId64 " no primeiro cadastro\n",
+               cards, heap, per_card, grow);
+        CHECK(per_card <= BYTES_PER_CARD_MAX);
+        CHECK(grow <= GROW_MAX);
+        CHECK_OK(database_close());
+    }
+    printf("test_database_heap: ok\n");
+    return 0;
+}
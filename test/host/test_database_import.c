@@ -0,0 +1,116 @@
+// Importação desfeita por database_import_abort, cadastro/remoção recusados
+// durante a importação e compactação segurada durante uma varredura
+#include <string.h>
+#include <unistd.h>
+#include "test_util.h"
+#include "database.h"
+
+static int card_total(void) {
+    int total = 0, accesses = 0;
+    CHECK_OK(database_get_stats(&total, &accesses));
+    return total;
+}
+
+static void import_range(uint32_t from, uint32_t to) {
+    for (uint32_t i = from; i < to; i++) {
+        rfid_record_t record = { .access_level = ACCESS_LEVEL_ADMIN, .access_count = 3 };
+        test_uid(i, record.uid, sizeof(record.uid));
+        snprintf(record.name, sizeof(record.name), "Importado %" PRIu32, i);
+        CHECK_OK(database_import_add(&record));
+    }
+}
+
+static void test_abort(void) {
+    char uid[MAX_UID_LENGTH];
+    for (uint32_t i = 0; i < 10; i++) {
+        test_uid(i, uid, sizeof(uid));
+        CHECK_OK(database_add_card(uid, "Existente", ACCESS_LEVEL_USER));
+    }
+    for (uint32_t i = 0; i < 3; i++) {
+        test_uid(i, uid, sizeof(uid));
+        CHECK_OK(database_delete_card(uid)); // buracos na lista livre
+    }
+
+    CHECK_OK(database_import_begin());
+    import_range(100, 150);
+    test_uid(500, uid, sizeof(uid));
+    CHECK(database_add_card(uid, "Durante", ACCESS_LEVEL_USER) == ESP_ERR_INVALID_STATE);
+    test_uid(5, uid, sizeof(uid));
+    CHECK(database_delete_card(uid) == ESP_ERR_INVALID_STATE);
+    CHECK_OK(database_update_card_access(uid));
+    database_import_abort();
+    database_import_abort(); // sem importação: nada a fazer
+
+    uint8_t level;
+    CHECK(card_total() == 7);
+    test_uid(120, uid, sizeof(uid));
+    CHECK(database_lookup_access(uid, &level) == ESP_ERR_NOT_FOUND);
+    test_uid(5, uid, sizeof(uid));
+    CHECK_OK(database_lookup_access(uid, &level));
+
+    // Nada do lote sobrevive ao reboot e ele pode ser importado de novo
+    CHECK_OK(database_close());
+    CHECK_OK(database_init());
+    CHECK(card_total() == 7);
+    test_uid(120, uid, sizeof(uid));
+    CHECK(database_lookup_access(uid, &level) == ESP_ERR_NOT_FOUND);
+
+    database_import_stats_t stats;
+    CHECK_OK(database_import_begin());
+    import_range(100, 150);
+    CHECK_OK(database_import_end(&stats));
+    CHECK(stats.imported == 50 && stats.duplicates == 0);
+    CHECK(card_total() == 57);
+    CHECK_OK(database_lookup_access(uid, &level));
+    CHECK(level == ACCESS_LEVEL_ADMIN);
+    test_uid(500, uid, sizeof(uid));
+    CHECK_OK(database_add_card(uid, "Depois", ACCESS_LEVEL_USER));
+}
+
+static void test_compact_pause(void) {
+    char uid[MAX_UID_LENGTH];
+    for (uint32_t i = 100; i < 130; i++) {
+        test_uid(i, uid, sizeof(uid));
+        CHECK_OK(database_delete_card(uid));
+    }
+    int expected = card_total();
+
+    database_cards_iter_t iter;
+    rfid_record_t record;
+    database_compact_pause();
+    CHECK_OK(database_cards_iter_begin(&iter, 0, NULL, NULL));
+    database_set_flush_interval(1);
+    int seen = 0;
+    esp_err_t ret;
+    while ((ret = database_cards_iter_next(&iter, &record)) == ESP_OK) {
+        seen++;
+        usleep(1000); // vários ciclos da task de flush durante a varredura
+    }
+    CHECK(ret == ESP_ERR_NOT_FOUND);
+    CHECK(seen == expected);
+    uint32_t cursor = database_cards_iter_cursor(&iter);
+    database_cards_iter_end(&iter);
+    database_compact_resume();
+
+    // Sem a pausa a compactação fecha os buracos e o cursor antigo expira
+    database_cards_iter_t stale;
+    for (int i = 0; i < 500; i++) {
+        if (database_cards_iter_begin(&stale, cursor, NULL, NULL) == ESP_ERR_INVALID_STATE) {
+            break;
+        }
+        usleep(1000);
+    }
+    CHECK(database_cards_iter_begin(&stale, cursor, NULL, NULL) == ESP_ERR_INVALID_STATE);
+    database_set_flush_interval(0);
+}
+
+int main(void) {
+    test_reset_flash();
+    fake_nvs_set_partition_size("rfid0", 0);
+    CHECK_OK(database_init());
+    test_abort();
+    test_compact_pause();
+    CHECK_OK(database_close());
+    printf("test_database_import: ok\n");
+    return 0;
+}
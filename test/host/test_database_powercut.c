@@ -0,0 +1,171 @@
+// Queda de energia em cada gravação do NVS durante um roteiro de cadastros,
+// remoções e transações: após reabrir, o banco tem de estar no estado de
+// antes ou de depois da operação interrompida, nunca no meio dela
+#include <string.h>
+#include <unistd.h>
+#include "test_util.h"
+#include "database.h"
+
+#define CARDS       24
+#define MAX_STEPS   48
+
+static char s_states[MAX_STEPS][CARDS + 1];
+static int s_state_count;
+
+static void card_uid(int k, char *uid, size_t size) {
+    test_uid((uint32_t)k, uid, size);
+}
+
+static void card_name(int k, char *name, size_t size) {
+    snprintf(name, size, "nome%d", k);
+}
+
+// '.' ausente, 'X' íntegro, 'n' com nome errado (c_ sem o n_ correspondente)
+static void snapshot(char *out) {
+    for (int k = 0; k < CARDS; k++) {
+        char uid[MAX_UID_LENGTH], name[MAX_NAME_LENGTH];
+        rfid_record_t record;
+        card_uid(k, uid, sizeof(uid));
+        card_name(k, name, sizeof(name));
+        if (database_get_card(uid, &record) != ESP_OK) {
+            out[k] = '.';
+        } else {
+            out[k] = strcmp(record.name, name) == 0 ? 'X' : 'n';
+        }
+    }
+    out[CARDS] = '\0';
+}
+
+static esp_err_t add(int k) {
+    char uid[MAX_UID_LENGTH], name[MAX_NAME_LENGTH];
+    card_uid(k, uid, sizeof(uid));
+    card_name(k, name, sizeof(name));
+    return database_add_card(uid, name, (uint8_t)(ACCESS_LEVEL_USER + k % 2));
+}
+
+static esp_err_t del(int k) {
+    char uid[MAX_UID_LENGTH];
+    card_uid(k, uid, sizeof(uid));
+    return database_delete_card(uid);
+}
+
+// Retorna quantas operações completaram antes da primeira falha
+static int script(bool record) {
+    int done = 0;
+#define STEP(expr) do { \
+    if ((expr) != ESP_OK) { \
+        return done; \
+    } \
+    done++; \
+    if (record) { \
+        snapshot(s_states[s_state_count++]); \
+    } \
+} while (0)
+
+    for (int k = 0; k < 16; k++) {
+        STEP(add(k));
+    }
+    for (int k = 3; k < 16; k += 4) {
+        STEP(del(k));
+    }
+    STEP(add(16));                          // reaproveita um slot livre
+    if (database_txn_begin() != ESP_OK) {
+        return done;
+    }
+    add(17);
+    del(5);
+    add(18);
+    STEP(database_txn_commit());
+    if (database_txn_begin() != ESP_OK) {
+        return done;
+    }
+    add(19);
+    del(6);
+    database_txn_abort();
+    STEP(ESP_OK);
+    for (int k = 12; k < 15; k++) {
+        STEP(del(k));
+    }
+    STEP(add(20));
+#undef STEP
+    return done;
+}
+
+// Gravação que falha no meio de um cadastro, sem reboot: o banco aberto não
+// pode ficar com o cartão no índice e fora do armazenamento (ou o contrário)
+static void check_failed_add(void) {
+    test_reset_flash();
+    CHECK_OK(database_init());
+    for (int k = 0; k < 4; k++) {
+        CHECK_OK(add(k));
+    }
+    CHECK_OK(del(1));                       // o próximo cadastro reusa o slot
+    for (int64_t cut = 0; cut < 16; cut++) {
+        char uid[MAX_UID_LENGTH];
+        rfid_record_t record;
+        card_uid(CARDS - 2, uid, sizeof(uid));
+        fake_nvs_fail_after(cut);
+        esp_err_t ret = add(CARDS - 2);
+        fake_nvs_fail_after(-1);
+        if (ret == ESP_OK) {
+            CHECK_OK(database_get_card(uid, &record));
+            CHECK_OK(del(CARDS - 2));
+            continue;
+        }
+        CHECK(database_get_card(uid, &record) == ESP_ERR_NOT_FOUND);
+        CHECK_OK(add(CARDS - 2));
+        CHECK_OK(database_get_card(uid, &record));
+        CHECK_OK(del(CARDS - 2));
+    }
+    CHECK_OK(database_close());
+}
+
+int main(void) {
+    alarm(240);
+    check_failed_add();
+    char initial[CARDS + 1];
+    memset(initial, '.', CARDS);
+    initial[CARDS] = '\0';
+
+    test_reset_flash();
+    CHECK_OK(database_init());
+    fake_nvs_counters_t before, after;
+    fake_nvs_get_counters(&before);
+    s_state_count = 0;
+    int total = script(true);
+    fake_nvs_get_counters(&after);
+    CHECK_OK(database_close());
+    int64_t writes = (int64_t)(after.writes - before.writes);
+    printf("roteiro: %d operações, %" PRId64 " gravações\n", total, writes);
+
+    int bad = 0;
+    uint32_t replayed = 0;
+    for (int64_t cut = 0; cut <= writes; cut++) {
+        test_reset_flash();
+        CHECK_OK(database_init());
+        fake_nvs_fail_after(cut);
+        int done = script(false);
+        database_close();                   // sem energia nada mais chega ao flash
+        fake_nvs_fail_after(-1);
+
+        CHECK_OK(database_init());
+        storage_journal_stats_t journal;
+        CHECK_OK(database_get_journal_stats(&journal, NULL));
+        replayed += journal.replayed;
+        char now[CARDS + 1];
+        snapshot(now);
+        const char *prev = done == 0 ? initial : s_states[done - 1];
+        const char *next = done < total ? s_states[done] : prev;
+        if (strcmp(now, prev) != 0 && strcmp(now, next) != 0) {
+            bad++;
+            printf("corte %" PRId64 " (operação %d): %s\n  esperado %s\n  ou       %s\n", cut, done, now, prev, next);
+        }
+        // O banco recuperado continua aceitando gravações
+        CHECK_OK(add(CARDS - 1));
+        CHECK_OK(database_close());
+    }
+    printf("%" PRId64 " cortes, %d inconsistentes, %" PRIu32 " registros refeitos\n", writes + 1, bad, replayed);
+    CHECK(bad == 0);
+    printf("test_database_powercut: ok\n");
+    return 0;
+}
@@ -0,0 +1,144 @@
+// Paginação de database_query_cards pelo cursor de posição no índice: cada
+// cartão uma vez, sem releitura dos já entregues, estável sob acessos
+#include <string.h>
+#include "test_util.h"
+#include "database.h"
+
+#define CARDS   300
+#define PAGE    7
+
+static uint8_t s_seen[CARDS];
+
+static uint32_t card_of(const rfid_record_t *record) {
+    for (uint32_t i = 0; i < CARDS; i++) {
+        char uid[MAX_UID_LENGTH];
+        test_uid(i, uid, sizeof(uid));
+        if (strcmp(uid, record->uid) == 0) {
+            return i;
+        }
+    }
+    CHECK(!"UID fora do conjunto");
+    return 0;
+}
+
+// Pagina a consulta inteira; 'touch' é chamado entre as páginas
+static uint32_t query_all(const database_card_query_t *query, void (*touch)(const rfid_record_t *, uint32_t)) {
+    memset(s_seen, 0, sizeof(s_seen));
+    rfid_record_t page[PAGE];
+    uint64_t cursor = 0;
+    uint32_t total = 0;
+    do {
+        uint32_t got = 0;
+        CHECK_OK(database_query_cards(query, &cursor, page, PAGE, &got));
+        CHECK(got == PAGE || cursor == 0);
+        for (uint32_t i = 0; i < got; i++) {
+            uint32_t card = card_of(&page[i]);
+            CHECK(s_seen[card] == 0); // nenhum repetido
+            s_seen[card] = 1;
+            total++;
+        }
+        if (touch && got > 0) {
+            touch(page, got);
+        }
+    } while (cursor != 0);
+    return total;
+}
+
+static void test_name_prefix(void) {
+    // Prefixo maior que CARD_QUERY_NAME_KEY_LEN: cada candidato custa uma
+    // leitura do registro frio, então reler os já pulados seria O(n²)
+    database_card_query_t query = { .name_prefix = "funcionario 1" };
+    fake_nvs_counters_t before, after;
+    fake_nvs_get_counters(&before);
+    uint32_t total = query_all(&query, NULL);
+    fake_nvs_get_counters(&after);
+    uint32_t expected = 0;
+    for (uint32_t i = 0; i < CARDS; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "Funcionario %" PRIu32, i);
+        bool match = strncmp(name, "Funcionario 1", 13) == 0;
+        CHECK(s_seen[i] == match);
+        expected += match;
+    }
+    CHECK(total == expected);
+    // Candidatos da faixa "funciona" (todos) lidos uma vez + os entregues
+    CHECK(after.reads - before.reads <= CARDS + 2 * total);
+
+    // Cadastro desloca o vetor por nome: cursor expira
+    rfid_record_t page[PAGE];
+    uint64_t cursor = 0;
+    uint32_t got = 0;
+    CHECK_OK(database_query_cards(&query, &cursor, page, PAGE, &got));
+    CHECK(cursor != 0);
+    char uid[MAX_UID_LENGTH];
+    test_uid(CARDS + 1, uid, sizeof(uid));
+    CHECK_OK(database_add_card(uid, "Funcionario 999", ACCESS_LEVEL_USER));
+    CHECK(database_query_cards(&query, &cursor, page, PAGE, &got) == ESP_ERR_INVALID_STATE);
+    CHECK(got == 0 && cursor == 0);
+    CHECK_OK(database_delete_card(uid));
+
+    // Cursor de outra consulta
+    database_card_query_t by_level = { .access_level = ACCESS_LEVEL_ADMIN };
+    cursor = 0;
+    CHECK_OK(database_query_cards(&query, &cursor, page, PAGE, &got));
+    CHECK(database_query_cards(&by_level, &cursor, page, PAGE, &got) == ESP_ERR_INVALID_ARG);
+}
+
+// Toca o último cartão entregue e um já entregue antes dele
+static void touch_delivered(const rfid_record_t *page, uint32_t got) {
+    CHECK_OK(database_update_card_access(page[got - 1].uid));
+    CHECK_OK(database_update_card_access(page[0].uid));
+}
+
+static void test_last_seen(void) {
+    // Todos com last_seen no passado: um acesso leva o cartão para o fim da
+    // lista (e para fora do corte), o que deslocava a paginação por offset
+    database_card_query_t before = { .seen_before = 1000000 };
+    CHECK(query_all(&before, touch_delivered) == CARDS);
+    for (uint32_t i = 0; i < CARDS; i++) {
+        CHECK(s_seen[i]);
+    }
+    // Todos tocados agora, quase todos no mesmo segundo: a ordem entre eles
+    // é a do slot. Do mais recente para o mais antigo.
+    for (uint32_t i = 0; i < CARDS; i++) {
+        char uid[MAX_UID_LENGTH];
+        test_uid(i, uid, sizeof(uid));
+        CHECK_OK(database_update_card_access(uid));
+    }
+    database_card_query_t after = { .seen_after = 1000000 };
+    CHECK(query_all(&after, touch_delivered) == CARDS);
+}
+
+static void test_level(void) {
+    database_card_query_t query = { .access_level = ACCESS_LEVEL_ADMIN };
+    uint32_t total = query_all(&query, NULL);
+    for (uint32_t i = 0; i < CARDS; i++) {
+        CHECK(s_seen[i] == (i % 3 == 0));
+    }
+    CHECK(total == (CARDS + 2) / 3);
+}
+
+int main(void) {
+    test_reset_flash();
+    fake_nvs_set_partition_size("rfid0", 0);
+    CHECK_OK(database_init());
+    CHECK_OK(database_import_begin());
+    for (uint32_t i = 0; i < CARDS; i++) {
+        rfid_record_t record = {
+            .access_level = (i % 3 == 0) ? ACCESS_LEVEL_ADMIN : ACCESS_LEVEL_USER,
+            .first_seen = 1000,
+            .last_seen = 1000 + (i * 37) % CARDS,
+        };
+        test_uid(i, record.uid, sizeof(record.uid));
+        snprintf(record.name, sizeof(record.name), "Funcionario %" PRIu32, i);
+        CHECK_OK(database_import_add(&record));
+    }
+    CHECK_OK(database_import_end(NULL));
+
+    test_name_prefix();
+    test_level();
+    test_last_seen();
+    CHECK_OK(database_close());
+    printf("test_database_query: ok\n");
+    return 0;
+}
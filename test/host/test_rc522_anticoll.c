@@ -0,0 +1,102 @@
+// Cascata e anticolisão do driver RC522 contra PICCs emulados: UIDs de 4, 7
+// e 10 bytes sozinhos e com colisões em cada nível, inclusive entre cartões
+// de 7 e de 10 bytes. Cada leitura tem de sair na primeira tentativa, com o
+// UID do cartão que o bit disputado em 1 escolhe.
+#include <string.h>
+#include "test_util.h"
+#include "rc522.h"
+
+typedef struct {
+    const char *name;
+    fake_picc_t cards[FAKE_RC522_MAX_CARDS];
+    int count;
+    int winner;                 // índice do cartão que sai da anticolisão
+    bool collides;
+} anticoll_case_t;
+
+#define PICC4(...)   { .uid = {__VA_ARGS__}, .uid_len = 4, .sak = 0x08 }
+#define PICC7(...)   { .uid = {__VA_ARGS__}, .uid_len = 7, .sak = 0x00 }
+#define PICC10(...)  { .uid = {__VA_ARGS__}, .uid_len = 10, .sak = 0x20 }
+
+static const anticoll_case_t s_cases[] = {
+    { "4 bytes", { PICC4(0xDE, 0xAD, 0xBE, 0xEF) }, 1, 0, false },
+    { "7 bytes", { PICC7(0x04, 0xA1, 0xB2, 0xC3, 0xD4, 0xE5, 0xF6) }, 1, 0, false },
+    { "10 bytes", { PICC10(0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99) }, 1, 0, false },
+    // Nível 1: o bit 0 do primeiro byte decide
+    { "2x4, bit 0", { PICC4(0x12, 0x34, 0x56, 0x78), PICC4(0x13, 0x34, 0x56, 0x78) }, 2, 1, true },
+    { "2x4, 2 colisões", { PICC4(0x12, 0x34, 0x56, 0x78), PICC4(0x12, 0x34, 0x57, 0x79) }, 2, 1, true },
+    { "3x4", { PICC4(0x01, 0, 0, 0), PICC4(0x02, 0, 0, 0), PICC4(0x03, 0, 0, 0) }, 3, 2, true },
+    // Mesmo fabricante: CT + 3 bytes iguais no nível 1, colisão no nível 2
+    { "2x7, nível 2", { PICC7(0x04, 0xA1, 0xB2, 0xC3, 0xD4, 0xE5, 0xF6),
+                        PICC7(0x04, 0xA1, 0xB2, 0x03, 0xD4, 0xE5, 0xF6) }, 2, 0, true },
+    { "2x7, nível 1", { PICC7(0x04, 0xA1, 0xB2, 0xC3, 0xD4, 0xE5, 0xF6),
+                        PICC7(0x04, 0xA1, 0xB3, 0xC3, 0xD4, 0xE5, 0xF6) }, 2, 1, true },
+    // Colisão no último bit do UID do nível 2 (CollPos 0 = bit 32)
+    { "2x7, bit 32", { PICC7(0x04, 0xA1, 0xB2, 0xC3, 0xD4, 0xE5, 0x76),
+                       PICC7(0x04, 0xA1, 0xB2, 0xC3, 0xD4, 0xE5, 0xF6) }, 2, 1, true },
+    { "2x10, nível 2", { PICC10(0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99),
+                         PICC10(0x04, 0x11, 0x22, 0x33, 0x45, 0x55, 0x66, 0x77, 0x88, 0x99) }, 2, 1, true },
+    { "2x10, nível 3", { PICC10(0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99),
+                         PICC10(0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x70, 0x88, 0x98) }, 2, 0, true },
+    // Tamanhos diferentes: no nível 1 o CT (0x88) do de 7 bytes contra o
+    // primeiro byte do de 4; depois o de 7 contra o de 10 no nível 2
+    { "4 e 7", { PICC4(0x08, 0xA1, 0xB2, 0xC3), PICC7(0x04, 0xA1, 0xB2, 0xC3, 0xD4, 0xE5, 0xF6) }, 2, 1, true },
+    { "7 e 10", { PICC7(0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66),
+                  PICC10(0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99) }, 2, 0, true },
+    { "3x10", { PICC10(0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x01),
+                PICC10(0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x02),
+                PICC10(0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x03) }, 3, 2, true },
+};
+
+static uint8_t levels_of(uint8_t uid_len) {
+    return uid_len == 4 ? 1 : uid_len == 7 ? 2 : 3;
+}
+
+static void run_case(rc522_handle_t *handle, const anticoll_case_t *c) {
+    const fake_picc_t *want = &c->cards[c->winner];
+    rc522_card_t card;
+    rc522_trace_t trace;
+
+    fake_rc522_set_cards(c->cards, c->count);
+    memset(&card, 0, sizeof(card));
+    CHECK(rc522_card_present(handle) == RC522_OK);
+    int status = rc522_read_card(handle, &card);
+    CHECK_OK(rc522_get_trace(handle, &trace));
+    uint32_t collisions = fake_rc522_collisions();
+
+    char uid[32];
+    rc522_uid_to_string(&card, uid, sizeof(uid));
+    printf("%-16s status %d, UID %-30s SAK %02X, %u níveis, %u tentativas, %" PRIu32 " colisões\n",
+           c->name, status, uid, card.sak, trace.levels, trace.attempts, collisions);
+    CHECK(status == RC522_OK);
+    CHECK(card.uid_len == want->uid_len);
+    CHECK(memcmp(card.uid, want->uid, want->uid_len) == 0);
+    CHECK(card.sak == want->sak);
+    CHECK(trace.levels == levels_of(want->uid_len));
+    CHECK(trace.attempts == 1);
+    CHECK(trace.reused_atqa);
+    CHECK((collisions > 0) == c->collides);
+}
+
+int main(void) {
+    rc522_handle_t handle;
+    memset(&handle, 0, sizeof(handle));
+    CHECK_OK(rc522_init(&handle));
+
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) {
+        run_case(&handle, &s_cases[i]);
+    }
+
+    // Campo vazio: sem cartão, sem erro de SPI
+    fake_rc522_set_cards(NULL, 0);
+    CHECK(rc522_card_present(&handle) == RC522_ERR_NO_CARD);
+
+    rc522_stats_t stats;
+    CHECK_OK(rc522_get_stats(&handle, &stats));
+    printf("%" PRIu32 " leituras, %" PRIu32 " comandos, %" PRIu32 " timeouts, %" PRIu32 " transações SPI\n",
+           stats.card_reads, stats.commands, stats.timeouts, stats.spi_transactions);
+    CHECK(stats.card_reads == sizeof(s_cases) / sizeof(s_cases[0]));
+    CHECK_OK(rc522_deinit(&handle));
+    printf("test_rc522_anticoll: ok\n");
+    return 0;
+}
@@ -0,0 +1,98 @@
+// Backend de arquivo: instâncias independentes e persistência pelo arquivo,
+// direto e através do banco
+#include <string.h>
+#include <unistd.h>
+#include "test_util.h"
+#include "storage_backend.h"
+#include "database.h"
+
+static void test_instances(void) {
+    const storage_backend_t *a = storage_file_backend(NULL);
+    const storage_backend_t *b = storage_file_backend(NULL);
+    CHECK(a && b && a != b && a->ctx != b->ctx);
+    CHECK_OK(a->open(a->ctx, "t"));
+    CHECK_OK(b->open(b->ctx, "t"));
+
+    CHECK_OK(storage_set_u32(a, "k", 1));
+    CHECK_OK(storage_set_u32(b, "k", 2));
+    CHECK_OK(storage_commit(a));
+    CHECK_OK(storage_commit(b));
+    uint32_t value = 0;
+    CHECK_OK(storage_get_u32(a, "k", &value));
+    CHECK(value == 1);
+    CHECK_OK(storage_get_u32(b, "k", &value));
+    CHECK(value == 2);
+    CHECK_OK(storage_erase(a, "k"));
+    CHECK(storage_get_u32(a, "k", &value) == ESP_ERR_NOT_FOUND);
+    CHECK_OK(storage_get_u32(b, "k", &value));
+
+    a->close(a->ctx);
+    b->close(b->ctx);
+    storage_file_backend_free(a);
+    storage_file_backend_free(b);
+    storage_file_backend_free(NULL);
+}
+
+static void test_file_reopen(const char *path) {
+    const storage_backend_t *be = storage_file_backend(path);
+    CHECK(be);
+    CHECK_OK(be->open(be->ctx, "t"));
+    CHECK_OK(storage_set_u32(be, "persist", 42));
+    CHECK_OK(storage_commit(be));
+    CHECK_OK(storage_set_u32(be, "pending", 7)); // sem commit: não vai ao arquivo
+    be->close(be->ctx);
+    storage_file_backend_free(be);
+
+    be = storage_file_backend(path);
+    CHECK_OK(be->open(be->ctx, "t"));
+    uint32_t value = 0;
+    CHECK_OK(storage_get_u32(be, "persist", &value));
+    CHECK(value == 42);
+    be->close(be->ctx);
+    storage_file_backend_free(be);
+}
+
+static void test_database_reopen(const char *path) {
+    const storage_backend_t *be = storage_file_backend(path);
+    CHECK_OK(database_init_with_backend(be));
+    char uid[MAX_UID_LENGTH];
+    for (uint32_t i = 0; i < 20; i++) {
+        test_uid(i, uid, sizeof(uid));
+        CHECK_OK(database_add_card(uid, "Teste", ACCESS_LEVEL_USER));
+    }
+    test_uid(3, uid, sizeof(uid));
+    CHECK_OK(database_delete_card(uid));
+    CHECK_OK(database_close());
+    storage_file_backend_free(be);
+
+    be = storage_file_backend(path);
+    CHECK_OK(database_init_with_backend(be));
+    int total = 0, accesses = 0;
+    CHECK_OK(database_get_stats(&total, &accesses));
+    CHECK(total == 19);
+    uint8_t level = 0;
+    test_uid(7, uid, sizeof(uid));
+    CHECK_OK(database_lookup_access(uid, &level));
+    CHECK(level == ACCESS_LEVEL_USER);
+    test_uid(3, uid, sizeof(uid));
+    CHECK(database_lookup_access(uid, &level) == ESP_ERR_NOT_FOUND);
+    CHECK_OK(database_close());
+    storage_file_backend_free(be);
+}
+
+int main(void) {
+    char path[] = "/tmp/rfid_storage_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+    unlink(path);
+
+    test_reset_flash();
+    test_instances();
+    test_file_reopen(path);
+    unlink(path);
+    test_database_reopen(path);
+    unlink(path);
+    printf("test_storage_file: ok\n");
+    return 0;
+}
@@ -0,0 +1,134 @@
+// Journal com o NVS cheio: o registro gravado cuja aplicação falha fica
+// pendente (nunca é descartado), as leituras o enxergam, gravações novas
+// falham e um grupo que apaga chaves leva o pendente junto e libera espaço
+#include <string.h>
+#include <unistd.h>
+#include "test_util.h"
+#include "nvs_flash.h"
+#include "storage_backend.h"
+
+#define VALUE_LEN   200
+#define FILLER_LEN  32
+
+static size_t free_entries(const storage_backend_t *nvs) {
+    size_t used = 0, total = 0;
+    CHECK_OK(storage_nvs_usage(nvs, &used, &total));
+    return total - used;
+}
+
+static void fill_value(uint8_t *value, char tag) {
+    memset(value, tag, VALUE_LEN);
+}
+
+static void check_value(const storage_backend_t *be, const char *key, char tag) {
+    uint8_t value[VALUE_LEN], expected[VALUE_LEN];
+    size_t len = sizeof(value);
+    CHECK_OK(storage_get(be, key, value, &len));
+    fill_value(expected, tag);
+    CHECK(len == VALUE_LEN && memcmp(value, expected, len) == 0);
+}
+
+static esp_err_t group_abc(const storage_backend_t *j) {
+    uint8_t value[VALUE_LEN];
+    CHECK(storage_journal_begin());
+    for (char tag = 'a'; tag <= 'c'; tag++) {
+        char key[2] = { tag, '\0' };
+        fill_value(value, tag);
+        CHECK_OK(storage_set(j, key, value, sizeof(value)));
+    }
+    return storage_commit(j);
+}
+
+int main(void) {
+    alarm(60);
+    test_reset_flash();
+    fake_nvs_set_partition_size("nvs", 0x3000);
+    CHECK_OK(nvs_flash_init());
+    const storage_backend_t *nvs = storage_nvs_backend();
+    const storage_backend_t *j = storage_journal_backend(nvs);
+    CHECK_OK(j->open(j->ctx, "jtest"));
+
+    // Anel com registros já aplicados
+    for (uint32_t i = 0; i < STORAGE_JOURNAL_SLOTS - 1; i++) {
+        char key[8];
+        snprintf(key, sizeof(key), "w%" PRIu32, i);
+        CHECK(storage_journal_begin());
+        CHECK_OK(storage_set_u32(j, key, i));
+        CHECK_OK(storage_commit(j));
+    }
+
+    // Enche o NVS e deixa espaço para o registro de a/b/c (~22 entradas),
+    // mas não para aplicá-lo (3 x 9 entradas)
+    uint8_t filler[FILLER_LEN] = { 0 };
+    uint32_t fillers = 0;
+    for (;; fillers++) {
+        char key[8];
+        snprintf(key, sizeof(key), "f%" PRIu32, fillers);
+        esp_err_t ret = storage_set(j, key, filler, sizeof(filler));
+        if (ret == ESP_ERR_NO_MEM) {
+            break;
+        }
+        CHECK_OK(ret);
+    }
+    CHECK_OK(storage_commit(j));
+    while (free_entries(nvs) < 27) {
+        char key[8];
+        snprintf(key, sizeof(key), "f%" PRIu32, --fillers);
+        CHECK_OK(storage_erase(j, key));
+    }
+    CHECK_OK(storage_commit(j));
+
+    // Registro gravado: o grupo está confirmado mesmo sem ter sido aplicado
+    CHECK_OK(group_abc(j));
+    storage_journal_stats_t stats;
+    storage_journal_get_stats(&stats);
+    CHECK(stats.pending && stats.deferred == 1);
+    check_value(j, "a", 'a');
+    check_value(j, "c", 'c');
+    size_t len = 0;
+    CHECK(storage_get(nvs, "c", NULL, &len) == ESP_ERR_NOT_FOUND);
+
+    // Sem espaço, gravações que não liberam nada falham e não mexem no pendente
+    CHECK(storage_set_u32(j, "x", 1) == ESP_ERR_NO_MEM);
+    CHECK(storage_journal_begin());
+    CHECK_OK(storage_set_u32(j, "y", 1));
+    CHECK(storage_commit(j) == ESP_ERR_NO_MEM);
+    uint32_t value;
+    CHECK(storage_get_u32(j, "y", &value) == ESP_ERR_NOT_FOUND);
+
+    // Reabrir com o NVS ainda cheio: o registro continua pendente e visível
+    j->close(j->ctx);
+    CHECK_OK(j->open(j->ctx, "jtest"));
+    storage_journal_get_stats(&stats);
+    CHECK(stats.pending && stats.replayed == 1);
+    check_value(j, "b", 'b');
+
+    // Remoção: vai junto com o pendente, apaga primeiro e aplica tudo
+    CHECK(storage_journal_begin());
+    for (uint32_t i = 0; i < 10; i++) {
+        char key[8];
+        snprintf(key, sizeof(key), "f%" PRIu32, --fillers);
+        CHECK_OK(storage_erase(j, key));
+    }
+    CHECK_OK(storage_commit(j));
+    storage_journal_get_stats(&stats);
+    CHECK(!stats.pending);
+    check_value(nvs, "a", 'a');
+    check_value(nvs, "b", 'b');
+    check_value(nvs, "c", 'c');
+    char key[8];
+    snprintf(key, sizeof(key), "f%" PRIu32, fillers);
+    CHECK(storage_get(nvs, key, NULL, &len) == ESP_ERR_NOT_FOUND);
+
+    // Espaço de volta: gravações normais e nada a refazer no próximo open
+    CHECK_OK(storage_set_u32(j, "x", 1));
+    CHECK_OK(storage_commit(j));
+    j->close(j->ctx);
+    CHECK_OK(j->open(j->ctx, "jtest"));
+    storage_journal_get_stats(&stats);
+    CHECK(!stats.pending && stats.replayed == 0);
+    check_value(j, "a", 'a');
+    j->close(j->ctx);
+    printf("test_storage_journal: ok\n");
+    return 0;
+}
@@ -0,0 +1,68 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+// Utilidades dos testes no host: CHECK vale também em builds sem assert
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <malloc.h>
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "fake_host.h"
+#include "access_log.h"
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: falhou: %s\n", __FILE__, __LINE__, #cond); \
+        exit(1); \
+    } \
+} while (0)
+
+#define CHECK_OK(expr) do { \
+    esp_err_t check_ret_ = (expr); \
+    if (check_ret_ != ESP_OK) { \
+        fprintf(stderr, "%s:%d: %s retornou %s\n", __FILE__, __LINE__, #expr, esp_err_to_name(check_ret_)); \
+        exit(1); \
+    } \
+} while (0)
+
+// Ambiente limpo com as partições de partitions.csv (layout de 2MB)
+static inline void test_reset_flash(void) {
+    fake_nvs_reset();
+    fake_partition_reset();
+    fake_nvs_set_partition_size("nvs", 0x6000);
+    fake_nvs_set_partition_size("rfid0", 0xB0000);
+    fake_partition_add(ACCESS_LOG_PARTITION_LABEL, ACCESS_LOG_PARTITION_SUBTYPE, 0x40000);
+}
+
+// UID de 4 bytes no formato do leitor ("AA:BB:CC:DD") para o índice i
+static inline void test_uid(uint32_t i, char *uid, size_t size) {
+    snprintf(uid, size, "%02X:%02X:%02X:%02X", (unsigned)((i >> 16) & 0xFF), (unsigned)((i >> 8) & 0xFF),
+             (unsigned)(i & 0xFF), (unsigned)((i * 7u + 0x5Au) & 0xFF));
+}
+
+// Argumento numérico opcional da linha de comando
+static inline long test_arg(int argc, char **argv, int index, long fallback) {
+    return argc > index ? strtol(argv[index], NULL, 10) : fallback;
+}
+
+static inline int64_t test_now_us(void) {
+    return esp_timer_get_time();
+}
+
+// Bytes alocados no heap agora (malloc do sanitizer ou da glibc); o
+// runtime do sanitizer exporta a função mesmo sem o cabeçalho instalado
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+size_t __sanitizer_get_current_allocated_bytes(void);
+#endif
+
+static inline size_t test_heap_used(void) {
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+    return __sanitizer_get_current_allocated_bytes();
+#else
+    return mallinfo2().uordblks;
+#endif
+}
+
+#endif // TEST_UTIL_H